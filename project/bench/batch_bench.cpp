@@ -0,0 +1,255 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** Cost of many small cloths simulated by a cloth_batch, compared with the
+ *  same cloths stepped one after the other as separate mesh_parametric_cloth.
+ *  The results are written in JSON.
+ *
+ *  usage: batch_bench [--counts 1,100,10000] [--size 16] [--min-time 0.5]
+ *                     [--integrator explicit|implicit|xpbd] [--wind F]
+ *                     [--separate-max 1000] [--output file.json]
+ *
+ *  Each instance is a size x size grid fixed by two corners, with its own
+ *  stiffness. The separate cloths are only simulated up to separate-max
+ *  instances. For a single instance, the batch is also checked against the
+ *  separate cloth (max_deviation: largest distance between the positions).
+ */
+
+#include "bench_common.hpp"
+#include "../src/cloth/cloth_batch.hpp"
+#include "../src/cloth/mesh_parametric_cloth.hpp"
+#include "../src/lib/common/error_handling.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace cpe;
+using namespace bench;
+
+namespace
+{
+
+/** Parameters of the benchmark */
+struct settings
+{
+    std::vector<int> counts = {1,100,10000};
+    int size = 16;
+    double min_time = 0.5;
+    cloth_integrator integrator = integrator_explicit_euler;
+    int wind_force = 0;
+    int separate_max = 1000;
+    std::string output;
+};
+
+/** Timings for one number of instances */
+struct measure
+{
+    int N_instance = 0;
+    int N_vertex = 0;
+    int N_spring = 0;
+    double build_ms = 0;
+    std::vector<double> batch_ns;
+    std::vector<double> separate_ns;
+    double max_deviation = -1;
+};
+
+settings read_settings(int argc,char** argv)
+{
+    settings param;
+    read_arguments(argc,argv,[&param](std::string const& name,std::string const& value)
+    {
+        if(name=="counts") param.counts = read_list<int>(value);
+        else if(name=="size") param.size = std::stoi(value);
+        else if(name=="min-time") param.min_time = std::stod(value);
+        else if(name=="integrator") param.integrator = read_integrator(value);
+        else if(name=="wind") param.wind_force = std::stoi(value);
+        else if(name=="separate-max") param.separate_max = std::stoi(value);
+        else if(name=="output") param.output = value;
+        else return false;
+        return true;
+    });
+
+    ASSERT_CPE(param.size>1,"Grid size should be >1");
+    for(int const N : param.counts)
+        ASSERT_CPE(N>0,"Number of instances should be >0");
+    return param;
+}
+
+/** Stiffness of the instance k (varies slightly from one instance to the other) */
+float structural_stiffness(int const k)
+{
+    return 10.0f+0.01f*(k%100);
+}
+
+/** Position of the instance k: rows of 100 cloths */
+vec3 instance_offset(int const k)
+{
+    return vec3(1.5f*(k%100),1.5f*(k/100),0.0f);
+}
+
+void bench_count(int const N_instance,settings const& param,std::vector<measure>& results)
+{
+    scene_parameters scene;
+    measure m;
+    m.N_instance = N_instance;
+
+    mesh_parametric_cloth model;
+    model.set_plane_xy_unit(param.size,param.size);
+    model.set_integrator(param.integrator);
+
+    //batch
+    auto const t_build = bench_clock::now();
+    cloth_batch batch;
+    batch.set_integrator(param.integrator);
+    for(int k=0 ; k<N_instance ; ++k)
+    {
+        int const instance = batch.add(model,instance_offset(k));
+        cloth_instance_parameters instance_param = batch.parameters(instance);
+        instance_param.k_structural = structural_stiffness(k);
+        instance_param.wind_force = param.wind_force;
+        batch.set_parameters(instance,instance_param);
+    }
+    m.N_vertex = batch.size_vertex();
+    m.N_spring = batch.springs().size();
+    m.build_ms = elapsed_ms(t_build,bench_clock::now());
+
+    repeat(m.batch_ns,param.min_time,[&]()
+    {
+        auto const t0 = bench_clock::now();
+        batch.update_force(scene.ground,scene.sphere_radius,scene.sphere_center);
+        batch.integration_step(scene.dt);
+        return elapsed_ns(t0,bench_clock::now());
+    });
+
+    //separate cloths, stepped one after the other
+    if(N_instance<=param.separate_max)
+    {
+        std::vector<std::unique_ptr<mesh_parametric_cloth> > cloths;
+        for(int k=0 ; k<N_instance ; ++k)
+        {
+            cloths.emplace_back(new mesh_parametric_cloth);
+            mesh_parametric_cloth& cloth = *cloths.back();
+            cloth.set_plane_xy_unit(param.size,param.size);
+            cloth.set_integrator(param.integrator);
+            cloth.set_k_struct(structural_stiffness(k));
+        }
+
+        bool wind = param.wind_force>0;
+        //same number of steps as the batch
+        while(m.separate_ns.size()<m.batch_ns.size())
+        {
+            auto const t0 = bench_clock::now();
+            for(int k=0 ; k<N_instance ; ++k)
+            {
+                mesh_parametric_cloth& cloth = *cloths[k];
+                cloth.update_force(scene.ground,wind,param.wind_force,scene.sphere_radius,scene.sphere_center-instance_offset(k));
+                cloth.integration_step(scene.dt);
+                if(wind)
+                {
+                    cloth.sync_mesh();
+                    cloth.fill_normal();
+                }
+            }
+            m.separate_ns.push_back(elapsed_ns(t0,bench_clock::now()));
+        }
+
+        //compare the positions of the first instance
+        if(N_instance==1 && !wind)
+        {
+            std::vector<vec3> position;
+            batch.export_positions(0,position);
+            m.max_deviation = 0;
+            for(int k=0 ; k<static_cast<int>(position.size()) ; ++k)
+            {
+                vec3 const p = cloths[0]->particle_data().position.get(k);
+                m.max_deviation = std::max(m.max_deviation,static_cast<double>(norm(position[k]-p)));
+            }
+        }
+    }
+
+    results.push_back(m);
+}
+
+void write_json(settings const& param,std::vector<measure> const& results)
+{
+    json_object header = json_header("batch_bench");
+    header.set("spring_kernel",spring_kernel_name(best_spring_kernel()));
+    header.set("integrator",integrator_name(param.integrator));
+    header.set("size_u",param.size).set("size_v",param.size);
+    header.set("wind",param.wind_force);
+    header.set("min_time_s",param.min_time);
+
+    std::vector<json_object> lines;
+    for(measure const& m : results)
+    {
+        double const t_batch = median(m.batch_ns);
+        json_object line;
+        line.set("instances",m.N_instance)
+            .set("vertices",m.N_vertex).set("springs",m.N_spring)
+            .set("build_ms",m.build_ms)
+            .set("steps",m.batch_ns.size())
+            .set("batch_step_median_ns",t_batch)
+            .set("batch_ns_per_instance",t_batch/m.N_instance)
+            .set("batch_ns_per_vertex",t_batch/m.N_vertex);
+        if(m.separate_ns.empty())
+            line.set_null("separate_step_median_ns").set_null("separate_ns_per_instance").set_null("speedup");
+        else
+        {
+            double const t_separate = median(m.separate_ns);
+            line.set("separate_step_median_ns",t_separate)
+                .set("separate_ns_per_instance",t_separate/m.N_instance)
+                .set("speedup",t_separate/t_batch);
+        }
+        if(m.max_deviation<0)
+            line.set_null("max_deviation");
+        else
+            line.set("max_deviation",m.max_deviation);
+        lines.push_back(line);
+    }
+    bench::write_json(param.output,header,lines);
+}
+
+}
+
+int main(int argc,char** argv)
+{
+    try
+    {
+        settings const param = read_settings(argc,argv);
+
+        std::vector<measure> results;
+        for(int const N : param.counts)
+        {
+            std::cerr<<N<<" instances ..."<<std::endl;
+            bench_count(N,param,results);
+        }
+
+        write_json(param,results);
+
+        return EXIT_SUCCESS;
+    }
+    catch(exception_cpe const& e)
+    {
+        std::cerr<<std::endl<<e.report_exception()<<std::endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,235 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef BENCH_COMMON_HPP
+#define BENCH_COMMON_HPP
+
+/** Helpers shared by the benchmarks of project/bench: timing, median,
+ *  command line of "--name value" pairs and JSON output.
+ *
+ *  The output of a benchmark is a JSON object made of header fields and of an
+ *  array "results" with one object per measure:
+ *  {"benchmark": name, "threads": N, <header fields>, "results": [{...},{...}]}
+ */
+
+#include "../src/cloth/particle_dynamics.hpp"
+#include "../src/lib/3d/vec3.hpp"
+#include "../src/lib/common/error_handling.hpp"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bench
+{
+
+typedef std::chrono::steady_clock bench_clock;
+
+inline double elapsed_ns(bench_clock::time_point const& t0,bench_clock::time_point const& t1)
+{
+    return std::chrono::duration<double,std::nano>(t1-t0).count();
+}
+
+inline double elapsed_ms(bench_clock::time_point const& t0,bench_clock::time_point const& t1)
+{
+    return std::chrono::duration<double,std::milli>(t1-t0).count();
+}
+
+inline double median(std::vector<double> values)
+{
+    ASSERT_CPE(!values.empty(),"No value");
+    std::sort(values.begin(),values.end());
+    int const N = values.size();
+    return N%2==1 ? values[N/2] : 0.5*(values[N/2-1]+values[N/2]);
+}
+
+/** Repeat the timed call f() (returning its time in ns) until min_time seconds
+ *  are spent, at least 3 calls */
+template <typename FUNCTION>
+void repeat(std::vector<double>& times_ns,double const min_time,FUNCTION f)
+{
+    double total = 0.0;
+    while(times_ns.size()<3 || total<min_time*1e9)
+    {
+        double const t = f();
+        times_ns.push_back(t);
+        total += t;
+    }
+}
+
+/** Scene of the interactive program: ground, sphere and time step */
+struct scene_parameters
+{
+    float ground = -1.101f;
+    cpe::vec3 sphere_center = cpe::vec3(0.5f,0.05f,-1.1f);
+    float sphere_radius = 0.198f;
+    float dt = 0.15f;
+};
+
+/** Call read(name,value) for each pair "--name value" of the command line,
+ *  read returns false if it does not know the argument */
+template <typename READ>
+void read_arguments(int argc,char** argv,READ read)
+{
+    for(int k=1 ; k<argc ; ++k)
+    {
+        std::string const arg = argv[k];
+        ASSERT_CPE(k+1<argc,"Missing value after "+arg);
+        std::string const value = argv[++k];
+        if(arg.compare(0,2,"--")!=0 || !read(arg.substr(2),value))
+            throw cpe::exception_cpe("Unknown argument "+arg,EXCEPTION_PARAMETERS_CPE);
+    }
+}
+
+/** Comma separated list of values (1,2,3) */
+template <typename T>
+std::vector<T> read_list(std::string const& value)
+{
+    std::vector<T> values;
+    std::stringstream tokens(value);
+    std::string token;
+    while(std::getline(tokens,token,','))
+    {
+        std::stringstream token_value(token);
+        T v;
+        if(!(token_value>>v))
+            throw cpe::exception_cpe("Incorrect value "+token+" in "+value,EXCEPTION_PARAMETERS_CPE);
+        values.push_back(v);
+    }
+    return values;
+}
+
+inline cpe::cloth_integrator read_integrator(std::string const& value)
+{
+    if(value=="explicit") return cpe::integrator_explicit_euler;
+    if(value=="implicit") return cpe::integrator_implicit_euler;
+    if(value=="xpbd") return cpe::integrator_xpbd;
+    throw cpe::exception_cpe("Unknown integrator "+value,EXCEPTION_PARAMETERS_CPE);
+}
+
+inline std::string integrator_name(cpe::cloth_integrator const type)
+{
+    switch(type)
+    {
+    case cpe::integrator_explicit_euler: return "explicit";
+    case cpe::integrator_implicit_euler: return "implicit";
+    case cpe::integrator_xpbd: return "xpbd";
+    }
+    return "unknown";
+}
+
+/** Fields "name": value of a JSON object, in insertion order */
+class json_object
+{
+public:
+
+    /** Numbers (a non finite value is written as null) */
+    template <typename T>
+    json_object& set(std::string const& name,T const value)
+    {
+        std::ostringstream v;
+        v<<value;
+        fields.push_back({name,std::isfinite(static_cast<double>(value)) ? v.str() : std::string("null")});
+        return *this;
+    }
+    json_object& set(std::string const& name,bool const value)
+    {
+        fields.push_back({name,value ? "true" : "false"});
+        return *this;
+    }
+    json_object& set(std::string const& name,std::string const& value)
+    {
+        fields.push_back({name,"\""+value+"\""});
+        return *this;
+    }
+    json_object& set(std::string const& name,char const* value)
+    {
+        return set(name,std::string(value));
+    }
+    json_object& set_null(std::string const& name)
+    {
+        fields.push_back({name,"null"});
+        return *this;
+    }
+
+    int size() const {return fields.size();}
+    /** "name": value of the field k */
+    std::string field(int const k) const {return "\""+fields[k].first+"\": "+fields[k].second;}
+    /** {"name": value, ...} on one line */
+    std::string str() const
+    {
+        std::string s = "{";
+        for(int k=0 ; k<size() ; ++k)
+            s += (k>0 ? ", " : "")+field(k);
+        return s+"}";
+    }
+
+private:
+
+    std::vector<std::pair<std::string,std::string>> fields;
+};
+
+/** Header of the output of the benchmark name (name and number of threads) */
+inline json_object json_header(std::string const& name)
+{
+    json_object header;
+    header.set("benchmark",name);
+    header.set("threads",omp_get_max_threads());
+    return header;
+}
+
+/** Header fields one per line, then the results one per line */
+inline void write_json(std::ostream& out,json_object const& header,std::vector<json_object> const& results)
+{
+    out<<"{"<<std::endl;
+    for(int k=0 ; k<header.size() ; ++k)
+        out<<"  "<<header.field(k)<<","<<std::endl;
+    out<<"  \"results\": ["<<std::endl;
+    for(int k=0 ; k<static_cast<int>(results.size()) ; ++k)
+        out<<"    "<<results[k].str()<<(k+1<static_cast<int>(results.size())?",":"")<<std::endl;
+    out<<"  ]"<<std::endl;
+    out<<"}"<<std::endl;
+}
+
+/** Write the JSON output in the file output, or on the standard output if it is empty */
+inline void write_json(std::string const& output,json_object const& header,std::vector<json_object> const& results)
+{
+    if(output.empty())
+    {
+        write_json(std::cout,header,results);
+        return;
+    }
+    std::ofstream fid(output.c_str());
+    if(!fid.good())
+        throw cpe::exception_cpe("Cannot open file "+output,EXCEPTION_PARAMETERS_CPE);
+    write_json(fid,header,results);
+}
+
+}
+
+#endif
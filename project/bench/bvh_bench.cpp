@@ -0,0 +1,348 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** Build, refit and queries of the bvh on triangle meshes of increasing size.
+ *  The results are written in JSON.
+ *
+ *  usage: bvh_bench [--triangles 500,50000,5000000] [--mesh file.obj/.off]
+ *                   [--queries 100000] [--check 1000] [--output file.json]
+ *
+ *  The meshes are bumpy spheres of radius ~1 (or the given file). The queries
+ *  (closest point at a distance < 0.05, rays from outside toward the center,
+ *  spheres of radius 0.02) are placed randomly around the surface. The first
+ *  --check queries are compared with a brute force loop over all the
+ *  triangles (mismatch: number of different answers, brute_force_ns: time of
+ *  the three brute force queries). The collision of a
+ *  100x100 cloth with the mesh (mesh_collider) is also timed.
+ */
+
+#include "bench_common.hpp"
+#include "../src/cloth/mesh_collider.hpp"
+#include "../src/cloth/mesh_parametric_cloth.hpp"
+#include "../src/lib/intersection/bvh.hpp"
+#include "../src/lib/mesh/mesh.hpp"
+#include "../src/lib/mesh/mesh_io.hpp"
+#include "../src/lib/random/counter_rng.hpp"
+#include "../src/lib/common/error_handling.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace cpe;
+using namespace bench;
+
+namespace
+{
+
+/** Parameters of the benchmark */
+struct settings
+{
+    std::vector<int> triangles = {500,50000,5000000};
+    std::string mesh_file;
+    int queries = 100000;
+    int check = 1000;
+    std::string output;
+};
+
+/** Timings for one mesh */
+struct measure
+{
+    int N_triangle = 0;
+    int N_node = 0;
+    int depth = 0;
+    double build_ms = 0;
+    double refit_ms = 0;
+    double closest_ns = 0;
+    double ray_ns = 0;
+    double sphere_ns = 0;
+    double brute_force_ns = 0;
+    double cloth_collide_ms = 0;
+    int mismatch = 0;
+};
+
+float const query_distance = 0.05f;
+float const query_radius = 0.02f;
+
+settings read_settings(int argc,char** argv)
+{
+    settings param;
+    read_arguments(argc,argv,[&param](std::string const& name,std::string const& value)
+    {
+        if(name=="triangles") param.triangles = read_list<int>(value);
+        else if(name=="mesh") param.mesh_file = value;
+        else if(name=="queries") param.queries = std::stoi(value);
+        else if(name=="check") param.check = std::stoi(value);
+        else if(name=="output") param.output = value;
+        else return false;
+        return true;
+    });
+
+    ASSERT_CPE(param.queries>0,"Number of queries should be >0");
+    return param;
+}
+
+/** Sphere of radius ~1 with bumps, about N_triangle triangles (latitude/longitude grid) */
+mesh bumpy_sphere(int const N_triangle,float const phase)
+{
+    int const N_u = std::max(4,static_cast<int>(std::sqrt(N_triangle)));
+    int const N_v = std::max(3,N_triangle/(2*N_u));
+    float const pi = 3.14159265f;
+
+    mesh m;
+    for(int kv=0 ; kv<=N_v ; ++kv)
+    {
+        float const theta = pi*kv/N_v;
+        for(int ku=0 ; ku<N_u ; ++ku)
+        {
+            float const phi = 2.0f*pi*ku/N_u;
+            float const r = 1.0f+0.05f*std::sin(7.0f*phi+phase)*std::sin(5.0f*theta);
+            m.add_vertex(vec3(r*std::sin(theta)*std::cos(phi),r*std::sin(theta)*std::sin(phi),r*std::cos(theta)));
+        }
+    }
+    for(int kv=0 ; kv<N_v ; ++kv)
+    {
+        for(int ku=0 ; ku<N_u ; ++ku)
+        {
+            int const i0 = kv*N_u+ku;
+            int const i1 = kv*N_u+(ku+1)%N_u;
+            m.add_triangle_index(triangle_index(i0,i0+N_u,i1));
+            m.add_triangle_index(triangle_index(i1,i0+N_u,i1+N_u));
+        }
+    }
+    return m;
+}
+
+/** Distance between p and the triangle (a,b,c) */
+float point_triangle_distance(vec3 const& p,vec3 const& a,vec3 const& b,vec3 const& c)
+{
+    //inside the prism of the triangle: distance to the plane, otherwise to the closest edge
+    vec3 const n = normalized(cross(b-a,c-a));
+    vec3 const q = p-dot(p-a,n)*n;
+    if(dot(cross(b-a,q-a),n)>=0.0f && dot(cross(c-b,q-b),n)>=0.0f && dot(cross(a-c,q-c),n)>=0.0f)
+        return std::abs(dot(p-a,n));
+
+    float d = norm(p-a);
+    vec3 const corners[3] = {a,b,c};
+    for(int k=0 ; k<3 ; ++k)
+    {
+        vec3 const e0 = corners[k], e1 = corners[(k+1)%3];
+        float const t = std::min(std::max(dot(p-e0,e1-e0)/dot(e1-e0,e1-e0),0.0f),1.0f);
+        d = std::min(d,norm(p-(e0+t*(e1-e0))));
+    }
+    return d;
+}
+
+/** Parameter of the intersection of the ray with the triangle (a,b,c), <0 if none */
+float ray_triangle_parameter(vec3 const& origin,vec3 const& direction,vec3 const& a,vec3 const& b,vec3 const& c)
+{
+    vec3 const n = cross(b-a,c-a);
+    float const dn = dot(direction,n);
+    if(std::abs(dn)<1e-12f)
+        return -1.0f;
+    float const t = dot(a-origin,n)/dn;
+    vec3 const q = origin+t*direction;
+    if(dot(cross(b-a,q-a),n)>=0.0f && dot(cross(c-b,q-b),n)>=0.0f && dot(cross(a-c,q-c),n)>=0.0f)
+        return t;
+    return -1.0f;
+}
+
+/** Answers of the three queries by a loop over all the triangles */
+struct brute_force_answer
+{
+    float distance = -1.0f;
+    float t = -1.0f;
+    int N_overlap = 0;
+};
+
+brute_force_answer brute_force(mesh const& m,vec3 const& p,vec3 const& origin,vec3 const& direction)
+{
+    brute_force_answer answer;
+    for(int k=0 ; k<m.size_connectivity() ; ++k)
+    {
+        triangle_index const tri = m.connectivity(k);
+        vec3 const a = m.vertex(tri.u0()), b = m.vertex(tri.u1()), c = m.vertex(tri.u2());
+
+        float const d = point_triangle_distance(p,a,b,c);
+        if(answer.distance<0.0f || d<answer.distance)
+            answer.distance = d;
+        if(d<=query_radius)
+            ++answer.N_overlap;
+
+        float const t = ray_triangle_parameter(origin,direction,a,b,c);
+        if(t>=0.0f && (answer.t<0.0f || t<answer.t))
+            answer.t = t;
+    }
+    return answer;
+}
+
+void bench_mesh(mesh& m,settings const& param,std::vector<measure>& results)
+{
+    measure r;
+    r.N_triangle = m.size_connectivity();
+    std::cerr<<r.N_triangle<<" triangles ..."<<std::endl;
+
+    bvh tree;
+    auto const t_build = bench_clock::now();
+    tree.build(m);
+    r.build_ms = elapsed_ms(t_build,bench_clock::now());
+    r.N_node = tree.size_node();
+    r.depth = tree.depth();
+
+    //queries around the surface
+    int const N = param.queries;
+    counter_rng const rng(1,0);
+    std::vector<float> x(N),y(N),z(N);
+    std::vector<vec3> center(N),origin(N),direction(N);
+    for(int k=0 ; k<N ; ++k)
+    {
+        vec3 const d = normalized(vec3(rng.uniform(4*k)-0.5f,rng.uniform(4*k+1)-0.5f,rng.uniform(4*k+2)-0.5f)+vec3(1e-4f,0,0));
+        float const r_query = 0.9f+0.2f*rng.uniform(4*k+3);
+        vec3 const p = r_query*d;
+        x[k] = p.x(); y[k] = p.y(); z[k] = p.z();
+        center[k] = p;
+        origin[k] = 2.0f*d;
+        direction[k] = -d;
+    }
+
+    std::vector<bvh_closest_point> closest;
+    auto const t0 = bench_clock::now();
+    tree.closest_point(x.data(),y.data(),z.data(),N,query_distance,closest);
+    auto const t1 = bench_clock::now();
+    std::vector<bvh_ray_hit> hits;
+    tree.ray(origin,direction,4.0f,hits);
+    auto const t2 = bench_clock::now();
+    std::vector<int> offset,overlap;
+    tree.sphere_overlap(center,query_radius,offset,overlap);
+    auto const t3 = bench_clock::now();
+    r.closest_ns = elapsed_ns(t0,t1)/N;
+    r.ray_ns = elapsed_ns(t1,t2)/N;
+    r.sphere_ns = elapsed_ns(t2,t3)/N;
+
+    //brute force check (on meshes small enough)
+    int const N_check = static_cast<long>(param.check)*r.N_triangle<=500000000L ? std::min(param.check,N) : 0;
+    auto const t_brute = bench_clock::now();
+    for(int k=0 ; k<N_check ; ++k)
+    {
+        brute_force_answer const expected = brute_force(m,center[k],origin[k],direction[k]);
+
+        //closest point: same distance (or both farther than the query distance)
+        bool const found = closest[k].triangle>=0;
+        if(found!=(expected.distance<query_distance) || (found && std::abs(closest[k].distance-expected.distance)>1e-4f))
+            ++r.mismatch;
+        //ray: same first hit
+        if((hits[k].triangle>=0)!=(expected.t>=0.0f) || (hits[k].triangle>=0 && std::abs(hits[k].t-expected.t)>1e-4f))
+            ++r.mismatch;
+        //sphere: same number of triangles
+        if(offset[k+1]-offset[k]!=expected.N_overlap)
+            ++r.mismatch;
+    }
+    if(N_check>0)
+        r.brute_force_ns = elapsed_ns(t_brute,bench_clock::now())/N_check;
+
+    //deformation of the mesh then refit
+    mesh moved = bumpy_sphere(r.N_triangle,0.3f);
+    if(param.mesh_file.empty() && moved.size_connectivity()==r.N_triangle)
+    {
+        auto const t_refit = bench_clock::now();
+        tree.refit(moved);
+        r.refit_ms = elapsed_ms(t_refit,bench_clock::now());
+    }
+
+    //cloth 100x100 laid on the top of the mesh
+    mesh_parametric_cloth cloth;
+    cloth.set_plane_xy_unit(100,100);
+    particle_store particles = cloth.particle_data();
+    for(int k=0 ; k<particles.size() ; ++k)
+    {
+        particles.position.x[k] = 2.0f*particles.position.x[k]-1.0f;
+        particles.position.y[k] = 2.0f*particles.position.y[k]-1.0f;
+        particles.position.z[k] = 1.0f;
+    }
+    mesh_collider collider;
+    collider.set_mesh(m);
+    auto const t_cloth = bench_clock::now();
+    collider.collide(particles);
+    r.cloth_collide_ms = elapsed_ms(t_cloth,bench_clock::now());
+
+    results.push_back(r);
+}
+
+void write_json(settings const& param,std::vector<measure> const& results)
+{
+    json_object header = json_header("bvh_bench");
+    header.set("mesh",param.mesh_file.empty() ? "bumpy_sphere" : param.mesh_file);
+    header.set("queries",param.queries);
+
+    std::vector<json_object> lines;
+    for(measure const& r : results)
+    {
+        json_object line;
+        line.set("triangles",r.N_triangle)
+            .set("nodes",r.N_node).set("depth",r.depth)
+            .set("build_ms",r.build_ms).set("refit_ms",r.refit_ms)
+            .set("closest_point_ns",r.closest_ns)
+            .set("ray_ns",r.ray_ns)
+            .set("sphere_overlap_ns",r.sphere_ns);
+        if(r.brute_force_ns>0)
+            line.set("brute_force_ns",r.brute_force_ns);
+        else
+            line.set_null("brute_force_ns");
+        line.set("cloth_collide_ms",r.cloth_collide_ms)
+            .set("mismatch",r.mismatch);
+        lines.push_back(line);
+    }
+    bench::write_json(param.output,header,lines);
+}
+
+}
+
+int main(int argc,char** argv)
+{
+    try
+    {
+        settings const param = read_settings(argc,argv);
+
+        std::vector<measure> results;
+        if(!param.mesh_file.empty())
+        {
+            mesh m = load_mesh_file(param.mesh_file);
+            bench_mesh(m,param,results);
+        }
+        else
+        {
+            for(int const N : param.triangles)
+            {
+                mesh m = bumpy_sphere(N,0.0f);
+                bench_mesh(m,param,results);
+            }
+        }
+
+        write_json(param,results);
+
+        return EXIT_SUCCESS;
+    }
+    catch(exception_cpe const& e)
+    {
+        std::cerr<<std::endl<<e.report_exception()<<std::endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,293 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** Size and speed of the cloth caches: the frames of a simulation are
+ *  recorded with the raw codec and with the quantized codec for several
+ *  tolerances. The results are written in JSON.
+ *
+ *  usage: cache_bench [--size 100] [--steps 300] [--wind 25] [--normals 0/1]
+ *                     [--tolerances 1e-3,1e-4,1e-5] [--frames-per-chunk 16]
+ *                     [--file cache_bench.ccache] [--output file.json]
+ *
+ *  The frames are kept in memory (size*size*steps*12 bytes, twice with the
+ *  normals). For each codec: encode time of the chunks (writing thread
+ *  excluded), file size and compression ratio against the raw floats,
+ *  sequential playback (read_frame of every frame, decoding included) and
+ *  random seeks, largest error against the simulated values. The cache file
+ *  is removed at the end.
+ */
+
+#include "bench_common.hpp"
+#include "../src/cloth/cloth_cache.hpp"
+#include "../src/cloth/cloth_cache_codec.hpp"
+#include "../src/cloth/mesh_parametric_cloth.hpp"
+#include "../src/lib/common/error_handling.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace cpe;
+using namespace bench;
+
+namespace
+{
+
+/** Parameters of the benchmark */
+struct settings
+{
+    int size = 100;
+    int steps = 300;
+    int wind_force = 25;
+    bool normals = false;
+    std::vector<float> tolerances = {1e-3f,1e-4f,1e-5f};
+    int frames_per_chunk = 16;
+    std::string file = "cache_bench.ccache";
+    std::string output;
+};
+
+/** Results for one codec */
+struct measure
+{
+    std::string codec;
+    float tolerance = 0;
+    long file_bytes = 0;
+    double encode_ms = 0;
+    double playback_ms = 0;
+    double seek_us = 0;
+    float max_error_position = 0;
+    float max_error_normal = 0;
+};
+
+settings read_settings(int argc,char** argv)
+{
+    settings param;
+    read_arguments(argc,argv,[&param](std::string const& name,std::string const& value)
+    {
+        if(name=="size") param.size = std::stoi(value);
+        else if(name=="steps") param.steps = std::stoi(value);
+        else if(name=="wind") param.wind_force = std::stoi(value);
+        else if(name=="normals") param.normals = std::stoi(value)!=0;
+        else if(name=="tolerances") param.tolerances = read_list<float>(value);
+        else if(name=="frames-per-chunk") param.frames_per_chunk = std::stoi(value);
+        else if(name=="file") param.file = value;
+        else if(name=="output") param.output = value;
+        else return false;
+        return true;
+    });
+
+    ASSERT_CPE(param.size>1,"Grid size should be >1");
+    ASSERT_CPE(param.steps>0,"Number of steps should be >0");
+    ASSERT_CPE(param.frames_per_chunk>0,"Frames per chunk should be >0");
+    for(float const tolerance : param.tolerances)
+        ASSERT_CPE(tolerance>0,"Tolerance should be >0");
+    return param;
+}
+
+/** Simulate the cloth and store its frames (layout of the raw chunks) */
+void simulate(settings const& param,std::vector<float>& frames)
+{
+    scene_parameters scene;
+    mesh_parametric_cloth cloth;
+    cloth.set_plane_xy_unit(param.size,param.size);
+
+    int const N = cloth.size_vertex();
+    size_t const frame_size = static_cast<size_t>(N)*(param.normals ? 6 : 3);
+    frames.resize(frame_size*param.steps);
+
+    bool wind = param.wind_force>0;
+    for(int step=0 ; step<param.steps ; ++step)
+    {
+        cloth.update_force(scene.ground,wind,param.wind_force,scene.sphere_radius,scene.sphere_center);
+        cloth.integration_step(scene.dt);
+        if(wind || param.normals)
+        {
+            cloth.sync_mesh();
+            cloth.fill_normal();
+        }
+
+        float* const frame = &frames[step*frame_size];
+        particle_store const& particles = cloth.particle_data();
+        std::copy(particles.position.x.begin(),particles.position.x.end(),frame);
+        std::copy(particles.position.y.begin(),particles.position.y.end(),frame+N);
+        std::copy(particles.position.z.begin(),particles.position.z.end(),frame+2*N);
+        if(param.normals)
+        {
+            float const* const normal = cloth.pointer_normal();
+            for(int k=0 ; k<N ; ++k)
+                for(int i=0 ; i<3 ; ++i)
+                    frame[(3+i)*N+k] = normal[3*k+i];
+        }
+    }
+}
+
+void bench_codec(cloth_cache_info const& info,std::vector<float> const& frames,int const N_frame,
+                 settings const& param,std::vector<measure>& results)
+{
+    measure m;
+    m.codec = info.codec==codec_raw ? "raw" : "quantized";
+    m.tolerance = info.codec==codec_raw ? 0.0f : info.tolerance;
+    int const N = info.N_vertex;
+    size_t const frame_size = static_cast<size_t>(N)*cache_channel_count(info);
+
+    //encoding alone (done by the writing thread of the recorder)
+    if(info.codec==codec_quantized)
+    {
+        std::vector<char> payload;
+        auto const t0 = bench_clock::now();
+        for(int f=0 ; f<N_frame ; f+=info.frames_per_chunk)
+            encode_quantized_chunk(&frames[f*frame_size],std::min(info.frames_per_chunk,N_frame-f),info,payload);
+        m.encode_ms = elapsed_ms(t0,bench_clock::now());
+    }
+
+    cloth_recorder recorder;
+    recorder.open(param.file,info);
+    for(int f=0 ; f<N_frame ; ++f)
+    {
+        float const* const frame = &frames[f*frame_size];
+        std::vector<float> normal;
+        if(info.has_normal)
+        {
+            normal.resize(3*N);
+            for(int k=0 ; k<N ; ++k)
+                for(int i=0 ; i<3 ; ++i)
+                    normal[3*k+i] = frame[(3+i)*N+k];
+        }
+        recorder.push_frame(frame,frame+N,frame+2*N,info.has_normal ? normal.data() : nullptr);
+    }
+    recorder.close();
+    {
+        std::ifstream fid(param.file.c_str(),std::ios::binary|std::ios::ate);
+        m.file_bytes = fid.tellg();
+    }
+
+    //playback of every frame, then random seeks
+    cloth_cache cache;
+    cache.open(param.file);
+    std::vector<vec3> position,normal;
+    auto const t_play = bench_clock::now();
+    for(int f=0 ; f<N_frame ; ++f)
+        cache.read_frame(f,position,&normal);
+    m.playback_ms = elapsed_ms(t_play,bench_clock::now());
+
+    std::mt19937 generator(1);
+    std::uniform_int_distribution<int> random_frame(0,N_frame-1);
+    int const N_seek = 50;
+    auto const t_seek = bench_clock::now();
+    for(int k=0 ; k<N_seek ; ++k)
+        cache.read_frame(random_frame(generator),position,&normal);
+    m.seek_us = 1000.0*elapsed_ms(t_seek,bench_clock::now())/N_seek;
+
+    for(int f=0 ; f<N_frame ; ++f)
+    {
+        cache.read_frame(f,position,&normal);
+        float const* const frame = &frames[f*frame_size];
+        for(int k=0 ; k<N ; ++k)
+            for(int i=0 ; i<3 ; ++i)
+            {
+                m.max_error_position = std::max(m.max_error_position,std::abs(position[k][i]-frame[i*N+k]));
+                if(info.has_normal)
+                    m.max_error_normal = std::max(m.max_error_normal,std::abs(normal[k][i]-frame[(3+i)*N+k]));
+            }
+    }
+    cache.close();
+    std::remove(param.file.c_str());
+
+    results.push_back(m);
+}
+
+void write_json(settings const& param,std::vector<measure> const& results)
+{
+    int const N = param.size*param.size;
+    double const raw_bytes = static_cast<double>(N)*(param.normals ? 6 : 3)*sizeof(float)*param.steps;
+
+    json_object header = json_header("cache_bench");
+    header.set("size_u",param.size).set("size_v",param.size);
+    header.set("frames",param.steps);
+    header.set("wind",param.wind_force);
+    header.set("normals",param.normals);
+    header.set("frames_per_chunk",param.frames_per_chunk);
+    header.set("raw_bytes",static_cast<long>(raw_bytes));
+
+    std::vector<json_object> lines;
+    for(measure const& m : results)
+    {
+        json_object line;
+        line.set("codec",m.codec).set("tolerance",m.tolerance)
+            .set("file_bytes",m.file_bytes)
+            .set("compression_ratio",raw_bytes/m.file_bytes)
+            .set("bits_per_vertex_frame",8.0*m.file_bytes/(static_cast<double>(N)*param.steps))
+            .set("encode_ms_per_frame",m.encode_ms/param.steps)
+            .set("playback_frames_per_s",1000.0*param.steps/m.playback_ms)
+            .set("playback_mb_per_s",raw_bytes/(1000.0*m.playback_ms))
+            .set("seek_us",m.seek_us)
+            .set("max_error_position",m.max_error_position);
+        if(param.normals)
+            line.set("max_error_normal",m.max_error_normal);
+        lines.push_back(line);
+    }
+    bench::write_json(param.output,header,lines);
+}
+
+}
+
+int main(int argc,char** argv)
+{
+    try
+    {
+        settings const param = read_settings(argc,argv);
+
+        std::cerr<<"simulation of "<<param.steps<<" frames ..."<<std::endl;
+        std::vector<float> frames;
+        simulate(param,frames);
+
+        cloth_cache_info info;
+        info.N_vertex = param.size*param.size;
+        info.size_u = param.size;
+        info.size_v = param.size;
+        info.has_normal = param.normals;
+        info.frames_per_chunk = param.frames_per_chunk;
+        info.dt = scene_parameters().dt;
+
+        std::vector<measure> results;
+        std::cerr<<"raw ..."<<std::endl;
+        bench_codec(info,frames,param.steps,param,results);
+        info.codec = codec_quantized;
+        for(float const tolerance : param.tolerances)
+        {
+            std::cerr<<"quantized "<<tolerance<<" ..."<<std::endl;
+            info.tolerance = tolerance;
+            bench_codec(info,frames,param.steps,param,results);
+        }
+
+        write_json(param,results);
+
+        return EXIT_SUCCESS;
+    }
+    catch(exception_cpe const& e)
+    {
+        std::cerr<<std::endl<<e.report_exception()<<std::endl;
+        return EXIT_FAILURE;
+    }
+}
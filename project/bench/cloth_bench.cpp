@@ -0,0 +1,243 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** Micro benchmarks of the hot paths of the simulation: update_force,
+ *  integration_step, fill_normal (generic, two parallel passes and grid
+ *  gather) and set_plane_xy_unit, timed separately
+ *  for several grid sizes. The results are written in JSON.
+ *
+ *  usage: cloth_bench [--sizes 50,100,200,500,1000,2000] [--min-time 0.5]
+ *                     [--integrator explicit|implicit|xpbd] [--output file.json]
+ *
+ *  For each operation, the call is repeated until min-time seconds are spent
+ *  (at least 3 calls). The bandwidth is the estimated compulsory memory
+ *  traffic of one call (each array read/written once) divided by the median
+ *  time, it is null when no simple estimate exists (implicit, xpbd).
+ */
+
+#include "bench_common.hpp"
+#include "../src/cloth/mesh_parametric_cloth.hpp"
+#include "../src/lib/common/error_handling.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace cpe;
+using namespace bench;
+
+namespace
+{
+
+/** Parameters of the benchmark */
+struct settings
+{
+    std::vector<int> sizes = {50,100,200,500,1000,2000};
+    double min_time = 0.5;
+    cloth_integrator integrator = integrator_explicit_euler;
+    std::string output;
+};
+
+/** Timings of one operation for one grid size */
+struct measure
+{
+    std::string operation;
+    int size = 0;
+    int N_vertex = 0;
+    int N_spring = 0;
+    std::vector<double> times_ns;
+    /** Estimated memory traffic of one call (<=0 if unknown) */
+    double bytes = 0;
+};
+
+settings read_settings(int argc,char** argv)
+{
+    settings param;
+    read_arguments(argc,argv,[&param](std::string const& name,std::string const& value)
+    {
+        if(name=="sizes") param.sizes = read_list<int>(value);
+        else if(name=="min-time") param.min_time = std::stod(value);
+        else if(name=="integrator") param.integrator = read_integrator(value);
+        else if(name=="output") param.output = value;
+        else return false;
+        return true;
+    });
+
+    for(int const N : param.sizes)
+        ASSERT_CPE(N>1,"Grid size should be >1");
+    return param;
+}
+
+void bench_size(int const N,settings const& param,std::vector<measure>& results)
+{
+    int const N_vertex = N*N;
+    int const N_triangle = 2*(N-1)*(N-1);
+
+    //set_plane_xy_unit: a new cloth per call (the mesh data is appended)
+    measure m_init;
+    m_init.operation = "set_plane_xy_unit";
+    repeat(m_init.times_ns,param.min_time,[N]()
+    {
+        std::unique_ptr<mesh_parametric_cloth> cloth(new mesh_parametric_cloth);
+        auto const t0 = bench_clock::now();
+        cloth->set_plane_xy_unit(N,N);
+        auto const t1 = bench_clock::now();
+        return elapsed_ns(t0,t1);
+    });
+
+    mesh_parametric_cloth cloth;
+    cloth.set_plane_xy_unit(N,N);
+    cloth.set_integrator(param.integrator);
+    int const N_spring = cloth.springs().size();
+
+    //update_force and integration_step timed separately along a simulation
+    scene_parameters scene;
+    bool wind = false;
+    measure m_force,m_integration;
+    m_force.operation = "update_force";
+    m_integration.operation = "integration_step";
+    double total = 0.0;
+    while(m_force.times_ns.size()<3 || total<2*param.min_time*1e9)
+    {
+        auto const t0 = bench_clock::now();
+        cloth.update_force(scene.ground,wind,0,scene.sphere_radius,scene.sphere_center);
+        auto const t1 = bench_clock::now();
+        cloth.integration_step(scene.dt);
+        auto const t2 = bench_clock::now();
+
+        m_force.times_ns.push_back(elapsed_ns(t0,t1));
+        m_integration.times_ns.push_back(elapsed_ns(t1,t2));
+        total += elapsed_ns(t0,t2);
+    }
+
+    //fill_normal on the current (deformed) positions
+    cloth.sync_mesh();
+    measure m_normal;
+    m_normal.operation = "fill_normal";
+    repeat(m_normal.times_ns,param.min_time,[&cloth]()
+    {
+        auto const t0 = bench_clock::now();
+        cloth.fill_normal();
+        auto const t1 = bench_clock::now();
+        return elapsed_ns(t0,t1);
+    });
+
+    //triangle normals then per vertex gather, same values (vertex to triangle table built before)
+    cloth.vertex_triangle_offset();
+    measure m_normal_parallel;
+    m_normal_parallel.operation = "fill_normal_parallel";
+    repeat(m_normal_parallel.times_ns,param.min_time,[&cloth]()
+    {
+        auto const t0 = bench_clock::now();
+        cloth.fill_normal_parallel();
+        auto const t1 = bench_clock::now();
+        return elapsed_ns(t0,t1);
+    });
+
+    //normals gathered from the one ring of the grid, same values
+    measure m_normal_grid;
+    m_normal_grid.operation = "fill_normal_grid";
+    repeat(m_normal_grid.times_ns,param.min_time,[&cloth]()
+    {
+        auto const t0 = bench_clock::now();
+        cloth.fill_normal_grid();
+        auto const t1 = bench_clock::now();
+        return elapsed_ns(t0,t1);
+    });
+
+    //compulsory traffic estimates (bytes)
+    // set_plane_xy_unit: write vertex,normal,color(12) uv(8) particles(40) triangles(12) springs(16)
+    m_init.bytes = 84.0*N_vertex + 12.0*N_triangle + 16.0*N_spring;
+    // update_force: gravity write force(12), springs read(16/spring) position(12) rw force(24), collision read position(12) rw velocity(24)
+    m_force.bytes = 84.0*N_vertex + 16.0*N_spring;
+    // explicit integration: read force(12) inverse mass(4), rw velocity(24) position(24), divergence check position(12)
+    m_integration.bytes = param.integrator==integrator_explicit_euler ? 76.0*N_vertex : 0.0;
+    // fill_normal: clear normal(12), read triangles(12/triangle) position(12) rw normal(24), normalization rw normal(24)
+    m_normal.bytes = 72.0*N_vertex + 12.0*N_triangle;
+    // fill_normal_parallel: read triangles(12/triangle) position(12) write triangle normal(12/triangle),
+    // read offsets(4) indices(12/triangle) triangle normal(36/triangle) write normal(12)
+    m_normal_parallel.bytes = 28.0*N_vertex + 72.0*N_triangle;
+    // fill_normal_grid: read position(12), write normal(12)
+    m_normal_grid.bytes = 24.0*N_vertex;
+
+    for(measure* m : {&m_init,&m_force,&m_integration,&m_normal,&m_normal_parallel,&m_normal_grid})
+    {
+        m->size = N;
+        m->N_vertex = N_vertex;
+        m->N_spring = N_spring;
+        results.push_back(*m);
+    }
+}
+
+void write_json(settings const& param,std::vector<measure> const& results)
+{
+    json_object header = json_header("cloth_bench");
+    header.set("spring_kernel",spring_kernel_name(best_spring_kernel()));
+    header.set("integrator",integrator_name(param.integrator));
+    header.set("min_time_s",param.min_time);
+
+    std::vector<json_object> lines;
+    for(measure const& m : results)
+    {
+        double const t_median = median(m.times_ns);
+        json_object line;
+        line.set("operation",m.operation)
+            .set("size_u",m.size).set("size_v",m.size)
+            .set("vertices",m.N_vertex).set("springs",m.N_spring)
+            .set("repetitions",m.times_ns.size())
+            .set("time_median_ns",t_median)
+            .set("time_min_ns",*std::min_element(m.times_ns.begin(),m.times_ns.end()))
+            .set("ns_per_vertex",t_median/m.N_vertex)
+            .set("vertices_per_s",1e9*m.N_vertex/t_median);
+        if(m.bytes>0)
+            line.set("bytes_per_call",m.bytes).set("bandwidth_GBps",m.bytes/t_median);
+        else
+            line.set_null("bytes_per_call").set_null("bandwidth_GBps");
+        lines.push_back(line);
+    }
+    bench::write_json(param.output,header,lines);
+}
+
+}
+
+int main(int argc,char** argv)
+{
+    try
+    {
+        settings const param = read_settings(argc,argv);
+
+        std::vector<measure> results;
+        for(int const N : param.sizes)
+        {
+            std::cerr<<"grid "<<N<<"x"<<N<<" ..."<<std::endl;
+            bench_size(N,param,results);
+        }
+
+        write_json(param,results);
+
+        return EXIT_SUCCESS;
+    }
+    catch(exception_cpe const& e)
+    {
+        std::cerr<<std::endl<<e.report_exception()<<std::endl;
+        return EXIT_FAILURE;
+    }
+}
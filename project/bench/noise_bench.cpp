@@ -0,0 +1,172 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** Check the batched simplex noise against the scalar snoise3/snoise4 and
+ *  measure their throughput (points/second).
+ *
+ *  usage: noise_bench [N_point] [repetitions]
+ *  Returns a non zero value if the batched noise differs from the scalar one.
+ *
+ *  The batch works in single precision and the reference in double precision:
+ *  the rounding error stays below 1e-4 (at most 4e-5 observed over 8M points).
+ *  Close to a face of the simplex grid, the rounding can select the
+ *  neighbouring simplex. The noise (kernel radius^2 0.6 instead of 0.5) is not
+ *  continuous there: the two corners that change have a squared distance >=0.5
+ *  and contribute at most scale*0.1^4 each, so the jump is <=2*32*0.1^4=6.4e-3
+ *  for snoise3 and <=2*27*0.1^4=5.4e-3 for snoise4 (both reached numerically).
+ *  These points are accepted up to the jump, provided they are rare (about 1
+ *  in 1e6 observed, at most 1 in 1e5 accepted). The octaves of perlin sum to
+ *  0.5*5.4e-3/(1-0.3) < 5.4e-3 at most.
+ */
+
+#include "../src/external/perlin/simplexnoise1234.hpp"
+#include "../src/lib/perlin/perlin.hpp"
+#include "../src/lib/3d/vec4.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace cpe;
+
+namespace
+{
+
+typedef std::chrono::steady_clock bench_clock;
+
+double elapsed_s(bench_clock::time_point const& t0,bench_clock::time_point const& t1)
+{
+    return std::chrono::duration<double>(t1-t0).count();
+}
+
+/** Rounding error of the single precision batch */
+double const tolerance = 1e-4;
+/** Largest jump of the noise across a face of the simplex grid */
+double const jump_3d = 6.4e-3;
+double const jump_4d = 5.4e-3;
+
+/** Largest error, and number of points above the rounding tolerance */
+struct comparison
+{
+    double error = 0.0;
+    int N_jump = 0;
+
+    void add(double const e)
+    {
+        error = std::max(error,e);
+        if(e>tolerance)
+            ++N_jump;
+    }
+    bool valid(int const N,double const jump) const
+    {
+        return error<=jump && N_jump<=1+N/100000;
+    }
+};
+
+void print(std::string const& name,int const N,int const repetitions,double const t_scalar,double const t_batch,comparison const& c,bool const ok)
+{
+    double const points = static_cast<double>(N)*repetitions;
+    std::cout<<name<<" : scalar "<<points/t_scalar/1e6<<" Mpoint/s , batch "<<points/t_batch/1e6<<" Mpoint/s"
+             <<" , max error "<<c.error<<" ("<<c.N_jump<<" points across a simplex face)"<<(ok?" [OK]":" [FAILED]")<<std::endl;
+}
+
+}
+
+int main(int argc,char** argv)
+{
+    int const N = argc>1 ? std::atoi(argv[1]) : 1000000;
+    int const repetitions = argc>2 ? std::atoi(argv[2]) : 5;
+
+    std::vector<float> x(N),y(N),z(N),w(N),value(N);
+    uint32_t seed = 12345u;
+    auto random = [&seed]()
+    {
+        seed = seed*1664525u+1013904223u;
+        return 16.0f*static_cast<float>(seed>>8)/16777216.0f;
+    };
+    for(int k=0 ; k<N ; ++k)
+    {
+        x[k] = random(); y[k] = random(); z[k] = random(); w[k] = random();
+    }
+
+    bool valid = true;
+    volatile double sink = 0.0;
+
+    //3D
+    {
+        auto const t0 = bench_clock::now();
+        for(int r=0 ; r<repetitions ; ++r)
+            for(int k=0 ; k<N ; ++k)
+                sink = sink+snoise3(x[k],y[k],z[k]);
+        auto const t1 = bench_clock::now();
+        for(int r=0 ; r<repetitions ; ++r)
+            snoise3_batch(x.data(),y.data(),z.data(),value.data(),N);
+        auto const t2 = bench_clock::now();
+
+        comparison c;
+        for(int k=0 ; k<N ; ++k)
+            c.add(std::abs(snoise3(x[k],y[k],z[k])-value[k]));
+        bool const ok = c.valid(N,jump_3d);
+        valid = valid && ok;
+        print("snoise3",N,repetitions,elapsed_s(t0,t1),elapsed_s(t1,t2),c,ok);
+    }
+
+    //4D
+    {
+        auto const t0 = bench_clock::now();
+        for(int r=0 ; r<repetitions ; ++r)
+            for(int k=0 ; k<N ; ++k)
+                sink = sink+snoise4(x[k],y[k],z[k],w[k]);
+        auto const t1 = bench_clock::now();
+        for(int r=0 ; r<repetitions ; ++r)
+            snoise4_batch(x.data(),y.data(),z.data(),w.data(),value.data(),N);
+        auto const t2 = bench_clock::now();
+
+        comparison c;
+        for(int k=0 ; k<N ; ++k)
+            c.add(std::abs(snoise4(x[k],y[k],z[k],w[k])-value[k]));
+        bool const ok = c.valid(N,jump_4d);
+        valid = valid && ok;
+        print("snoise4",N,repetitions,elapsed_s(t0,t1),elapsed_s(t1,t2),c,ok);
+    }
+
+    //Perlin 4D (5 octaves)
+    {
+        perlin const noise;
+        auto const t0 = bench_clock::now();
+        for(int k=0 ; k<N ; ++k)
+            sink = sink+noise(vec4(x[k],y[k],z[k],w[k]));
+        auto const t1 = bench_clock::now();
+        noise.evaluate_batch(x.data(),y.data(),z.data(),w.data(),value.data(),N);
+        auto const t2 = bench_clock::now();
+
+        comparison c;
+        for(int k=0 ; k<N ; ++k)
+            c.add(std::abs(noise(vec4(x[k],y[k],z[k],w[k]))-value[k]));
+        bool const ok = c.valid(N,jump_4d);
+        valid = valid && ok;
+        print("perlin 4D",N,1,elapsed_s(t0,t1),elapsed_s(t1,t2),c,ok);
+    }
+
+    return valid ? EXIT_SUCCESS : EXIT_FAILURE;
+}
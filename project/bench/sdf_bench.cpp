@@ -0,0 +1,247 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** Build, storage and lookup of signed distance fields on closed meshes of
+ *  increasing size. The results are written in JSON.
+ *
+ *  usage: sdf_bench [--subdivisions 2,5,8] [--voxel 0.02] [--band 0.06]
+ *                   [--points 1000000] [--output file.json]
+ *
+ *  The meshes are subdivided octahedra projected on the unit sphere
+ *  (8.4^s triangles). The field is written in a temporary file and read back
+ *  (roundtrip: 1 if the lookups are identical). The lookups are done at random
+ *  points of the band: SIMD and scalar implementations are compared
+ *  (simd_deviation), and the distance to the exact one, 1-|p| (max_error, the
+ *  interpolation and the faceting of the mesh both contribute).
+ */
+
+#include "bench_common.hpp"
+#include "../src/lib/intersection/signed_distance_field.hpp"
+#include "../src/lib/mesh/mesh.hpp"
+#include "../src/lib/random/counter_rng.hpp"
+#include "../src/lib/common/error_handling.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace cpe;
+using namespace bench;
+
+namespace
+{
+
+/** Parameters of the benchmark */
+struct settings
+{
+    std::vector<int> subdivisions = {2,5,8};
+    float voxel = 0.02f;
+    float band = 0.06f;
+    int points = 1000000;
+    std::string output;
+};
+
+/** Measures for one mesh */
+struct measure
+{
+    int N_triangle = 0;
+    double build_ms = 0;
+    int band_blocks = 0;
+    long memory_bytes = 0;
+    double save_ms = 0;
+    double load_ms = 0;
+    bool roundtrip = false;
+    double simd_ns = 0;
+    double scalar_ns = 0;
+    double simd_deviation = 0;
+    double max_error = 0;
+};
+
+settings read_settings(int argc,char** argv)
+{
+    settings param;
+    read_arguments(argc,argv,[&param](std::string const& name,std::string const& value)
+    {
+        if(name=="subdivisions") param.subdivisions = read_list<int>(value);
+        else if(name=="voxel") param.voxel = std::stof(value);
+        else if(name=="band") param.band = std::stof(value);
+        else if(name=="points") param.points = std::stoi(value);
+        else if(name=="output") param.output = value;
+        else return false;
+        return true;
+    });
+
+    ASSERT_CPE(param.points>0,"Number of points should be >0");
+    return param;
+}
+
+/** Closed unit sphere: octahedron subdivided s times (shared midpoints), counter clockwise seen from outside */
+mesh subdivided_sphere(int const subdivisions)
+{
+    std::vector<vec3> vertex = {vec3(1,0,0),vec3(-1,0,0),vec3(0,1,0),vec3(0,-1,0),vec3(0,0,1),vec3(0,0,-1)};
+    std::vector<triangle_index> triangles = {
+        triangle_index(0,2,4),triangle_index(2,1,4),triangle_index(1,3,4),triangle_index(3,0,4),
+        triangle_index(2,0,5),triangle_index(1,2,5),triangle_index(3,1,5),triangle_index(0,3,5)};
+
+    for(int s=0 ; s<subdivisions ; ++s)
+    {
+        std::map<std::pair<int,int>,int> midpoint;
+        auto const middle = [&](int const a,int const b)
+        {
+            std::pair<int,int> const key(std::min(a,b),std::max(a,b));
+            auto const it = midpoint.find(key);
+            if(it!=midpoint.end())
+                return it->second;
+            vertex.push_back(normalized(vertex[a]+vertex[b]));
+            int const index = vertex.size()-1;
+            midpoint[key] = index;
+            return index;
+        };
+
+        std::vector<triangle_index> refined;
+        refined.reserve(4*triangles.size());
+        for(triangle_index const& t : triangles)
+        {
+            int const a = t.u0(), b = t.u1(), c = t.u2();
+            int const ab = middle(a,b), bc = middle(b,c), ca = middle(c,a);
+            refined.push_back(triangle_index(a,ab,ca));
+            refined.push_back(triangle_index(ab,b,bc));
+            refined.push_back(triangle_index(ca,bc,c));
+            refined.push_back(triangle_index(ab,bc,ca));
+        }
+        triangles.swap(refined);
+    }
+
+    mesh m;
+    for(vec3 const& p : vertex)
+        m.add_vertex(p);
+    for(triangle_index const& t : triangles)
+        m.add_triangle_index(t);
+    return m;
+}
+
+void bench_mesh(int const subdivisions,settings const& param,std::vector<measure>& results)
+{
+    measure r;
+    mesh const m = subdivided_sphere(subdivisions);
+    r.N_triangle = m.size_connectivity();
+    std::cerr<<r.N_triangle<<" triangles ..."<<std::endl;
+
+    signed_distance_field field;
+    auto const t_build = bench_clock::now();
+    field.build(m,param.voxel,param.band);
+    r.build_ms = elapsed_ms(t_build,bench_clock::now());
+    r.band_blocks = field.size_band_block();
+    r.memory_bytes = field.memory_size();
+
+    //points in the band around the sphere
+    int const N = param.points;
+    counter_rng const rng(7,0);
+    std::vector<float> x(N),y(N),z(N),radius(N);
+    for(int k=0 ; k<N ; ++k)
+    {
+        vec3 const d = normalized(vec3(rng.uniform(4*k)-0.5f,rng.uniform(4*k+1)-0.5f,rng.uniform(4*k+2)-0.5f)+vec3(1e-4f,0,0));
+        radius[k] = 1.0f+0.9f*param.band*(2.0f*rng.uniform(4*k+3)-1.0f);
+        x[k] = radius[k]*d.x(); y[k] = radius[k]*d.y(); z[k] = radius[k]*d.z();
+    }
+
+    std::vector<float> d_simd(N),gx(N),gy(N),gz(N);
+    std::vector<float> d_scalar(N),hx(N),hy(N),hz(N);
+    auto const t0 = bench_clock::now();
+    field.sample(x.data(),y.data(),z.data(),N,d_simd.data(),gx.data(),gy.data(),gz.data());
+    auto const t1 = bench_clock::now();
+    field.sample_scalar(x.data(),y.data(),z.data(),N,d_scalar.data(),hx.data(),hy.data(),hz.data());
+    auto const t2 = bench_clock::now();
+    r.simd_ns = elapsed_ns(t0,t1)/N;
+    r.scalar_ns = elapsed_ns(t1,t2)/N;
+
+    for(int k=0 ; k<N ; ++k)
+    {
+        r.simd_deviation = std::max(r.simd_deviation,static_cast<double>(std::abs(d_simd[k]-d_scalar[k])));
+        r.simd_deviation = std::max(r.simd_deviation,static_cast<double>(std::abs(gx[k]-hx[k])+std::abs(gy[k]-hy[k])+std::abs(gz[k]-hz[k])));
+        r.max_error = std::max(r.max_error,static_cast<double>(std::abs(d_scalar[k]-(radius[k]-1.0f))));
+    }
+
+    //roundtrip through a file
+    char const* const filename = "sdf_bench_roundtrip.sdf";
+    auto const t_save = bench_clock::now();
+    field.save(filename);
+    auto const t_load = bench_clock::now();
+    signed_distance_field loaded;
+    loaded.load(filename);
+    r.load_ms = elapsed_ms(t_load,bench_clock::now());
+    r.save_ms = elapsed_ms(t_save,t_load);
+    std::remove(filename);
+
+    loaded.sample_scalar(x.data(),y.data(),z.data(),N,d_simd.data(),gx.data(),gy.data(),gz.data());
+    r.roundtrip = d_simd==d_scalar && gx==hx && gy==hy && gz==hz;
+
+    results.push_back(r);
+}
+
+void write_json(settings const& param,std::vector<measure> const& results)
+{
+    json_object header = json_header("sdf_bench");
+    header.set("voxel",param.voxel).set("band",param.band);
+    header.set("points",param.points);
+
+    std::vector<json_object> lines;
+    for(measure const& r : results)
+    {
+        json_object line;
+        line.set("triangles",r.N_triangle)
+            .set("build_ms",r.build_ms)
+            .set("band_blocks",r.band_blocks).set("memory_bytes",r.memory_bytes)
+            .set("save_ms",r.save_ms).set("load_ms",r.load_ms)
+            .set("roundtrip",r.roundtrip ? 1 : 0)
+            .set("sample_simd_ns",r.simd_ns).set("sample_scalar_ns",r.scalar_ns)
+            .set("simd_deviation",r.simd_deviation)
+            .set("max_error",r.max_error);
+        lines.push_back(line);
+    }
+    bench::write_json(param.output,header,lines);
+}
+
+}
+
+int main(int argc,char** argv)
+{
+    try
+    {
+        settings const param = read_settings(argc,argv);
+
+        std::vector<measure> results;
+        for(int const s : param.subdivisions)
+            bench_mesh(s,param,results);
+
+        write_json(param,results);
+
+        return EXIT_SUCCESS;
+    }
+    catch(exception_cpe const& e)
+    {
+        std::cerr<<std::endl<<e.report_exception()<<std::endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,219 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** Check the SIMD spring kernels against the scalar reference and measure
+ *  their throughput (springs/second).
+ *
+ *  Also checks the coloring of a high valence fan (hub shared by more than
+ *  64 springs).
+ *
+ *  usage: spring_kernel_bench [grid_size] [repetitions]
+ *  Returns a non zero value if a kernel differs from the scalar reference
+ *  or if a color batch shares a vertex.
+ */
+
+#include "../src/cloth/spring.hpp"
+#include "../src/cloth/spring_kernel.hpp"
+#include "../src/lib/common/exception_cpe.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace cpe;
+
+namespace
+{
+
+/** Regular grid of N*N vertices with jittered positions and the 12-neighbour springs */
+struct spring_grid
+{
+    std::vector<float> px,py,pz;
+    std::vector<spring> springs;
+    std::vector<int> batch_offset;
+};
+
+spring_grid build_grid(int const N)
+{
+    spring_grid g;
+    g.px.resize(N*N); g.py.resize(N*N); g.pz.resize(N*N);
+
+    float const L = 1.0f/(N-1);
+    uint32_t seed = 12345u;
+    auto jitter = [&seed,L]()
+    {
+        seed = seed*1664525u+1013904223u;
+        return 0.3f*L*(static_cast<float>(seed>>8)/16777216.0f-0.5f);
+    };
+
+    for(int kv=0 ; kv<N ; ++kv)
+    {
+        for(int ku=0 ; ku<N ; ++ku)
+        {
+            int const k = ku+N*kv;
+            g.px[k] = ku*L+jitter();
+            g.py[k] = kv*L+jitter();
+            g.pz[k] = jitter();
+        }
+    }
+
+    struct offset { int du; int dv; float k; float L; };
+    offset const offsets[] = { {1,0,10.0f,L} , {0,1,10.0f,L} ,
+                               {1,1,7.0f,std::sqrt(2.0f)*L} , {1,-1,7.0f,std::sqrt(2.0f)*L} ,
+                               {2,0,2.0f,2*L} , {0,2,2.0f,2*L} };
+    for(offset const& o : offsets)
+        for(int kv=0 ; kv<N ; ++kv)
+            for(int ku=0 ; ku<N ; ++ku)
+                if(ku+o.du>=0 && ku+o.du<N && kv+o.dv>=0 && kv+o.dv<N)
+                    g.springs.push_back({ku+N*kv , ku+o.du+N*(kv+o.dv) , o.k , o.L});
+
+    color_springs(g.springs,0,g.springs.size(),N*N,g.batch_offset);
+    g.batch_offset.push_back(g.springs.size());
+
+    return g;
+}
+
+/** Check that every spring is kept and that no two springs of a batch share a vertex */
+bool check_batches(std::vector<spring> const& springs,std::vector<int> const& batch_offset,int const N_vertex)
+{
+    if(batch_offset.empty() || batch_offset.front()!=0 || batch_offset.back()!=static_cast<int>(springs.size()))
+        return false;
+    std::vector<int> last_batch(N_vertex,-1);
+    for(int b=0 ; b+1<static_cast<int>(batch_offset.size()) ; ++b)
+    {
+        for(int k=batch_offset[b] ; k<batch_offset[b+1] ; ++k)
+        {
+            spring const& s = springs[k];
+            if(last_batch[s.i]==b || last_batch[s.j]==b)
+                return false;
+            last_batch[s.i] = b;
+            last_batch[s.j] = b;
+        }
+    }
+    return true;
+}
+
+/** Fan of N_segment triangles around a hub: spokes, rim and the bending springs
+ *  between a spoke and the next but one, the hub has a valence of 2*N_segment */
+bool check_fan_coloring(int const N_segment)
+{
+    std::vector<spring> springs;
+    int const N_vertex = N_segment+1;
+    for(int k=0 ; k<N_segment ; ++k)
+    {
+        springs.push_back({0,1+k,10.0f,1.0f});
+        springs.push_back({1+k,1+(k+1)%N_segment,10.0f,0.1f});
+        springs.push_back({0,1+(k+2)%N_segment,2.0f,1.0f});
+    }
+
+    std::vector<int> batch_offset;
+    color_springs(springs,0,springs.size(),N_vertex,batch_offset);
+    batch_offset.push_back(springs.size());
+
+    bool const ok = static_cast<int>(springs.size())==3*N_segment && check_batches(springs,batch_offset,N_vertex);
+    std::cout<<"fan of "<<N_segment<<" triangles : "<<batch_offset.size()-1<<" batches"<<(ok?" [OK]":" [FAILED]")<<std::endl;
+    return ok;
+}
+
+void run(spring_grid const& g,spring_kernel const kernel,std::vector<float>& fx,std::vector<float>& fy,std::vector<float>& fz)
+{
+    std::fill(fx.begin(),fx.end(),0.0f);
+    std::fill(fy.begin(),fy.end(),0.0f);
+    std::fill(fz.begin(),fz.end(),0.0f);
+
+    for(int b=0 ; b+1<static_cast<int>(g.batch_offset.size()) ; ++b)
+        kernel(g.springs.data(),g.batch_offset[b],g.batch_offset[b+1],
+               g.px.data(),g.py.data(),g.pz.data(),fx.data(),fy.data(),fz.data());
+}
+
+}
+
+int main(int argc,char** argv)
+{
+    int const N = argc>1 ? std::atoi(argv[1]) : 500;
+    int const repetitions = argc>2 ? std::atoi(argv[2]) : 20;
+    float const tolerance = 1e-4f;
+
+    try
+    {
+        spring_grid const g = build_grid(N);
+        int const N_vertex = N*N;
+        int const N_spring = g.springs.size();
+
+        std::vector<float> ref_x(N_vertex),ref_y(N_vertex),ref_z(N_vertex);
+        run(g,spring_forces_scalar,ref_x,ref_y,ref_z);
+
+        float max_ref = 0.0f;
+        for(int k=0 ; k<N_vertex ; ++k)
+            max_ref = std::max(max_ref,std::sqrt(ref_x[k]*ref_x[k]+ref_y[k]*ref_y[k]+ref_z[k]*ref_z[k]));
+
+        std::cout<<"grid "<<N<<"x"<<N<<" : "<<N_spring<<" springs in "<<g.batch_offset.size()-1<<" batches"<<std::endl;
+
+        bool valid = check_batches(g.springs,g.batch_offset,N_vertex);
+        valid = check_fan_coloring(80) && valid;
+        valid = check_fan_coloring(150) && valid;
+
+        spring_kernel_type const types[] = {spring_kernel_scalar,spring_kernel_sse,spring_kernel_avx2};
+        for(spring_kernel_type const type : types)
+        {
+            std::string const name = spring_kernel_name(type);
+            if(!spring_kernel_supported(type))
+            {
+                std::cout<<name<<" : not supported by this CPU"<<std::endl;
+                continue;
+            }
+            spring_kernel const kernel = get_spring_kernel(type);
+
+            //correctness against the scalar reference
+            std::vector<float> fx(N_vertex),fy(N_vertex),fz(N_vertex);
+            run(g,kernel,fx,fy,fz);
+            float max_error = 0.0f;
+            for(int k=0 ; k<N_vertex ; ++k)
+            {
+                float const dx = fx[k]-ref_x[k];
+                float const dy = fy[k]-ref_y[k];
+                float const dz = fz[k]-ref_z[k];
+                max_error = std::max(max_error,std::sqrt(dx*dx+dy*dy+dz*dz));
+            }
+            float const relative_error = max_ref>0 ? max_error/max_ref : max_error;
+            bool const ok = relative_error<=tolerance;
+            valid = valid && ok;
+
+            //throughput
+            auto const t0 = std::chrono::steady_clock::now();
+            for(int r=0 ; r<repetitions ; ++r)
+                run(g,kernel,fx,fy,fz);
+            auto const t1 = std::chrono::steady_clock::now();
+            double const seconds = std::chrono::duration<double>(t1-t0).count();
+
+            std::cout<<name<<" : "<<(static_cast<double>(N_spring)*repetitions/seconds)/1e6<<" Mspring/s"
+                     <<" , relative error "<<relative_error<<(ok?" [OK]":" [FAILED]")<<std::endl;
+        }
+
+        return valid ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    catch(exception_cpe const& e)
+    {
+        std::cout<<std::endl<<e.report_exception()<<std::endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,584 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** Headless cloth simulation (no Qt, no OpenGL).
+ *
+ *  Runs the same scene as the interactive program (cloth fixed by two corners
+ *  falling on a sphere above the ground) for a given number of steps, as fast
+ *  as possible, and writes the resulting positions and the timings on disk.
+ *  The grid can be replaced by any triangle mesh (--mesh file.obj/.off), and
+ *  any triangle mesh can be added as an obstacle (--collider file.obj/.off),
+ *  directly or through a signed distance field (--sdf-mesh, --sdf).
+ *  The state of the cloth can be written at the end of the run (--checkpoint)
+ *  and a run can start from such a state instead of the flat cloth (--restart).
+ *  The positions of every step can be recorded in a cloth cache (--record)
+ *  played back by the interactive program without simulating.
+ *
+ *  usage: cloth_sim [--config file] [--key value]...
+ *  See print_usage() for the list of keys. A config file contains one
+ *  "key value" (or "key = value") per line, '#' starts a comment.
+ */
+
+#include "../src/cloth/mesh_parametric_cloth.hpp"
+#include "../src/cloth/mesh_cloth.hpp"
+#include "../src/cloth/cloth_cache.hpp"
+#include "../src/lib/mesh/format/mesh_io_off.hpp"
+#include "../src/lib/mesh/mesh_io.hpp"
+#include "../src/lib/mesh/mesh.hpp"
+#include "../src/lib/common/error_handling.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace cpe;
+
+namespace
+{
+
+/** Parameters of the headless run */
+struct settings
+{
+    int size_u = 50;
+    int size_v = 50;
+    std::string mesh_file;
+    std::vector<int> fixed;
+    int steps = 1000;
+    float dt = 0.15f;
+    cloth_integrator integrator = integrator_explicit_euler;
+    int xpbd_iterations = 10;
+    int cg_iterations = 100;
+    float k_structural = 10.0f;
+    float k_shearing = 7.0f;
+    float k_bending = 2.0f;
+    int wind_force = 0;
+    bool self_collision = false;
+    float self_thickness = 0.005f;
+    float self_stiffness = 20.0f;
+    bool sleep = false;
+    float sleep_velocity = 2e-3f;
+    float sleep_acceleration = 2e-3f;
+    int sleep_steps = 30;
+    std::string collider_file;
+    float collider_thickness = 0.005f;
+    std::string sdf_file;
+    std::string sdf_mesh_file;
+    float sdf_voxel = 0.02f;
+    float sdf_band = 0.06f;
+    float sdf_thickness = 0.005f;
+    wind_model wind_type = wind_perlin;
+    float ground = -1.101f;
+    vec3 sphere_center = vec3(0.5f,0.05f,-1.1f);
+    float sphere_radius = 0.198f;
+    float ground_friction = 0.5f;
+    float sphere_friction = 0.0f;
+    std::vector<collider> colliders;
+    int save_every = 0;
+    std::string restart;
+    std::string checkpoint;
+    std::string record;
+    bool record_normals = false;
+    int record_chunk = 16;
+    cloth_cache_codec record_codec = codec_raw;
+    float record_tolerance = 1e-4f;
+    std::string output = "cloth";
+
+    /** Set a parameter from its key, returns false for unknown keys */
+    bool set(std::string const& key,std::string const& value);
+};
+
+cloth_integrator read_integrator(std::string const& value)
+{
+    if(value=="explicit")
+        return integrator_explicit_euler;
+    if(value=="implicit")
+        return integrator_implicit_euler;
+    if(value=="xpbd")
+        return integrator_xpbd;
+    throw exception_cpe("Unknown integrator "+value+" (expected explicit, implicit or xpbd)",EXCEPTION_PARAMETERS_CPE);
+}
+
+std::vector<int> read_index_list(std::string const& value)
+{
+    std::vector<int> index;
+    std::stringstream tokens(value);
+    std::string buffer;
+    while(std::getline(tokens,buffer,','))
+        index.push_back(std::stoi(buffer));
+    return index;
+}
+
+std::vector<float> read_float_list(std::string const& value)
+{
+    std::vector<float> values;
+    std::stringstream tokens(value);
+    std::string buffer;
+    while(std::getline(tokens,buffer,','))
+        values.push_back(std::stof(buffer));
+    return values;
+}
+
+/** Capsule "x0,y0,z0,x1,y1,z1,radius[,friction]" */
+collider read_capsule(std::string const& value)
+{
+    std::vector<float> const v = read_float_list(value);
+    if(v.size()!=7 && v.size()!=8)
+        throw exception_cpe("Incorrect capsule "+value+" (expected x0,y0,z0,x1,y1,z1,radius[,friction])",EXCEPTION_PARAMETERS_CPE);
+    return capsule_collider(vec3(v[0],v[1],v[2]),vec3(v[3],v[4],v[5]),v[6],0.0005f,v.size()==8 ? v[7] : 0.0f);
+}
+
+/** Box "cx,cy,cz,hx,hy,hz[,friction]" (center and half sizes) */
+collider read_box(std::string const& value)
+{
+    std::vector<float> const v = read_float_list(value);
+    if(v.size()!=6 && v.size()!=7)
+        throw exception_cpe("Incorrect box "+value+" (expected cx,cy,cz,hx,hy,hz[,friction])",EXCEPTION_PARAMETERS_CPE);
+    return box_collider(vec3(v[0],v[1],v[2]),vec3(v[3],v[4],v[5]),0.0005f,v.size()==7 ? v[6] : 0.0f);
+}
+
+wind_model read_wind_model(std::string const& value)
+{
+    if(value=="random")
+        return wind_random;
+    if(value=="perlin")
+        return wind_perlin;
+    throw exception_cpe("Unknown wind model "+value+" (expected random or perlin)",EXCEPTION_PARAMETERS_CPE);
+}
+
+cloth_cache_codec read_cache_codec(std::string const& value)
+{
+    if(value=="raw")
+        return codec_raw;
+    if(value=="quantized")
+        return codec_quantized;
+    throw exception_cpe("Unknown cache codec "+value+" (expected raw or quantized)",EXCEPTION_PARAMETERS_CPE);
+}
+
+bool settings::set(std::string const& key,std::string const& value)
+{
+    if(key=="size") {size_u = size_v = std::stoi(value);}
+    else if(key=="size-u") {size_u = std::stoi(value);}
+    else if(key=="size-v") {size_v = std::stoi(value);}
+    else if(key=="mesh") {mesh_file = value;}
+    else if(key=="fixed") {fixed = read_index_list(value);}
+    else if(key=="steps") {steps = std::stoi(value);}
+    else if(key=="dt") {dt = std::stof(value);}
+    else if(key=="integrator") {integrator = read_integrator(value);}
+    else if(key=="xpbd-iterations") {xpbd_iterations = std::stoi(value);}
+    else if(key=="cg-iterations") {cg_iterations = std::stoi(value);}
+    else if(key=="k-structural") {k_structural = std::stof(value);}
+    else if(key=="k-shearing") {k_shearing = std::stof(value);}
+    else if(key=="k-bending") {k_bending = std::stof(value);}
+    else if(key=="wind") {wind_force = std::stoi(value);}
+    else if(key=="wind-model") {wind_type = read_wind_model(value);}
+    else if(key=="self-collision") {self_collision = std::stoi(value)!=0;}
+    else if(key=="self-thickness") {self_thickness = std::stof(value);}
+    else if(key=="self-stiffness") {self_stiffness = std::stof(value);}
+    else if(key=="sleep") {sleep = std::stoi(value)!=0;}
+    else if(key=="sleep-velocity") {sleep_velocity = std::stof(value);}
+    else if(key=="sleep-acceleration") {sleep_acceleration = std::stof(value);}
+    else if(key=="sleep-steps") {sleep_steps = std::stoi(value);}
+    else if(key=="collider") {collider_file = value;}
+    else if(key=="collider-thickness") {collider_thickness = std::stof(value);}
+    else if(key=="sdf") {sdf_file = value;}
+    else if(key=="sdf-mesh") {sdf_mesh_file = value;}
+    else if(key=="sdf-voxel") {sdf_voxel = std::stof(value);}
+    else if(key=="sdf-band") {sdf_band = std::stof(value);}
+    else if(key=="sdf-thickness") {sdf_thickness = std::stof(value);}
+    else if(key=="ground") {ground = std::stof(value);}
+    else if(key=="sphere-x") {sphere_center.x() = std::stof(value);}
+    else if(key=="sphere-y") {sphere_center.y() = std::stof(value);}
+    else if(key=="sphere-z") {sphere_center.z() = std::stof(value);}
+    else if(key=="sphere-radius") {sphere_radius = std::stof(value);}
+    else if(key=="ground-friction") {ground_friction = std::stof(value);}
+    else if(key=="sphere-friction") {sphere_friction = std::stof(value);}
+    else if(key=="capsule") {colliders.push_back(read_capsule(value));}
+    else if(key=="box") {colliders.push_back(read_box(value));}
+    else if(key=="save-every") {save_every = std::stoi(value);}
+    else if(key=="restart") {restart = value;}
+    else if(key=="checkpoint") {checkpoint = value;}
+    else if(key=="record") {record = value;}
+    else if(key=="record-normals") {record_normals = std::stoi(value)!=0;}
+    else if(key=="record-chunk") {record_chunk = std::stoi(value);}
+    else if(key=="record-codec") {record_codec = read_cache_codec(value);}
+    else if(key=="record-tolerance") {record_tolerance = std::stof(value);}
+    else if(key=="output") {output = value;}
+    else return false;
+    return true;
+}
+
+void print_usage(char const* program)
+{
+    std::cout<<"usage: "<<program<<" [--config file] [--key value]..."<<std::endl
+             <<"  --size N             grid of NxN particles (or --size-u/--size-v, default 50)"<<std::endl
+             <<"  --mesh file          cloth built on a triangle mesh (.obj or .off) instead of the grid"<<std::endl
+             <<"  --fixed i,j,...      fixed vertices of the --mesh cloth (default none)"<<std::endl
+             <<"  --steps N            number of time steps (default 1000)"<<std::endl
+             <<"  --dt h               time step (default 0.15)"<<std::endl
+             <<"  --integrator name    explicit, implicit or xpbd (default explicit)"<<std::endl
+             <<"  --xpbd-iterations N  constraint iterations of xpbd (default 10)"<<std::endl
+             <<"  --cg-iterations N    max conjugate gradient iterations of implicit (default 100)"<<std::endl
+             <<"  --k-structural k     (default 10) --k-shearing k (default 7) --k-bending k (default 2)"<<std::endl
+             <<"  --wind F             wind force, 0 disables the wind (default 0)"<<std::endl
+             <<"  --wind-model name    random or perlin (default perlin)"<<std::endl
+             <<"  --self-collision 0/1 repulsion between the parts of the cloth (default 0)"<<std::endl
+             <<"  --self-thickness t   distance of the self repulsion (default 0.005)"<<std::endl
+             <<"  --self-stiffness k   stiffness of the self repulsion (default 20)"<<std::endl
+             <<"  --sleep 0/1          deactivation of the tiles of the cloth at rest (default 0)"<<std::endl
+             <<"  --sleep-velocity v   speed of a particle at rest (default 0.002)"<<std::endl
+             <<"  --sleep-acceleration a change of velocity per time of a particle at rest (default 0.002)"<<std::endl
+             <<"  --sleep-steps N      steps at rest before a tile falls asleep (default 30)"<<std::endl
+             <<"  --collider file      triangle mesh obstacle (.obj or .off, default none)"<<std::endl
+             <<"  --collider-thickness t distance kept from the obstacle (default 0.005)"<<std::endl
+             <<"  --sdf-mesh file      closed mesh obstacle sampled in a signed distance field (.obj or .off)"<<std::endl
+             <<"  --sdf file           distance field file: written after --sdf-mesh, read otherwise"<<std::endl
+             <<"  --sdf-voxel h        cell size of the field built from --sdf-mesh (default 0.02)"<<std::endl
+             <<"  --sdf-band b         distance stored around the surface (default 0.06)"<<std::endl
+             <<"  --sdf-thickness t    distance kept from the field obstacle (default 0.005)"<<std::endl
+             <<"  --ground z           height of the ground (default -1.101)"<<std::endl
+             <<"  --sphere-x/-y/-z v   center of the sphere (default 0.5 0.05 -1.1)"<<std::endl
+             <<"  --sphere-radius r    radius of the sphere (default 0.198)"<<std::endl
+             <<"  --ground-friction f  friction of the ground (default 0.5) --sphere-friction f (default 0)"<<std::endl
+             <<"  --capsule x0,y0,z0,x1,y1,z1,r[,f]  additional capsule obstacle (repeatable)"<<std::endl
+             <<"  --box cx,cy,cz,hx,hy,hz[,f]        additional box obstacle, center and half sizes (repeatable)"<<std::endl
+             <<"  --save-every N       also save the positions every N steps (default 0: final only)"<<std::endl
+             <<"  --restart file       start from a checkpoint (its state, integrator, stiffness and colliders replace the settings)"<<std::endl
+             <<"  --checkpoint file    write the state of the cloth at the end of the run"<<std::endl
+             <<"  --record file        record the positions of every step in a cloth cache (default none)"<<std::endl
+             <<"  --record-normals 0/1 also record the normals (default 0)"<<std::endl
+             <<"  --record-chunk N     frames per chunk of the cache (default 16)"<<std::endl
+             <<"  --record-codec name  raw or quantized (default raw)"<<std::endl
+             <<"  --record-tolerance e maximal error on the positions of the quantized codec (default 1e-4)"<<std::endl
+             <<"  --output prefix      output files prefix (default cloth)"<<std::endl
+             <<"Outputs: prefix.off (final mesh), prefix_timing.csv (per step timings)"<<std::endl;
+}
+
+void read_config_file(std::string const& filename,settings& param)
+{
+    std::ifstream fid(filename.c_str());
+    if(!fid.good())
+        throw exception_cpe("Cannot open config file "+filename,EXCEPTION_PARAMETERS_CPE);
+
+    std::string buffer;
+    int line = 0;
+    while(std::getline(fid,buffer))
+    {
+        ++line;
+        buffer = buffer.substr(0,buffer.find('#'));
+        for(char& c : buffer)
+            if(c=='=')
+                c = ' ';
+
+        std::stringstream tokens(buffer);
+        std::string key,value;
+        if(!(tokens>>key))
+            continue;
+        if(!(tokens>>value) || !param.set(key,value))
+            throw exception_cpe("Incorrect entry at line "+std::to_string(line)+" of "+filename,EXCEPTION_PARAMETERS_CPE);
+    }
+}
+
+settings read_settings(int argc,char** argv)
+{
+    settings param;
+    for(int k=1 ; k<argc ; ++k)
+    {
+        std::string const arg = argv[k];
+        if(arg=="--help" || arg=="-h")
+        {
+            print_usage(argv[0]);
+            std::exit(EXIT_SUCCESS);
+        }
+        if(arg.size()<3 || arg.substr(0,2)!="--" || k+1>=argc)
+            throw exception_cpe("Incorrect argument "+arg+" (see --help)",EXCEPTION_PARAMETERS_CPE);
+
+        std::string const key = arg.substr(2);
+        std::string const value = argv[++k];
+        if(key=="config")
+            read_config_file(value,param);
+        else if(!param.set(key,value))
+            throw exception_cpe("Unknown parameter "+arg+" (see --help)",EXCEPTION_PARAMETERS_CPE);
+    }
+
+    ASSERT_CPE(param.size_u>1 && param.size_v>1,"Grid size should be >1");
+    ASSERT_CPE(param.steps>=0,"Number of steps should be >=0");
+    ASSERT_CPE(param.dt>0,"Time step should be >0");
+    ASSERT_CPE(param.record_chunk>0,"Frames per chunk should be >0");
+    ASSERT_CPE(param.record_tolerance>0,"Record tolerance should be >0");
+    return param;
+}
+
+std::string frame_filename(std::string const& prefix,int const step)
+{
+    char buffer[32];
+    std::snprintf(buffer,sizeof(buffer),"_%06d.off",step);
+    return prefix+buffer;
+}
+
+double elapsed_ms(std::chrono::steady_clock::time_point const& t0,std::chrono::steady_clock::time_point const& t1)
+{
+    return std::chrono::duration<double,std::milli>(t1-t0).count();
+}
+
+std::string cloth_name(mesh_parametric_cloth const& cloth)
+{
+    return std::to_string(cloth.size_u())+"x"+std::to_string(cloth.size_v());
+}
+
+std::string cloth_name(mesh_cloth const& cloth)
+{
+    return std::to_string(cloth.size_vertex())+" vertices ("+std::to_string(cloth.size_edge())+" edges)";
+}
+
+/** Normals of the cloth from its current mesh positions (gathered on the grid) */
+void update_normals(mesh_parametric_cloth& cloth)
+{
+    cloth.fill_normal_grid();
+}
+
+void update_normals(mesh_cloth& cloth)
+{
+    cloth.fill_normal_parallel();
+}
+
+/** Description of the frames of the cache recording a cloth */
+cloth_cache_info cache_info(mesh_parametric_cloth const& cloth)
+{
+    cloth_cache_info info;
+    info.N_vertex = cloth.size_vertex();
+    info.size_u = cloth.size_u();
+    info.size_v = cloth.size_v();
+    return info;
+}
+
+cloth_cache_info cache_info(mesh_cloth const& cloth)
+{
+    cloth_cache_info info;
+    info.N_vertex = cloth.size_vertex();
+    return info;
+}
+
+/** Run the simulation on a cloth (grid or triangle mesh), returns the exit code */
+template <typename CLOTH>
+int simulate(CLOTH& cloth,settings const& param)
+{
+    cloth.set_k_struct(param.k_structural);
+    cloth.set_k_shear(param.k_shearing);
+    cloth.set_k_bend(param.k_bending);
+    cloth.set_integrator(param.integrator);
+    cloth.set_wind_model(param.wind_type);
+    cloth.get_xpbd_solver().set_iterations(param.xpbd_iterations);
+    cloth.get_implicit_solver().set_max_iterations(param.cg_iterations);
+    cloth.set_self_collision(param.self_collision);
+    cloth.get_self_collision_solver().set_thickness(param.self_thickness);
+    cloth.get_self_collision_solver().set_stiffness(param.self_stiffness);
+    cloth.set_sleeping(param.sleep);
+    cloth.get_sleep_tiles().set_velocity_threshold(param.sleep_velocity);
+    cloth.get_sleep_tiles().set_acceleration_threshold(param.sleep_acceleration);
+    cloth.get_sleep_tiles().set_sleep_steps(param.sleep_steps);
+    collider_registry& colliders = cloth.get_colliders();
+    colliders.get(collider_registry::scene_ground).friction = param.ground_friction;
+    colliders.get(collider_registry::scene_sphere).friction = param.sphere_friction;
+    for(collider const& c : param.colliders)
+        colliders.add(c);
+    if(!param.restart.empty())
+    {
+        auto const t_load = std::chrono::steady_clock::now();
+        cloth.load_checkpoint(param.restart);
+        std::cout<<"Checkpoint "<<param.restart<<" (step "<<cloth.step_count()<<") restored in "
+                 <<elapsed_ms(t_load,std::chrono::steady_clock::now())<<" ms"<<std::endl;
+    }
+    if(!param.collider_file.empty())
+    {
+        int const collider = cloth.add_mesh_collider(load_mesh_file(param.collider_file),param.collider_thickness);
+        bvh const& tree = cloth.get_mesh_collider(collider).get_bvh();
+        std::cout<<"Collider "<<param.collider_file<<": "<<tree.size_triangle()<<" triangles, "
+                 <<tree.size_node()<<" bvh nodes, depth "<<tree.depth()<<std::endl;
+    }
+    if(!param.sdf_mesh_file.empty() || !param.sdf_file.empty())
+    {
+        signed_distance_field field;
+        auto const t_build = std::chrono::steady_clock::now();
+        if(!param.sdf_mesh_file.empty())
+        {
+            field.build(load_mesh_file(param.sdf_mesh_file),param.sdf_voxel,param.sdf_band);
+            if(!param.sdf_file.empty())
+                field.save(param.sdf_file);
+        }
+        else
+            field.load(param.sdf_file);
+        std::cout<<"Distance field "<<field.size_cell(0)<<"x"<<field.size_cell(1)<<"x"<<field.size_cell(2)
+                 <<" ("<<field.size_band_block()<<" band blocks, "<<field.memory_size()/1024<<" KB) in "
+                 <<elapsed_ms(t_build,std::chrono::steady_clock::now())<<" ms"<<std::endl;
+        cloth.add_sdf_collider(field,param.sdf_thickness);
+    }
+
+    std::ofstream timing((param.output+"_timing.csv").c_str());
+    if(!timing.good())
+        throw exception_cpe("Cannot open "+param.output+"_timing.csv",EXCEPTION_PARAMETERS_CPE);
+    timing<<"step,update_force_ms,integration_ms,normal_ms,awake_tiles"<<std::endl;
+
+    cloth_recorder recorder;
+    if(!param.record.empty())
+    {
+        cloth_cache_info info = cache_info(cloth);
+        info.has_normal = param.record_normals;
+        info.frames_per_chunk = param.record_chunk;
+        info.codec = param.record_codec;
+        info.tolerance = param.record_tolerance;
+        info.dt = param.dt;
+        recorder.open(param.record,info);
+    }
+    double record_ms = 0.0;
+
+    float ground = param.ground;
+    bool wind = param.wind_force>0;
+    int const N_vertex = cloth.size_vertex();
+    bool diverged = false;
+    int step = 0;
+    double total_ms = 0.0;
+
+    for(step=0 ; step<param.steps ; ++step)
+    {
+        auto const t0 = std::chrono::steady_clock::now();
+        try
+        {
+            cloth.update_force(ground,wind,param.wind_force,param.sphere_radius,param.sphere_center);
+        }
+        catch(exception_divergence const&) {diverged = true;}
+        auto const t1 = std::chrono::steady_clock::now();
+        try
+        {
+            if(!diverged)
+                cloth.integration_step(param.dt);
+        }
+        catch(exception_divergence const&) {diverged = true;}
+        auto const t2 = std::chrono::steady_clock::now();
+
+        //the wind depends on the normals of the cloth
+        if(wind)
+        {
+            cloth.sync_mesh();
+            update_normals(cloth);
+        }
+        auto const t3 = std::chrono::steady_clock::now();
+
+        timing<<step<<","<<elapsed_ms(t0,t1)<<","<<elapsed_ms(t1,t2)<<","<<elapsed_ms(t2,t3)<<","<<cloth.get_sleep_tiles().size_awake()<<"\n";
+        total_ms += elapsed_ms(t0,t3);
+
+        if(diverged)
+        {
+            std::cout<<"Divergence at step "<<step<<", simulation stopped"<<std::endl;
+            break;
+        }
+
+        if(recorder.is_open())
+        {
+            auto const t_record = std::chrono::steady_clock::now();
+            if(param.record_normals && !wind)
+            {
+                cloth.sync_mesh();
+                update_normals(cloth);
+            }
+            particle_store const& particles = cloth.particle_data();
+            recorder.push_frame(particles.position.x.data(),particles.position.y.data(),particles.position.z.data(),
+                                param.record_normals ? cloth.pointer_normal() : nullptr);
+            record_ms += elapsed_ms(t_record,std::chrono::steady_clock::now());
+        }
+
+        if(param.save_every>0 && (step+1)%param.save_every==0)
+        {
+            cloth.sync_mesh();
+            save_mesh_file_off(cloth,frame_filename(param.output,step+1));
+        }
+    }
+
+    cloth.sync_mesh();
+    save_mesh_file_off(cloth,param.output+".off");
+    if(!param.checkpoint.empty())
+    {
+        auto const t_save = std::chrono::steady_clock::now();
+        cloth.save_checkpoint(param.checkpoint);
+        std::cout<<"Checkpoint "<<param.checkpoint<<" written in "<<elapsed_ms(t_save,std::chrono::steady_clock::now())<<" ms"<<std::endl;
+    }
+
+    if(recorder.is_open())
+    {
+        int const N_frame = recorder.size_frame();
+        auto const t_close = std::chrono::steady_clock::now();
+        recorder.close();
+        std::cout<<N_frame<<" frames recorded in "<<param.record<<" ("<<record_ms<<" ms in the simulation loop, "
+                 <<elapsed_ms(t_close,std::chrono::steady_clock::now())<<" ms to close)"<<std::endl;
+    }
+
+    int const N_step = diverged ? step+1 : step;
+    std::cout<<N_step<<" steps of a "<<cloth_name(cloth)<<" cloth in "<<total_ms<<" ms"<<std::endl;
+    if(N_step>0 && total_ms>0)
+        std::cout<<1000.0*N_step/total_ms<<" steps/s , "
+                 <<1e6*total_ms/(static_cast<double>(N_step)*N_vertex)<<" ns/vertex/step"<<std::endl;
+    if(param.sleep)
+        std::cout<<cloth.get_sleep_tiles().size_awake()<<" of "<<cloth.get_sleep_tiles().size_tile()<<" tiles awake"<<std::endl;
+
+    return diverged ? 2 : EXIT_SUCCESS;
+}
+
+}
+
+int main(int argc,char** argv)
+{
+    try
+    {
+        settings const param = read_settings(argc,argv);
+
+        //the cloth of a restart is given by the checkpoint
+        bool const restart = !param.restart.empty();
+        bool const restart_mesh = restart && read_checkpoint_header(param.restart).layout==checkpoint_mesh;
+
+        if(restart ? !restart_mesh : param.mesh_file.empty())
+        {
+            mesh_parametric_cloth cloth;
+            if(!restart)
+                cloth.set_plane_xy_unit(param.size_u,param.size_v);
+            return simulate(cloth,param);
+        }
+
+        mesh_cloth cloth;
+        if(!restart)
+        {
+            cloth.load(param.mesh_file);
+            for(int const index : param.fixed)
+                cloth.set_fixed(index,true);
+        }
+        return simulate(cloth,param);
+    }
+    catch(exception_cpe const& e)
+    {
+        std::cout<<std::endl<<e.report_exception()<<std::endl;
+        return EXIT_FAILURE;
+    }
+    catch(std::exception const& e)
+    {
+        std::cout<<"Error: "<<e.what()<<std::endl;
+        return EXIT_FAILURE;
+    }
+}
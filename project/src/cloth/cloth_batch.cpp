@@ -0,0 +1,381 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cloth_batch.hpp"
+
+#include "mesh_parametric_cloth.hpp"
+#include "mesh_cloth.hpp"
+#include "particle_dynamics.hpp"
+#include "../lib/common/error_handling.hpp"
+#include <cmath>
+
+namespace cpe
+{
+
+int cloth_batch::add(mesh_parametric_cloth const& cloth,vec3 const& offset)
+{
+    return add(static_cast<cloth_solver const&>(cloth),static_cast<mesh_basic const&>(cloth),offset);
+}
+
+int cloth_batch::add(mesh_cloth const& cloth,vec3 const& offset)
+{
+    return add(static_cast<cloth_solver const&>(cloth),static_cast<mesh_basic const&>(cloth),offset);
+}
+
+int cloth_batch::add(cloth_solver const& cloth,mesh_basic const& surface,vec3 const& offset)
+{
+    particle_store const& source = cloth.particle_data();
+    int const N = source.size();
+    int const begin = particles.size();
+    int const instance = size();
+    ASSERT_CPE(N>0,"Empty cloth");
+
+    //particles
+    particles.resize(begin+N);
+    for(int k=0 ; k<N ; ++k)
+    {
+        particles.position.set(begin+k,source.position.get(k)+offset);
+        particles.velocity.set(begin+k,source.velocity.get(k));
+        particles.force.set(begin+k,vec3());
+        particles.inv_mass[begin+k] = source.inv_mass[k];
+    }
+    particle_instance.resize(begin+N,instance);
+    normal.resize(begin+N);
+    instance_vertex_offset.push_back(begin+N);
+
+    //triangles
+    int const N_triangle = surface.size_connectivity();
+    int const* const index = surface.pointer_triangle_index();
+    for(int k=0 ; k<N_triangle ; ++k)
+        triangles.push_back(triangle_index(index[3*k]+begin,index[3*k+1]+begin,index[3*k+2]+begin));
+    instance_triangle_offset.push_back(triangles.size());
+
+    //springs (merged with the others at the next prepare_springs)
+    std::vector<spring> const& source_springs = cloth.springs();
+    for(int f=0 ; f<spring_family_size ; ++f)
+    {
+        for(int k=cloth.spring_offset(f) ; k<cloth.spring_offset(f+1) ; ++k)
+        {
+            spring s = source_springs[k];
+            s.i += begin;
+            s.j += begin;
+            new_springs[f].push_back(s);
+        }
+    }
+
+    cloth_instance_parameters param;
+    param.k_structural = cloth.get_k_struct();
+    param.k_shearing = cloth.get_k_shear();
+    param.k_bending = cloth.get_k_bend();
+    instance_parameters.push_back(param);
+
+    static vec3 const g (0.0f,0.0f,-9.81f);
+    instance_gravity.push_back(g/N);
+    instance_offset.push_back(offset);
+
+    return instance;
+}
+
+int cloth_batch::size() const
+{
+    return instance_parameters.size();
+}
+
+int cloth_batch::size_vertex() const
+{
+    return particles.size();
+}
+
+int cloth_batch::vertex_offset(int const instance) const
+{
+    ASSERT_CPE(instance>=0 && instance<=size(),"Incorrect instance "+std::to_string(instance));
+    return instance_vertex_offset[instance];
+}
+
+particle_store const& cloth_batch::particle_data() const
+{
+    return particles;
+}
+
+cloth_instance_parameters const& cloth_batch::parameters(int const instance) const
+{
+    ASSERT_CPE(instance>=0 && instance<size(),"Incorrect instance "+std::to_string(instance));
+    return instance_parameters[instance];
+}
+
+void cloth_batch::set_parameters(int const instance,cloth_instance_parameters const& param)
+{
+    ASSERT_CPE(instance>=0 && instance<size(),"Incorrect instance "+std::to_string(instance));
+    instance_parameters[instance] = param;
+    stiffness_changed = true;
+}
+
+void cloth_batch::set_fixed(int const instance,int const index,bool const fixed)
+{
+    ASSERT_CPE(instance>=0 && instance<size(),"Incorrect instance "+std::to_string(instance));
+    int const k = instance_vertex_offset[instance]+index;
+    ASSERT_CPE(index>=0 && k<instance_vertex_offset[instance+1],"Incorrect vertex index "+std::to_string(index));
+    particles.inv_mass[k] = fixed ? 0.0f : 1.0f;
+}
+
+vec3 cloth_batch::position(int const instance,int const index) const
+{
+    ASSERT_CPE(instance>=0 && instance<size(),"Incorrect instance "+std::to_string(instance));
+    int const k = instance_vertex_offset[instance]+index;
+    ASSERT_CPE(index>=0 && k<instance_vertex_offset[instance+1],"Incorrect vertex index "+std::to_string(index));
+    return particles.position.get(k);
+}
+
+void cloth_batch::export_positions(int const instance,std::vector<vec3>& position) const
+{
+    ASSERT_CPE(instance>=0 && instance<size(),"Incorrect instance "+std::to_string(instance));
+    int const begin = instance_vertex_offset[instance];
+    int const N = instance_vertex_offset[instance+1]-begin;
+
+    position.resize(N);
+    for(int k=0 ; k<N ; ++k)
+        position[k] = particles.position.get(begin+k);
+}
+
+void cloth_batch::prepare_springs()
+{
+    bool const added = !new_springs[spring_structural].empty() || !new_springs[spring_shearing].empty() || !new_springs[spring_bending].empty();
+    if(added)
+    {
+        std::vector<spring> merged;
+        merged.reserve(spring_data.size()+new_springs[0].size()+new_springs[1].size()+new_springs[2].size());
+
+        int family_offset[spring_family_size+1];
+        for(int f=0 ; f<spring_family_size ; ++f)
+        {
+            family_offset[f] = merged.size();
+            merged.insert(merged.end(),spring_data.begin()+spring_family_offset[f],spring_data.begin()+spring_family_offset[f+1]);
+            merged.insert(merged.end(),new_springs[f].begin(),new_springs[f].end());
+            new_springs[f].clear();
+        }
+        family_offset[spring_family_size] = merged.size();
+
+        spring_data.swap(merged);
+        for(int f=0 ; f<=spring_family_size ; ++f)
+            spring_family_offset[f] = family_offset[f];
+
+        //the instances share no vertex: coloring all the springs at once gives
+        // as many batches as the most constrained instance
+        spring_batch_offset.clear();
+        for(int f=0 ; f<spring_family_size ; ++f)
+            color_springs(spring_data,spring_family_offset[f],spring_family_offset[f+1],particles.size(),spring_batch_offset);
+        spring_batch_offset.push_back(spring_data.size());
+    }
+
+    if(stiffness_changed)
+    {
+        for(int f=0 ; f<spring_family_size ; ++f)
+        {
+            int const begin = spring_family_offset[f];
+            int const end = spring_family_offset[f+1];
+
+            #pragma omp parallel for schedule(static)
+            for(int k=begin ; k<end ; ++k)
+            {
+                cloth_instance_parameters const& param = instance_parameters[particle_instance[spring_data[k].i]];
+                spring_data[k].k = f==spring_structural ? param.k_structural : (f==spring_shearing ? param.k_shearing : param.k_bending);
+            }
+        }
+        stiffness_changed = false;
+    }
+}
+
+void cloth_batch::compute_wind_normals()
+{
+    int const N_instance = size();
+    float const* const px = particles.position.x.data();
+    float const* const py = particles.position.y.data();
+    float const* const pz = particles.position.z.data();
+
+    //same computation as mesh_basic::fill_normal, the instances are independent
+    #pragma omp parallel for schedule(static)
+    for(int i=0 ; i<N_instance ; ++i)
+    {
+        if(instance_parameters[i].wind_force<=0)
+            continue;
+
+        for(int k=instance_vertex_offset[i] ; k<instance_vertex_offset[i+1] ; ++k)
+            normal[k] = vec3();
+
+        for(int k_triangle=instance_triangle_offset[i] ; k_triangle<instance_triangle_offset[i+1] ; ++k_triangle)
+        {
+            triangle_index const& tri = triangles[k_triangle];
+            vec3 const p0(px[tri.u0()],py[tri.u0()],pz[tri.u0()]);
+            vec3 const p1(px[tri.u1()],py[tri.u1()],pz[tri.u1()]);
+            vec3 const p2(px[tri.u2()],py[tri.u2()],pz[tri.u2()]);
+
+            vec3 const u1 = normalized(p1-p0);
+            vec3 const u2 = normalized(p2-p0);
+            vec3 const n = normalized(cross(u1,u2));
+
+            for(int kv=0 ; kv<3 ; ++kv)
+                normal[tri[kv]] += n;
+        }
+
+        for(int k=instance_vertex_offset[i] ; k<instance_vertex_offset[i+1] ; ++k)
+            normal[k] = normalized(normal[k]);
+    }
+}
+
+void cloth_batch::update_force(float const h,float const radius,vec3 const& center)
+{
+    prepare_springs();
+
+    int const N_total = particles.size();
+    float* const fx = particles.force.x.data();
+    float* const fy = particles.force.y.data();
+    float* const fz = particles.force.z.data();
+
+    //Gravity
+    #pragma omp parallel for schedule(static)
+    for(int k=0 ; k<N_total ; ++k)
+    {
+        vec3 const& g = instance_gravity[particle_instance[k]];
+        fx[k] = g.x();
+        fy[k] = g.y();
+        fz[k] = g.z();
+    }
+
+    //Springs of all the instances, handled as constraints by XPBD
+    if(integrator_type!=integrator_xpbd)
+        add_spring_forces(particles,spring_data,spring_batch_offset,kernel_type);
+
+    //Collisions
+    colliders.set_scene(h,radius,center);
+    colliders.resolve(particles);
+
+    //Wind
+    bool wind = false;
+    for(cloth_instance_parameters const& param : instance_parameters)
+        wind = wind || param.wind_force>0;
+    if(!wind)
+        return;
+
+    compute_wind_normals();
+
+    sample_wind_intensity(particles,wind_type,wind_noise,wind_seed,step_counter,wind_intensity);
+    int const N_instance = instance_parameters.size();
+    for(int i=0 ; i<N_instance ; ++i)
+        if(instance_parameters[i].wind_force>0)
+            add_wind_forces(particles,normal,wind_intensity,instance_parameters[i].wind_force,
+                            {instance_vertex_offset[i],instance_vertex_offset[i+1]});
+}
+
+void cloth_batch::integration_step(float const dt)
+{
+    prepare_springs();
+
+    integrate(integrator_type,implicit,xpbd,particles,spring_data,spring_batch_offset,dt,{{0,particles.size()}});
+    ++step_counter;
+
+    //security check, relative to each instance (throw exception if divergence is detected)
+    if( max_instance_distance() > CLOTH_DIVERGENCE_LIMIT )
+    {
+        int const N_total = particles.size();
+        int k = 0;
+        while(k<N_total-1 && norm(particles.position.get(k)-instance_offset[particle_instance[k]])<=CLOTH_DIVERGENCE_LIMIT)
+            ++k;
+        throw exception_divergence("Divergence of the cloth instance "+std::to_string(particle_instance[k]),EXCEPTION_PARAMETERS_CPE);
+    }
+}
+
+float cloth_batch::max_instance_distance() const
+{
+    int const N = particles.size();
+    float const* const px = particles.position.x.data();
+    float const* const py = particles.position.y.data();
+    float const* const pz = particles.position.z.data();
+
+    float max_norm2 = 0.0f;
+    #pragma omp parallel for schedule(static) reduction(max:max_norm2)
+    for(int k=0 ; k<N ; ++k)
+    {
+        vec3 const& o = instance_offset[particle_instance[k]];
+        float const x = px[k]-o.x();
+        float const y = py[k]-o.y();
+        float const z = pz[k]-o.z();
+        float const n2 = x*x+y*y+z*z;
+        max_norm2 = n2>max_norm2 ? n2 : max_norm2;
+    }
+    return std::sqrt(max_norm2);
+}
+
+long cloth_batch::step_count() const
+{
+    return step_counter;
+}
+
+void cloth_batch::set_integrator(cloth_integrator const type)
+{
+    integrator_type = type;
+}
+
+cloth_integrator cloth_batch::get_integrator() const
+{
+    return integrator_type;
+}
+
+implicit_solver& cloth_batch::get_implicit_solver()
+{
+    return implicit;
+}
+
+xpbd_solver& cloth_batch::get_xpbd_solver()
+{
+    return xpbd;
+}
+
+void cloth_batch::set_wind_seed(uint64_t const seed)
+{
+    wind_seed = seed;
+    wind_noise.set_seed(seed);
+}
+
+void cloth_batch::set_wind_model(wind_model const type)
+{
+    wind_type = type;
+}
+
+wind_field& cloth_batch::get_wind_field()
+{
+    return wind_noise;
+}
+
+collider_registry& cloth_batch::get_colliders()
+{
+    return colliders;
+}
+
+std::vector<spring> const& cloth_batch::springs()
+{
+    prepare_springs();
+    return spring_data;
+}
+
+void cloth_batch::set_spring_kernel(spring_kernel_type const type)
+{
+    ASSERT_CPE(spring_kernel_supported(type),"Spring kernel "+spring_kernel_name(type)+" is not supported by this CPU");
+    kernel_type = type;
+}
+
+}
@@ -0,0 +1,173 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef CLOTH_BATCH_HPP
+#define CLOTH_BATCH_HPP
+
+#include "cloth_solver.hpp"
+#include "../lib/mesh/triangle_index.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace cpe
+{
+
+class mesh_basic;
+class mesh_parametric_cloth;
+class mesh_cloth;
+
+/** Parameters of one cloth of a cloth_batch */
+struct cloth_instance_parameters
+{
+    float k_structural = 10.0f;
+    float k_shearing = 7.0f;
+    float k_bending = 2.0f;
+    /** Wind force (same scale as the wind of a single cloth), 0 disables the wind */
+    int wind_force = 0;
+};
+
+/** Many independent cloths simulated together.
+ *
+ *  The particles of all the instances are packed in a single particle_store and
+ *  their springs in a single list (sorted by family and colored as a whole), so
+ *  that a step of the whole batch costs one pass per operation whatever the
+ *  number of instances, instead of one pass per cloth.
+ *  The instances share the integrator, the wind model and the obstacles;
+ *  stiffness, wind force and fixed vertices are given per instance.
+ *  With the implicit integrator the batch is solved as a single system (the
+ *  conjugate gradient stops on the residual of the whole batch). */
+class cloth_batch
+{
+public:
+
+    /** Add a copy of a cloth (current positions and velocities, fixed vertices,
+     *  springs and triangles) translated by offset. Returns the index of the instance. */
+    int add(mesh_parametric_cloth const& cloth,vec3 const& offset=vec3());
+    int add(mesh_cloth const& cloth,vec3 const& offset=vec3());
+
+    /** Number of instances */
+    int size() const;
+    /** Total number of particles */
+    int size_vertex() const;
+    /** Particles of the instance i are in [vertex_offset(i),vertex_offset(i+1)) of the shared arrays */
+    int vertex_offset(int instance) const;
+    /** Direct access to the particles of all the instances */
+    particle_store const& particle_data() const;
+
+    cloth_instance_parameters const& parameters(int instance) const;
+    /** Change the parameters of an instance (the stiffness is applied at the next update_force) */
+    void set_parameters(int instance,cloth_instance_parameters const& param);
+    /** Fix (null inverse mass) or release the particle of the vertex index of an instance */
+    void set_fixed(int instance,int index,bool fixed);
+
+    /** Position of the vertex index of an instance */
+    vec3 position(int instance,int index) const;
+    /** Copy the positions of an instance (vertex order of the cloth it was built from) */
+    void export_positions(int instance,std::vector<vec3>& position) const;
+
+    /** Gravity, springs, collisions and wind of all the instances.
+     *  The ground (height h) and the sphere are the scene entries of the collider registry. */
+    void update_force(float h,float radius,vec3 const& center);
+    void integration_step(float dt);
+    /** Number of calls to integration_step */
+    long step_count() const;
+
+    /** Time integration scheme shared by all the instances */
+    void set_integrator(cloth_integrator type);
+    cloth_integrator get_integrator() const;
+    implicit_solver& get_implicit_solver();
+    xpbd_solver& get_xpbd_solver();
+
+    /** Wind shared by all the instances (see cloth_solver) */
+    void set_wind_seed(uint64_t seed);
+    void set_wind_model(wind_model type);
+    wind_field& get_wind_field();
+
+    /** Analytic colliders shared by all the instances (world coordinates) */
+    collider_registry& get_colliders();
+
+    /** Springs of all the instances, sorted by family and by color batch */
+    std::vector<spring> const& springs();
+    void set_spring_kernel(spring_kernel_type type);
+
+private:
+
+    /** Copy the particles, springs and triangles of a cloth */
+    int add(cloth_solver const& cloth,mesh_basic const& surface,vec3 const& offset);
+
+    /** Merge the springs of the instances added since the last call and color them,
+     *  apply the stiffness changes */
+    void prepare_springs();
+    /** Normals of the instances subject to the wind (one thread per instance) */
+    void compute_wind_normals();
+    /** Largest distance between a particle and the offset of its instance */
+    float max_instance_distance() const;
+
+    /** Position, velocity, force and inverse mass of the particles of all the instances (SoA) */
+    particle_store particles;
+    /** Instance of each particle */
+    std::vector<int> particle_instance;
+
+    /** Particles of instance i are in [instance_vertex_offset[i],instance_vertex_offset[i+1]) */
+    std::vector<int> instance_vertex_offset = {0};
+    /** Triangles of instance i are in [instance_triangle_offset[i],instance_triangle_offset[i+1]) */
+    std::vector<int> instance_triangle_offset = {0};
+    /** Parameters of each instance */
+    std::vector<cloth_instance_parameters> instance_parameters;
+    /** Gravity force of the particles of each instance (the weight of a cloth does not depend on its resolution) */
+    std::vector<vec3> instance_gravity;
+    /** Translation given when adding each instance (reference of the divergence check) */
+    std::vector<vec3> instance_offset;
+
+    /** Triangles of all the instances (indices in the shared arrays) */
+    std::vector<triangle_index> triangles;
+    /** Normal of each particle (only filled for the instances subject to the wind) */
+    std::vector<vec3> normal;
+    /** Wind intensity of each particle for the current step */
+    aligned_vector<float> wind_intensity;
+
+    /** Springs of all the instances, sorted by family */
+    std::vector<spring> spring_data;
+    /** Springs of family f are in [spring_family_offset[f],spring_family_offset[f+1]) */
+    int spring_family_offset[spring_family_size+1] = {0,0,0,0};
+    /** Springs of batch b are in [spring_batch_offset[b],spring_batch_offset[b+1]) and share no vertex */
+    std::vector<int> spring_batch_offset;
+    /** Springs of the instances added since the last prepare_springs, per family */
+    std::vector<spring> new_springs[spring_family_size];
+    /** True if the stiffness of an instance changed since the last prepare_springs */
+    bool stiffness_changed = false;
+    spring_kernel_type kernel_type = best_spring_kernel();
+
+    collider_registry colliders;
+
+    cloth_integrator integrator_type = integrator_explicit_euler;
+    implicit_solver implicit;
+    xpbd_solver xpbd;
+
+    long step_counter = 0;
+    uint64_t wind_seed = 0;
+    wind_model wind_type = wind_perlin;
+    wind_field wind_noise;
+
+};
+
+}
+
+#endif
@@ -0,0 +1,417 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cloth_cache.hpp"
+#include "cloth_cache_codec.hpp"
+
+#include "../lib/common/error_handling.hpp"
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+namespace cpe
+{
+
+static char const file_magic[8] = {'C','P','E','_','C','A','C','H'};
+static char const chunk_magic[4] = {'C','H','N','K'};
+static uint32_t const file_version = 2;
+static uint32_t const file_byte_order = 0x01020304;
+
+static cloth_cache_header make_header(cloth_cache_info const& info,int const N_frame,int const N_chunk,uint64_t const index_offset)
+{
+    cloth_cache_header header;
+    std::memset(static_cast<void*>(&header),0,sizeof(header));
+    std::memcpy(header.magic,file_magic,sizeof(file_magic));
+    header.version = file_version;
+    header.byte_order = file_byte_order;
+    header.info = info;
+    header.N_frame = N_frame;
+    header.N_chunk = N_chunk;
+    header.index_offset = index_offset;
+    return header;
+}
+
+/** Number of floats of a frame */
+static int floats_per_frame(cloth_cache_info const& info)
+{
+    return info.N_vertex*(info.has_normal ? 6 : 3);
+}
+
+cloth_recorder::cloth_recorder()
+{}
+
+cloth_recorder::~cloth_recorder()
+{
+    try
+    {
+        close();
+    }
+    catch(exception_cpe const& e)
+    {
+        std::cout<<std::endl<<e.report_exception()<<std::endl;
+    }
+}
+
+void cloth_recorder::open(std::string const& filename,cloth_cache_info const& info)
+{
+    close();
+    ASSERT_CPE(info.N_vertex>0 && info.frames_per_chunk>0,"Incorrect cache description");
+    ASSERT_CPE(info.codec==codec_raw || info.codec==codec_quantized,"Unknown cache codec");
+    ASSERT_CPE(info.codec==codec_raw || (info.tolerance>0 && info.normal_tolerance>0),"The tolerances of the cache should be >0");
+
+    stream.open(filename.c_str(),std::ios::binary|std::ios::trunc);
+    if(!stream.good())
+        throw exception_cpe("Cannot open file "+filename,EXCEPTION_PARAMETERS_CPE);
+
+    //the header is written again by close with the index
+    cloth_cache_header const header = make_header(info,0,0,0);
+    stream.write(reinterpret_cast<char const*>(&header),sizeof(header));
+
+    file_name = filename;
+    cache_info = info;
+    frame_size = floats_per_frame(info);
+    N_frame = 0;
+    current = chunk();
+    file_offset = sizeof(header);
+    chunk_offset.clear();
+    stop_flag = false;
+    error_message.clear();
+
+    open_flag = true;
+    writer = std::thread(&cloth_recorder::write_loop,this);
+}
+
+void cloth_recorder::push_frame(float const* const px,float const* const py,float const* const pz,float const* const normal)
+{
+    ASSERT_CPE(open_flag,"No recording in progress");
+    check_error();
+
+    int const N = cache_info.N_vertex;
+    size_t const offset = current.data.size();
+    current.data.resize(offset+frame_size);
+    float* const data = &current.data[offset];
+    std::memcpy(data,px,N*sizeof(float));
+    std::memcpy(data+N,py,N*sizeof(float));
+    std::memcpy(data+2*N,pz,N*sizeof(float));
+    if(cache_info.has_normal)
+    {
+        ASSERT_CPE(normal!=nullptr,"The normals of the frame are required");
+        for(int k=0 ; k<N ; ++k)
+        {
+            data[3*N+k] = normal[3*k];
+            data[4*N+k] = normal[3*k+1];
+            data[5*N+k] = normal[3*k+2];
+        }
+    }
+
+    ++current.N_frame;
+    ++N_frame;
+    if(current.N_frame==cache_info.frames_per_chunk)
+        submit_chunk();
+}
+
+void cloth_recorder::submit_chunk()
+{
+    if(current.N_frame==0)
+        return;
+
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    queue_changed.wait(lock,[this]{return static_cast<int>(queue.size())<max_pending;});
+    queue.push_back(std::move(current));
+
+    //next chunk, in the buffer of an already written one
+    current = chunk();
+    current.first_frame = N_frame;
+    if(!free_buffers.empty())
+    {
+        current.data.swap(free_buffers.back());
+        free_buffers.pop_back();
+        current.data.clear();
+    }
+    lock.unlock();
+    queue_changed.notify_all();
+}
+
+void cloth_recorder::write_loop()
+{
+    while(true)
+    {
+        chunk c;
+        bool failed = false;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_changed.wait(lock,[this]{return !queue.empty() || stop_flag;});
+            if(queue.empty())
+                return;
+            c = std::move(queue.front());
+            queue.pop_front();
+            failed = !error_message.empty();
+        }
+        queue_changed.notify_all();
+
+        //after an error the chunks are dropped (reported by the next push_frame or close)
+        if(!failed)
+            write_chunk(c);
+
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        free_buffers.push_back(std::move(c.data));
+    }
+}
+
+void cloth_recorder::write_chunk(chunk const& c)
+{
+    cloth_cache_chunk header;
+    std::memcpy(header.magic,chunk_magic,sizeof(chunk_magic));
+    header.first_frame = c.first_frame;
+    header.N_frame = c.N_frame;
+    header.reserved = 0;
+
+    char const* payload = reinterpret_cast<char const*>(c.data.data());
+    header.payload_size = c.data.size()*sizeof(float);
+    if(cache_info.codec==codec_quantized)
+    {
+        try
+        {
+            encode_quantized_chunk(c.data.data(),c.N_frame,cache_info,encoded);
+        }
+        catch(exception_cpe const&)
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            error_message = "Cannot encode the frames "+std::to_string(c.first_frame)+" to "+
+                    std::to_string(c.first_frame+c.N_frame-1)+" of "+file_name+" (non finite values)";
+            return;
+        }
+        //the chunks stay aligned on floats
+        encoded.resize((encoded.size()+sizeof(float)-1)/sizeof(float)*sizeof(float),0);
+        payload = encoded.data();
+        header.payload_size = encoded.size();
+    }
+
+    stream.write(reinterpret_cast<char const*>(&header),sizeof(header));
+    stream.write(payload,header.payload_size);
+    if(!stream.good())
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        error_message = "Error while writing file "+file_name;
+        return;
+    }
+
+    chunk_offset.push_back(file_offset);
+    file_offset += sizeof(header)+header.payload_size;
+}
+
+void cloth_recorder::check_error()
+{
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    if(!error_message.empty())
+        throw exception_cpe(error_message,EXCEPTION_PARAMETERS_CPE);
+}
+
+void cloth_recorder::close()
+{
+    if(!open_flag)
+        return;
+    open_flag = false;
+
+    submit_chunk();
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stop_flag = true;
+    }
+    queue_changed.notify_all();
+    writer.join();
+
+    //index of the chunks, then the final header
+    uint64_t const index_offset = file_offset;
+    stream.write(reinterpret_cast<char const*>(chunk_offset.data()),chunk_offset.size()*sizeof(uint64_t));
+    cloth_cache_header const header = make_header(cache_info,N_frame,chunk_offset.size(),index_offset);
+    stream.seekp(0);
+    stream.write(reinterpret_cast<char const*>(&header),sizeof(header));
+    bool const written = stream.good();
+    stream.close();
+
+    check_error();
+    if(!written)
+        throw exception_cpe("Error while writing file "+file_name,EXCEPTION_PARAMETERS_CPE);
+}
+
+bool cloth_recorder::is_open() const
+{
+    return open_flag;
+}
+
+cloth_cache_info const& cloth_recorder::info() const
+{
+    return cache_info;
+}
+
+int cloth_recorder::size_frame() const
+{
+    return N_frame;
+}
+
+/** Copy of the header of the chunk at the given offset (the chunks are only aligned on floats) */
+static cloth_cache_chunk read_chunk_header(mapped_file const& file,uint64_t const offset)
+{
+    cloth_cache_chunk c;
+    std::memcpy(&c,file.data()+offset,sizeof(c));
+    return c;
+}
+
+/** Read in c the header of the chunk at the given offset, true if it is the valid chunk of index k_chunk */
+static bool valid_chunk(mapped_file const& file,uint64_t const offset,int const k_chunk,
+                        cloth_cache_info const& info,int const frame_size,cloth_cache_chunk& c)
+{
+    if(offset%sizeof(float)!=0 || offset>file.size() || file.size()-offset<sizeof(cloth_cache_chunk))
+        return false;
+    c = read_chunk_header(file,offset);
+    uint64_t const available = file.size()-offset-sizeof(cloth_cache_chunk);
+    return std::memcmp(c.magic,chunk_magic,sizeof(chunk_magic))==0 &&
+            c.first_frame==static_cast<int64_t>(k_chunk)*info.frames_per_chunk &&
+            c.N_frame>0 && c.N_frame<=info.frames_per_chunk &&
+            c.payload_size%sizeof(float)==0 && c.payload_size<=available &&
+            (info.codec!=codec_raw || c.payload_size==static_cast<uint64_t>(c.N_frame)*frame_size*sizeof(float));
+}
+
+void cloth_cache::open(std::string const& filename)
+{
+    close();
+    file_name = filename;
+    file.open(filename);
+    if(file.size()<sizeof(header))
+        throw exception_cpe("File "+filename+" is not a cloth cache",EXCEPTION_PARAMETERS_CPE);
+
+    std::memcpy(&header,file.data(),sizeof(header));
+    cloth_cache_info const& info = header.info;
+    if(std::memcmp(header.magic,file_magic,sizeof(file_magic))!=0)
+        throw exception_cpe("File "+filename+" is not a cloth cache",EXCEPTION_PARAMETERS_CPE);
+    if(header.byte_order!=file_byte_order)
+        throw exception_cpe("Cache "+filename+" was written with another byte order",EXCEPTION_PARAMETERS_CPE);
+    if(header.version!=file_version)
+        throw exception_cpe("Unsupported version "+std::to_string(header.version)+" of cloth cache in "+filename,EXCEPTION_PARAMETERS_CPE);
+    if(info.N_vertex<=0 || info.frames_per_chunk<=0 || (info.codec!=codec_raw && info.codec!=codec_quantized) || header.N_frame<0 || header.N_chunk<0 ||
+       static_cast<int64_t>(info.size_u)*info.size_v!=(info.size_u==0 ? 0 : info.N_vertex))
+        throw exception_cpe("Incorrect header in "+filename,EXCEPTION_PARAMETERS_CPE);
+    frame_size = floats_per_frame(info);
+
+    if(header.index_offset==0)
+    {
+        scan_chunks();
+        return;
+    }
+
+    int const N_chunk = header.N_chunk;
+    if(header.index_offset>file.size() || (file.size()-header.index_offset)/sizeof(uint64_t)<static_cast<uint64_t>(N_chunk) ||
+       static_cast<int64_t>(N_chunk)*info.frames_per_chunk<header.N_frame)
+        throw exception_cpe("Truncated cloth cache "+filename,EXCEPTION_PARAMETERS_CPE);
+    chunk_offset.resize(N_chunk);
+    std::memcpy(chunk_offset.data(),file.data()+header.index_offset,N_chunk*sizeof(uint64_t));
+
+    //frames are located from their index: only the last chunk may be incomplete
+    int64_t N_frame = 0;
+    for(int k=0 ; k<N_chunk ; ++k)
+    {
+        cloth_cache_chunk c;
+        if(!valid_chunk(file,chunk_offset[k],k,info,frame_size,c) || (k+1<N_chunk && c.N_frame!=info.frames_per_chunk))
+            throw exception_cpe("Incorrect chunk "+std::to_string(k)+" in cloth cache "+filename,EXCEPTION_PARAMETERS_CPE);
+        N_frame += c.N_frame;
+    }
+    if(N_frame!=header.N_frame)
+        throw exception_cpe("Incorrect number of frames in cloth cache "+filename,EXCEPTION_PARAMETERS_CPE);
+}
+
+void cloth_cache::scan_chunks()
+{
+    //the chunks follow each other after the header, up to the first incomplete one
+    // (a chunk with less frames can only be the last one)
+    chunk_offset.clear();
+    int N_frame = 0;
+    uint64_t offset = sizeof(header);
+    cloth_cache_chunk c;
+    while(valid_chunk(file,offset,chunk_offset.size(),header.info,frame_size,c))
+    {
+        chunk_offset.push_back(offset);
+        N_frame += c.N_frame;
+        offset += sizeof(cloth_cache_chunk)+c.payload_size;
+        if(c.N_frame!=header.info.frames_per_chunk)
+            break;
+    }
+    header.N_frame = N_frame;
+    header.N_chunk = chunk_offset.size();
+}
+
+void cloth_cache::close()
+{
+    file.close();
+    chunk_offset.clear();
+    frame_size = 0;
+    decoded_chunk = -1;
+}
+
+bool cloth_cache::is_open() const
+{
+    return file.is_open();
+}
+
+cloth_cache_info const& cloth_cache::info() const
+{
+    return header.info;
+}
+
+int cloth_cache::size_frame() const
+{
+    return is_open() ? header.N_frame : 0;
+}
+
+float const* cloth_cache::chunk_data(int const chunk)
+{
+    char const* const payload = file.data()+chunk_offset[chunk]+sizeof(cloth_cache_chunk);
+    if(header.info.codec==codec_raw)
+        return reinterpret_cast<float const*>(payload);
+
+    if(chunk!=decoded_chunk)
+    {
+        cloth_cache_chunk const c = read_chunk_header(file,chunk_offset[chunk]);
+        decoded.resize(static_cast<size_t>(c.N_frame)*frame_size);
+        decoded_chunk = -1;
+        decode_quantized_chunk(payload,c.payload_size,c.N_frame,header.info,decoded.data());
+        decoded_chunk = chunk;
+    }
+    return decoded.data();
+}
+
+void cloth_cache::read_frame(int const frame,std::vector<vec3>& position,std::vector<vec3>* const normal)
+{
+    ASSERT_CPE(frame>=0 && frame<size_frame(),"Incorrect frame index "+std::to_string(frame));
+
+    int const N = header.info.N_vertex;
+    int const frames_per_chunk = header.info.frames_per_chunk;
+    float const* const data = chunk_data(frame/frames_per_chunk)+static_cast<size_t>(frame%frames_per_chunk)*frame_size;
+
+    position.resize(N);
+    for(int k=0 ; k<N ; ++k)
+        position[k] = vec3(data[k],data[N+k],data[2*N+k]);
+    if(normal!=nullptr && header.info.has_normal)
+    {
+        normal->resize(N);
+        for(int k=0 ; k<N ; ++k)
+            (*normal)[k] = vec3(data[3*N+k],data[4*N+k],data[5*N+k]);
+    }
+}
+
+}
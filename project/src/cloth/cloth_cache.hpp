@@ -0,0 +1,214 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef CLOTH_CACHE_HPP
+#define CLOTH_CACHE_HPP
+
+#include "../lib/3d/vec3.hpp"
+#include "../lib/common/mapped_file.hpp"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cpe
+{
+
+/** Encoding of the frames of a chunk */
+enum cloth_cache_codec
+{
+    /** Raw floats */
+    codec_raw = 0,
+    /** Quantized values, predicted and entropy coded (see cloth_cache_codec.hpp) */
+    codec_quantized = 1
+};
+
+/** Description of the frames of a cloth cache */
+struct cloth_cache_info
+{
+    /** Number of vertices of each frame */
+    int32_t N_vertex = 0;
+    /** Size of the grid of a mesh_parametric_cloth (0 for another surface) */
+    int32_t size_u = 0;
+    int32_t size_v = 0;
+    /** 1 if the frames also store the normals */
+    int32_t has_normal = 0;
+    /** Number of frames per chunk (all the chunks are full but the last one) */
+    int32_t frames_per_chunk = 16;
+    /** Encoding of the chunks (cloth_cache_codec) */
+    int32_t codec = codec_raw;
+    /** Simulated time between two frames */
+    float dt = 0.0f;
+    /** Maximal error on the positions (codec_quantized) */
+    float tolerance = 1e-4f;
+    /** Maximal error on the coordinates of the normals (codec_quantized) */
+    float normal_tolerance = 1e-3f;
+};
+
+/** Header at the beginning of a cache file */
+struct cloth_cache_header
+{
+    char magic[8];
+    uint32_t version;
+    /** Written as 0x01020304, checks the byte order of the machine reading the file */
+    uint32_t byte_order;
+    cloth_cache_info info;
+    int32_t N_frame;
+    int32_t N_chunk;
+    /** Position of the chunk index in the file (0 if the recording was not closed) */
+    uint64_t index_offset;
+};
+
+/** Header of a chunk, followed by its payload */
+struct cloth_cache_chunk
+{
+    char magic[4];
+    int32_t first_frame;
+    int32_t N_frame;
+    uint32_t reserved;
+    uint64_t payload_size;
+};
+
+/** Recorder of the frames of a simulation in a cache file.
+ *
+ *  The frames are grouped in chunks of frames_per_chunk consecutive frames,
+ *  each frame stores the x, y and z arrays of the positions (then of the
+ *  normals). push_frame only copies the data in the current chunk: the full
+ *  chunks are encoded (see cloth_cache_info::codec) and written by a
+ *  dedicated thread, so that the simulation does not wait for the disk. close writes the index of the chunks at the end of the
+ *  file (a file which was not closed can still be read, its chunks are
+ *  then found by scanning the file). */
+class cloth_recorder
+{
+public:
+
+    cloth_recorder();
+    ~cloth_recorder();
+
+    cloth_recorder(cloth_recorder const&) = delete;
+    cloth_recorder& operator=(cloth_recorder const&) = delete;
+
+    /** Create the file and start the writing thread (closes the current recording) */
+    void open(std::string const& filename,cloth_cache_info const& info);
+    /** Append a frame: positions (px,py,pz) and normals (x,y,z interleaved,
+     *  only read if the cache has normals). Waits only if the writing thread
+     *  is max_pending chunks late. */
+    void push_frame(float const* px,float const* py,float const* pz,float const* normal=nullptr);
+    /** Write the last chunk and the index, stop the writing thread */
+    void close();
+
+    bool is_open() const;
+    cloth_cache_info const& info() const;
+    /** Number of frames pushed since open */
+    int size_frame() const;
+
+    /** Maximal number of full chunks waiting to be written */
+    static int const max_pending = 8;
+
+private:
+
+    /** Frames waiting to be written */
+    struct chunk
+    {
+        int first_frame = 0;
+        int N_frame = 0;
+        std::vector<float> data;
+    };
+
+    /** Loop of the writing thread */
+    void write_loop();
+    /** Encode and append a chunk to the file (writing thread) */
+    void write_chunk(chunk const& c);
+    /** Hand the current chunk to the writing thread */
+    void submit_chunk();
+    /** Throw the error met by the writing thread, if any */
+    void check_error();
+
+    std::string file_name;
+    cloth_cache_info cache_info;
+    bool open_flag = false;
+    /** Number of floats of a frame */
+    int frame_size = 0;
+    int N_frame = 0;
+    /** Chunk being filled by push_frame */
+    chunk current;
+
+    /** Shared with the writing thread */
+    std::mutex queue_mutex;
+    std::condition_variable queue_changed;
+    std::deque<chunk> queue;
+    /** Buffers of the written chunks, reused by the next ones */
+    std::vector<std::vector<float> > free_buffers;
+    bool stop_flag = false;
+    std::string error_message;
+
+    /** Used by the writing thread only (then by close once joined) */
+    std::thread writer;
+    std::ofstream stream;
+    /** Payload of the chunk being written (encoded chunks) */
+    std::vector<char> encoded;
+    uint64_t file_offset = 0;
+    std::vector<uint64_t> chunk_offset;
+};
+
+/** Cache file recorded by cloth_recorder, read frame by frame in any order.
+ *  The file is mapped in memory and the chunk of a frame is found in
+ *  constant time from the index. The last encoded chunk read is kept
+ *  decoded: consecutive frames only decode one chunk every frames_per_chunk. */
+class cloth_cache
+{
+public:
+
+    /** Map the file and read its index (exception_cpe if it is not a valid cache) */
+    void open(std::string const& filename);
+    void close();
+    bool is_open() const;
+
+    cloth_cache_info const& info() const;
+    int size_frame() const;
+
+    /** Positions of a frame, and its normals if they are stored and normal is not null */
+    void read_frame(int frame,std::vector<vec3>& position,std::vector<vec3>* normal=nullptr);
+
+private:
+
+    /** Floats of the frames of a chunk (decoded if needed) */
+    float const* chunk_data(int chunk);
+    /** Find the chunks of a file which was not closed */
+    void scan_chunks();
+
+    std::string file_name;
+    mapped_file file;
+    cloth_cache_header header;
+    std::vector<uint64_t> chunk_offset;
+    /** Number of floats of a frame */
+    int frame_size = 0;
+    /** Frames of the chunk decoded_chunk (encoded chunks) */
+    std::vector<float> decoded;
+    int decoded_chunk = -1;
+};
+
+}
+
+#endif
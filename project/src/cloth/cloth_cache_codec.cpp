@@ -0,0 +1,389 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cloth_cache_codec.hpp"
+
+#include "cloth_cache.hpp"
+#include "../lib/common/error_handling.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace cpe
+{
+
+/** Beginning of the payload of a quantized chunk, followed by the segments of the channels */
+struct quantized_chunk_header
+{
+    /** Value of the quantized level 0 of each channel */
+    float origin[6];
+    /** Distance between two quantized levels of each channel */
+    float step[6];
+    /** Size in bytes of the segment of each channel */
+    uint64_t segment_size[6];
+};
+
+/** Number of residuals sharing a Rice parameter */
+static int const block_size = 64;
+/** Rice parameter marking a block of zeros */
+static uint32_t const zero_block = 31;
+/** Quotients from this value are followed by the raw 32 bits residual */
+static int const rice_escape = 24;
+/** Maximal number of levels of a channel (the step is enlarged for larger ranges) */
+static float const max_level = static_cast<float>(1<<24);
+
+/** Writer of bits, LSB first */
+struct bit_writer
+{
+    std::vector<char>& out;
+    uint64_t buffer = 0;
+    int count = 0;
+
+    explicit bit_writer(std::vector<char>& out_param):out(out_param) {}
+
+    /** Append the n (<=32) lowest bits of value (higher bits must be zero) */
+    void put(uint32_t const value,int const n)
+    {
+        buffer |= static_cast<uint64_t>(value)<<count;
+        count += n;
+        if(count>=32)
+        {
+            uint32_t const word = static_cast<uint32_t>(buffer);
+            size_t const size = out.size();
+            out.resize(size+4);
+            std::memcpy(&out[size],&word,4);
+            buffer >>= 32;
+            count -= 32;
+        }
+    }
+
+    /** Write the pending bits, padded to a byte */
+    void flush()
+    {
+        for( ; count>0 ; count-=8)
+        {
+            out.push_back(static_cast<char>(buffer&0xff));
+            buffer >>= 8;
+        }
+        buffer = 0;
+        count = 0;
+    }
+};
+
+/** Reader of the bits of a bit_writer. Never reads outside of [data,data+size):
+ *  the bits after the end are zeros. */
+struct bit_reader
+{
+    unsigned char const* data;
+    uint64_t size;
+    uint64_t position = 0;
+
+    bit_reader(char const* data_param,uint64_t size_param)
+        :data(reinterpret_cast<unsigned char const*>(data_param)),size(size_param) {}
+
+    /** At least the 56 next bits */
+    uint64_t peek() const
+    {
+        uint64_t const byte = position>>3;
+        uint64_t word = 0;
+        if(byte+8<=size)
+            std::memcpy(&word,data+byte,8);
+        else if(byte<size)
+            std::memcpy(&word,data+byte,size-byte);
+        return word>>(position&7);
+    }
+
+    /** Read n (<=32) bits */
+    uint32_t get(int const n)
+    {
+        uint32_t const value = static_cast<uint32_t>(peek()&((uint64_t(1)<<n)-1));
+        position += n;
+        return value;
+    }
+
+    bool overrun() const {return position>8*size;}
+};
+
+static uint32_t zigzag(uint32_t const r)
+{
+    return (r<<1)^(0u-(r>>31));
+}
+
+static uint32_t unzigzag(uint32_t const u)
+{
+    return (u>>1)^(0u-(u&1));
+}
+
+/** Rice code the zigzag residuals u[0..N[ */
+static void write_residuals(bit_writer& out,uint32_t const* u,int const N)
+{
+    for(int b=0 ; b<N ; b+=block_size)
+    {
+        int const n = std::min(block_size,N-b);
+        uint64_t sum = 0;
+        for(int k=0 ; k<n ; ++k)
+            sum += u[b+k];
+        if(sum==0)
+        {
+            out.put(zero_block,5);
+            continue;
+        }
+
+        //parameter close to log2 of the mean
+        int r = 0;
+        while(r<30 && (static_cast<uint64_t>(n)<<(r+1))<=sum)
+            ++r;
+        out.put(r,5);
+        uint32_t const mask = (1u<<r)-1;
+        for(int k=0 ; k<n ; ++k)
+        {
+            uint32_t const value = u[b+k];
+            uint32_t const q = value>>r;
+            if(q<static_cast<uint32_t>(rice_escape))
+            {
+                out.put(1u<<q,q+1);
+                out.put(value&mask,r);
+            }
+            else
+            {
+                out.put(1u<<rice_escape,rice_escape+1);
+                out.put(value,32);
+            }
+        }
+    }
+}
+
+/** Read N zigzag residuals written by write_residuals, false if the data is incorrect */
+static bool read_residuals(bit_reader& in,uint32_t* u,int const N)
+{
+    for(int b=0 ; b<N ; b+=block_size)
+    {
+        int const n = std::min(block_size,N-b);
+        uint32_t const r = in.get(5);
+        if(r==zero_block)
+        {
+            std::fill(u+b,u+b+n,0u);
+            continue;
+        }
+        if(r>30)
+            return false;
+
+        uint64_t const mask = (uint64_t(1)<<r)-1;
+        for(int k=0 ; k<n ; ++k)
+        {
+            uint64_t const word = in.peek();
+            int const zeros = word==0 ? 64 : __builtin_ctzll(word);
+            if(zeros<rice_escape)
+            {
+                u[b+k] = (static_cast<uint32_t>(zeros)<<r) | static_cast<uint32_t>((word>>(zeros+1))&mask);
+                in.position += zeros+1+r;
+            }
+            else if(zeros==rice_escape)
+            {
+                in.position += rice_escape+1;
+                u[b+k] = in.get(32);
+            }
+            else
+                return false;
+        }
+    }
+    return true;
+}
+
+/** Number of vertices per row used by the spatial prediction (a single row for a mesh) */
+static int prediction_row_size(cloth_cache_info const& info)
+{
+    bool const grid = info.size_u>1 && static_cast<int64_t>(info.size_u)*info.size_v==info.N_vertex;
+    return grid ? info.size_u : info.N_vertex;
+}
+
+/** Predictors of a frame */
+enum frame_predictor {predict_previous=0,predict_linear=1,predict_spatial=2};
+
+int cache_channel_count(cloth_cache_info const& info)
+{
+    return info.has_normal ? 6 : 3;
+}
+
+void encode_quantized_chunk(float const* const data,int const N_frame,cloth_cache_info const& info,std::vector<char>& payload)
+{
+    int const N = info.N_vertex;
+    int const Nu = prediction_row_size(info);
+    int const N_channel = cache_channel_count(info);
+    size_t const frame_size = static_cast<size_t>(N)*N_channel;
+
+    quantized_chunk_header header;
+    std::memset(static_cast<void*>(&header),0,sizeof(header));
+    payload.resize(sizeof(header));
+
+    std::vector<uint32_t> q(N),q1(N),q2(N),residual(N),residual_linear(N);
+    bit_writer out(payload);
+    for(int c=0 ; c<N_channel ; ++c)
+    {
+        //range of the channel over the chunk
+        float lo = std::numeric_limits<float>::max();
+        float hi = -lo;
+        for(int f=0 ; f<N_frame ; ++f)
+        {
+            float const* const value = data+f*frame_size+static_cast<size_t>(c)*N;
+            for(int k=0 ; k<N ; ++k)
+            {
+                if(!std::isfinite(value[k]))
+                    throw exception_cpe("Non finite value in frame "+std::to_string(f)+" of the chunk",EXCEPTION_PARAMETERS_CPE);
+                lo = std::min(lo,value[k]);
+                hi = std::max(hi,value[k]);
+            }
+        }
+        float const tolerance = c<3 ? info.tolerance : info.normal_tolerance;
+        //step slightly below twice the tolerance: the float rounding of the
+        //quantization and of the decoding stays within the bound
+        float const rounding = 4.0f*std::numeric_limits<float>::epsilon()*std::max(std::abs(lo),std::abs(hi));
+        float const step = std::max(2.0f*(tolerance-std::min(rounding,0.5f*tolerance)),(hi-lo)/max_level);
+        float const inverse_step = 1.0f/step;
+        header.origin[c] = lo;
+        header.step[c] = step;
+
+        size_t const begin = payload.size();
+        for(int f=0 ; f<N_frame ; ++f)
+        {
+            float const* const value = data+f*frame_size+static_cast<size_t>(c)*N;
+            for(int k=0 ; k<N ; ++k)
+                q[k] = static_cast<uint32_t>(std::lrint((value[k]-lo)*inverse_step));
+
+            if(f==0)
+            {
+                //parallelogram rule on the grid
+                for(int k=0 ; k<N ; ++k)
+                {
+                    int const u = k%Nu;
+                    uint32_t const predicted = k<Nu ? (u>0 ? q[k-1] : 0u) : (u>0 ? q[k-1]+q[k-Nu]-q[k-Nu-1] : q[k-Nu]);
+                    residual[k] = zigzag(q[k]-predicted);
+                }
+            }
+            else
+            {
+                uint64_t cost_previous = 0, cost_linear = 0;
+                for(int k=0 ; k<N ; ++k)
+                {
+                    residual[k] = zigzag(q[k]-q1[k]);
+                    cost_previous += residual[k];
+                }
+                if(f>=2)
+                {
+                    for(int k=0 ; k<N ; ++k)
+                    {
+                        residual_linear[k] = zigzag(q[k]-(2*q1[k]-q2[k]));
+                        cost_linear += residual_linear[k];
+                    }
+                    bool const linear = cost_linear<cost_previous;
+                    out.put(linear ? predict_linear : predict_previous,1);
+                    if(linear)
+                        residual.swap(residual_linear);
+                }
+            }
+            write_residuals(out,residual.data(),N);
+
+            q2.swap(q1);
+            q1.swap(q);
+        }
+        out.flush();
+        header.segment_size[c] = payload.size()-begin;
+    }
+
+    std::memcpy(&payload[0],&header,sizeof(header));
+}
+
+void decode_quantized_chunk(char const* const payload,uint64_t const payload_size,int const N_frame,cloth_cache_info const& info,float* const data)
+{
+    int const N = info.N_vertex;
+    int const Nu = prediction_row_size(info);
+    int const N_channel = cache_channel_count(info);
+    size_t const frame_size = static_cast<size_t>(N)*N_channel;
+
+    quantized_chunk_header header;
+    if(payload_size<sizeof(header))
+        throw exception_cpe("Truncated quantized chunk",EXCEPTION_PARAMETERS_CPE);
+    std::memcpy(&header,payload,sizeof(header));
+
+    //the segments follow the header
+    uint64_t segment_begin[6];
+    uint64_t offset = sizeof(header);
+    for(int c=0 ; c<N_channel ; ++c)
+    {
+        if(header.segment_size[c]>payload_size-offset)
+            throw exception_cpe("Incorrect segment size in quantized chunk",EXCEPTION_PARAMETERS_CPE);
+        segment_begin[c] = offset;
+        offset += header.segment_size[c];
+    }
+
+    bool corrupted = false;
+    #pragma omp parallel for schedule(static) reduction(||:corrupted)
+    for(int c=0 ; c<N_channel ; ++c)
+    {
+        bit_reader in(payload+segment_begin[c],header.segment_size[c]);
+        std::vector<uint32_t> q(N),q1(N),q2(N),residual(N);
+        float const origin = header.origin[c];
+        float const step = header.step[c];
+
+        for(int f=0 ; f<N_frame && !corrupted ; ++f)
+        {
+            int const predictor = f==0 ? predict_spatial : (f==1 ? predict_previous : static_cast<int>(in.get(1)));
+            if(!read_residuals(in,residual.data(),N) || in.overrun())
+            {
+                corrupted = true;
+                break;
+            }
+
+            switch(predictor)
+            {
+            case predict_spatial:
+                for(int k=0 ; k<Nu ; ++k)
+                    q[k] = (k>0 ? q[k-1] : 0u)+unzigzag(residual[k]);
+                for(int row=Nu ; row<N ; row+=Nu)
+                {
+                    q[row] = q[row-Nu]+unzigzag(residual[row]);
+                    for(int k=row+1 ; k<row+Nu ; ++k)
+                        q[k] = q[k-1]+q[k-Nu]-q[k-Nu-1]+unzigzag(residual[k]);
+                }
+                break;
+            case predict_previous:
+                for(int k=0 ; k<N ; ++k)
+                    q[k] = q1[k]+unzigzag(residual[k]);
+                break;
+            default:
+                for(int k=0 ; k<N ; ++k)
+                    q[k] = 2*q1[k]-q2[k]+unzigzag(residual[k]);
+                break;
+            }
+
+            float* const value = data+f*frame_size+static_cast<size_t>(c)*N;
+            for(int k=0 ; k<N ; ++k)
+                value[k] = origin+static_cast<float>(static_cast<int32_t>(q[k]))*step;
+
+            q2.swap(q1);
+            q1.swap(q);
+        }
+    }
+
+    if(corrupted)
+        throw exception_cpe("Corrupted quantized chunk",EXCEPTION_PARAMETERS_CPE);
+}
+
+}
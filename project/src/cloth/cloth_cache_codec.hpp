@@ -0,0 +1,62 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef CLOTH_CACHE_CODEC_HPP
+#define CLOTH_CACHE_CODEC_HPP
+
+#include <cstdint>
+#include <vector>
+
+namespace cpe
+{
+
+struct cloth_cache_info;
+
+/** Compressed chunks of a cloth cache (codec_quantized).
+ *
+ *  A chunk is split in channels: x, y and z of the positions, then of the
+ *  normals. Each channel is quantized on a uniform grid spanning its range
+ *  over the frames of the chunk, with a step of twice the tolerance of the
+ *  cache, slightly reduced to absorb the float rounding: the error of a
+ *  decoded value is at most the tolerance (unless the range of the channel
+ *  needs more than 2^24 levels). The integer values are then predicted:
+ *  - first frame of the chunk: from the neighbours already coded in the
+ *    grid (parallelogram rule), or from the previous vertex for a mesh,
+ *  - following frames: from the previous frame, or extrapolated from the
+ *    two previous ones (constant velocity), whichever costs less.
+ *  The residuals are Rice coded by blocks of 64 values (parameter chosen per
+ *  block, a block of zeros takes 5 bits). The channels are coded in separate
+ *  segments: they are decoded in parallel. A chunk only depends on itself,
+ *  so any frame is reached by decoding a single chunk. */
+
+/** Number of channels of the frames of a cache */
+int cache_channel_count(cloth_cache_info const& info);
+
+/** Encode N_frame frames of data, laid out as the raw chunks (x[N],y[N],z[N],
+ *  then the normals for each frame), in payload (exception_cpe for non finite values) */
+void encode_quantized_chunk(float const* data,int N_frame,cloth_cache_info const& info,std::vector<char>& payload);
+
+/** Decode a chunk of N_frame frames written by encode_quantized_chunk into
+ *  data (raw chunk layout). exception_cpe if the payload is corrupted */
+void decode_quantized_chunk(char const* payload,uint64_t payload_size,int N_frame,cloth_cache_info const& info,float* data);
+
+}
+
+#endif
@@ -0,0 +1,194 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cloth_checkpoint.hpp"
+
+#include "../lib/common/error_handling.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+
+namespace cpe
+{
+
+static char const file_magic[8] = {'C','P','E','_','C','K','P','T'};
+static uint32_t const file_version = 1;
+static uint32_t const file_byte_order = 0x01020304;
+/** Alignment of the sections (page of the usual systems, independent of the machine writing the file) */
+static uint32_t const file_page_size = 4096;
+/** Size of the blocks copied in parallel when reading a section */
+static uint64_t const copy_block_size = 1<<20;
+
+static_assert(sizeof(checkpoint_header)<=file_page_size,"The header of a checkpoint should fit in a page");
+static_assert(sizeof(spring)==16 && std::is_trivially_copyable<spring>::value,"Springs are stored as raw memory");
+
+static uint64_t align_page(uint64_t const offset)
+{
+    return (offset+file_page_size-1)/file_page_size*file_page_size;
+}
+
+checkpoint_writer::checkpoint_writer()
+{
+    std::memset(&file_header,0,sizeof(file_header));
+    std::memcpy(file_header.magic,file_magic,sizeof(file_magic));
+    file_header.version = file_version;
+    file_header.byte_order = file_byte_order;
+    file_header.page_size = file_page_size;
+    for(int k=0 ; k<checkpoint_section_size ; ++k)
+    {
+        section_data[k] = nullptr;
+        section_size[k] = 0;
+    }
+}
+
+checkpoint_header& checkpoint_writer::header()
+{
+    return file_header;
+}
+
+void checkpoint_writer::set_section(checkpoint_section const id,void const* const data,uint64_t const size)
+{
+    ASSERT_CPE(id>=0 && id<checkpoint_section_size,"Incorrect checkpoint section");
+    section_data[id] = data;
+    section_size[id] = size;
+}
+
+void checkpoint_writer::copy_section(checkpoint_section const id,void const* const data,uint64_t const size)
+{
+    ASSERT_CPE(id>=0 && id<checkpoint_section_size,"Incorrect checkpoint section");
+    char const* const bytes = static_cast<char const*>(data);
+    section_copy[id].assign(bytes,bytes+size);
+    set_section(id,section_copy[id].data(),size);
+}
+
+void checkpoint_writer::write(std::string const& filename)
+{
+    //section table: each section starts on a page after the header page
+    uint64_t offset = file_page_size;
+    for(int k=0 ; k<checkpoint_section_size ; ++k)
+    {
+        file_header.section_offset[k] = section_size[k]>0 ? offset : 0;
+        file_header.section_size[k] = section_size[k];
+        offset = align_page(offset+section_size[k]);
+    }
+
+    std::ofstream fid(filename.c_str(),std::ios::binary);
+    if(!fid.good())
+        throw exception_cpe("Cannot open file "+filename,EXCEPTION_PARAMETERS_CPE);
+
+    std::vector<char> const padding(file_page_size,0);
+    fid.write(reinterpret_cast<char const*>(&file_header),sizeof(file_header));
+    fid.write(padding.data(),file_page_size-sizeof(file_header));
+    for(int k=0 ; k<checkpoint_section_size ; ++k)
+    {
+        if(section_size[k]==0)
+            continue;
+        fid.write(static_cast<char const*>(section_data[k]),section_size[k]);
+        fid.write(padding.data(),align_page(section_size[k])-section_size[k]);
+    }
+
+    if(!fid.good())
+        throw exception_cpe("Error while writing file "+filename,EXCEPTION_PARAMETERS_CPE);
+}
+
+/** Error message of an invalid header (empty if the header is valid) */
+static std::string check_header(checkpoint_header const& header,uint64_t const file_size,std::string const& filename)
+{
+    if(std::memcmp(header.magic,file_magic,sizeof(file_magic))!=0)
+        return "File "+filename+" is not a cloth checkpoint";
+    if(header.byte_order!=file_byte_order)
+        return "Checkpoint "+filename+" was written with another byte order";
+    if(header.version!=file_version)
+        return "Unsupported version "+std::to_string(header.version)+" of checkpoint in "+filename;
+    if(header.page_size==0 || header.N_particle<0 || header.N_triangle<0 || header.N_spring<0 || header.N_batch<0 || header.N_collider<0)
+        return "Incorrect header in "+filename;
+    for(int k=0 ; k<checkpoint_section_size ; ++k)
+    {
+        uint64_t const offset = header.section_offset[k];
+        uint64_t const size = header.section_size[k];
+        if(offset%header.page_size!=0 || offset>file_size || size>file_size-offset)
+            return "Truncated checkpoint "+filename;
+    }
+    return "";
+}
+
+checkpoint_header read_checkpoint_header(std::string const& filename)
+{
+    std::ifstream fid(filename.c_str(),std::ios::binary|std::ios::ate);
+    if(!fid.good())
+        throw exception_cpe("Cannot open file "+filename,EXCEPTION_PARAMETERS_CPE);
+    uint64_t const file_size = fid.tellg();
+
+    checkpoint_header header;
+    fid.seekg(0);
+    fid.read(reinterpret_cast<char*>(&header),sizeof(header));
+    if(!fid.good())
+        throw exception_cpe("File "+filename+" is not a cloth checkpoint",EXCEPTION_PARAMETERS_CPE);
+    std::string const error = check_header(header,file_size,filename);
+    if(!error.empty())
+        throw exception_cpe(error,EXCEPTION_PARAMETERS_CPE);
+    return header;
+}
+
+checkpoint_reader::checkpoint_reader(std::string const& filename)
+    :file_name(filename)
+{
+    file.open(filename);
+    if(file.size()<sizeof(checkpoint_header))
+        throw exception_cpe("File "+filename+" is not a cloth checkpoint",EXCEPTION_PARAMETERS_CPE);
+
+    std::memcpy(&file_header,file.data(),sizeof(file_header));
+    std::string const error = check_header(file_header,file.size(),filename);
+    if(!error.empty())
+        throw exception_cpe(error,EXCEPTION_PARAMETERS_CPE);
+}
+
+checkpoint_header const& checkpoint_reader::header() const
+{
+    return file_header;
+}
+
+std::string const& checkpoint_reader::filename() const
+{
+    return file_name;
+}
+
+void const* checkpoint_reader::section(checkpoint_section const id,uint64_t const size) const
+{
+    ASSERT_CPE(id>=0 && id<checkpoint_section_size,"Incorrect checkpoint section");
+    if(file_header.section_size[id]!=size)
+        throw exception_cpe("Incorrect size of section "+std::to_string(id)+" in checkpoint "+file_name,EXCEPTION_PARAMETERS_CPE);
+    return file.data()+file_header.section_offset[id];
+}
+
+void checkpoint_reader::read_section(checkpoint_section const id,void* const data,uint64_t const size) const
+{
+    char const* const source = static_cast<char const*>(section(id,size));
+    char* const destination = static_cast<char*>(data);
+    long const N_block = (size+copy_block_size-1)/copy_block_size;
+    #pragma omp parallel for schedule(static)
+    for(long k_block=0 ; k_block<N_block ; ++k_block)
+    {
+        uint64_t const begin = k_block*copy_block_size;
+        uint64_t const end = std::min(begin+copy_block_size,size);
+        std::memcpy(destination+begin,source+begin,end-begin);
+    }
+}
+
+}
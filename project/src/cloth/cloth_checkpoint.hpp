@@ -0,0 +1,202 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef CLOTH_CHECKPOINT_HPP
+#define CLOTH_CHECKPOINT_HPP
+
+#include "spring.hpp"
+#include "../lib/common/mapped_file.hpp"
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace cpe
+{
+
+/** Arrays stored in a checkpoint file */
+enum checkpoint_section
+{
+    section_position_x = 0,
+    section_position_y = 1,
+    section_position_z = 2,
+    section_velocity_x = 3,
+    section_velocity_y = 4,
+    section_velocity_z = 5,
+    section_inv_mass = 6,
+    /** Springs (i,j,k,rest_length) sorted by family and by batch */
+    section_spring = 7,
+    /** Offsets of the spring batches (N_batch+1 entries) */
+    section_spring_batch = 8,
+    /** Analytic colliders (checkpoint_collider) */
+    section_collider = 9,
+    /** Triangles of a mesh cloth (3 indices per triangle) */
+    section_triangle = 10,
+    /** Texture coordinates of a mesh cloth (2 floats per vertex) */
+    section_texture_coord = 11,
+    /** Lattices of the Perlin wind (see wind_field::get_lattice_state) */
+    section_wind_lattice = 12,
+    checkpoint_section_size = 13
+};
+
+/** Surface of the cloth stored in a checkpoint */
+enum checkpoint_layout
+{
+    /** Regular grid of size_u x size_v particles (mesh_parametric_cloth) */
+    checkpoint_grid = 0,
+    /** Arbitrary triangle mesh (mesh_cloth) */
+    checkpoint_mesh = 1
+};
+
+/** Header of a checkpoint file, stored in the first page of the file */
+struct checkpoint_header
+{
+    char magic[8];
+    uint32_t version;
+    /** Written as 0x01020304, checks the byte order of the machine reading the file */
+    uint32_t byte_order;
+    /** Alignment of the sections in the file */
+    uint32_t page_size;
+    int32_t layout;
+    /** Size of the grid (checkpoint_grid only) */
+    int32_t size_u;
+    int32_t size_v;
+
+    int32_t N_particle;
+    int32_t N_triangle;
+    int32_t N_spring;
+    int32_t N_batch;
+    int32_t N_collider;
+    int32_t spring_family_offset[spring_family_size+1];
+
+    int32_t integrator;
+    int32_t wind_model;
+    int32_t self_collision;
+    /** Cell size of the self collision grids (0: not built yet) */
+    float self_collision_cell;
+    int32_t sleeping;
+    float k_structural;
+    float k_shearing;
+    float k_bending;
+    int64_t step_counter;
+    uint64_t wind_seed;
+    /** Steps of the Perlin wind lattices (section_wind_lattice) */
+    int64_t wind_lattice_step[2];
+
+    /** Position in the file (multiple of page_size) and size in bytes of each section, 0 if absent */
+    uint64_t section_offset[checkpoint_section_size];
+    uint64_t section_size[checkpoint_section_size];
+};
+
+/** Analytic collider as stored in a checkpoint */
+struct checkpoint_collider
+{
+    int32_t shape;
+    int32_t enabled;
+    float p0[3];
+    float p1[3];
+    float radius;
+    float thickness;
+    float friction;
+};
+
+/** Read and check the header of a checkpoint file without mapping it */
+checkpoint_header read_checkpoint_header(std::string const& filename);
+
+/** Writer of a checkpoint file.
+ *
+ *  The file is the header page followed by the sections, each of them
+ *  starting on a page boundary so that the whole file can be mapped in
+ *  memory and each array read in place (native byte order). */
+class checkpoint_writer
+{
+public:
+
+    checkpoint_writer();
+
+    /** Header to fill before write (the section table is set by write) */
+    checkpoint_header& header();
+    /** Reference an array to store in a section. The data is not copied and
+     *  must stay valid until write. */
+    void set_section(checkpoint_section id,void const* data,uint64_t size);
+    /** Copy an array into a section (small temporary arrays) */
+    void copy_section(checkpoint_section id,void const* data,uint64_t size);
+
+    /** Write the header and the sections */
+    void write(std::string const& filename);
+
+private:
+
+    checkpoint_header file_header;
+    /** Data and size of each section */
+    void const* section_data[checkpoint_section_size];
+    uint64_t section_size[checkpoint_section_size];
+    /** Storage of the copied sections */
+    std::vector<char> section_copy[checkpoint_section_size];
+};
+
+/** Checkpoint file mapped in memory (read only).
+ *  The header and the bounds of the sections are checked at the opening. */
+class checkpoint_reader
+{
+public:
+
+    /** Map the file (exception_cpe if it is not a valid checkpoint) */
+    explicit checkpoint_reader(std::string const& filename);
+
+    checkpoint_header const& header() const;
+    std::string const& filename() const;
+
+    /** Section of count elements read in place in the mapped file (valid while
+     *  the reader exists), exception_cpe if the size differs */
+    template <typename T>
+    T const* view(checkpoint_section id,int count) const;
+    /** Copy a section of count elements into data (resized), exception_cpe if the size differs */
+    template <typename T,typename ALLOCATOR>
+    void read(checkpoint_section id,std::vector<T,ALLOCATOR>& data,int count) const;
+
+private:
+
+    /** Address of a section of size bytes in the mapped file */
+    void const* section(checkpoint_section id,uint64_t size) const;
+    /** Copy a section of size bytes into data */
+    void read_section(checkpoint_section id,void* data,uint64_t size) const;
+
+    std::string file_name;
+    mapped_file file;
+    checkpoint_header file_header;
+};
+
+template <typename T>
+T const* checkpoint_reader::view(checkpoint_section const id,int const count) const
+{
+    return static_cast<T const*>(section(id,static_cast<uint64_t>(count)*sizeof(T)));
+}
+
+template <typename T,typename ALLOCATOR>
+void checkpoint_reader::read(checkpoint_section const id,std::vector<T,ALLOCATOR>& data,int const count) const
+{
+    data.resize(count);
+    read_section(id,data.data(),static_cast<uint64_t>(count)*sizeof(T));
+}
+
+}
+
+#endif
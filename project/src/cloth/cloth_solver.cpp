@@ -0,0 +1,643 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cloth_solver.hpp"
+#include "particle_dynamics.hpp"
+
+#include "../lib/common/error_handling.hpp"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace cpe
+{
+
+/** Number of particles of the sleep tiles of a cloth without specific layout */
+static int const default_tile_size = 256;
+
+void cloth_solver::compute_forces(float const h,bool const wind,int const wind_force,float const radius,vec3 const& center,std::vector<vec3> const& normal)
+{
+    int const N_total = particles.size();
+    ASSERT_CPE(static_cast<int>(normal.size()) == N_total , "Error of size");
+
+    colliders.set_scene(h,radius,center);
+
+    //Sleeping tiles: the wind and the self collision keep the cloth awake,
+    // a collider moving close to a sleeping tile wakes it up
+    sleep_active = sleeping_enabled && !wind && !self_collision_enabled;
+    if(sleeping_enabled && !sleep_active)
+        sleep.wake_all();
+    if(sleep_active)
+        wake_disturbed_tiles();
+    bool const partial = sleep.size_awake()<sleep.size_tile();
+    if(partial && sleep.springs_outdated())
+        sleep.filter_springs(spring_data,spring_batch_offset,particles);
+    if(sleep_active)
+        sleep.begin_step(particles);
+    std::vector<particle_range> const& awake = sleep.awake_ranges();
+
+    //Gravity
+    static vec3 const g (0.0f,0.0f,-9.81f);
+    vec3 const g_normalized = g/N_total;
+
+    float* const fx = particles.force.x.data();
+    float* const fy = particles.force.y.data();
+    float* const fz = particles.force.z.data();
+
+    for(particle_range const& r : awake)
+    {
+        #pragma omp parallel for schedule(static)
+        for(int k=r.begin ; k<r.end ; ++k)
+        {
+            fx[k] = g_normalized.x();
+            fy[k] = g_normalized.y();
+            fz[k] = g_normalized.z();
+        }
+    }
+
+    //Springs (structural, shearing and bending), handled as constraints by XPBD
+    if(integrator_type!=integrator_xpbd)
+    {
+        if(partial)
+            add_spring_forces(particles,sleep.awake_springs(),sleep.awake_batch_offset(),kernel_type);
+        else
+            compute_spring_forces();
+    }
+
+    //Self collision
+    if(self_collision_enabled)
+        self_repulsion.add_forces(particles);
+
+    //Collisions (each particle is handled independently)
+    colliders.resolve(particles,awake);
+    for(mesh_collider& collider : mesh_colliders)
+        collider.collide(particles,awake);
+    for(sdf_collider& collider : sdf_colliders)
+        collider.collide(particles,awake);
+
+    //Wind force
+    if(wind)
+    {
+        sample_wind_intensity(particles,wind_type,wind_noise,wind_seed,step_counter,wind_intensity);
+        add_wind_forces(particles,normal,wind_intensity,wind_force,{0,N_total});
+    }
+}
+
+void cloth_solver::integration_step(float const& dt)
+{
+    int const N = particles.size();
+    ASSERT_CPE(particles.velocity.size() == N,"Incorrect size");
+    ASSERT_CPE(particles.force.size() == N,"Incorrect size");
+
+    //the sleeping particles are seen as fixed particles by the implicit and XPBD solvers
+    std::vector<particle_range> const& awake = sleep.awake_ranges();
+    bool const partial = sleep.size_awake()<sleep.size_tile();
+    std::vector<spring> const& springs = partial ? sleep.awake_springs() : spring_data;
+    std::vector<int> const& batch_offset = partial ? sleep.awake_batch_offset() : spring_batch_offset;
+    if(partial && integrator_type!=integrator_explicit_euler)
+    {
+        awake_inv_mass.assign(N,0.0f);
+        for(particle_range const& r : awake)
+            std::copy(particles.inv_mass.begin()+r.begin,particles.inv_mass.begin()+r.end,awake_inv_mass.begin()+r.begin);
+        std::swap(particles.inv_mass,awake_inv_mass);
+    }
+
+    integrate(integrator_type,implicit,xpbd,particles,springs,batch_offset,dt,awake);
+    ++step_counter;
+
+    if(partial && integrator_type!=integrator_explicit_euler)
+        std::swap(particles.inv_mass,awake_inv_mass);
+
+    //security check (throw exception if divergence is detected)
+    float const max_norm = max_position_norm();
+    if( max_norm > CLOTH_DIVERGENCE_LIMIT )
+    {
+        std::cout << "norme de p : " << max_norm << std::endl;
+        throw exception_divergence("Divergence of the system",EXCEPTION_PARAMETERS_CPE);
+    }
+
+    if(sleep_active)
+        sleep.end_step(particles,dt);
+    else
+        sleep.advance();
+}
+
+float cloth_solver::max_position_norm() const
+{
+    float const* const px = particles.position.x.data();
+    float const* const py = particles.position.y.data();
+    float const* const pz = particles.position.z.data();
+
+    float max_norm2 = 0.0f;
+    for(particle_range const& r : sleep.awake_ranges())
+    {
+        #pragma omp parallel for schedule(static) reduction(max:max_norm2)
+        for(int k=r.begin ; k<r.end ; ++k)
+        {
+            float const n2 = px[k]*px[k]+py[k]*py[k]+pz[k]*pz[k];
+            max_norm2 = n2>max_norm2 ? n2 : max_norm2;
+        }
+    }
+    return std::sqrt(max_norm2);
+}
+
+/** Wake the sleeping tiles whose bounding sphere is closer to the collider than its thickness */
+static void wake_close_tiles(sleep_tiles& sleep,collider const& c)
+{
+    if(!c.enabled)
+        return;
+    int const N_tile = sleep.size_tile();
+    for(int t=0 ; t<N_tile ; ++t)
+        if(!sleep.awake(t) && collider_distance(c,sleep.bound_center(t))<sleep.bound_radius(t)+c.thickness)
+            sleep.wake(t);
+}
+
+void cloth_solver::wake_disturbed_tiles()
+{
+    int const N_collider = colliders.size();
+    if(static_cast<int>(collider_state.size())!=N_collider)
+        sleep.wake_all();
+    else
+    {
+        //a collider changed: the tiles close to its previous and new state are woken up
+        for(int k=0 ; k<N_collider ; ++k)
+        {
+            collider const& c = colliders.get(k);
+            if(same_collider(collider_state[k],c))
+                continue;
+            wake_close_tiles(sleep,collider_state[k]);
+            wake_close_tiles(sleep,c);
+        }
+    }
+
+    collider_state.resize(N_collider);
+    for(int k=0 ; k<N_collider ; ++k)
+        collider_state[k] = colliders.get(k);
+}
+
+void cloth_solver::set_sleeping(bool const enabled)
+{
+    sleeping_enabled = enabled;
+    sleep.wake_all();
+}
+
+bool cloth_solver::get_sleeping() const
+{
+    return sleeping_enabled;
+}
+
+sleep_tiles& cloth_solver::get_sleep_tiles()
+{
+    return sleep;
+}
+
+sleep_tiles const& cloth_solver::get_sleep_tiles() const
+{
+    return sleep;
+}
+
+void cloth_solver::initialize_sleep_tiles(int const tile_size)
+{
+    sleep.set_tiles(particles.size(),tile_size);
+}
+
+void cloth_solver::export_moved_positions(std::vector<vec3>& vertex,long& stamp) const
+{
+    int const N = particles.size();
+    if(static_cast<int>(vertex.size())!=N)
+        particles.position.export_aos(vertex);
+    else
+    {
+        float const* const px = particles.position.x.data();
+        float const* const py = particles.position.y.data();
+        float const* const pz = particles.position.z.data();
+        int const N_tile = sleep.size_tile();
+        for(int t=0 ; t<N_tile ; ++t)
+        {
+            if(sleep.motion(t)<=stamp)
+                continue;
+            int const end = sleep.tile_end(t);
+            for(int k=sleep.tile_begin(t) ; k<end ; ++k)
+                vertex[k] = vec3(px[k],py[k],pz[k]);
+        }
+    }
+    stamp = sleep.clock();
+}
+
+void cloth_solver::set_integrator(cloth_integrator const type)
+{
+    integrator_type = type;
+}
+
+cloth_integrator cloth_solver::get_integrator() const
+{
+    return integrator_type;
+}
+
+implicit_solver& cloth_solver::get_implicit_solver()
+{
+    return implicit;
+}
+
+xpbd_solver& cloth_solver::get_xpbd_solver()
+{
+    return xpbd;
+}
+
+void cloth_solver::compute_spring_forces()
+{
+    add_spring_forces(particles,spring_data,spring_batch_offset,kernel_type);
+}
+
+void cloth_solver::set_spring_kernel(spring_kernel_type const type)
+{
+    ASSERT_CPE(spring_kernel_supported(type),"Spring kernel "+spring_kernel_name(type)+" is not supported by this CPU");
+    kernel_type = type;
+}
+
+spring_kernel_type cloth_solver::get_spring_kernel_type() const
+{
+    return kernel_type;
+}
+
+void cloth_solver::set_family_stiffness(spring_family const family,float const k)
+{
+    int const begin = spring_family_offset[family];
+    int const end = spring_family_offset[family+1];
+    ASSERT_CPE(end <= static_cast<int>(spring_data.size()),"Incorrect spring offset");
+
+    for(int k_spring=begin ; k_spring<end ; ++k_spring)
+        spring_data[k_spring].k = k;
+
+    //new equilibrium (and the filtered springs are rebuilt)
+    sleep.wake_all();
+}
+
+void cloth_solver::set_k_struct(float const& k){
+    k_structural = k;
+    set_family_stiffness(spring_structural,k);
+}
+
+void cloth_solver::set_k_shear(float const& k){
+    k_shearing = k;
+    set_family_stiffness(spring_shearing,k);
+}
+
+void cloth_solver::set_k_bend(float const& k){
+    k_bending = k;
+    set_family_stiffness(spring_bending,k);
+}
+
+std::string cloth_solver::str_k_struct(){
+    return std::to_string(k_structural);
+}
+
+std::string cloth_solver::str_k_shear(){
+    return std::to_string(k_shearing);
+}
+
+std::string cloth_solver::str_k_bend(){
+    return std::to_string(k_bending);
+}
+
+void cloth_solver::set_self_collision(bool const enabled)
+{
+    self_collision_enabled = enabled;
+    sleep.wake_all();
+}
+
+bool cloth_solver::get_self_collision() const
+{
+    return self_collision_enabled;
+}
+
+self_collision& cloth_solver::get_self_collision_solver()
+{
+    return self_repulsion;
+}
+
+collider_registry& cloth_solver::get_colliders()
+{
+    return colliders;
+}
+
+int cloth_solver::add_mesh_collider(mesh_basic const& m,float const thickness)
+{
+    mesh_collider collider;
+    collider.set_thickness(thickness);
+    collider.set_mesh(m);
+    mesh_colliders.push_back(std::move(collider));
+    sleep.wake_all();
+    return mesh_colliders.size()-1;
+}
+
+mesh_collider& cloth_solver::get_mesh_collider(int const index)
+{
+    ASSERT_CPE(index>=0 && index<size_mesh_collider(),"Incorrect collider index");
+    sleep.wake_all();
+    return mesh_colliders[index];
+}
+
+int cloth_solver::size_mesh_collider() const
+{
+    return mesh_colliders.size();
+}
+
+void cloth_solver::clear_mesh_collider()
+{
+    mesh_colliders.clear();
+    sleep.wake_all();
+}
+
+int cloth_solver::add_sdf_collider(signed_distance_field const& field,float const thickness)
+{
+    sdf_colliders.push_back(sdf_collider());
+    sdf_colliders.back().set_field(field);
+    sdf_colliders.back().set_thickness(thickness);
+    sleep.wake_all();
+    return sdf_colliders.size()-1;
+}
+
+sdf_collider& cloth_solver::get_sdf_collider(int const index)
+{
+    ASSERT_CPE(index>=0 && index<size_sdf_collider(),"Incorrect collider index");
+    sleep.wake_all();
+    return sdf_colliders[index];
+}
+
+int cloth_solver::size_sdf_collider() const
+{
+    return sdf_colliders.size();
+}
+
+void cloth_solver::clear_sdf_collider()
+{
+    sdf_colliders.clear();
+    sleep.wake_all();
+}
+
+void cloth_solver::initialize_self_collision(std::vector<triangle_index> const& triangles)
+{
+    self_repulsion.set_topology(triangles,particles.size());
+}
+
+float cloth_solver::get_k_struct() const
+{
+    return k_structural;
+}
+
+float cloth_solver::get_k_shear() const
+{
+    return k_shearing;
+}
+
+float cloth_solver::get_k_bend() const
+{
+    return k_bending;
+}
+
+particle_store const& cloth_solver::particle_data() const
+{
+    return particles;
+}
+
+std::vector<spring> const& cloth_solver::springs() const
+{
+    return spring_data;
+}
+
+int cloth_solver::spring_offset(int const family) const
+{
+    ASSERT_CPE(family>=0 && family<=spring_family_size,"Incorrect spring family");
+    return spring_family_offset[family];
+}
+
+void cloth_solver::initialize_particles(std::vector<vec3> const& position)
+{
+    int const N = position.size();
+    particles.position.import_aos(position);
+    particles.resize(N);
+    particles.velocity.fill(vec3());
+    particles.force.fill(vec3());
+    for(float& w : particles.inv_mass)
+        w = 1.0f;
+    sleep.set_tiles(N,default_tile_size);
+}
+
+void cloth_solver::initialize_springs(std::vector<spring> const& springs,int const family_offset[spring_family_size+1])
+{
+    ASSERT_CPE(family_offset[0]==0 && family_offset[spring_family_size]==static_cast<int>(springs.size()),"Incorrect spring offset");
+
+    spring_data = springs;
+    for(int f=0 ; f<=spring_family_size ; ++f)
+        spring_family_offset[f] = family_offset[f];
+
+    //split each family into batches of springs without common vertex
+    spring_batch_offset.clear();
+    for(int f=0 ; f<spring_family_size ; ++f)
+        color_springs(spring_data,spring_family_offset[f],spring_family_offset[f+1],particles.size(),spring_batch_offset);
+    spring_batch_offset.push_back(spring_data.size());
+    sleep.wake_all();
+
+    step_counter = 0;
+}
+
+void cloth_solver::write_checkpoint(checkpoint_writer& file) const
+{
+    int const N = particles.size();
+    int const N_collider = colliders.size();
+
+    checkpoint_header& header = file.header();
+    header.N_particle = N;
+    header.N_spring = spring_data.size();
+    header.N_batch = spring_batch_offset.size()-1;
+    header.N_collider = N_collider;
+    for(int f=0 ; f<=spring_family_size ; ++f)
+        header.spring_family_offset[f] = spring_family_offset[f];
+    header.integrator = integrator_type;
+    header.wind_model = wind_type;
+    header.self_collision = self_collision_enabled;
+    header.self_collision_cell = self_repulsion.get_cell_size();
+    header.sleeping = sleeping_enabled;
+    header.k_structural = k_structural;
+    header.k_shearing = k_shearing;
+    header.k_bending = k_bending;
+    header.step_counter = step_counter;
+    header.wind_seed = wind_seed;
+
+    uint64_t const size = static_cast<uint64_t>(N)*sizeof(float);
+    file.set_section(section_position_x,particles.position.x.data(),size);
+    file.set_section(section_position_y,particles.position.y.data(),size);
+    file.set_section(section_position_z,particles.position.z.data(),size);
+    file.set_section(section_velocity_x,particles.velocity.x.data(),size);
+    file.set_section(section_velocity_y,particles.velocity.y.data(),size);
+    file.set_section(section_velocity_z,particles.velocity.z.data(),size);
+    file.set_section(section_inv_mass,particles.inv_mass.data(),size);
+    file.set_section(section_spring,spring_data.data(),spring_data.size()*sizeof(spring));
+    file.set_section(section_spring_batch,spring_batch_offset.data(),spring_batch_offset.size()*sizeof(int));
+
+    std::vector<checkpoint_collider> stored(N_collider);
+    for(int k=0 ; k<N_collider ; ++k)
+    {
+        collider const& c = colliders.get(k);
+        checkpoint_collider& s = stored[k];
+        s.shape = c.shape;
+        s.enabled = c.enabled;
+        for(int d=0 ; d<3 ; ++d)
+        {
+            s.p0[d] = c.p0[d];
+            s.p1[d] = c.p1[d];
+        }
+        s.radius = c.radius;
+        s.thickness = c.thickness;
+        s.friction = c.friction;
+    }
+    file.copy_section(section_collider,stored.data(),stored.size()*sizeof(checkpoint_collider));
+
+    long lattice_step[2];
+    std::vector<float> lattice_data;
+    wind_noise.get_lattice_state(lattice_step,lattice_data);
+    header.wind_lattice_step[0] = lattice_step[0];
+    header.wind_lattice_step[1] = lattice_step[1];
+    file.copy_section(section_wind_lattice,lattice_data.data(),lattice_data.size()*sizeof(float));
+}
+
+void cloth_solver::read_checkpoint(checkpoint_reader const& file)
+{
+    checkpoint_header const& header = file.header();
+    std::string const& filename = file.filename();
+    int const N = header.N_particle;
+    int const N_spring = header.N_spring;
+    int const N_batch = header.N_batch;
+    int const N_collider = header.N_collider;
+
+    //check the values used as indices before modifying the solver
+    if(header.integrator<integrator_explicit_euler || header.integrator>integrator_xpbd ||
+       header.wind_model<wind_random || header.wind_model>wind_perlin || N_collider<=collider_registry::scene_sphere ||
+       header.spring_family_offset[0]!=0 || header.spring_family_offset[spring_family_size]!=N_spring)
+        throw exception_cpe("Incorrect header in checkpoint "+filename,EXCEPTION_PARAMETERS_CPE);
+    for(int f=0 ; f<spring_family_size ; ++f)
+        if(header.spring_family_offset[f]>header.spring_family_offset[f+1])
+            throw exception_cpe("Incorrect spring offset in checkpoint "+filename,EXCEPTION_PARAMETERS_CPE);
+
+    //checked in place in the file, then copied in the arrays of the solver (kept if the size is unchanged)
+    spring const* const springs = file.view<spring>(section_spring,N_spring);
+    int const* const batch_offset = file.view<int>(section_spring_batch,N_batch+1);
+    checkpoint_collider const* const stored = file.view<checkpoint_collider>(section_collider,N_collider);
+
+    bool valid_spring = true;
+    #pragma omp parallel for schedule(static) reduction(&&:valid_spring)
+    for(int k=0 ; k<N_spring ; ++k)
+        valid_spring = valid_spring && springs[k].i>=0 && springs[k].i<N && springs[k].j>=0 && springs[k].j<N;
+    if(!valid_spring)
+        throw exception_cpe("Incorrect spring in checkpoint "+filename,EXCEPTION_PARAMETERS_CPE);
+    if(batch_offset[0]!=0 || batch_offset[N_batch]!=N_spring)
+        throw exception_cpe("Incorrect spring batch in checkpoint "+filename,EXCEPTION_PARAMETERS_CPE);
+    for(int b=0 ; b<N_batch ; ++b)
+        if(batch_offset[b]>batch_offset[b+1])
+            throw exception_cpe("Incorrect spring batch in checkpoint "+filename,EXCEPTION_PARAMETERS_CPE);
+    for(int k=0 ; k<N_collider ; ++k)
+        if(stored[k].shape<collider_plane || stored[k].shape>collider_box || !(stored[k].thickness>=0.0f) || !(stored[k].friction>=0.0f))
+            throw exception_cpe("Incorrect collider in checkpoint "+filename,EXCEPTION_PARAMETERS_CPE);
+
+    //particles
+    particles.resize(N);
+    file.read(section_position_x,particles.position.x,N);
+    file.read(section_position_y,particles.position.y,N);
+    file.read(section_position_z,particles.position.z,N);
+    file.read(section_velocity_x,particles.velocity.x,N);
+    file.read(section_velocity_y,particles.velocity.y,N);
+    file.read(section_velocity_z,particles.velocity.z,N);
+    file.read(section_inv_mass,particles.inv_mass,N);
+    particles.force.fill(vec3());
+
+    //springs, in the stored order of the batches
+    file.read(section_spring,spring_data,N_spring);
+    spring_batch_offset.assign(batch_offset,batch_offset+N_batch+1);
+    for(int f=0 ; f<=spring_family_size ; ++f)
+        spring_family_offset[f] = header.spring_family_offset[f];
+    k_structural = header.k_structural;
+    k_shearing = header.k_shearing;
+    k_bending = header.k_bending;
+
+    //colliders of the registry (the scene entries are the first two)
+    colliders.clear();
+    for(int k=0 ; k<N_collider ; ++k)
+    {
+        checkpoint_collider const& s = stored[k];
+        collider c;
+        c.shape = static_cast<collider_shape>(s.shape);
+        c.enabled = s.enabled!=0;
+        c.p0 = vec3(s.p0[0],s.p0[1],s.p0[2]);
+        c.p1 = vec3(s.p1[0],s.p1[1],s.p1[2]);
+        c.radius = s.radius;
+        c.thickness = s.thickness;
+        c.friction = s.friction;
+        if(k<=collider_registry::scene_sphere)
+            colliders.get(k) = c;
+        else
+            colliders.add(c);
+    }
+
+    integrator_type = static_cast<cloth_integrator>(header.integrator);
+    wind_type = static_cast<wind_model>(header.wind_model);
+    set_wind_seed(header.wind_seed);
+    //the stored lattices are ignored if the resolution of the wind changed (sampled again)
+    long const lattice_step[2] = {static_cast<long>(header.wind_lattice_step[0]),static_cast<long>(header.wind_lattice_step[1])};
+    std::vector<float> lattice_data;
+    file.read(section_wind_lattice,lattice_data,header.section_size[section_wind_lattice]/sizeof(float));
+    wind_noise.set_lattice_state(lattice_step,lattice_data);
+    self_collision_enabled = header.self_collision!=0;
+    if(header.self_collision_cell>0.0f)
+        self_repulsion.set_cell_size(header.self_collision_cell);
+    sleeping_enabled = header.sleeping!=0;
+    step_counter = header.step_counter;
+
+    //the tiles keep their size, the whole cloth is awake and copied at the next sync
+    sleep.set_tiles(N,sleep.size_tile()>0 ? sleep.tile_size() : default_tile_size);
+    sleep.wake_all();
+}
+
+void cloth_solver::set_wind_seed(uint64_t const seed)
+{
+    wind_seed = seed;
+    wind_noise.set_seed(seed);
+}
+
+void cloth_solver::set_wind_model(wind_model const type)
+{
+    wind_type = type;
+}
+
+wind_model cloth_solver::get_wind_model() const
+{
+    return wind_type;
+}
+
+wind_field& cloth_solver::get_wind_field()
+{
+    return wind_noise;
+}
+
+long cloth_solver::step_count() const
+{
+    return step_counter;
+}
+
+
+}
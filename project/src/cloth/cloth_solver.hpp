@@ -0,0 +1,231 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef CLOTH_SOLVER_HPP
+#define CLOTH_SOLVER_HPP
+
+#include "../lib/3d/vec3.hpp"
+#include "../lib/common/exception_cpe.hpp"
+#include "spring.hpp"
+#include "spring_kernel.hpp"
+#include "particle_store.hpp"
+#include "particle_dynamics.hpp"
+#include "implicit_solver.hpp"
+#include "xpbd_solver.hpp"
+#include "wind_field.hpp"
+#include "self_collision.hpp"
+#include "collider_registry.hpp"
+#include "mesh_collider.hpp"
+#include "sdf_collider.hpp"
+#include "sleep_tiles.hpp"
+#include "cloth_checkpoint.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cpe
+{
+
+/** Mass-spring solver of a cloth, independent of the topology of the surface.
+ *
+ *  Holds the particles, the flat list of springs (sorted by family and split
+ *  into batches without common vertex), the integrators and the wind.
+ *  The cloth meshes derive from it and only provide the initial positions,
+ *  the springs and the normals used by the wind. */
+class cloth_solver
+{
+public:
+
+    /** Direct access to the particles of the solver */
+    particle_store const& particle_data() const;
+
+    void integration_step(const float &dt);
+    /** Number of calls to integration_step since the springs were built */
+    long step_count() const;
+    /** Seed of the random wind intensity (the wind of a step only depends on the seed and the step count) */
+    void set_wind_seed(uint64_t seed);
+    /** Select the distribution of the wind intensity (default: Perlin gusts) */
+    void set_wind_model(wind_model type);
+    wind_model get_wind_model() const;
+    /** Parameters of the Perlin wind (lattice resolution, update period, frequencies) */
+    wind_field& get_wind_field();
+
+    /** Select the time integration scheme used by integration_step */
+    void set_integrator(cloth_integrator type);
+    cloth_integrator get_integrator() const;
+    /** Parameters of the backward Euler integrator */
+    implicit_solver& get_implicit_solver();
+    /** Parameters of the XPBD solver (number of iterations) */
+    xpbd_solver& get_xpbd_solver();
+
+    void set_k_struct(float const& k);
+    void set_k_shear(float const& k);
+    void set_k_bend(float const& k);
+    std::string str_k_struct();
+    std::string str_k_shear();
+    std::string str_k_bend();
+    float get_k_struct() const;
+    float get_k_shear() const;
+    float get_k_bend() const;
+
+    /** Repulsion between the parts of the cloth closer than a thickness (default: disabled) */
+    void set_self_collision(bool enabled);
+    bool get_self_collision() const;
+    /** Parameters of the self collision (thickness, stiffness) */
+    self_collision& get_self_collision_solver();
+
+    /** Deactivation of the tiles of the cloth at rest (default: disabled).
+     *  The wind and the self collision keep the whole cloth awake. */
+    void set_sleeping(bool enabled);
+    bool get_sleeping() const;
+    /** Tiles of particles and sleep thresholds */
+    sleep_tiles& get_sleep_tiles();
+    sleep_tiles const& get_sleep_tiles() const;
+
+    /** Analytic colliders (the first two are the ground and the sphere given to update_force) */
+    collider_registry& get_colliders();
+
+    /** Add a triangle mesh obstacle (its bvh is built here), returns its index */
+    int add_mesh_collider(mesh_basic const& m,float thickness);
+    /** Obstacle of the given index (thickness, deformation of the mesh), wakes up the cloth */
+    mesh_collider& get_mesh_collider(int index);
+    int size_mesh_collider() const;
+    void clear_mesh_collider();
+
+    /** Add a static obstacle given by a signed distance field (copied), returns its index */
+    int add_sdf_collider(signed_distance_field const& field,float thickness);
+    /** Obstacle of the given index, wakes up the cloth */
+    sdf_collider& get_sdf_collider(int index);
+    int size_sdf_collider() const;
+    void clear_sdf_collider();
+
+    /** Springs of the cloth, sorted by family and by color batch */
+    std::vector<spring> const& springs() const;
+    /** Springs of family f are in [spring_offset(f),spring_offset(f+1)) */
+    int spring_offset(int family) const;
+    /** Add the forces of all the springs (each spring evaluated once) */
+    void compute_spring_forces();
+    /** Select the implementation used to evaluate the springs (default: fastest supported one) */
+    void set_spring_kernel(spring_kernel_type type);
+    spring_kernel_type get_spring_kernel_type() const;
+
+protected:
+
+    /** Reset the particles at the given positions with zero velocity and unit inverse mass */
+    void initialize_particles(std::vector<vec3> const& position);
+    /** Set the springs (sorted by family, family f in [family_offset[f],family_offset[f+1]))
+     *  and split each family into batches. Resets the step counter. */
+    void initialize_springs(std::vector<spring> const& springs,int const family_offset[spring_family_size+1]);
+
+    /** Set the triangles of the cloth used by the self collision */
+    void initialize_self_collision(std::vector<triangle_index> const& triangles);
+    /** Group the particles in sleep tiles of tile_size consecutive particles (default 256) */
+    void initialize_sleep_tiles(int tile_size);
+
+    /** Copy into vertex the positions of the tiles moved since the clock stamp
+     *  of the sleep tiles (all of them if the size differs), update stamp */
+    void export_moved_positions(std::vector<vec3>& vertex,long& stamp) const;
+
+    /** Fill the header and the sections of a checkpoint with the state of the solver:
+     *  particles, springs and batches, stiffness, analytic colliders, integrator,
+     *  wind and step counter (the arrays are referenced until the write) */
+    void write_checkpoint(checkpoint_writer& file) const;
+    /** Restore the state written by write_checkpoint (the particles are resized,
+     *  the springs are restored without being colored again, all the tiles are awake).
+     *  The derived cloth restores its own surface. */
+    void read_checkpoint(checkpoint_reader const& file);
+
+    /** Gravity, springs, self collision, collisions and wind.
+     *  The ground (height h) and the sphere are the scene entries of the collider registry.
+     *  The wind pushes each particle along its normal (one normal per particle). */
+    void compute_forces(float h,bool wind,int wind_force,float radius,vec3 const& center,std::vector<vec3> const& normal);
+
+    /** Position, velocity, force and inverse mass of the particles (SoA) */
+    particle_store particles;
+
+    float k_structural = 10.0f,k_shearing = 7.0f, k_bending = 2.0f;
+
+private:
+
+    /** Set the stiffness of all the springs of a given family */
+    void set_family_stiffness(spring_family family,float k);
+
+    /** Largest distance between an awake particle and the origin */
+    float max_position_norm() const;
+    /** Wake the sleeping tiles close to the colliders changed since the last step */
+    void wake_disturbed_tiles();
+
+    /** Flat list of springs, sorted by family */
+    std::vector<spring> spring_data;
+    /** Springs of family f are in [spring_family_offset[f],spring_family_offset[f+1]) */
+    int spring_family_offset[spring_family_size+1] = {0,0,0,0};
+    /** Springs of batch b are in [spring_batch_offset[b],spring_batch_offset[b+1]) and share no vertex */
+    std::vector<int> spring_batch_offset;
+    /** Implementation of the spring evaluation */
+    spring_kernel_type kernel_type = best_spring_kernel();
+
+    /** Time integration scheme */
+    cloth_integrator integrator_type = integrator_explicit_euler;
+    /** Work data of the backward Euler integrator */
+    implicit_solver implicit;
+    /** Work data of the XPBD solver */
+    xpbd_solver xpbd;
+
+    /** Self collision (enabled flag and work data) */
+    bool self_collision_enabled = false;
+    self_collision self_repulsion;
+
+    /** Analytic colliders */
+    collider_registry colliders;
+    /** Triangle mesh obstacles */
+    std::vector<mesh_collider> mesh_colliders;
+    /** Distance field obstacles */
+    std::vector<sdf_collider> sdf_colliders;
+
+    /** Sleeping tiles (enabled flag, sleep allowed during the current step, state) */
+    bool sleeping_enabled = false;
+    bool sleep_active = false;
+    sleep_tiles sleep;
+    /** Colliders of the registry at the previous step */
+    std::vector<collider> collider_state;
+    /** Inverse masses with zeros on the sleeping particles (swapped in for the implicit and XPBD steps) */
+    aligned_vector<float> awake_inv_mass;
+
+    /** Number of time steps since the springs were built */
+    long step_counter = 0;
+    /** Seed of the random wind */
+    uint64_t wind_seed = 0;
+    /** Distribution of the wind intensity */
+    wind_model wind_type = wind_perlin;
+    /** Perlin gusts */
+    wind_field wind_noise;
+    /** Wind intensity of each particle for the current step */
+    aligned_vector<float> wind_intensity;
+
+};
+
+class exception_divergence : public exception_cpe
+{
+    using exception_cpe::exception_cpe;
+};
+
+}
+
+#endif
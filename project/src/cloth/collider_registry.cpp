@@ -0,0 +1,309 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "collider_registry.hpp"
+
+#include "../lib/common/error_handling.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace cpe
+{
+
+/** Number of particles processed by a thread for all the colliders before the next ones (stay in L1) */
+static int const chunk_size = 1024;
+
+collider plane_collider(vec3 const& point,vec3 const& normal,float const thickness,float const friction)
+{
+    collider c;
+    c.shape = collider_plane;
+    c.p0 = point;
+    c.p1 = normalized(normal);
+    c.thickness = thickness;
+    c.friction = friction;
+    return c;
+}
+
+collider sphere_collider(vec3 const& center,float const radius,float const thickness,float const friction)
+{
+    collider c;
+    c.shape = collider_sphere;
+    c.p0 = center;
+    c.radius = radius;
+    c.thickness = thickness;
+    c.friction = friction;
+    return c;
+}
+
+collider capsule_collider(vec3 const& p0,vec3 const& p1,float const radius,float const thickness,float const friction)
+{
+    collider c;
+    c.shape = collider_capsule;
+    c.p0 = p0;
+    c.p1 = p1;
+    c.radius = radius;
+    c.thickness = thickness;
+    c.friction = friction;
+    return c;
+}
+
+collider box_collider(vec3 const& center,vec3 const& half_size,float const thickness,float const friction)
+{
+    collider c;
+    c.shape = collider_box;
+    c.p0 = center;
+    c.p1 = half_size;
+    c.thickness = thickness;
+    c.friction = friction;
+    return c;
+}
+
+float collider_distance(collider const& c,vec3 const& p)
+{
+    switch(c.shape)
+    {
+    case collider_plane:
+        return dot(p-c.p0,c.p1);
+    case collider_sphere:
+        return norm(p-c.p0)-c.radius;
+    case collider_capsule:
+    {
+        vec3 const u = c.p1-c.p0;
+        float const u2 = dot(u,u);
+        float const t = u2>0.0f ? std::min(std::max(dot(p-c.p0,u)/u2,0.0f),1.0f) : 0.0f;
+        return norm(p-(c.p0+t*u))-c.radius;
+    }
+    case collider_box:
+    {
+        vec3 const q = p-c.p0;
+        float const ex = std::abs(q.x())-c.p1.x(), ey = std::abs(q.y())-c.p1.y(), ez = std::abs(q.z())-c.p1.z();
+        vec3 const outside = vec3(std::max(ex,0.0f),std::max(ey,0.0f),std::max(ez,0.0f));
+        return norm(outside)+std::min(std::max(ex,std::max(ey,ez)),0.0f);
+    }
+    }
+    return 0.0f;
+}
+
+static bool same_vec3(vec3 const& a,vec3 const& b)
+{
+    return a.x()==b.x() && a.y()==b.y() && a.z()==b.z();
+}
+
+bool same_collider(collider const& a,collider const& b)
+{
+    return a.shape==b.shape && same_vec3(a.p0,b.p0) && same_vec3(a.p1,b.p1) && a.radius==b.radius &&
+           a.thickness==b.thickness && a.friction==b.friction && a.enabled==b.enabled;
+}
+
+collider_registry::collider_registry()
+{
+    //scene of the interactive program: ground and sphere
+    colliders.push_back(plane_collider(vec3(0.0f,0.0f,-1.101f),vec3(0.0f,0.0f,1.0f),0.0005f,0.5f));
+    colliders.push_back(sphere_collider(vec3(0.5f,0.05f,-1.1f),0.198f,0.0005f,0.0f));
+}
+
+int collider_registry::add(collider const& c)
+{
+    ASSERT_CPE(c.thickness>=0.0f && c.friction>=0.0f,"Thickness and friction should be >=0");
+    colliders.push_back(c);
+    return colliders.size()-1;
+}
+
+collider& collider_registry::get(int const index)
+{
+    ASSERT_CPE(index>=0 && index<size(),"Incorrect collider index");
+    return colliders[index];
+}
+
+collider const& collider_registry::get(int const index) const
+{
+    ASSERT_CPE(index>=0 && index<size(),"Incorrect collider index");
+    return colliders[index];
+}
+
+int collider_registry::size() const
+{
+    return colliders.size();
+}
+
+void collider_registry::clear()
+{
+    colliders.resize(scene_sphere+1);
+}
+
+void collider_registry::set_scene(float const ground,float const radius,vec3 const& center)
+{
+    colliders[scene_ground].p0 = vec3(0.0f,0.0f,ground);
+    colliders[scene_sphere].p0 = center;
+    colliders[scene_sphere].radius = radius;
+}
+
+/** Projection of the particles [begin,end) closer than the thickness to the surface given by distance.
+ *  distance(x,y,z,d,nx,ny,nz) gives the signed distance and the unit normal of the surface at a point. */
+template <typename DISTANCE>
+static int resolve_range(float const thickness,float const friction,int const begin,int const end,
+                         float* px,float* py,float* pz,float* vx,float* vy,float* vz,float const* inv_mass,
+                         DISTANCE const& distance)
+{
+    int contact = 0;
+    #pragma omp simd reduction(+:contact)
+    for(int k=begin ; k<end ; ++k)
+    {
+        float d,nx,ny,nz;
+        distance(px[k],py[k],pz[k],d,nx,ny,nz);
+        float const depth = thickness-d;
+        bool const active = depth>0.0f && inv_mass[k]>0.0f;
+
+        //normal speed toward the surface removed, tangential speed reduced by friction times this speed
+        float const vn = vx[k]*nx+vy[k]*ny+vz[k]*nz;
+        float const tx = vx[k]-vn*nx, ty = vy[k]-vn*ny, tz = vz[k]-vn*nz;
+        float const vt = std::sqrt(tx*tx+ty*ty+tz*tz);
+        float const factor = std::max(0.0f,1.0f-friction*std::max(-vn,0.0f)/std::max(vt,1e-12f));
+        float const vn_out = std::max(vn,0.0f);
+
+        px[k] = active ? px[k]+depth*nx : px[k];
+        py[k] = active ? py[k]+depth*ny : py[k];
+        pz[k] = active ? pz[k]+depth*nz : pz[k];
+        vx[k] = active ? vn_out*nx+factor*tx : vx[k];
+        vy[k] = active ? vn_out*ny+factor*ty : vy[k];
+        vz[k] = active ? vn_out*nz+factor*tz : vz[k];
+        contact += active ? 1 : 0;
+    }
+    return contact;
+}
+
+/** Distance to a point (sphere of radius r around it), the normal is +z at the point itself */
+static inline void point_distance(float const dx,float const dy,float const dz,float const r,float& d,float& nx,float& ny,float& nz)
+{
+    float const length = std::sqrt(dx*dx+dy*dy+dz*dz);
+    float const inv = 1.0f/std::max(length,1e-12f);
+    bool const valid = length>0.0f;
+    d = length-r;
+    nx = valid ? dx*inv : 0.0f;
+    ny = valid ? dy*inv : 0.0f;
+    nz = valid ? dz*inv : 1.0f;
+}
+
+static int resolve_collider(collider const& c,int const begin,int const end,
+                            float* px,float* py,float* pz,float* vx,float* vy,float* vz,float const* inv_mass)
+{
+    float const ax = c.p0.x(), ay = c.p0.y(), az = c.p0.z();
+    float const bx = c.p1.x(), by = c.p1.y(), bz = c.p1.z();
+    float const r = c.radius;
+
+    switch(c.shape)
+    {
+    case collider_plane:
+        return resolve_range(c.thickness,c.friction,begin,end,px,py,pz,vx,vy,vz,inv_mass,
+                             [=](float x,float y,float z,float& d,float& nx,float& ny,float& nz)
+        {
+            d = (x-ax)*bx+(y-ay)*by+(z-az)*bz;
+            nx = bx; ny = by; nz = bz;
+        });
+
+    case collider_sphere:
+        return resolve_range(c.thickness,c.friction,begin,end,px,py,pz,vx,vy,vz,inv_mass,
+                             [=](float x,float y,float z,float& d,float& nx,float& ny,float& nz)
+        {
+            point_distance(x-ax,y-ay,z-az,r,d,nx,ny,nz);
+        });
+
+    case collider_capsule:
+    {
+        float const ux = bx-ax, uy = by-ay, uz = bz-az;
+        float const u2 = ux*ux+uy*uy+uz*uz;
+        float const inv_u2 = u2>0.0f ? 1.0f/u2 : 0.0f;
+        return resolve_range(c.thickness,c.friction,begin,end,px,py,pz,vx,vy,vz,inv_mass,
+                             [=](float x,float y,float z,float& d,float& nx,float& ny,float& nz)
+        {
+            float const t = std::min(std::max(((x-ax)*ux+(y-ay)*uy+(z-az)*uz)*inv_u2,0.0f),1.0f);
+            point_distance(x-(ax+t*ux),y-(ay+t*uy),z-(az+t*uz),r,d,nx,ny,nz);
+        });
+    }
+
+    case collider_box:
+        return resolve_range(c.thickness,c.friction,begin,end,px,py,pz,vx,vy,vz,inv_mass,
+                             [=](float x,float y,float z,float& d,float& nx,float& ny,float& nz)
+        {
+            float const qx = x-ax, qy = y-ay, qz = z-az;
+            float const ex = std::abs(qx)-bx, ey = std::abs(qy)-by, ez = std::abs(qz)-bz;
+            float const sx = qx<0.0f ? -1.0f : 1.0f, sy = qy<0.0f ? -1.0f : 1.0f, sz = qz<0.0f ? -1.0f : 1.0f;
+
+            //outside: distance to the closest point of the box
+            float const ox = std::max(ex,0.0f), oy = std::max(ey,0.0f), oz = std::max(ez,0.0f);
+            float const outside_length = std::sqrt(ox*ox+oy*oy+oz*oz);
+            float const inv = 1.0f/std::max(outside_length,1e-12f);
+
+            //inside: closest face
+            float const e_max = std::max(ex,std::max(ey,ez));
+            bool const face_x = ex>=e_max;
+            bool const face_y = !face_x && ey>=e_max;
+            bool const face_z = !face_x && !face_y;
+
+            bool const outside = e_max>0.0f;
+            d = outside ? outside_length : e_max;
+            nx = outside ? sx*ox*inv : (face_x ? sx : 0.0f);
+            ny = outside ? sy*oy*inv : (face_y ? sy : 0.0f);
+            nz = outside ? sz*oz*inv : (face_z ? sz : 0.0f);
+        });
+    }
+    return 0;
+}
+
+void collider_registry::resolve(particle_store& particles)
+{
+    resolve(particles,{{0,particles.size()}});
+}
+
+void collider_registry::resolve(particle_store& particles,std::vector<particle_range> const& ranges)
+{
+    float* const px = particles.position.x.data();
+    float* const py = particles.position.y.data();
+    float* const pz = particles.position.z.data();
+    float* const vx = particles.velocity.x.data();
+    float* const vy = particles.velocity.y.data();
+    float* const vz = particles.velocity.z.data();
+    float const* const inv_mass = particles.inv_mass.data();
+
+    //split the ranges in chunks
+    chunks.clear();
+    for(particle_range const& r : ranges)
+        for(int begin=r.begin ; begin<r.end ; begin+=chunk_size)
+            chunks.push_back({begin,std::min(begin+chunk_size,r.end)});
+    int const N_chunk = chunks.size();
+
+    //each particle sees the colliders in the order of the registry, whatever the number of threads
+    int contact = 0;
+    #pragma omp parallel for schedule(static) reduction(+:contact)
+    for(int k_chunk=0 ; k_chunk<N_chunk ; ++k_chunk)
+    {
+        int const begin = chunks[k_chunk].begin;
+        int const end = chunks[k_chunk].end;
+        for(collider const& c : colliders)
+            if(c.enabled)
+                contact += resolve_collider(c,begin,end,px,py,pz,vx,vy,vz,inv_mass);
+    }
+    N_contact = contact;
+}
+
+int collider_registry::last_contact() const
+{
+    return N_contact;
+}
+
+}
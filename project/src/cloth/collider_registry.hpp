@@ -0,0 +1,122 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef COLLIDER_REGISTRY_HPP
+#define COLLIDER_REGISTRY_HPP
+
+#include "particle_store.hpp"
+#include "../lib/3d/vec3.hpp"
+#include <vector>
+
+namespace cpe
+{
+
+/** Analytic shapes of the colliders */
+enum collider_shape
+{
+    collider_plane = 0,
+    collider_sphere = 1,
+    collider_capsule = 2,
+    collider_box = 3
+};
+
+/** Analytic obstacle of the cloth. The geometry depends on the shape:
+ *  - plane: point p0 and unit normal p1 (the particles are kept on the side of the normal)
+ *  - sphere: center p0 and radius
+ *  - capsule: segment [p0,p1] and radius
+ *  - box: center p0 and half sizes p1 (axis aligned) */
+struct collider
+{
+    collider_shape shape = collider_plane;
+    vec3 p0 = vec3(0.0f,0.0f,0.0f);
+    vec3 p1 = vec3(0.0f,0.0f,1.0f);
+    float radius = 0.0f;
+    /** Distance kept between the particles and the surface */
+    float thickness = 0.0f;
+    /** Coulomb coefficient: the tangential speed is reduced by friction times the normal speed removed */
+    float friction = 0.0f;
+    /** Disabled colliders are kept in the registry but ignored */
+    bool enabled = true;
+};
+
+collider plane_collider(vec3 const& point,vec3 const& normal,float thickness=0.0f,float friction=0.0f);
+collider sphere_collider(vec3 const& center,float radius,float thickness=0.0f,float friction=0.0f);
+collider capsule_collider(vec3 const& p0,vec3 const& p1,float radius,float thickness=0.0f,float friction=0.0f);
+collider box_collider(vec3 const& center,vec3 const& half_size,float thickness=0.0f,float friction=0.0f);
+
+/** Signed distance between a point and the surface of a collider (negative inside) */
+float collider_distance(collider const& c,vec3 const& p);
+/** True if the two colliders have the same parameters */
+bool same_collider(collider const& a,collider const& b);
+
+/** Any number of analytic colliders, resolved in a collision pass on the particles.
+ *
+ *  A particle closer to a collider than its thickness (or inside it) is moved
+ *  along the normal of the surface up to the thickness. Its normal velocity
+ *  toward the collider is removed and its tangential velocity is reduced by
+ *  friction. The particles are processed by chunks in parallel; inside a
+ *  chunk each collider is a branch free loop on the coordinate arrays
+ *  (vectorized). Fixed particles (zero inverse mass) are not moved.
+ *
+ *  The first two entries are the ground and the sphere of the scene (see
+ *  set_scene), they can be disabled or changed as the others. */
+class collider_registry
+{
+public:
+
+    /** Index of the entries of the scene */
+    enum scene_entry
+    {
+        scene_ground = 0,
+        scene_sphere = 1
+    };
+
+    /** Registry holding the ground and the sphere of the scene */
+    collider_registry();
+
+    /** Add a collider, returns its index */
+    int add(collider const& c);
+    collider& get(int index);
+    collider const& get(int index) const;
+    int size() const;
+    /** Remove all the colliders except the entries of the scene */
+    void clear();
+
+    /** Set the height of the ground and the sphere of the scene (the other parameters are kept) */
+    void set_scene(float ground,float radius,vec3 const& center);
+
+    /** Collision pass on the positions and velocities */
+    void resolve(particle_store& particles);
+    /** Collision pass restricted to ranges of particles */
+    void resolve(particle_store& particles,std::vector<particle_range> const& ranges);
+    /** Number of particle/collider contacts during the last resolve */
+    int last_contact() const;
+
+private:
+
+    std::vector<collider> colliders;
+    int N_contact = 0;
+    /** Chunks of particles processed by the threads during resolve */
+    std::vector<particle_range> chunks;
+};
+
+}
+
+#endif
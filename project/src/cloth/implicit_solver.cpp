@@ -0,0 +1,408 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "implicit_solver.hpp"
+
+#include "../lib/common/error_handling.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cpe
+{
+
+/** Size of the blocks of the reductions: partial sums are computed per block
+ *  and summed in order, so that the result does not depend on the threads */
+static int const REDUCTION_BLOCK = 4096;
+
+static float* component(soa_vec3& v,int const d)
+{
+    return d==0 ? v.x.data() : (d==1 ? v.y.data() : v.z.data());
+}
+static float const* component(soa_vec3 const& v,int const d)
+{
+    return d==0 ? v.x.data() : (d==1 ? v.y.data() : v.z.data());
+}
+
+/** Deterministic dot product between two soa vectors */
+static double dot(soa_vec3 const& a,soa_vec3 const& b)
+{
+    int const N = a.size();
+    int const N_block = (N+REDUCTION_BLOCK-1)/REDUCTION_BLOCK;
+    std::vector<double> partial(N_block,0.0);
+
+    #pragma omp parallel for schedule(static)
+    for(int block=0 ; block<N_block ; ++block)
+    {
+        int const begin = block*REDUCTION_BLOCK;
+        int const end = begin+REDUCTION_BLOCK<N ? begin+REDUCTION_BLOCK : N;
+        double s = 0.0;
+        for(int d=0 ; d<3 ; ++d)
+        {
+            float const* const pa = component(a,d);
+            float const* const pb = component(b,d);
+            float s_d = 0.0f;
+            for(int k=begin ; k<end ; ++k)
+                s_d += pa[k]*pb[k];
+            s += s_d;
+        }
+        partial[block] = s;
+    }
+
+    double s = 0.0;
+    for(double const value : partial)
+        s += value;
+    return s;
+}
+
+/** y = x + alpha.y */
+static void xpay(soa_vec3 const& x,float const alpha,soa_vec3& y)
+{
+    int const N = x.size();
+    for(int d=0 ; d<3 ; ++d)
+    {
+        float const* const px = component(x,d);
+        float* const py = component(y,d);
+        #pragma omp parallel for schedule(static)
+        for(int k=0 ; k<N ; ++k)
+            py[k] = px[k]+alpha*py[k];
+    }
+}
+
+/** y = y + alpha.x */
+static void axpy(float const alpha,soa_vec3 const& x,soa_vec3& y)
+{
+    int const N = x.size();
+    for(int d=0 ; d<3 ; ++d)
+    {
+        float const* const px = component(x,d);
+        float* const py = component(y,d);
+        #pragma omp parallel for schedule(static)
+        for(int k=0 ; k<N ; ++k)
+            py[k] += alpha*px[k];
+    }
+}
+
+/** y = D.x (D diagonal) */
+static void multiply_diagonal(soa_vec3 const& D,soa_vec3 const& x,soa_vec3& y)
+{
+    int const N = x.size();
+    for(int d=0 ; d<3 ; ++d)
+    {
+        float const* const pD = component(D,d);
+        float const* const px = component(x,d);
+        float* const py = component(y,d);
+        #pragma omp parallel for schedule(static)
+        for(int k=0 ; k<N ; ++k)
+            py[k] = pD[k]*px[k];
+    }
+}
+
+/** y = y + scale.K.x using the spring Jacobian blocks */
+static void add_stiffness_product(aligned_vector<float> const* J,
+                                  std::vector<int> const& spring_i,std::vector<int> const& spring_j,
+                                  std::vector<int> const& batch_offset,
+                                  float const scale,soa_vec3 const& x,soa_vec3& y)
+{
+    float const* const xx = x.x.data();
+    float const* const xy = x.y.data();
+    float const* const xz = x.z.data();
+    float* const yx = y.x.data();
+    float* const yy = y.y.data();
+    float* const yz = y.z.data();
+    float const* const Jxx = J[0].data();
+    float const* const Jyy = J[1].data();
+    float const* const Jzz = J[2].data();
+    float const* const Jxy = J[3].data();
+    float const* const Jxz = J[4].data();
+    float const* const Jyz = J[5].data();
+
+    int const N_batch = static_cast<int>(batch_offset.size())-1;
+
+    #pragma omp parallel
+    {
+        for(int b=0 ; b<N_batch ; ++b)
+        {
+            #pragma omp for schedule(static)
+            for(int k=batch_offset[b] ; k<batch_offset[b+1] ; ++k)
+            {
+                int const i = spring_i[k];
+                int const j = spring_j[k];
+                float const dx = xx[i]-xx[j];
+                float const dy = xy[i]-xy[j];
+                float const dz = xz[i]-xz[j];
+
+                float const fx = scale*(Jxx[k]*dx + Jxy[k]*dy + Jxz[k]*dz);
+                float const fy = scale*(Jxy[k]*dx + Jyy[k]*dy + Jyz[k]*dz);
+                float const fz = scale*(Jxz[k]*dx + Jyz[k]*dy + Jzz[k]*dz);
+
+                yx[i] += fx; yy[i] += fy; yz[i] += fz;
+                yx[j] -= fx; yy[j] -= fy; yz[j] -= fz;
+            }
+        }
+    }
+}
+
+
+implicit_solver::implicit_solver()
+    :max_iterations(100),tolerance(1e-4f),iterations_done(0),residual(0.0f)
+{}
+
+void implicit_solver::set_max_iterations(int const N)
+{
+    ASSERT_CPE(N>0,"Number of iterations should be >0");
+    max_iterations = N;
+}
+
+void implicit_solver::set_tolerance(float const epsilon)
+{
+    ASSERT_CPE(epsilon>0,"Tolerance should be >0");
+    tolerance = epsilon;
+}
+
+int implicit_solver::last_iterations() const
+{
+    return iterations_done;
+}
+
+float implicit_solver::last_residual() const
+{
+    return residual;
+}
+
+void implicit_solver::compute_jacobian(particle_store const& particles,std::vector<spring> const& springs)
+{
+    int const N_spring = springs.size();
+    for(int d=0 ; d<6 ; ++d)
+        J[d].resize(N_spring);
+    spring_i.resize(N_spring);
+    spring_j.resize(N_spring);
+
+    float const* const px = particles.position.x.data();
+    float const* const py = particles.position.y.data();
+    float const* const pz = particles.position.z.data();
+
+    #pragma omp parallel for schedule(static)
+    for(int k=0 ; k<N_spring ; ++k)
+    {
+        spring const& s = springs[k];
+        spring_i[k] = s.i;
+        spring_j[k] = s.j;
+
+        float ux = px[s.i]-px[s.j];
+        float uy = py[s.i]-py[s.j];
+        float uz = pz[s.i]-pz[s.j];
+        float const L = std::sqrt(ux*ux+uy*uy+uz*uz);
+        if(L<1e-12f)
+        {
+            for(int d=0 ; d<6 ; ++d)
+                J[d][k] = 0.0f;
+            continue;
+        }
+        ux /= L; uy /= L; uz /= L;
+
+        //df_i/dx_i = -k.[ u.u^t + (1-L0/L).(I-u.u^t) ], the transverse term is
+        // dropped for compressed springs to keep the system definite
+        float const transverse = std::max(0.0f,1.0f-s.rest_length/L);
+        float const a = -s.k*(1.0f-transverse);
+        float const b = -s.k*transverse;
+
+        J[0][k] = a*ux*ux+b;
+        J[1][k] = a*uy*uy+b;
+        J[2][k] = a*uz*uz+b;
+        J[3][k] = a*ux*uy;
+        J[4][k] = a*ux*uz;
+        J[5][k] = a*uy*uz;
+    }
+}
+
+void implicit_solver::apply_system(soa_vec3 const& x,soa_vec3& y,
+                                   std::vector<int> const& batch_offset,
+                                   float const dt,float const damping)
+{
+    int const N = x.size();
+    float const* const m = mass.data();
+    float const diagonal = 1.0f+dt*damping;
+
+    for(int d=0 ; d<3 ; ++d)
+    {
+        float const* const px = component(x,d);
+        float* const py = component(y,d);
+        #pragma omp parallel for schedule(static)
+        for(int k=0 ; k<N ; ++k)
+            py[k] = diagonal*m[k]*px[k];
+    }
+
+    add_stiffness_product(J,spring_i,spring_j,batch_offset,-dt*dt,x,y);
+    filter(y);
+}
+
+void implicit_solver::filter(soa_vec3& x) const
+{
+    int const N = x.size();
+    float const* const mask = free_mask.data();
+    for(int d=0 ; d<3 ; ++d)
+    {
+        float* const px = component(x,d);
+        #pragma omp parallel for schedule(static)
+        for(int k=0 ; k<N ; ++k)
+            px[k] *= mask[k];
+    }
+}
+
+void implicit_solver::step(particle_store& particles,
+                           std::vector<spring> const& springs,
+                           std::vector<int> const& batch_offset,
+                           float const dt,float const damping)
+{
+    int const N = particles.size();
+    ASSERT_CPE(batch_offset.size()>0 && batch_offset.back()==static_cast<int>(springs.size()),"Incorrect spring batches");
+
+    for(soa_vec3* v : {&dv,&r,&z,&p,&q,&rhs,&inv_diagonal})
+        v->resize(N);
+    mass.resize(N);
+    free_mask.resize(N);
+
+    float const* const w = particles.inv_mass.data();
+    #pragma omp parallel for schedule(static)
+    for(int k=0 ; k<N ; ++k)
+    {
+        free_mask[k] = w[k]>0.0f ? 1.0f : 0.0f;
+        mass[k] = w[k]>0.0f ? 1.0f/w[k] : 1.0f;
+    }
+
+    compute_jacobian(particles,springs);
+
+    //rhs = h.(f - c.M.v + h.K.v)
+    for(int d=0 ; d<3 ; ++d)
+    {
+        float const* const f = component(particles.force,d);
+        float const* const v = component(particles.velocity,d);
+        float* const b = component(rhs,d);
+        #pragma omp parallel for schedule(static)
+        for(int k=0 ; k<N ; ++k)
+            b[k] = dt*(f[k]-damping*mass[k]*v[k]);
+    }
+    add_stiffness_product(J,spring_i,spring_j,batch_offset,dt*dt,particles.velocity,rhs);
+    filter(rhs);
+
+    //Jacobi preconditioner: inverse of diag(M(1+h.c) - h^2.K)
+    for(int d=0 ; d<3 ; ++d)
+    {
+        float* const D = component(inv_diagonal,d);
+        #pragma omp parallel for schedule(static)
+        for(int k=0 ; k<N ; ++k)
+            D[k] = (1.0f+dt*damping)*mass[k];
+    }
+    {
+        int const N_spring = springs.size();
+        int const N_batch = static_cast<int>(batch_offset.size())-1;
+        #pragma omp parallel
+        {
+            for(int b=0 ; b<N_batch ; ++b)
+            {
+                #pragma omp for schedule(static)
+                for(int k=batch_offset[b] ; k<batch_offset[b+1] ; ++k)
+                {
+                    for(int d=0 ; d<3 ; ++d)
+                    {
+                        float* const D = component(inv_diagonal,d);
+                        D[spring_i[k]] -= dt*dt*J[d][k];
+                        D[spring_j[k]] -= dt*dt*J[d][k];
+                    }
+                }
+            }
+        }
+        ASSERT_CPE(N_spring==static_cast<int>(spring_i.size()),"Incorrect Jacobian size");
+    }
+    for(int d=0 ; d<3 ; ++d)
+    {
+        float* const D = component(inv_diagonal,d);
+        #pragma omp parallel for schedule(static)
+        for(int k=0 ; k<N ; ++k)
+            D[k] = 1.0f/D[k];
+    }
+
+    //preconditioned conjugate gradient on dv
+    for(int d=0 ; d<3 ; ++d)
+    {
+        float* const x = component(dv,d);
+        float const* const b = component(rhs,d);
+        float* const rr = component(r,d);
+        #pragma omp parallel for schedule(static)
+        for(int k=0 ; k<N ; ++k)
+        {
+            x[k] = 0.0f;
+            rr[k] = b[k];
+        }
+    }
+
+    double const norm_rhs = std::sqrt(dot(rhs,rhs));
+    iterations_done = 0;
+    residual = 0.0f;
+
+    if(norm_rhs>0.0)
+    {
+        multiply_diagonal(inv_diagonal,r,z);
+        filter(z);
+        p.x = z.x; p.y = z.y; p.z = z.z;
+        double rz = dot(r,z);
+
+        double norm_r = norm_rhs;
+        while(iterations_done<max_iterations && norm_r>tolerance*norm_rhs)
+        {
+            apply_system(p,q,batch_offset,dt,damping);
+
+            double const pq = dot(p,q);
+            if(pq<=0.0)
+                break;
+            float const alpha = static_cast<float>(rz/pq);
+
+            axpy(alpha,p,dv);
+            axpy(-alpha,q,r);
+            norm_r = std::sqrt(dot(r,r));
+
+            multiply_diagonal(inv_diagonal,r,z);
+            filter(z);
+            double const rz_new = dot(r,z);
+            float const beta = static_cast<float>(rz_new/rz);
+            rz = rz_new;
+            xpay(z,beta,p);
+
+            ++iterations_done;
+        }
+        residual = static_cast<float>(norm_r/norm_rhs);
+    }
+
+    //v = v+dv, x = x+h.v
+    for(int d=0 ; d<3 ; ++d)
+    {
+        float* const v = component(particles.velocity,d);
+        float* const x = component(particles.position,d);
+        float const* const delta = component(dv,d);
+        float const* const mask = free_mask.data();
+        #pragma omp parallel for schedule(static)
+        for(int k=0 ; k<N ; ++k)
+        {
+            v[k] = mask[k]*(v[k]+delta[k]);
+            x[k] += dt*v[k];
+        }
+    }
+}
+
+}
@@ -0,0 +1,100 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef IMPLICIT_SOLVER_HPP
+#define IMPLICIT_SOLVER_HPP
+
+#include "spring.hpp"
+#include "particle_store.hpp"
+
+#include <vector>
+
+namespace cpe
+{
+
+/** Backward Euler time integration of a mass-spring system (Baraff & Witkin 98).
+ *
+ *  The linear system
+ *    ( M(1+h.c) - h^2.K ) dv = h.( f - c.M.v + h.K.v )
+ *  is solved matrix-free with a Jacobi preconditioned conjugate gradient,
+ *  K being the Jacobian of the spring forces with respect to the positions
+ *  (one 3x3 block per spring, made negative semi-definite by clamping the
+ *  transverse term of compressed springs). Fixed particles (zero inverse mass)
+ *  are kept fixed by filtering the system.
+ *
+ *  The products by K use the colored spring batches: the result does not depend
+ *  on the number of threads.
+ */
+class implicit_solver
+{
+public:
+
+    implicit_solver();
+
+    /** Maximal number of conjugate gradient iterations per step */
+    void set_max_iterations(int N);
+    /** Relative residual at which the conjugate gradient stops */
+    void set_tolerance(float epsilon);
+
+    /** Number of iterations done during the last step */
+    int last_iterations() const;
+    /** Relative residual reached during the last step */
+    float last_residual() const;
+
+    /** Update the velocities and positions of the particles for a time step dt.
+     *  The forces (including the springs) must have been computed at the current positions. */
+    void step(particle_store& particles,
+              std::vector<spring> const& springs,
+              std::vector<int> const& batch_offset,
+              float dt,float damping);
+
+private:
+
+    /** Compute the 3x3 Jacobian block of every spring */
+    void compute_jacobian(particle_store const& particles,std::vector<spring> const& springs);
+    /** y = A.x */
+    void apply_system(soa_vec3 const& x,soa_vec3& y,
+                      std::vector<int> const& batch_offset,
+                      float dt,float damping);
+    /** Cancel the entries of the fixed particles */
+    void filter(soa_vec3& x) const;
+
+    /** Jacobian blocks (symmetric, stored as xx,yy,zz,xy,xz,yz) */
+    aligned_vector<float> J[6];
+    /** Indices of the spring extremities (copied from the springs) */
+    std::vector<int> spring_i,spring_j;
+
+    /** Mass and mask (1 for free particles, 0 for fixed ones) */
+    aligned_vector<float> mass,free_mask;
+    /** Jacobi preconditioner (inverse of the diagonal of A) */
+    soa_vec3 inv_diagonal;
+
+    /** Conjugate gradient work vectors */
+    soa_vec3 dv,r,z,p,q,rhs;
+
+    int max_iterations;
+    float tolerance;
+    int iterations_done;
+    float residual;
+};
+
+}
+
+#endif
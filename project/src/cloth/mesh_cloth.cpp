@@ -0,0 +1,260 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mesh_cloth.hpp"
+
+#include "../lib/common/error_handling.hpp"
+#include "../lib/mesh/mesh_io.hpp"
+#include <algorithm>
+
+namespace cpe
+{
+
+void mesh_cloth::set_mesh(mesh const& m)
+{
+    static_cast<mesh&>(*this) = m;
+    ASSERT_CPE(valid_mesh(),"Invalid mesh");
+    fill_normal_parallel();
+    fill_empty_field_by_default();
+
+    initialize_particles(vertex_data);
+    build_adjacency();
+    build_springs();
+    initialize_self_collision(connectivity_data);
+}
+
+void mesh_cloth::load(std::string const& filename)
+{
+    set_mesh(load_mesh_file(filename));
+}
+
+void mesh_cloth::save_checkpoint(std::string const& filename) const
+{
+    checkpoint_writer file;
+    write_checkpoint(file);
+    file.header().layout = checkpoint_mesh;
+    file.header().N_triangle = size_connectivity();
+    file.set_section(section_triangle,pointer_triangle_index(),size_connectivity()*sizeof(triangle_index));
+    file.set_section(section_texture_coord,pointer_texture_coord(),size_texture_coord()*sizeof(vec2));
+    file.write(filename);
+}
+
+void mesh_cloth::load_checkpoint(std::string const& filename)
+{
+    checkpoint_reader file(filename);
+    checkpoint_header const& header = file.header();
+    if(header.layout!=checkpoint_mesh)
+        throw exception_cpe("Checkpoint "+filename+" does not store a mesh cloth",EXCEPTION_PARAMETERS_CPE);
+
+    std::vector<triangle_index> triangles;
+    std::vector<vec2> texture;
+    file.read(section_triangle,triangles,header.N_triangle);
+    file.read(section_texture_coord,texture,header.N_particle);
+    for(triangle_index const& tri : triangles)
+        for(int k=0 ; k<3 ; ++k)
+            if(tri[k]<0 || tri[k]>=header.N_particle)
+                throw exception_cpe("Incorrect triangle in checkpoint "+filename,EXCEPTION_PARAMETERS_CPE);
+
+    read_checkpoint(file);
+
+    //surface at the stored positions, the springs are not built: they are read from the file
+    particles.position.export_aos(vertex_data);
+    connectivity_data.swap(triangles);
+    connectivity_changed();
+    texture_coord_data.swap(texture);
+    normal_data.clear();
+    color_data.clear();
+    fill_normal_parallel();
+    fill_empty_field_by_default();
+    ASSERT_CPE(valid_mesh(),"Invalid mesh");
+
+    build_adjacency();
+    initialize_self_collision(connectivity_data);
+    mesh_clock = -1;
+}
+
+void mesh_cloth::set_fixed(int const index,bool const fixed)
+{
+    ASSERT_CPE(index>=0 && index<particles.size(),"Incorrect vertex index "+std::to_string(index));
+    particles.inv_mass[index] = fixed ? 0.0f : 1.0f;
+}
+
+vec3 mesh_cloth::speed(int const index) const
+{
+    ASSERT_CPE(index>=0 && index<particles.size(),"Incorrect vertex index "+std::to_string(index));
+    return particles.velocity.get(index);
+}
+
+vec3 mesh_cloth::force(int const index) const
+{
+    ASSERT_CPE(index>=0 && index<particles.size(),"Incorrect vertex index "+std::to_string(index));
+    return particles.force.get(index);
+}
+
+void mesh_cloth::update_force(float& h, bool& wind, int wind_force, float radius, vec3 center)
+{
+    ASSERT_CPE(particles.size() == size_vertex() , "Error of size");
+    ASSERT_CPE(size_normal() == size_vertex() , "Error of size");
+
+    compute_forces(h,wind,wind_force,radius,center,normal_data);
+}
+
+void mesh_cloth::sync_mesh()
+{
+    ASSERT_CPE(particles.size() == size_vertex(),"Incorrect size");
+    export_moved_positions(vertex_data,mesh_clock);
+}
+
+std::vector<int> const& mesh_cloth::adjacency_offset() const
+{
+    return adjacency_offset_data;
+}
+
+std::vector<int> const& mesh_cloth::adjacency() const
+{
+    return adjacency_data;
+}
+
+int mesh_cloth::size_edge() const
+{
+    return adjacency_data.size()/2;
+}
+
+bool mesh_cloth::is_edge(int const i,int const j) const
+{
+    auto const begin = adjacency_data.begin()+adjacency_offset_data[i];
+    auto const end = adjacency_data.begin()+adjacency_offset_data[i+1];
+    return std::binary_search(begin,end,j);
+}
+
+void mesh_cloth::build_adjacency()
+{
+    int const N_vertex = size_vertex();
+    int const N_triangle = size_connectivity();
+
+    //each triangle gives 2 neighbors to each of its vertices (shared edges are counted twice)
+    std::vector<int> offset(N_vertex+1,0);
+    for(int k_triangle=0 ; k_triangle<N_triangle ; ++k_triangle)
+        for(int k=0 ; k<3 ; ++k)
+            offset[connectivity_data[k_triangle][k]+1] += 2;
+    for(int k=0 ; k<N_vertex ; ++k)
+        offset[k+1] += offset[k];
+
+    std::vector<int> neighbor(offset[N_vertex]);
+    std::vector<int> fill(offset.begin(),offset.end()-1);
+    for(int k_triangle=0 ; k_triangle<N_triangle ; ++k_triangle)
+    {
+        triangle_index const& tri = connectivity_data[k_triangle];
+        for(int k=0 ; k<3 ; ++k)
+        {
+            int const a = tri[k];
+            neighbor[fill[a]++] = tri[(k+1)%3];
+            neighbor[fill[a]++] = tri[(k+2)%3];
+        }
+    }
+
+    //sort the neighbors of each vertex and remove the duplicates (and degenerated edges)
+    adjacency_offset_data.assign(N_vertex+1,0);
+    adjacency_data.clear();
+    adjacency_data.reserve(neighbor.size()/2);
+    for(int k=0 ; k<N_vertex ; ++k)
+    {
+        auto const begin = neighbor.begin()+offset[k];
+        auto const end = neighbor.begin()+offset[k+1];
+        std::sort(begin,end);
+        for(auto it=begin ; it!=end ; ++it)
+            if(*it!=k && (it==begin || *it!=*(it-1)))
+                adjacency_data.push_back(*it);
+        adjacency_offset_data[k+1] = adjacency_data.size();
+    }
+}
+
+void mesh_cloth::build_springs()
+{
+    int const N_vertex = size_vertex();
+    int const N_triangle = size_connectivity();
+
+    std::vector<spring> spring_data;
+    spring_data.reserve(adjacency_data.size()/2);
+    int family_offset[spring_family_size+1];
+
+    //structural: one spring per edge (i<j), in the order of the adjacency
+    family_offset[spring_structural] = 0;
+    for(int i=0 ; i<N_vertex ; ++i)
+    {
+        for(int k=adjacency_offset_data[i] ; k<adjacency_offset_data[i+1] ; ++k)
+        {
+            int const j = adjacency_data[k];
+            if(j>i)
+                spring_data.push_back({i , j , k_structural , norm(vertex_data[i]-vertex_data[j])});
+        }
+    }
+
+    //shearing: none
+    family_offset[spring_shearing] = spring_data.size();
+
+    //bending: the edges are found as pairs of half edges (a,b) with the same
+    // extremities, the spring links the two vertices opposite to the edge.
+    struct half_edge { int a; int b; int opposite; };
+    std::vector<half_edge> half_edges;
+    half_edges.reserve(3*N_triangle);
+    for(int k_triangle=0 ; k_triangle<N_triangle ; ++k_triangle)
+    {
+        triangle_index const& tri = connectivity_data[k_triangle];
+        for(int k=0 ; k<3 ; ++k)
+        {
+            int const a = tri[k];
+            int const b = tri[(k+1)%3];
+            half_edges.push_back({std::min(a,b) , std::max(a,b) , tri[(k+2)%3]});
+        }
+    }
+    std::sort(half_edges.begin(),half_edges.end(),[](half_edge const& e0,half_edge const& e1)
+              {return e0.a<e1.a || (e0.a==e1.a && e0.b<e1.b);});
+
+    std::vector<std::pair<int,int> > bending;
+    int const N_half_edge = half_edges.size();
+    for(int begin=0,end=0 ; begin<N_half_edge ; begin=end)
+    {
+        end = begin+1;
+        while(end<N_half_edge && half_edges[end].a==half_edges[begin].a && half_edges[end].b==half_edges[begin].b)
+            ++end;
+
+        //every pair of triangles around the edge (a single pair on a manifold mesh)
+        for(int k0=begin ; k0<end ; ++k0)
+        {
+            for(int k1=k0+1 ; k1<end ; ++k1)
+            {
+                int const c = half_edges[k0].opposite;
+                int const d = half_edges[k1].opposite;
+                if(c!=d && !is_edge(c,d))
+                    bending.push_back({std::min(c,d),std::max(c,d)});
+            }
+        }
+    }
+    std::sort(bending.begin(),bending.end());
+    bending.erase(std::unique(bending.begin(),bending.end()),bending.end());
+
+    family_offset[spring_bending] = spring_data.size();
+    for(auto const& e : bending)
+        spring_data.push_back({e.first , e.second , k_bending , norm(vertex_data[e.first]-vertex_data[e.second])});
+    family_offset[spring_family_size] = spring_data.size();
+
+    initialize_springs(spring_data,family_offset);
+}
+
+}
@@ -0,0 +1,97 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef MESH_CLOTH_HPP
+#define MESH_CLOTH_HPP
+
+#include "../lib/mesh/mesh.hpp"
+#include "cloth_solver.hpp"
+#include <string>
+#include <vector>
+
+namespace cpe
+{
+
+/** Cloth built on an arbitrary triangle mesh.
+ *
+ *  Each edge of the mesh is a structural spring, and the two vertices opposite
+ *  to an edge shared by two triangles are linked by a bending spring. The
+ *  shearing family is empty (a triangle is already rigid with its three edges).
+ *  The rest lengths are the lengths of the mesh given to set_mesh.
+ *  Vertices duplicated along texture seams are not merged: the cloth is split
+ *  along these seams. */
+class mesh_cloth : public mesh, public cloth_solver
+{
+public:
+
+    using mesh::mesh;
+
+    /** Build the cloth from a triangle mesh (positions at rest, no fixed vertex) */
+    void set_mesh(mesh const& m);
+    /** Load a mesh file (.obj or .off) and build the cloth */
+    void load(std::string const& filename);
+
+    /** Write the complete state of the cloth (with its triangles) in a binary checkpoint file */
+    void save_checkpoint(std::string const& filename) const;
+    /** Restore a state written by save_checkpoint, the mesh is replaced by the stored one */
+    void load_checkpoint(std::string const& filename);
+
+    /** Fix (null inverse mass) or release the particle of a given vertex */
+    void set_fixed(int index,bool fixed);
+
+    /** Velocity of the particle of a given vertex */
+    vec3 speed(int index) const;
+    /** Force applied on the particle of a given vertex during the last update_force */
+    vec3 force(int index) const;
+
+    void update_force(float &h, bool &wind, int wind_force, float radius, vec3 center);
+
+    /** Copy the particle positions into the mesh vertices (see mesh_parametric_cloth::sync_mesh) */
+    void sync_mesh();
+
+    /** Vertex adjacency in compressed sparse row form: the neighbors of the
+     *  vertex k are adjacency()[j] for j in [adjacency_offset()[k],adjacency_offset()[k+1]),
+     *  sorted by increasing index. */
+    std::vector<int> const& adjacency_offset() const;
+    std::vector<int> const& adjacency() const;
+    /** Number of edges of the mesh */
+    int size_edge() const;
+
+private:
+
+    /** Build the vertex adjacency from the triangles */
+    void build_adjacency();
+    /** Build the structural and bending springs (called once per set_mesh) */
+    void build_springs();
+    /** True if the vertices i and j share an edge */
+    bool is_edge(int i,int j) const;
+
+    /** Begin of the neighbors of each vertex (size N_vertex+1) */
+    std::vector<int> adjacency_offset_data;
+    /** Neighbors of all the vertices */
+    std::vector<int> adjacency_data;
+    /** Clock of the sleep tiles at the last sync_mesh */
+    long mesh_clock = -1;
+
+};
+
+}
+
+#endif
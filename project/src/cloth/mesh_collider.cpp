@@ -0,0 +1,119 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mesh_collider.hpp"
+
+#include "../lib/mesh/mesh_basic.hpp"
+#include "../lib/common/error_handling.hpp"
+
+namespace cpe
+{
+
+void mesh_collider::set_mesh(mesh_basic const& m)
+{
+    tree.build(m);
+}
+
+void mesh_collider::update_mesh(mesh_basic const& m)
+{
+    tree.refit(m);
+}
+
+void mesh_collider::set_thickness(float const thickness_value)
+{
+    ASSERT_CPE(thickness_value>0.0f,"Thickness should be >0");
+    thickness = thickness_value;
+}
+
+float mesh_collider::get_thickness() const
+{
+    return thickness;
+}
+
+void mesh_collider::collide(particle_store& particles)
+{
+    collide(particles,{{0,particles.size()}});
+}
+
+void mesh_collider::collide(particle_store& particles,std::vector<particle_range> const& ranges)
+{
+    float* const px = particles.position.x.data();
+    float* const py = particles.position.y.data();
+    float* const pz = particles.position.z.data();
+    float* const vx = particles.velocity.x.data();
+    float* const vy = particles.velocity.y.data();
+    float* const vz = particles.velocity.z.data();
+    float const* const inv_mass = particles.inv_mass.data();
+
+    int contact = 0;
+    for(particle_range const& r : ranges)
+    {
+        int const offset = r.begin;
+        int const N = r.end-r.begin;
+        tree.closest_point(px+offset,py+offset,pz+offset,N,thickness,closest);
+
+        #pragma omp parallel for schedule(static) reduction(+:contact)
+        for(int k_closest=0 ; k_closest<N ; ++k_closest)
+        {
+            int const k = offset+k_closest;
+            bvh_closest_point const& c = closest[k_closest];
+            if(c.triangle<0 || inv_mass[k]==0.0f)
+                continue;
+
+            //direction from the mesh to the particle (normal of the face if the particle is on it)
+            float const qx = c.point.x(), qy = c.point.y(), qz = c.point.z();
+            float nx = px[k]-qx, ny = py[k]-qy, nz = pz[k]-qz;
+            if(c.distance>1e-6f)
+            {
+                float const inv_d = 1.0f/c.distance;
+                nx *= inv_d; ny *= inv_d; nz *= inv_d;
+            }
+            else
+            {
+                vec3 const n = tree.triangle_normal(c.triangle);
+                nx = n.x(); ny = n.y(); nz = n.z();
+            }
+
+            px[k] = qx+thickness*nx;
+            py[k] = qy+thickness*ny;
+            pz[k] = qz+thickness*nz;
+
+            float const vn = vx[k]*nx+vy[k]*ny+vz[k]*nz;
+            if(vn<0.0f)
+            {
+                vx[k] -= vn*nx;
+                vy[k] -= vn*ny;
+                vz[k] -= vn*nz;
+            }
+            ++contact;
+        }
+    }
+    N_contact = contact;
+}
+
+int mesh_collider::last_contact() const
+{
+    return N_contact;
+}
+
+bvh const& mesh_collider::get_bvh() const
+{
+    return tree;
+}
+
+}
@@ -0,0 +1,76 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef MESH_COLLIDER_HPP
+#define MESH_COLLIDER_HPP
+
+#include "particle_store.hpp"
+#include "../lib/intersection/bvh.hpp"
+#include <vector>
+
+namespace cpe
+{
+
+class mesh_basic;
+
+/** Triangle mesh obstacle of the cloth (any mesh, open or closed).
+ *
+ *  The mesh is stored in a bvh. At each step the closest point of the mesh is
+ *  queried for every particle (batch query, parallel): a particle closer than
+ *  the thickness is moved back at the thickness along the direction of the
+ *  closest point, and the normal component of its velocity toward the mesh is
+ *  removed. The side of the particle is kept, so the mesh behaves as a shell
+ *  of the given thickness. */
+class mesh_collider
+{
+public:
+
+    /** Build the bvh of the obstacle */
+    void set_mesh(mesh_basic const& m);
+    /** Follow a deformation of the obstacle (same triangles as set_mesh, refit of the bvh) */
+    void update_mesh(mesh_basic const& m);
+
+    /** Distance kept between the particles and the mesh */
+    void set_thickness(float thickness);
+    float get_thickness() const;
+
+    /** Project the particles closer than the thickness (fixed particles are not moved) */
+    void collide(particle_store& particles);
+    /** Collision restricted to ranges of particles */
+    void collide(particle_store& particles,std::vector<particle_range> const& ranges);
+
+    /** Number of particles projected during the last collide */
+    int last_contact() const;
+    /** Hierarchy of the obstacle (for additional queries) */
+    bvh const& get_bvh() const;
+
+private:
+
+    bvh tree;
+    float thickness = 0.005f;
+
+    /** Closest point of each particle */
+    std::vector<bvh_closest_point> closest;
+    int N_contact = 0;
+};
+
+}
+
+#endif
@@ -19,255 +19,172 @@
 #include "mesh_parametric_cloth.hpp"
 
 #include "../lib/common/error_handling.hpp"
+#include <algorithm>
 #include <cmath>
-#include <cstdlib>
-#include "../local/scene/scene.hpp"
 
 namespace cpe
 {
 
-
 void mesh_parametric_cloth::update_force(float& h, bool& wind, int wind_force, float radius, vec3 center)
 {
+    ASSERT_CPE(particles.size() == size_u()*size_v() , "Error of size");
+    ASSERT_CPE(size_normal() == size_u()*size_v() , "Error of size");
 
-    int const Nu = size_u();
-    int const Nv = size_v();
-    int const N_total = Nu*Nv;
-
-    ASSERT_CPE(static_cast<int>(force_data.size()) == Nu*Nv , "Error of size");
-
-
-    //Gravity
-    static vec3 const g (0.0f,0.0f,-9.81f);
-    vec3 const g_normalized = g/N_total;
-
-    for(int ku=0 ; ku<Nu ; ++ku)
-        {
-            for(int kv=0  ; kv<Nv ; ++kv)
-            {
-                force(ku,kv) = g_normalized;
-                compute_spring_forces(Nu, Nv, ku, kv);
-
-                if(vertex(ku,kv).z() < h + 0.0005f){
-                    vertex(ku,kv).z() += 0.0005f;
-
-                    vec3 normal = vertex(ku,kv) - vec3(0.0f,0.0f,-1.101f);
-                    cpe::normalized(normal);
-                    vec3 speed_normal = dot(speed(ku,kv),normal)*normal * (1- exp(-(abs(vertex(ku,kv).z() - h))*1000.0f));
-                    vec3 speed_tangent = (speed(ku,kv) - speed_normal) * (1- exp(-(abs(vertex(ku,kv).z() - h))*1000.0f));
-                    speed(ku,kv) = speed_tangent - speed_normal;
-                }
-
-                //Sphere collision
-                if(norm(vertex(ku,kv) - center) < radius)
-                {
-                    vertex(ku,kv) = vertex(ku,kv) + vec3(0.0005f,0.0005f,0.0005f);
-
-                    vec3 normal = vertex(ku,kv) - vec3(0.5f,0.05f,-1.1f);
-                    cpe::normalized(normal);
-                    vec3 speed_normal = dot(speed(ku,kv),normal)*normal;
-                    vec3 speed_tangent = speed(ku,kv) - speed_normal;
-                    speed(ku,kv) = speed_tangent - speed_normal;
-                }
-
-                //Wind force
-                if(wind){
-                    vec3 wind_direction = vec3(1.0f,0.0f,0.0f);
-                    int random = rand() % 5000;
-                    float K_wind = (float)random/100.0f * (float)wind_force/10000.0f;
-                    vec3 wind_force = K_wind*dot(normal(ku,kv),wind_direction)*normal(ku,kv);
-                    force(ku,kv) = force(ku,kv) + wind_force;
-                }
-
-            }
-        }
-
-        force(0,0)=vec3(0.0f, 0.0f, 0.0f);
-        force(0,Nv-1)=vec3(0.0f, 0.0f, 0.0f);
+    compute_forces(h,wind,wind_force,radius,center,normal_data);
 }
 
-void mesh_parametric_cloth::integration_step(float const& dt)
+void mesh_parametric_cloth::sync_mesh()
 {
-    ASSERT_CPE(speed_data.size() == force_data.size(),"Incorrect size");
-    ASSERT_CPE(static_cast<int>(speed_data.size()) == size_vertex(),"Incorrect size");
-
+    ASSERT_CPE(particles.size() == size_vertex(),"Incorrect size");
+    export_moved_positions(vertex_data,mesh_clock);
+}
 
+void mesh_parametric_cloth::sync_normal()
+{
     int const Nu = size_u();
     int const Nv = size_v();
-
-    //security check (throw exception if divergence is detected)
-    static float const LIMIT=30.0f;
-    //static float const K_LIMIT = 35.0f;
-    for(int ku=0 ; ku<Nu ; ++ku)
+    sleep_tiles const& tiles = get_sleep_tiles();
+    if(size_normal()!=size_vertex() || tiles.size_tile()==0 || tiles.tile_size()%Nu!=0)
     {
-        for(int kv=0 ; kv<Nv ; ++kv)
-        {
-            vec3& p = vertex(ku,kv);
-            speed(ku,kv) = (1-0.4f*dt)*speed(ku,kv) + dt*force(ku,kv);
-            p = p + speed(ku,kv)*dt;
-
-            /*if(norm(p) > LIMIT - 25.0f && k_bending > 0.1f && k_shearing > 0.1f && k_structural > 0.1f)
-            {
-                k_bending -= 1.0f;
-                k_shearing -= 1.0f;
-                k_structural -= 1.0f;
-            }
-            else if(norm(p) < LIMIT - 25.0f && k_bending < K_LIMIT && k_shearing < K_LIMIT && k_structural < K_LIMIT){
-                k_bending += 0.2f;
-                k_shearing += 0.2f;
-                k_structural += 0.2f;
-            }*/
-            if( norm(p) > LIMIT )
-            {
-                std::cout << "norme de p : " << norm(p) << std::endl;
-                throw exception_divergence("Divergence of the system",EXCEPTION_PARAMETERS_CPE);
-            }
-        }
+        fill_normal_grid();
+        normal_clock = mesh_clock;
+        return;
     }
 
-}
-
-void mesh_parametric_cloth::compute_spring_forces(const int &Nu, const int &Nv, int &ku, int &kv){
-    //structural string
-    float L_structural=1.0f/(Nu-1);
-
-    if (ku<Nu-1)
+    //the normal of a vertex depends on the rows before and after it
+    std::vector<char> moved(Nv,0);
+    int const N_tile = tiles.size_tile();
+    for(int t=0 ; t<N_tile ; ++t)
     {
-        vec3 u1 = vertex(ku,kv)-vertex(ku+1,kv);
-        force(ku,kv) += k_structural*(L_structural-norm(u1))*u1/norm(u1);
+        if(tiles.motion(t)<=normal_clock)
+            continue;
+        int const row_begin = std::max(tiles.tile_begin(t)/Nu-1,0);
+        int const row_end = std::min(tiles.tile_end(t)/Nu+1,Nv);
+        std::fill(moved.begin()+row_begin,moved.begin()+row_end,1);
     }
-    if (kv<Nv-1)
-    {
-        vec3 u2 = vertex(ku,kv)-vertex(ku,kv+1);
-        force(ku,kv) += k_structural*(L_structural-norm(u2))*u2/norm(u2);
-    }
-    if (ku>0)
-    {
-        vec3 u3 = vertex(ku,kv)-vertex(ku-1,kv);
-        force(ku,kv) += k_structural*(L_structural-norm(u3))*u3/norm(u3);
-    }
-    if (kv>0)
+
+    for(int kv=0 ; kv<Nv ; )
     {
-        vec3 u4 = vertex(ku,kv)-vertex(ku,kv-1);
-        force(ku,kv) += k_structural*(L_structural-norm(u4))*u4/norm(u4);
+        if(!moved[kv])
+        {
+            ++kv;
+            continue;
+        }
+        int const row_begin = kv;
+        while(kv<Nv && moved[kv])
+            ++kv;
+        fill_normal_grid_rows(row_begin,kv);
     }
+    normal_clock = mesh_clock;
+}
 
-    //shearing springs
-    float L_shearing=sqrt(2)*L_structural;
+void mesh_parametric_cloth::build_springs()
+{
+    int const Nu = size_u();
+    int const Nv = size_v();
 
-    if (ku<Nu-1 && kv<Nv-1)
-    {
-        vec3 u5 = vertex(ku,kv)-vertex(ku+1,kv+1);
-        force(ku,kv) += k_shearing*(L_shearing-norm(u5))*u5/norm(u5);
-    }
-    if (ku>0 && kv<Nv-1)
-    {
-        vec3 u6 = vertex(ku,kv)-vertex(ku-1,kv+1);
-        force(ku,kv) += k_shearing*(L_shearing-norm(u6))*u6/norm(u6);
-    }
-    if (kv>0 && ku<Nu-1)
-    {
-        vec3 u7 = vertex(ku,kv)-vertex(ku+1,kv-1);
-        force(ku,kv) += k_shearing*(L_shearing-norm(u7))*u7/norm(u7);
-    }
-    if (ku>0 && kv>0)
-    {
-        vec3 u8 = vertex(ku,kv)-vertex(ku-1,kv-1);
-        force(ku,kv) += k_shearing*(L_shearing-norm(u8))*u8/norm(u8);
-    }
+    float const L_structural = 1.0f/(Nu-1);
+    float const L_shearing = std::sqrt(2.0f)*L_structural;
+    float const L_bending = 2.0f*L_structural;
 
-    //bending springs
-    float L_bending=2*L_structural;
+    std::vector<spring> spring_data;
+    int family_offset[spring_family_size+1];
 
-    if (ku<Nu-2)
-    {
-        vec3 u9 = vertex(ku,kv)-vertex(ku+2,kv);
-        force(ku,kv) += k_bending*(L_bending-norm(u9))*u9/norm(u9);
-    }
-    if (kv<Nv-2)
-    {
-        vec3 u10 = vertex(ku,kv)-vertex(ku,kv+2);
-        force(ku,kv) += k_bending*(L_bending-norm(u10))*u10/norm(u10);
-    }
-    if (ku>1)
-    {
-        vec3 u11 = vertex(ku,kv)-vertex(ku-2,kv);
-        force(ku,kv) += k_bending*(L_bending-norm(u11))*u11/norm(u11);
-    }
-    if (kv>1)
+    //(du,dv) offsets of the springs linking (ku,kv) to (ku+du,kv+dv).
+    // Only one direction is stored: each spring appears once.
+    struct stencil { int du; int dv; };
+    static stencil const structural[] = { {1,0} , {0,1} };
+    static stencil const shearing[] = { {1,1} , {1,-1} };
+    static stencil const bending[] = { {2,0} , {0,2} };
+
+    auto add_family = [&](stencil const* offsets,int N_offsets,float k,float L)
     {
-        vec3 u12 = vertex(ku,kv)-vertex(ku,kv-2);
-        force(ku,kv) += k_bending*(L_bending-norm(u12))*u12/norm(u12);
-    }
-}
+        for(int k_offset=0 ; k_offset<N_offsets ; ++k_offset)
+        {
+            int const du = offsets[k_offset].du;
+            int const dv = offsets[k_offset].dv;
+            for(int kv=0 ; kv<Nv ; ++kv)
+            {
+                for(int ku=0 ; ku<Nu ; ++ku)
+                {
+                    int const ku2 = ku+du;
+                    int const kv2 = kv+dv;
+                    if(ku2<0 || ku2>=Nu || kv2<0 || kv2>=Nv)
+                        continue;
+                    spring_data.push_back({ku+Nu*kv , ku2+Nu*kv2 , k , L});
+                }
+            }
+        }
+    };
 
-void mesh_parametric_cloth::compute_single_spring_force(float k, float L, int ku, int kv, int adj_ku, int adj_kv){
-    vec3 u = vertex(ku,kv) - vertex(adj_ku,adj_kv);
-    force(ku,kv) = k*(L - norm(u))*u/norm(u);
-}
+    family_offset[spring_structural] = 0;
+    add_family(structural,2,k_structural,L_structural);
+    family_offset[spring_shearing] = spring_data.size();
+    add_family(shearing,2,k_shearing,L_shearing);
+    family_offset[spring_bending] = spring_data.size();
+    add_family(bending,2,k_bending,L_bending);
+    family_offset[spring_family_size] = spring_data.size();
 
-void mesh_parametric_cloth::set_k_struct(float const& k){
-    k_structural = k;
+    initialize_springs(spring_data,family_offset);
 }
 
-void mesh_parametric_cloth::set_k_shear(float const& k){
-    k_shearing = k;
-}
+void mesh_parametric_cloth::set_grid(int const size_u_param,int const size_v_param)
+{
+    //mesh_parametric::set_plane_xy_unit appends to the current surface
+    static_cast<mesh_parametric&>(*this) = mesh_parametric();
+    mesh_parametric::set_plane_xy_unit(size_u_param,size_v_param);
 
-void mesh_parametric_cloth::set_k_bend(float const& k){
-    k_bending = k;
-}
+    int const Nu = size_u();
+    int const Nv = size_v();
 
-std::string mesh_parametric_cloth::str_k_struct(){
-    return std::to_string(k_structural);
-}
+    initialize_particles(vertex_data);
 
-std::string mesh_parametric_cloth::str_k_shear(){
-    return std::to_string(k_shearing);
-}
+    //the two corners at v=0 and v=1 of the first row are fixed
+    particles.inv_mass[0] = 0.0f;
+    particles.inv_mass[Nu*(Nv-1)] = 0.0f;
+
+    initialize_self_collision(connectivity_data);
 
-std::string mesh_parametric_cloth::str_k_bend(){
-    return std::to_string(k_bending);
+    //sleep tiles made of whole rows (at least 256 particles)
+    initialize_sleep_tiles(Nu*((256+Nu-1)/Nu));
 }
 
 void mesh_parametric_cloth::set_plane_xy_unit(int const size_u_param,int const size_v_param)
 {
-    mesh_parametric::set_plane_xy_unit(size_u_param,size_v_param);
-
-    int const N = size_u()*size_v();
-    speed_data.resize(N);
-    force_data.resize(N);
+    set_grid(size_u_param,size_v_param);
+    build_springs();
 }
 
-vec3 const& mesh_parametric_cloth::speed(int const ku,int const kv) const
+void mesh_parametric_cloth::save_checkpoint(std::string const& filename) const
 {
-    ASSERT_CPE(ku >= 0 , "Value ku ("+std::to_string(ku)+") should be >=0 ");
-    ASSERT_CPE(ku < size_u() , "Value ku ("+std::to_string(ku)+") should be < size_u ("+std::to_string(size_u())+")");
-    ASSERT_CPE(kv >= 0 , "Value kv ("+std::to_string(kv)+") should be >=0 ");
-    ASSERT_CPE(kv < size_v() , "Value kv ("+std::to_string(kv)+") should be < size_v ("+std::to_string(size_v())+")");
-
-    int const offset = ku + size_u()*kv;
-
-    ASSERT_CPE(offset < static_cast<int>(speed_data.size()),"Internal error");
-
-    return speed_data[offset];
+    checkpoint_writer file;
+    write_checkpoint(file);
+    file.header().layout = checkpoint_grid;
+    file.header().size_u = size_u();
+    file.header().size_v = size_v();
+    file.write(filename);
 }
 
-vec3& mesh_parametric_cloth::speed(int const ku,int const kv)
+void mesh_parametric_cloth::load_checkpoint(std::string const& filename)
 {
-    ASSERT_CPE(ku >= 0 , "Value ku ("+std::to_string(ku)+") should be >=0 ");
-    ASSERT_CPE(ku < size_u() , "Value ku ("+std::to_string(ku)+") should be < size_u ("+std::to_string(size_u())+")");
-    ASSERT_CPE(kv >= 0 , "Value kv ("+std::to_string(kv)+") should be >=0 ");
-    ASSERT_CPE(kv < size_v() , "Value kv ("+std::to_string(kv)+") should be < size_v ("+std::to_string(size_v())+")");
-
-    int const offset = ku + size_u()*kv;
+    checkpoint_reader file(filename);
+    checkpoint_header const& header = file.header();
+    if(header.layout!=checkpoint_grid)
+        throw exception_cpe("Checkpoint "+filename+" does not store a grid cloth",EXCEPTION_PARAMETERS_CPE);
+    if(header.size_u<2 || header.size_v<2 || static_cast<long>(header.size_u)*header.size_v!=header.N_particle)
+        throw exception_cpe("Incorrect grid size in checkpoint "+filename,EXCEPTION_PARAMETERS_CPE);
 
-    ASSERT_CPE(offset < static_cast<int>(speed_data.size()),"Internal error");
+    //the springs are not built: they are read from the file
+    if(header.size_u!=size_u() || header.size_v!=size_v())
+        set_grid(header.size_u,header.size_v);
+    read_checkpoint(file);
 
-    return speed_data[offset];
+    //the wind of the next step uses the normals of the restored surface
+    sync_mesh();
+    fill_normal_grid();
 }
 
-vec3 const& mesh_parametric_cloth::force(int const ku,int const kv) const
+vec3 mesh_parametric_cloth::speed(int const ku,int const kv) const
 {
     ASSERT_CPE(ku >= 0 , "Value ku ("+std::to_string(ku)+") should be >=0 ");
     ASSERT_CPE(ku < size_u() , "Value ku ("+std::to_string(ku)+") should be < size_u ("+std::to_string(size_u())+")");
@@ -275,13 +192,10 @@ vec3 const& mesh_parametric_cloth::force(int const ku,int const kv) const
     ASSERT_CPE(kv < size_v() , "Value kv ("+std::to_string(kv)+") should be < size_v ("+std::to_string(size_v())+")");
 
     int const offset = ku + size_u()*kv;
-
-    ASSERT_CPE(offset < static_cast<int>(force_data.size()),"Internal error");
-
-    return force_data[offset];
+    return particles.velocity.get(offset);
 }
 
-vec3& mesh_parametric_cloth::force(int const ku,int const kv)
+vec3 mesh_parametric_cloth::force(int const ku,int const kv) const
 {
     ASSERT_CPE(ku >= 0 , "Value ku ("+std::to_string(ku)+") should be >=0 ");
     ASSERT_CPE(ku < size_u() , "Value ku ("+std::to_string(ku)+") should be < size_u ("+std::to_string(size_u())+")");
@@ -289,11 +203,7 @@ vec3& mesh_parametric_cloth::force(int const ku,int const kv)
     ASSERT_CPE(kv < size_v() , "Value kv ("+std::to_string(kv)+") should be < size_v ("+std::to_string(size_v())+")");
 
     int const offset = ku + size_u()*kv;
-
-    ASSERT_CPE(offset < static_cast<int>(force_data.size()),"Internal error");
-
-    return force_data[offset];
+    return particles.force.get(offset);
 }
 
-
 }
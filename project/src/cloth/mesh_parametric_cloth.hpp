@@ -22,48 +22,54 @@
 #define MESH_PARAMETRIC_CLOTH_HPP
 
 #include "../lib/mesh/mesh_parametric.hpp"
-#include "../lib/common/exception_cpe.hpp"
-#include <string>
+#include "cloth_solver.hpp"
 
 namespace cpe
 {
-class mesh_parametric_cloth : public mesh_parametric
+
+/** Cloth discretized as a regular grid of particles linked by structural,
+ *  shearing and bending springs (stencils of the grid). */
+class mesh_parametric_cloth : public mesh_parametric, public cloth_solver
 {
 public:
     using mesh_parametric::mesh_parametric;
 
     void set_plane_xy_unit(int const size_u_param,int const size_v_param);
 
-    vec3 const& speed(int ku,int kv) const;
-    vec3& speed(int ku,int kv);
+    /** Write the complete state of the cloth in a binary checkpoint file */
+    void save_checkpoint(std::string const& filename) const;
+    /** Restore a state written by save_checkpoint (the grid is resized if needed).
+     *  The file is mapped in memory and the arrays copied as they are. */
+    void load_checkpoint(std::string const& filename);
 
-    vec3 const& force(int ku,int kv) const;
-    vec3& force(int ku,int kv);
+    /** Velocity of the particle (ku,kv) */
+    vec3 speed(int ku,int kv) const;
+    /** Force applied on the particle (ku,kv) during the last update_force */
+    vec3 force(int ku,int kv) const;
 
     void update_force(float &h, bool &wind, int wind_force, float radius, vec3 center);
-    void integration_step(const float &dt);
-
-    void set_k_struct(float const& k);
-    void set_k_shear(float const& k);
-    void set_k_bend(float const& k);
-    std::string str_k_struct();
-    std::string str_k_shear();
-    std::string str_k_bend();
 
-    void compute_spring_forces(const int& Nu,const int& Nv, int& ku, int& kv);
-    void compute_single_spring_force(float k, float L, int ku, int kv, int adj_ku, int adj_kv);
+    /** Copy the particle positions into the mesh vertices.
+     *  The solver works on its own particle storage, the mesh (vertex(),
+     *  fill_normal(), OpenGL buffers) is only updated by this call.
+     *  Only the tiles moved since the last call are copied (see sleep_tiles). */
+    void sync_mesh();
+    /** Recompute the normals of the rows whose one ring moved since the last
+     *  call (same values as fill_normal, the sleeping tiles are skipped) */
+    void sync_normal();
 
 private:
 
-    std::vector<vec3> speed_data;
-    std::vector<vec3> force_data;
-    float k_structural = 10.0f,k_shearing = 7.0f, k_bending = 2.0f;
+    /** Flat grid with its particles, fixed corners, self collision and sleep tiles, without springs */
+    void set_grid(int size_u_param,int size_v_param);
 
-};
+    /** Build the list of springs of the current grid (called once per set_plane_xy_unit) */
+    void build_springs();
+
+    /** Clock of the sleep tiles at the last sync_mesh and sync_normal */
+    long mesh_clock = -1;
+    long normal_clock = -1;
 
-class exception_divergence : public exception_cpe
-{
-    using exception_cpe::exception_cpe;
 };
 
 }
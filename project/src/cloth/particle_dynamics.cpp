@@ -0,0 +1,151 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "particle_dynamics.hpp"
+
+#include "../lib/random/counter_rng.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <omp.h>
+
+namespace cpe
+{
+
+void add_spring_forces(particle_store& particles,std::vector<spring> const& spring_data,std::vector<int> const& spring_batch_offset,spring_kernel_type const kernel_type)
+{
+    float const* const px = particles.position.x.data();
+    float const* const py = particles.position.y.data();
+    float const* const pz = particles.position.z.data();
+    float* const fx = particles.force.x.data();
+    float* const fy = particles.force.y.data();
+    float* const fz = particles.force.z.data();
+
+    spring const* const springs = spring_data.data();
+    int const N_batch = static_cast<int>(spring_batch_offset.size())-1;
+    spring_kernel const kernel = get_spring_kernel(kernel_type);
+
+    //each spring is evaluated once, the opposite force is applied on the other extremity.
+    // Springs of a batch share no vertex: they are distributed among the threads
+    // without write conflict, and every force receives its contributions in the
+    // same order whatever the number of threads.
+    #pragma omp parallel
+    {
+        int const thread = omp_get_thread_num();
+        int const N_thread = omp_get_num_threads();
+
+        for(int b=0 ; b<N_batch ; ++b)
+        {
+            int const begin = spring_batch_offset[b];
+            int const N = spring_batch_offset[b+1]-begin;
+
+            kernel(springs,begin+(N*thread)/N_thread,begin+(N*(thread+1))/N_thread,px,py,pz,fx,fy,fz);
+
+            #pragma omp barrier
+        }
+    }
+}
+
+void sample_wind_intensity(particle_store const& particles,wind_model const type,wind_field& noise,uint64_t const seed,long const step,aligned_vector<float>& intensity)
+{
+    int const N = particles.size();
+    intensity.resize(N);
+    if(type==wind_perlin)
+        noise.evaluate(particles.position.x.data(),particles.position.y.data(),particles.position.z.data(),N,step,intensity.data());
+    else
+        counter_rng(seed,step).fill_uniform(intensity.data(),N);
+}
+
+void add_wind_forces(particle_store& particles,std::vector<vec3> const& normal,aligned_vector<float> const& intensity,int const wind_force,particle_range const& range)
+{
+    float* const fx = particles.force.x.data();
+    float* const fy = particles.force.y.data();
+    float* const fz = particles.force.z.data();
+
+    float const K_max = 50.0f*static_cast<float>(wind_force)/10000.0f;
+    vec3 const wind_direction = vec3(1.0f,0.0f,0.0f);
+
+    #pragma omp parallel for schedule(static)
+    for(int k=range.begin ; k<range.end ; ++k)
+    {
+        vec3 const& n = normal[k];
+        float const K_wind = K_max*intensity[k];
+        vec3 const f_wind = K_wind*dot(n,wind_direction)*n;
+        fx[k] += f_wind.x();
+        fy[k] += f_wind.y();
+        fz[k] += f_wind.z();
+    }
+}
+
+void integrate(cloth_integrator const type,implicit_solver& implicit,xpbd_solver& xpbd,particle_store& particles,
+               std::vector<spring> const& springs,std::vector<int> const& batch_offset,float const dt,std::vector<particle_range> const& awake)
+{
+    //nothing moves when all the particles are asleep
+    if(awake.empty())
+        return;
+
+    switch(type)
+    {
+    case integrator_implicit_euler:
+        implicit.step(particles,springs,batch_offset,dt,CLOTH_DAMPING);
+        break;
+    case integrator_xpbd:
+        xpbd.step(particles,springs,batch_offset,dt,CLOTH_DAMPING);
+        break;
+    default:
+        explicit_euler_step(particles,dt,CLOTH_DAMPING,awake);
+    }
+}
+
+void explicit_euler_step(particle_store& particles,float const dt,float const damping_coefficient)
+{
+    explicit_euler_step(particles,dt,damping_coefficient,{{0,particles.size()}});
+}
+
+void explicit_euler_step(particle_store& particles,float const dt,float const damping_coefficient,std::vector<particle_range> const& ranges)
+{
+    float* const px = particles.position.x.data();
+    float* const py = particles.position.y.data();
+    float* const pz = particles.position.z.data();
+    float* const vx = particles.velocity.x.data();
+    float* const vy = particles.velocity.y.data();
+    float* const vz = particles.velocity.z.data();
+    float const* const fx = particles.force.x.data();
+    float const* const fy = particles.force.y.data();
+    float const* const fz = particles.force.z.data();
+    float const* const w = particles.inv_mass.data();
+
+    float const damping = 1-damping_coefficient*dt;
+
+    for(particle_range const& r : ranges)
+    {
+        #pragma omp parallel for schedule(static)
+        for(int k=r.begin ; k<r.end ; ++k)
+        {
+            vx[k] = damping*vx[k] + dt*w[k]*fx[k];
+            vy[k] = damping*vy[k] + dt*w[k]*fy[k];
+            vz[k] = damping*vz[k] + dt*w[k]*fz[k];
+
+            px[k] += dt*vx[k];
+            py[k] += dt*vy[k];
+            pz[k] += dt*vz[k];
+        }
+    }
+}
+
+}
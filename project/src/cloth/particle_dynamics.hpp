@@ -0,0 +1,84 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef PARTICLE_DYNAMICS_HPP
+#define PARTICLE_DYNAMICS_HPP
+
+#include "particle_store.hpp"
+#include "spring.hpp"
+#include "spring_kernel.hpp"
+#include "implicit_solver.hpp"
+#include "xpbd_solver.hpp"
+#include "wind_field.hpp"
+#include "../lib/3d/vec3.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace cpe
+{
+
+/** Time integration schemes of the cloth */
+enum cloth_integrator
+{
+    /** Damped explicit (symplectic) Euler, requires small time steps */
+    integrator_explicit_euler = 0,
+    /** Backward Euler solved by conjugate gradient, stable for large steps and stiff springs */
+    integrator_implicit_euler = 1,
+    /** Springs projected as XPBD distance constraints, unconditionally stable */
+    integrator_xpbd = 2
+};
+
+/** Spatial/temporal distribution of the wind intensity */
+enum wind_model
+{
+    /** Independent random intensity per vertex and per step */
+    wind_random = 0,
+    /** Coherent gusts given by a Perlin noise in space and time */
+    wind_perlin = 1
+};
+
+/** Velocity damping coefficient of the cloth (dv/dt = f/m - CLOTH_DAMPING.v) */
+float const CLOTH_DAMPING = 0.4f;
+/** Distance above which the simulation is considered as diverged */
+float const CLOTH_DIVERGENCE_LIMIT = 30.0f;
+
+/** Add the forces of the springs to the particles (each spring evaluated once).
+ *  Springs of batch b are in [batch_offset[b],batch_offset[b+1]) and share no vertex. */
+void add_spring_forces(particle_store& particles,std::vector<spring> const& springs,std::vector<int> const& batch_offset,spring_kernel_type kernel_type);
+
+/** Wind intensity in [0,1] of every particle at the given step, independent of the thread scheduling */
+void sample_wind_intensity(particle_store const& particles,wind_model type,wind_field& noise,uint64_t seed,long step,aligned_vector<float>& intensity);
+/** Add the wind forces of strength wind_force (0-100) to the particles of the range,
+ *  normal to the surface and proportional to its exposure to the wind direction (x) */
+void add_wind_forces(particle_store& particles,std::vector<vec3> const& normal,aligned_vector<float> const& intensity,int wind_force,particle_range const& range);
+
+/** One time step of the given scheme restricted to the awake particles (the others
+ *  are fixed: their inverse mass must be 0 for the implicit and XPBD schemes) */
+void integrate(cloth_integrator type,implicit_solver& implicit,xpbd_solver& xpbd,particle_store& particles,
+               std::vector<spring> const& springs,std::vector<int> const& batch_offset,float dt,std::vector<particle_range> const& awake);
+
+/** Damped explicit Euler update of the velocities and positions */
+void explicit_euler_step(particle_store& particles,float dt,float damping);
+/** Explicit Euler update restricted to ranges of particles */
+void explicit_euler_step(particle_store& particles,float dt,float damping,std::vector<particle_range> const& ranges);
+
+}
+
+#endif
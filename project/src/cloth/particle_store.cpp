@@ -0,0 +1,102 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "particle_store.hpp"
+
+#include "../lib/common/error_handling.hpp"
+
+namespace cpe
+{
+
+int soa_vec3::size() const
+{
+    return x.size();
+}
+
+void soa_vec3::resize(int const N)
+{
+    ASSERT_CPE(N>=0,"Incorrect size");
+    x.resize(N,0.0f);
+    y.resize(N,0.0f);
+    z.resize(N,0.0f);
+}
+
+void soa_vec3::fill(vec3 const& v)
+{
+    int const N = size();
+    for(int k=0 ; k<N ; ++k)
+    {
+        x[k] = v.x();
+        y[k] = v.y();
+        z[k] = v.z();
+    }
+}
+
+vec3 soa_vec3::get(int const k) const
+{
+    ASSERT_CPE(k>=0 && k<size(),"Index ("+std::to_string(k)+") out of range ("+std::to_string(size())+")");
+    return vec3(x[k],y[k],z[k]);
+}
+
+void soa_vec3::set(int const k,vec3 const& v)
+{
+    ASSERT_CPE(k>=0 && k<size(),"Index ("+std::to_string(k)+") out of range ("+std::to_string(size())+")");
+    x[k] = v.x();
+    y[k] = v.y();
+    z[k] = v.z();
+}
+
+void soa_vec3::import_aos(std::vector<vec3> const& data)
+{
+    int const N = data.size();
+    resize(N);
+    for(int k=0 ; k<N ; ++k)
+    {
+        x[k] = data[k].x();
+        y[k] = data[k].y();
+        z[k] = data[k].z();
+    }
+}
+
+void soa_vec3::export_aos(std::vector<vec3>& data) const
+{
+    int const N = size();
+    data.resize(N);
+
+    float const* const px = x.data();
+    float const* const py = y.data();
+    float const* const pz = z.data();
+    for(int k=0 ; k<N ; ++k)
+        data[k] = vec3(px[k],py[k],pz[k]);
+}
+
+
+int particle_store::size() const
+{
+    return position.size();
+}
+
+void particle_store::resize(int const N)
+{
+    position.resize(N);
+    velocity.resize(N);
+    force.resize(N);
+    inv_mass.resize(N,1.0f);
+}
+
+}
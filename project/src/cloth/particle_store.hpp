@@ -0,0 +1,85 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef PARTICLE_STORE_HPP
+#define PARTICLE_STORE_HPP
+
+#include "../lib/3d/vec3.hpp"
+#include "../lib/common/aligned_allocator.hpp"
+
+#include <vector>
+
+namespace cpe
+{
+
+/** Structure of arrays storing 3D vectors as three aligned float arrays */
+struct soa_vec3
+{
+    aligned_vector<float> x;
+    aligned_vector<float> y;
+    aligned_vector<float> z;
+
+    /** Number of stored vectors */
+    int size() const;
+    /** Resize the three arrays (new entries are set to 0) */
+    void resize(int N);
+    /** Set all the entries to the value v */
+    void fill(vec3 const& v);
+
+    /** Get the k_th vector */
+    vec3 get(int k) const;
+    /** Set the k_th vector */
+    void set(int k,vec3 const& v);
+
+    /** Copy from an array of vec3 (the size is adapted) */
+    void import_aos(std::vector<vec3> const& data);
+    /** Copy to an array of vec3 (the size is adapted) */
+    void export_aos(std::vector<vec3>& data) const;
+};
+
+/** Range [begin,end) of particle indices */
+struct particle_range
+{
+    int begin;
+    int end;
+};
+
+/** Particle data of the cloth solver stored as structure of arrays.
+ *  Hot loops work directly on the raw x/y/z arrays. */
+struct particle_store
+{
+    /** Current positions */
+    soa_vec3 position;
+    /** Current velocities */
+    soa_vec3 velocity;
+    /** Accumulated forces */
+    soa_vec3 force;
+    /** Inverse of the mass (0 for fixed particles) */
+    aligned_vector<float> inv_mass;
+
+    /** Number of particles */
+    int size() const;
+    /** Resize all the arrays. New particles have zero velocity/force and unit mass */
+    void resize(int N);
+};
+
+}
+
+#endif
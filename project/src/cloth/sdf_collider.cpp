@@ -0,0 +1,116 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sdf_collider.hpp"
+
+#include "../lib/common/error_handling.hpp"
+#include <cmath>
+
+namespace cpe
+{
+
+void sdf_collider::set_field(signed_distance_field const& field_value)
+{
+    field = field_value;
+}
+
+void sdf_collider::load(std::string const& filename)
+{
+    field.load(filename);
+}
+
+signed_distance_field const& sdf_collider::get_field() const
+{
+    return field;
+}
+
+void sdf_collider::set_thickness(float const thickness_value)
+{
+    ASSERT_CPE(thickness_value>0.0f,"Thickness should be >0");
+    thickness = thickness_value;
+}
+
+float sdf_collider::get_thickness() const
+{
+    return thickness;
+}
+
+void sdf_collider::collide(particle_store& particles)
+{
+    collide(particles,{{0,particles.size()}});
+}
+
+void sdf_collider::collide(particle_store& particles,std::vector<particle_range> const& ranges)
+{
+    ASSERT_CPE(thickness<field.band(),"The thickness should be smaller than the band of the distance field");
+
+    float* const px = particles.position.x.data();
+    float* const py = particles.position.y.data();
+    float* const pz = particles.position.z.data();
+    float* const vx = particles.velocity.x.data();
+    float* const vy = particles.velocity.y.data();
+    float* const vz = particles.velocity.z.data();
+    float const* const inv_mass = particles.inv_mass.data();
+
+    int contact = 0;
+    for(particle_range const& r : ranges)
+    {
+        int const offset = r.begin;
+        int const N = r.end-r.begin;
+        distance.resize(N);
+        gradient.resize(N);
+        float* const gx = gradient.x.data();
+        float* const gy = gradient.y.data();
+        float* const gz = gradient.z.data();
+        field.sample(px+offset,py+offset,pz+offset,N,distance.data(),gx,gy,gz);
+
+        #pragma omp parallel for schedule(static) reduction(+:contact)
+        for(int k_sample=0 ; k_sample<N ; ++k_sample)
+        {
+            int const k = offset+k_sample;
+            if(distance[k_sample]>=thickness || inv_mass[k]==0.0f)
+                continue;
+            float const g_norm = std::sqrt(gx[k_sample]*gx[k_sample]+gy[k_sample]*gy[k_sample]+gz[k_sample]*gz[k_sample]);
+            if(g_norm<1e-6f)
+                continue;
+
+            float const nx = gx[k_sample]/g_norm, ny = gy[k_sample]/g_norm, nz = gz[k_sample]/g_norm;
+            float const depth = thickness-distance[k_sample];
+            px[k] += depth*nx;
+            py[k] += depth*ny;
+            pz[k] += depth*nz;
+
+            float const vn = vx[k]*nx+vy[k]*ny+vz[k]*nz;
+            if(vn<0.0f)
+            {
+                vx[k] -= vn*nx;
+                vy[k] -= vn*ny;
+                vz[k] -= vn*nz;
+            }
+            ++contact;
+        }
+    }
+    N_contact = contact;
+}
+
+int sdf_collider::last_contact() const
+{
+    return N_contact;
+}
+
+}
@@ -0,0 +1,74 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef SDF_COLLIDER_HPP
+#define SDF_COLLIDER_HPP
+
+#include "particle_store.hpp"
+#include "../lib/intersection/signed_distance_field.hpp"
+#include <string>
+
+namespace cpe
+{
+
+/** Static obstacle of the cloth given by a precomputed signed distance field.
+ *
+ *  The distance and its gradient are sampled for all the particles at once
+ *  (SIMD, parallel): the cost per particle does not depend on the number of
+ *  triangles of the obstacle. A particle at a distance smaller than the
+ *  thickness is moved along the gradient up to the thickness (this also
+ *  pushes out the particles inside the obstacle, up to the band of the field),
+ *  and the normal component of its velocity toward the obstacle is removed. */
+class sdf_collider
+{
+public:
+
+    /** Use a copy of the distance field */
+    void set_field(signed_distance_field const& field);
+    /** Read the distance field from a file written by signed_distance_field::save */
+    void load(std::string const& filename);
+    signed_distance_field const& get_field() const;
+
+    /** Distance kept between the particles and the surface (smaller than the band of the field) */
+    void set_thickness(float thickness);
+    float get_thickness() const;
+
+    /** Project the particles closer than the thickness (fixed particles are not moved) */
+    void collide(particle_store& particles);
+    /** Collision restricted to ranges of particles */
+    void collide(particle_store& particles,std::vector<particle_range> const& ranges);
+
+    /** Number of particles projected during the last collide */
+    int last_contact() const;
+
+private:
+
+    signed_distance_field field;
+    float thickness = 0.005f;
+
+    /** Distance and gradient at each particle */
+    aligned_vector<float> distance;
+    soa_vec3 gradient;
+    int N_contact = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,432 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "self_collision.hpp"
+
+#include "../lib/common/error_handling.hpp"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <omp.h>
+
+namespace cpe
+{
+
+/** Closest point of the triangle (a,b,c) to p, returns its barycentric coordinates (u,v,w) */
+static void closest_point_triangle(vec3 const& p,vec3 const& a,vec3 const& b,vec3 const& c,float& u,float& v,float& w)
+{
+    //Voronoi regions of the vertices, edges and face (Ericson, Real-Time Collision Detection 5.1.5)
+    vec3 const ab = b-a;
+    vec3 const ac = c-a;
+    vec3 const ap = p-a;
+    float const d1 = dot(ab,ap);
+    float const d2 = dot(ac,ap);
+    if(d1<=0.0f && d2<=0.0f) {u=1.0f; v=0.0f; w=0.0f; return;}
+
+    vec3 const bp = p-b;
+    float const d3 = dot(ab,bp);
+    float const d4 = dot(ac,bp);
+    if(d3>=0.0f && d4<=d3) {u=0.0f; v=1.0f; w=0.0f; return;}
+
+    float const vc = d1*d4-d3*d2;
+    if(vc<=0.0f && d1>=0.0f && d3<=0.0f)
+    {
+        float const t = d1/(d1-d3);
+        u=1.0f-t; v=t; w=0.0f; return;
+    }
+
+    vec3 const cp = p-c;
+    float const d5 = dot(ab,cp);
+    float const d6 = dot(ac,cp);
+    if(d6>=0.0f && d5<=d6) {u=0.0f; v=0.0f; w=1.0f; return;}
+
+    float const vb = d5*d2-d1*d6;
+    if(vb<=0.0f && d2>=0.0f && d6<=0.0f)
+    {
+        float const t = d2/(d2-d6);
+        u=1.0f-t; v=0.0f; w=t; return;
+    }
+
+    float const va = d3*d6-d5*d4;
+    if(va<=0.0f && (d4-d3)>=0.0f && (d5-d6)>=0.0f)
+    {
+        float const t = (d4-d3)/((d4-d3)+(d5-d6));
+        u=0.0f; v=1.0f-t; w=t; return;
+    }
+
+    float const denom = 1.0f/(va+vb+vc);
+    v = vb*denom;
+    w = vc*denom;
+    u = 1.0f-v-w;
+}
+
+/** Parameters (s,t) of the closest points p0+s(p1-p0) and q0+t(q1-q0) of two segments */
+static void closest_segment_segment(vec3 const& p0,vec3 const& p1,vec3 const& q0,vec3 const& q1,float& s,float& t)
+{
+    //(Ericson, Real-Time Collision Detection 5.1.9)
+    static float const EPSILON = 1e-12f;
+    vec3 const d1 = p1-p0;
+    vec3 const d2 = q1-q0;
+    vec3 const r = p0-q0;
+    float const a = dot(d1,d1);
+    float const e = dot(d2,d2);
+    float const f = dot(d2,r);
+
+    if(a<=EPSILON && e<=EPSILON) {s=0.0f; t=0.0f; return;}
+    if(a<=EPSILON) {s=0.0f; t=std::min(std::max(f/e,0.0f),1.0f); return;}
+
+    float const c = dot(d1,r);
+    if(e<=EPSILON) {t=0.0f; s=std::min(std::max(-c/a,0.0f),1.0f); return;}
+
+    float const b = dot(d1,d2);
+    float const denom = a*e-b*b;
+    s = denom>EPSILON ? std::min(std::max((b*f-c*e)/denom,0.0f),1.0f) : 0.0f;
+    t = (b*s+f)/e;
+    if(t<0.0f)
+    {
+        t = 0.0f;
+        s = std::min(std::max(-c/a,0.0f),1.0f);
+    }
+    else if(t>1.0f)
+    {
+        t = 1.0f;
+        s = std::min(std::max((b-c)/a,0.0f),1.0f);
+    }
+}
+
+void self_collision::set_thickness(float const value)
+{
+    ASSERT_CPE(value>0,"Thickness should be >0");
+    thickness = value;
+}
+
+float self_collision::get_thickness() const
+{
+    return thickness;
+}
+
+float self_collision::get_cell_size() const
+{
+    return vertex_grid.cell_size();
+}
+
+void self_collision::set_cell_size(float const size)
+{
+    vertex_grid.set_cell_size(size);
+    edge_grid.set_cell_size(size);
+}
+
+void self_collision::set_stiffness(float const k)
+{
+    stiffness = k;
+}
+
+void self_collision::set_damping(float const c)
+{
+    damping = c;
+}
+
+int self_collision::last_point_triangle() const
+{
+    return N_point_triangle;
+}
+
+int self_collision::last_edge_edge() const
+{
+    return N_edge_edge;
+}
+
+void self_collision::set_topology(std::vector<triangle_index> const& triangles_param,int const N_vertex)
+{
+    triangles = triangles_param;
+
+    //edges (a<b) grouped by their first vertex (counting sort), then sorted by
+    // their second vertex in each group: increasing (a,b) order without duplicate
+    std::vector<int> offset(N_vertex+1,0);
+    for(triangle_index const& tri : triangles)
+    {
+        for(int k=0 ; k<3 ; ++k)
+        {
+            int const a = tri[k];
+            int const b = tri[(k+1)%3];
+            ASSERT_CPE(a>=0 && a<N_vertex && b>=0 && b<N_vertex,"Incorrect triangle index");
+            if(a!=b)
+                ++offset[std::min(a,b)+1];
+        }
+    }
+    for(int k=0 ; k<N_vertex ; ++k)
+        offset[k+1] += offset[k];
+
+    std::vector<int> second(offset[N_vertex]);
+    std::vector<int> fill(offset.begin(),offset.end()-1);
+    for(triangle_index const& tri : triangles)
+    {
+        for(int k=0 ; k<3 ; ++k)
+        {
+            int const a = tri[k];
+            int const b = tri[(k+1)%3];
+            if(a!=b)
+                second[fill[std::min(a,b)]++] = std::max(a,b);
+        }
+    }
+
+    edge_a.clear();
+    edge_b.clear();
+    edge_a.reserve(second.size());
+    edge_b.reserve(second.size());
+    for(int a=0 ; a<N_vertex ; ++a)
+    {
+        auto const begin = second.begin()+offset[a];
+        auto const end = second.begin()+offset[a+1];
+        std::sort(begin,end);
+        for(auto it=begin ; it!=end ; ++it)
+        {
+            if(it!=begin && *it==*(it-1))
+                continue;
+            edge_a.push_back(a);
+            edge_b.push_back(*it);
+        }
+    }
+
+    int const N_edge = edge_a.size();
+    edge_min.resize(N_edge);
+    edge_extent.resize(N_edge);
+    edge_box.resize(N_edge);
+}
+
+void self_collision::update_grids(particle_store const& particles)
+{
+    float const* const px = particles.position.x.data();
+    float const* const py = particles.position.y.data();
+    float const* const pz = particles.position.z.data();
+    float* const ex = edge_min.x.data();
+    float* const ey = edge_min.y.data();
+    float* const ez = edge_min.z.data();
+    int const N_edge = edge_a.size();
+
+    double extent_sum = 0.0;
+    #pragma omp parallel for schedule(static) reduction(+:extent_sum)
+    for(int k=0 ; k<N_edge ; ++k)
+    {
+        int const a = edge_a[k];
+        int const b = edge_b[k];
+        ex[k] = std::min(px[a],px[b]);
+        ey[k] = std::min(py[a],py[b]);
+        ez[k] = std::min(pz[a],pz[b]);
+        edge_extent[k] = std::max(std::abs(px[a]-px[b]),std::max(std::abs(py[a]-py[b]),std::abs(pz[a]-pz[b])));
+        edge_box[k] = {ex[k],ey[k],ez[k],std::max(px[a],px[b]),std::max(py[a],py[b]),std::max(pz[a],pz[b])};
+        extent_sum += edge_extent[k];
+    }
+
+    //cells slightly larger than the mean edge: a query covers a few cells per axis.
+    // The size only changes when the edges become too long or too short, so that
+    // the grids can be updated incrementally from one step to the other.
+    float const required = (N_edge>0 ? static_cast<float>(extent_sum/N_edge) : 0.0f)+2.0f*thickness;
+    float const current = vertex_grid.cell_size();
+    if(required>current || required<0.5f*current)
+    {
+        vertex_grid.set_cell_size(1.25f*required);
+        edge_grid.set_cell_size(1.25f*required);
+    }
+    float const cell = edge_grid.cell_size();
+
+    vertex_grid.update(px,py,pz,particles.size());
+    edge_grid.update(ex,ey,ez,N_edge);
+
+    //edges longer than a cell
+    long_edges.clear();
+    long_extent = 0.0f;
+    for(int k=0 ; k<N_edge ; ++k)
+    {
+        if(edge_extent[k]>cell)
+        {
+            long_edges.push_back(k);
+            long_extent = std::max(long_extent,edge_extent[k]);
+        }
+    }
+    int const N_long = long_edges.size();
+    long_edge_min.resize(N_long);
+    for(int k=0 ; k<N_long ; ++k)
+        long_edge_min.set(k,edge_min.get(long_edges[k]));
+    if(N_long>0)
+        long_edge_grid.set_cell_size(long_extent);
+    long_edge_grid.update(long_edge_min.x.data(),long_edge_min.y.data(),long_edge_min.z.data(),N_long);
+}
+
+void self_collision::find_contacts(particle_store const& particles)
+{
+    float const* const px = particles.position.x.data();
+    float const* const py = particles.position.y.data();
+    float const* const pz = particles.position.z.data();
+    auto const position = [px,py,pz](int k){return vec3(px[k],py[k],pz[k]);};
+
+    int const N_triangle = triangles.size();
+    int const N_edge = edge_a.size();
+    float const cell = edge_grid.cell_size();
+    vec3 const cell_margin(cell,cell,cell);
+    vec3 const long_margin(long_extent,long_extent,long_extent);
+
+    //each thread fills its own lists over a static (contiguous) range: the
+    // concatenation of the lists follows the order of a sequential loop
+    int const N_thread_max = omp_get_max_threads();
+    thread_contacts.resize(2*N_thread_max);
+    for(auto& contacts : thread_contacts)
+        contacts.clear();
+
+    #pragma omp parallel
+    {
+        int const thread = omp_get_thread_num();
+
+        //point-triangle
+        std::vector<contact>& point_triangle = thread_contacts[thread];
+        #pragma omp for schedule(static) nowait
+        for(int k_triangle=0 ; k_triangle<N_triangle ; ++k_triangle)
+        {
+            triangle_index const& tri = triangles[k_triangle];
+            int const i0 = tri.u0(), i1 = tri.u1(), i2 = tri.u2();
+            box const bounds = {std::min(px[i0],std::min(px[i1],px[i2]))-thickness,
+                                std::min(py[i0],std::min(py[i1],py[i2]))-thickness,
+                                std::min(pz[i0],std::min(pz[i1],pz[i2]))-thickness,
+                                std::max(px[i0],std::max(px[i1],px[i2]))+thickness,
+                                std::max(py[i0],std::max(py[i1],py[i2]))+thickness,
+                                std::max(pz[i0],std::max(pz[i1],pz[i2]))+thickness};
+
+            vertex_grid.query(vec3(bounds.x0,bounds.y0,bounds.z0),vec3(bounds.x1,bounds.y1,bounds.z1),[&](int const k)
+            {
+                if(!bounds.contains(px[k],py[k],pz[k]))
+                    return;
+                if(k==i0 || k==i1 || k==i2)
+                    return;
+                vec3 const p = position(k);
+                vec3 const a = position(i0);
+                vec3 const b = position(i1);
+                vec3 const c = position(i2);
+                float u,v,w;
+                closest_point_triangle(p,a,b,c,u,v,w);
+                vec3 const d = p-(u*a+v*b+w*c);
+                float const distance = norm(d);
+                if(distance>=thickness)
+                    return;
+
+                vec3 const n = distance>1e-6f ? d/distance : normalized(cross(b-a,c-a));
+                point_triangle.push_back({{k,i0,i1,i2},{1.0f,-u,-v,-w},n,distance});
+            });
+        }
+
+        //edge-edge (closest points inside both edges, edges not sharing a vertex).
+        // The grid of all the edges is queried with a margin of one cell: it gives
+        // every short edge overlapping the box. Pairs with a long edge are found by
+        // the query of the long edge, pairs of long edges in the grid of long edges.
+        std::vector<contact>& edge_edge = thread_contacts[N_thread_max+thread];
+        #pragma omp for schedule(static) nowait
+        for(int e0=0 ; e0<N_edge ; ++e0)
+        {
+            int const a0 = edge_a[e0];
+            int const a1 = edge_b[e0];
+            box const& e0_box = edge_box[e0];
+            box const bounds = {e0_box.x0-thickness,e0_box.y0-thickness,e0_box.z0-thickness,
+                                e0_box.x1+thickness,e0_box.y1+thickness,e0_box.z1+thickness};
+            bool const long_e0 = edge_extent[e0]>cell;
+
+            auto const test = [&](int const e1)
+            {
+                if(!bounds.overlaps(edge_box[e1]))
+                    return;
+                int const b0 = edge_a[e1];
+                int const b1 = edge_b[e1];
+                if(b0==a0 || b0==a1 || b1==a0 || b1==a1)
+                    return;
+
+                vec3 const p0 = position(a0);
+                vec3 const p1 = position(a1);
+                vec3 const q0 = position(b0);
+                vec3 const q1 = position(b1);
+                float s,t;
+                closest_segment_segment(p0,p1,q0,q1,s,t);
+                if(s<=0.0f || s>=1.0f || t<=0.0f || t>=1.0f)
+                    return;
+
+                vec3 const d = (p0+s*(p1-p0))-(q0+t*(q1-q0));
+                float const distance = norm(d);
+                if(distance>=thickness || distance<=1e-6f)
+                    return;
+
+                edge_edge.push_back({{a0,a1,b0,b1},{1.0f-s,s,-(1.0f-t),-t},d/distance,distance});
+            };
+
+            vec3 const box_min(bounds.x0,bounds.y0,bounds.z0);
+            vec3 const box_max(bounds.x1,bounds.y1,bounds.z1);
+            edge_grid.query(box_min-cell_margin,box_max,[&](int const e1)
+            {
+                if((long_e0 || e1>e0) && edge_extent[e1]<=cell)
+                    test(e1);
+            });
+            if(long_e0)
+            {
+                long_edge_grid.query(box_min-long_margin,box_max,[&](int const k)
+                {
+                    if(long_edges[k]>e0)
+                        test(long_edges[k]);
+                });
+            }
+        }
+    }
+
+    N_point_triangle = 0;
+    N_edge_edge = 0;
+    for(int t=0 ; t<N_thread_max ; ++t)
+    {
+        N_point_triangle += thread_contacts[t].size();
+        N_edge_edge += thread_contacts[N_thread_max+t].size();
+    }
+}
+
+void self_collision::add_forces(particle_store& particles)
+{
+    if(triangles.empty())
+        return;
+
+    update_grids(particles);
+    find_contacts(particles);
+
+    float* const fx = particles.force.x.data();
+    float* const fy = particles.force.y.data();
+    float* const fz = particles.force.z.data();
+
+    //the contacts are few compared to the vertices: sequential accumulation
+    for(std::vector<contact> const& contacts : thread_contacts)
+    {
+        for(contact const& c : contacts)
+        {
+            float v_normal = 0.0f;
+            for(int k=0 ; k<4 ; ++k)
+                v_normal += c.weight[k]*dot(particles.velocity.get(c.vertex[k]),c.normal);
+
+            float const f = stiffness*(thickness-c.distance) + (v_normal<0.0f ? -damping*v_normal : 0.0f);
+            for(int k=0 ; k<4 ; ++k)
+            {
+                vec3 const f_k = (c.weight[k]*f)*c.normal;
+                fx[c.vertex[k]] += f_k.x();
+                fy[c.vertex[k]] += f_k.y();
+                fz[c.vertex[k]] += f_k.z();
+            }
+        }
+    }
+}
+
+}
@@ -0,0 +1,137 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef SELF_COLLISION_HPP
+#define SELF_COLLISION_HPP
+
+#include "particle_store.hpp"
+#include "spatial_hash.hpp"
+#include "../lib/mesh/triangle_index.hpp"
+#include <vector>
+
+namespace cpe
+{
+
+/** Repulsion between the parts of a cloth closer than a given thickness.
+ *
+ *  Broadphase: the vertices and the edges (lower corner of their bounding box)
+ *  are stored in spatial_hash grids with cells slightly larger than the mean
+ *  edge. Each triangle queries the vertices around its bounding box, each edge
+ *  the edges around its own. The few edges longer than a cell (stretched
+ *  regions) are also stored in a coarser grid sized by the longest edge, so
+ *  that they do not enlarge the cells of the whole cloth. The cost is linear in
+ *  the size of the cloth as long as the density of vertices per cell stays bounded.
+ *
+ *  Narrowphase: point-triangle and edge-edge closest points. A pair closer than
+ *  the thickness receives opposite forces k.(thickness-d) along the direction
+ *  of the closest points, plus a damping of their approaching velocity. The
+ *  forces are spread over the vertices with the barycentric weights of the
+ *  closest points.
+ *
+ *  The thickness should be smaller than the shortest edge, the vertices of a
+ *  triangle and the edges sharing a vertex are never tested together. This is
+ *  a proximity response: a vertex crossing a triangle during a single step is
+ *  not detected. */
+class self_collision
+{
+public:
+
+    /** Distance under which two parts of the cloth repel each other */
+    void set_thickness(float thickness);
+    float get_thickness() const;
+    /** Stiffness of the repulsion */
+    void set_stiffness(float k);
+    /** Damping of the approaching normal velocity */
+    void set_damping(float c);
+
+    /** Cell size of the broadphase grids, chosen from the mean edge with a hysteresis.
+     *  Given back to a restarted simulation so that it finds its contacts in the same order. */
+    float get_cell_size() const;
+    void set_cell_size(float size);
+
+    /** Set the triangles of the cloth (the edges are extracted from them) */
+    void set_topology(std::vector<triangle_index> const& triangles,int N_vertex);
+
+    /** Add the repulsion forces to the particles */
+    void add_forces(particle_store& particles);
+
+    /** Number of point-triangle and edge-edge pairs closer than the thickness during the last add_forces */
+    int last_point_triangle() const;
+    int last_edge_edge() const;
+
+private:
+
+    /** Axis aligned box on raw floats (tested for every candidate of the broadphase) */
+    struct box
+    {
+        float x0,y0,z0;
+        float x1,y1,z1;
+
+        bool contains(float x,float y,float z) const {return x>=x0 && x<=x1 && y>=y0 && y<=y1 && z>=z0 && z<=z1;}
+        bool overlaps(box const& b) const {return b.x1>=x0 && b.x0<=x1 && b.y1>=y0 && b.y0<=y1 && b.z1>=z0 && b.z0<=z1;}
+    };
+
+    /** Pair of primitives closer than the thickness. The force on vertex[k]
+     *  is weight[k]*f*normal with f the magnitude of the repulsion. */
+    struct contact
+    {
+        int vertex[4];
+        float weight[4];
+        vec3 normal;
+        float distance;
+    };
+
+    /** Update the cell size and the two grids */
+    void update_grids(particle_store const& particles);
+    /** Point-triangle and edge-edge pairs closer than the thickness (in a deterministic order) */
+    void find_contacts(particle_store const& particles);
+
+    float thickness = 0.005f;
+    float stiffness = 20.0f;
+    float damping = 1.0f;
+
+    std::vector<triangle_index> triangles;
+    /** Edges (a<b) of the triangles */
+    std::vector<int> edge_a,edge_b;
+
+    /** Vertices */
+    spatial_hash vertex_grid;
+    /** Lower corner of the bounding box of the edges */
+    spatial_hash edge_grid;
+    soa_vec3 edge_min;
+    /** Largest extent of each edge along one axis, and bounding box */
+    aligned_vector<float> edge_extent;
+    std::vector<box> edge_box;
+    /** Edges longer than a cell of edge_grid, and their lower corner */
+    spatial_hash long_edge_grid;
+    std::vector<int> long_edges;
+    soa_vec3 long_edge_min;
+    /** Largest extent of a long edge */
+    float long_extent = 0.0f;
+
+    /** Contacts found by each thread */
+    std::vector<std::vector<contact> > thread_contacts;
+    int N_point_triangle = 0;
+    int N_edge_edge = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,312 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "simulation_thread.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace cpe
+{
+
+simulation_thread::simulation_thread()
+{}
+
+simulation_thread::~simulation_thread()
+{
+    stop();
+}
+
+void simulation_thread::start(mesh_parametric_cloth const& cloth_param,simulation_parameters const& parameters_param,double const step_duration,int const max_substeps)
+{
+    stop();
+
+    cloth = cloth_param;
+    parameters = parameters_param;
+    clock.set_step_duration(step_duration);
+    clock.set_max_substeps(max_substeps);
+    clock.reset();
+    divergence_flag = false;
+    ++run_index;
+
+    running_flag = true;
+    worker = std::thread(&simulation_thread::run,this);
+}
+
+void simulation_thread::stop()
+{
+    running_flag = false;
+    if(worker.joinable())
+        worker.join();
+    apply_commands();
+    close_recording();
+}
+
+bool simulation_thread::running() const {return running_flag;}
+bool simulation_thread::diverged() const {return divergence_flag;}
+
+void simulation_thread::push(command const& c)
+{
+    std::lock_guard<std::mutex> lock(command_mutex);
+    command_queue.push_back(c);
+}
+
+void simulation_thread::set_k_params(float const k_structural,float const k_shearing,float const k_bending)
+{
+    push([=](mesh_parametric_cloth& m,simulation_parameters&)
+    {
+        m.set_k_struct(k_structural);
+        m.set_k_shear(k_shearing);
+        m.set_k_bend(k_bending);
+    });
+}
+
+void simulation_thread::set_wind(bool const wind)
+{
+    push([=](mesh_parametric_cloth&,simulation_parameters& p){p.wind = wind;});
+}
+
+void simulation_thread::set_wind_force(int const wind_force)
+{
+    push([=](mesh_parametric_cloth&,simulation_parameters& p){p.wind_force = wind_force;});
+}
+
+void simulation_thread::set_sphere(float const radius,vec3 const& center)
+{
+    push([=](mesh_parametric_cloth&,simulation_parameters& p){p.sphere_radius = radius; p.sphere_center = center;});
+}
+
+void simulation_thread::set_integrator(cloth_integrator const type)
+{
+    push([=](mesh_parametric_cloth& m,simulation_parameters&){m.set_integrator(type);});
+}
+
+void simulation_thread::save_checkpoint(std::string const& filename)
+{
+    push([=](mesh_parametric_cloth& m,simulation_parameters&)
+    {
+        try
+        {
+            m.save_checkpoint(filename);
+        }
+        catch(exception_cpe const& e)
+        {
+            std::cout<<std::endl<<e.report_exception()<<std::endl;
+        }
+    });
+}
+
+void simulation_thread::start_recording(std::string const& filename,cloth_cache_info const& format)
+{
+    push([=](mesh_parametric_cloth& m,simulation_parameters& p)
+    {
+        close_recording();
+        cloth_cache_info info = format;
+        info.N_vertex = m.size_vertex();
+        info.size_u = m.size_u();
+        info.size_v = m.size_v();
+        info.dt = p.dt;
+        try
+        {
+            recorder.open(filename,info);
+        }
+        catch(exception_cpe const& e)
+        {
+            std::cout<<std::endl<<e.report_exception()<<std::endl;
+        }
+    });
+}
+
+void simulation_thread::stop_recording()
+{
+    push([=](mesh_parametric_cloth&,simulation_parameters&){close_recording();});
+}
+
+void simulation_thread::record_step()
+{
+    if(!recorder.is_open())
+        return;
+    try
+    {
+        //with the wind, the normals are already those of the current step
+        if(recorder.info().has_normal && !parameters.wind)
+        {
+            cloth.sync_mesh();
+            cloth.sync_normal();
+        }
+        particle_store const& particles = cloth.particle_data();
+        recorder.push_frame(particles.position.x.data(),particles.position.y.data(),particles.position.z.data(),
+                            recorder.info().has_normal ? cloth.pointer_normal() : nullptr);
+    }
+    catch(exception_cpe const& e)
+    {
+        std::cout<<std::endl<<e.report_exception()<<std::endl;
+        close_recording();
+    }
+}
+
+void simulation_thread::close_recording()
+{
+    try
+    {
+        recorder.close();
+    }
+    catch(exception_cpe const& e)
+    {
+        std::cout<<std::endl<<e.report_exception()<<std::endl;
+    }
+}
+
+bool simulation_thread::consume_frame()
+{
+    return frames.update();
+}
+
+cloth_frame const& simulation_thread::frame() const
+{
+    return frames.read_buffer();
+}
+
+double simulation_thread::step_duration() const
+{
+    return clock.step_duration();
+}
+
+void simulation_thread::apply_commands()
+{
+    std::vector<command> pending;
+    {
+        std::lock_guard<std::mutex> lock(command_mutex);
+        pending.swap(command_queue);
+    }
+    for(command const& c : pending)
+        c(cloth,parameters);
+}
+
+/** Clock of the last change of the positions or the normals of a tile
+ *  (the normals of a row depend on the rows before and after it) */
+static long tile_change(sleep_tiles const& tiles,int const t)
+{
+    long motion = tiles.motion(t);
+    if(t>0)
+        motion = std::max(motion,tiles.motion(t-1));
+    if(t+1<tiles.size_tile())
+        motion = std::max(motion,tiles.motion(t+1));
+    return motion;
+}
+
+/** Copy the values value(k) of the tiles changed since the clock stamp */
+template <typename VALUE>
+static void copy_changed_tiles(sleep_tiles const& tiles,long const stamp,VALUE const& value,std::vector<vec3>& destination)
+{
+    int const N_tile = tiles.size_tile();
+    for(int t=0 ; t<N_tile ; ++t)
+    {
+        if(tile_change(tiles,t)<stamp)
+            continue;
+        int const end = tiles.tile_end(t);
+        for(int k=tiles.tile_begin(t) ; k<end ; ++k)
+            destination[k] = value(k);
+    }
+}
+
+void simulation_thread::run()
+{
+    long step = 0;
+    while(running_flag)
+    {
+        apply_commands();
+
+        int const N_step = divergence_flag ? 0 : clock.advance();
+        if(N_step>0)
+        {
+            cloth_frame& f = frames.write_buffer();
+            sleep_tiles const& tiles = cloth.get_sleep_tiles();
+            particle_store const& particles = cloth.particle_data();
+            auto const position_value = [&](int k) {return particles.position.get(k);};
+            auto const normal_value = [&](int k) {return cloth.normal(k%cloth.size_u(),k/cloth.size_u());};
+            int const N = cloth.size_vertex();
+            //a buffer of another run (or never written) is fully copied
+            bool const full = f.run!=run_index || static_cast<int>(f.position.size())!=N;
+            if(full)
+            {
+                f.position.resize(N);
+                f.previous_position.resize(N);
+                f.normal.resize(N);
+                f.clock = -1;
+            }
+
+            try
+            {
+                for(int k_step=0 ; k_step<N_step ; ++k_step)
+                {
+                    if(k_step==N_step-1)
+                        copy_changed_tiles(tiles,f.clock,position_value,f.previous_position);
+
+                    cloth.update_force(parameters.ground,parameters.wind,parameters.wind_force,
+                                       parameters.sphere_radius,parameters.sphere_center);
+                    cloth.integration_step(parameters.dt);
+
+                    //the wind of the next step depends on the normals of this one
+                    if(parameters.wind)
+                    {
+                        cloth.sync_mesh();
+                        cloth.sync_normal();
+                    }
+                    record_step();
+                    ++step;
+                }
+
+                if(!parameters.wind)
+                {
+                    cloth.sync_mesh();
+                    cloth.sync_normal();
+                }
+
+                copy_changed_tiles(tiles,f.clock,position_value,f.position);
+                copy_changed_tiles(tiles,f.clock,normal_value,f.normal);
+
+                int const N_tile = tiles.size_tile();
+                f.tile_offset.resize(N_tile+1);
+                f.tile_motion.resize(N_tile);
+                for(int t=0 ; t<N_tile ; ++t)
+                {
+                    f.tile_offset[t] = tiles.tile_begin(t);
+                    f.tile_motion[t] = tile_change(tiles,t);
+                }
+                f.tile_offset[N_tile] = N;
+                f.clock = tiles.clock();
+                f.run = run_index;
+                f.step = step;
+                f.time = std::chrono::steady_clock::now();
+                frames.publish();
+            }
+            catch(exception_divergence const&)
+            {
+                std::cout<<"\n\nDivergence, time integration stoped"<<std::endl;
+                divergence_flag = true;
+            }
+        }
+
+        //wait for the next step
+        double const remaining = (1.0-clock.alpha())*clock.step_duration();
+        std::this_thread::sleep_for(std::chrono::duration<double>(remaining));
+    }
+}
+
+}
@@ -0,0 +1,163 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef SIMULATION_THREAD_HPP
+#define SIMULATION_THREAD_HPP
+
+#include "mesh_parametric_cloth.hpp"
+#include "cloth_cache.hpp"
+#include "triple_buffer.hpp"
+#include "../lib/common/fixed_step_clock.hpp"
+#include "../lib/3d/vec3.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cpe
+{
+
+/** Parameters of the environment of the cloth used by update_force */
+struct simulation_parameters
+{
+    /** Height of the ground */
+    float ground = -1.101f;
+    bool wind = false;
+    int wind_force = 25;
+    float sphere_radius = 0.198f;
+    vec3 sphere_center = vec3(0.5f,0.05f,-1.1f);
+    /** Time step of the integration */
+    float dt = 0.15f;
+};
+
+/** State of the cloth published after a group of time steps */
+struct cloth_frame
+{
+    /** Positions after the last step */
+    std::vector<vec3> position;
+    /** Positions before the last step (rendering interpolation) */
+    std::vector<vec3> previous_position;
+    /** Normals after the last step */
+    std::vector<vec3> normal;
+    /** Number of steps computed since the start */
+    long step = 0;
+    /** Vertices of tile t are in [tile_offset[t],tile_offset[t+1]) (sleep tiles of the cloth) */
+    std::vector<int> tile_offset;
+    /** Clock of the last step during which the positions or the normals of each tile changed */
+    std::vector<long> tile_motion;
+    /** Clock of the sleep tiles when the frame was written */
+    long clock = -1;
+    /** Index of the simulation run (the clocks of two runs are not comparable) */
+    int run = -1;
+    /** Real time at which the last step was computed */
+    std::chrono::steady_clock::time_point time;
+};
+
+/** Run the time integration of a cloth on a dedicated thread.
+ *  The steps are paced by a fixed_step_clock, the finished frames are handed
+ *  to the renderer through a lock-free triple buffer. The cloth is only
+ *  accessed by the simulation thread once started: the parameters are changed
+ *  through a command queue applied between two steps.
+ *  Only the tiles of the cloth moved since a buffer was last written are
+ *  copied into it: a cloth at rest (see cloth_solver::set_sleeping) costs
+ *  almost nothing.
+ *  The steps can also be recorded in a cloth cache: the frames are only
+ *  copied by the simulation thread, the cache writes them on its own thread. */
+class simulation_thread
+{
+public:
+
+    /** Command applied by the simulation thread on the cloth and its environment */
+    typedef std::function<void(mesh_parametric_cloth&,simulation_parameters&)> command;
+
+    simulation_thread();
+    ~simulation_thread();
+    simulation_thread(simulation_thread const&) = delete;
+    simulation_thread& operator=(simulation_thread const&) = delete;
+
+    /** Start the simulation of a copy of the cloth (stop the current one if any) */
+    void start(mesh_parametric_cloth const& cloth,simulation_parameters const& parameters,double step_duration=0.025,int max_substeps=4);
+    /** Stop and join the simulation thread, the pending commands are applied
+     *  (a checkpoint asked before a restart is written) */
+    void stop();
+    bool running() const;
+    /** True when the simulation stopped because of a divergence */
+    bool diverged() const;
+
+    /** Queue a command, applied before the next step (thread safe) */
+    void push(command const& c);
+    void set_k_params(float k_structural,float k_shearing,float k_bending);
+    void set_wind(bool wind);
+    void set_wind_force(int wind_force);
+    void set_sphere(float radius,vec3 const& center);
+    void set_integrator(cloth_integrator type);
+    /** Write the state of the simulated cloth in a checkpoint file between two steps */
+    void save_checkpoint(std::string const& filename);
+    /** Record every following step in a cloth cache. The normals, chunk size,
+     *  codec and tolerances are taken from format (the size of the cloth and
+     *  the time step are filled by the simulation) */
+    void start_recording(std::string const& filename,cloth_cache_info const& format);
+    /** Close the current recording, if any */
+    void stop_recording();
+
+    /** Take the last published frame (consumer side, never blocks). Returns false if no new frame */
+    bool consume_frame();
+    /** Last frame taken by consume_frame (empty before the first frame) */
+    cloth_frame const& frame() const;
+    /** Real time duration of one step */
+    double step_duration() const;
+
+private:
+
+    /** Loop of the simulation thread */
+    void run();
+    /** Apply the queued commands */
+    void apply_commands();
+    /** Append the current state of the cloth to the recording */
+    void record_step();
+    /** Close the recording, reporting its errors */
+    void close_recording();
+
+    mesh_parametric_cloth cloth;
+    simulation_parameters parameters;
+    fixed_step_clock clock;
+
+    std::thread worker;
+    std::atomic<bool> running_flag{false};
+    std::atomic<bool> divergence_flag{false};
+
+    std::mutex command_mutex;
+    std::vector<command> command_queue;
+
+    triple_buffer<cloth_frame> frames;
+    /** Used by the simulation thread only (and by stop once joined) */
+    cloth_recorder recorder;
+
+    /** Incremented at each start */
+    int run_index = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,410 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sleep_tiles.hpp"
+
+#include "../lib/common/error_handling.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace cpe
+{
+
+sleep_tiles::sleep_tiles()
+    :velocity_threshold(2e-3f),acceleration_threshold(2e-3f),wake_distance(1e-3f),sleep_steps(30)
+{}
+
+void sleep_tiles::set_tiles(int const N_particle_param,int const tile_size_param)
+{
+    ASSERT_CPE(N_particle_param>=0 && tile_size_param>0,"Incorrect tile size");
+    N_particle = N_particle_param;
+    size_per_tile = tile_size_param;
+    N_tile = (N_particle+size_per_tile-1)/size_per_tile;
+
+    ++clock_value;
+    awake_flag.assign(N_tile,1);
+    rest_steps.assign(N_tile,0);
+    motion_clock.assign(N_tile,clock_value);
+    center.assign(N_tile,vec3());
+    radius.assign(N_tile,0.0f);
+    update_ranges();
+}
+
+int sleep_tiles::size_tile() const
+{
+    return N_tile;
+}
+
+int sleep_tiles::tile_size() const
+{
+    return size_per_tile;
+}
+
+int sleep_tiles::tile_begin(int const tile) const
+{
+    ASSERT_CPE(tile>=0 && tile<N_tile,"Incorrect tile index");
+    return tile*size_per_tile;
+}
+
+int sleep_tiles::tile_end(int const tile) const
+{
+    ASSERT_CPE(tile>=0 && tile<N_tile,"Incorrect tile index");
+    return std::min((tile+1)*size_per_tile,N_particle);
+}
+
+int sleep_tiles::tile(int const particle) const
+{
+    return particle/size_per_tile;
+}
+
+bool sleep_tiles::awake(int const tile) const
+{
+    ASSERT_CPE(tile>=0 && tile<N_tile,"Incorrect tile index");
+    return awake_flag[tile]!=0;
+}
+
+int sleep_tiles::size_awake() const
+{
+    return N_awake;
+}
+
+std::vector<particle_range> const& sleep_tiles::awake_ranges() const
+{
+    return ranges;
+}
+
+void sleep_tiles::wake(int const tile)
+{
+    ASSERT_CPE(tile>=0 && tile<N_tile,"Incorrect tile index");
+    if(awake_flag[tile])
+        return;
+    awake_flag[tile] = 1;
+    rest_steps[tile] = 0;
+    update_ranges();
+}
+
+void sleep_tiles::wake_all()
+{
+    awake_flag.assign(N_tile,1);
+    rest_steps.assign(N_tile,0);
+    update_ranges();
+}
+
+vec3 const& sleep_tiles::bound_center(int const tile) const
+{
+    ASSERT_CPE(tile>=0 && tile<N_tile,"Incorrect tile index");
+    return center[tile];
+}
+
+float sleep_tiles::bound_radius(int const tile) const
+{
+    ASSERT_CPE(tile>=0 && tile<N_tile,"Incorrect tile index");
+    return radius[tile];
+}
+
+void sleep_tiles::set_velocity_threshold(float const v)
+{
+    ASSERT_CPE(v>=0.0f,"Threshold should be >=0");
+    velocity_threshold = v;
+}
+
+float sleep_tiles::get_velocity_threshold() const
+{
+    return velocity_threshold;
+}
+
+void sleep_tiles::set_acceleration_threshold(float const a)
+{
+    ASSERT_CPE(a>=0.0f,"Threshold should be >=0");
+    acceleration_threshold = a;
+}
+
+float sleep_tiles::get_acceleration_threshold() const
+{
+    return acceleration_threshold;
+}
+
+void sleep_tiles::set_wake_distance(float const d)
+{
+    ASSERT_CPE(d>0.0f,"Distance should be >0");
+    wake_distance = d;
+}
+
+float sleep_tiles::get_wake_distance() const
+{
+    return wake_distance;
+}
+
+void sleep_tiles::set_sleep_steps(int const N)
+{
+    ASSERT_CPE(N>0,"Number of steps should be >0");
+    sleep_steps = N;
+}
+
+int sleep_tiles::get_sleep_steps() const
+{
+    return sleep_steps;
+}
+
+long sleep_tiles::clock() const
+{
+    return clock_value;
+}
+
+long sleep_tiles::motion(int const tile) const
+{
+    ASSERT_CPE(tile>=0 && tile<N_tile,"Incorrect tile index");
+    return motion_clock[tile];
+}
+
+long sleep_tiles::revision() const
+{
+    return revision_value;
+}
+
+void sleep_tiles::begin_step(particle_store& particles)
+{
+    ASSERT_CPE(particles.size()==N_particle,"Incorrect number of particles");
+    previous_velocity.resize(N_particle);
+
+    float const* const vx = particles.velocity.x.data();
+    float const* const vy = particles.velocity.y.data();
+    float const* const vz = particles.velocity.z.data();
+    float* const px = previous_velocity.x.data();
+    float* const py = previous_velocity.y.data();
+    float* const pz = previous_velocity.z.data();
+
+    for(particle_range const& r : ranges)
+    {
+        std::copy(vx+r.begin,vx+r.end,px+r.begin);
+        std::copy(vy+r.begin,vy+r.end,py+r.begin);
+        std::copy(vz+r.begin,vz+r.end,pz+r.begin);
+    }
+
+    //the springs of the boundary add forces on the sleeping particles, never cleared by the gravity
+    float* const fx = particles.force.x.data();
+    float* const fy = particles.force.y.data();
+    float* const fz = particles.force.z.data();
+    for(boundary_link const& link : boundary)
+    {
+        int const k = link.sleeping_particle;
+        fx[k] = 0.0f;
+        fy[k] = 0.0f;
+        fz[k] = 0.0f;
+    }
+}
+
+void sleep_tiles::end_step(particle_store& particles,float const dt)
+{
+    ASSERT_CPE(particles.size()==N_particle && previous_velocity.size()==N_particle,"Incorrect number of particles");
+    ++clock_value;
+
+    float const* const vx = particles.velocity.x.data();
+    float const* const vy = particles.velocity.y.data();
+    float const* const vz = particles.velocity.z.data();
+    float const* const px = previous_velocity.x.data();
+    float const* const py = previous_velocity.y.data();
+    float const* const pz = previous_velocity.z.data();
+
+    float const v2_max = velocity_threshold*velocity_threshold;
+    float const dv_max = acceleration_threshold*dt;
+    float const dv2_max = dv_max*dv_max;
+
+    //rest test of the awake tiles (largest speed and change of velocity of the tile)
+    #pragma omp parallel for schedule(static)
+    for(int t=0 ; t<N_tile ; ++t)
+    {
+        if(!awake_flag[t])
+            continue;
+        motion_clock[t] = clock_value;
+
+        int const begin = t*size_per_tile;
+        int const end = std::min(begin+size_per_tile,N_particle);
+        float v2 = 0.0f, dv2 = 0.0f;
+        #pragma omp simd reduction(max:v2,dv2)
+        for(int k=begin ; k<end ; ++k)
+        {
+            float const dx = vx[k]-px[k], dy = vy[k]-py[k], dz = vz[k]-pz[k];
+            v2 = std::max(v2,vx[k]*vx[k]+vy[k]*vy[k]+vz[k]*vz[k]);
+            dv2 = std::max(dv2,dx*dx+dy*dy+dz*dz);
+        }
+        rest_steps[t] = (v2<=v2_max && dv2<=dv2_max) ? rest_steps[t]+1 : 0;
+    }
+
+    bool changed = false;
+
+    //sleeping tiles disturbed by a neighbor moving faster than twice the threshold or drifting away
+    float const* const x = particles.position.x.data();
+    float const* const y = particles.position.y.data();
+    float const* const z = particles.position.z.data();
+    float const wake2 = 4.0f*v2_max;
+    float const drift2 = wake_distance*wake_distance;
+    for(boundary_link const& link : boundary)
+    {
+        int const k = link.particle;
+        if(awake_flag[link.tile])
+            continue;
+        float const dx = x[k]-link.reference.x(), dy = y[k]-link.reference.y(), dz = z[k]-link.reference.z();
+        if(vx[k]*vx[k]+vy[k]*vy[k]+vz[k]*vz[k]>wake2 || dx*dx+dy*dy+dz*dz>drift2)
+        {
+            awake_flag[link.tile] = 1;
+            rest_steps[link.tile] = 0;
+            changed = true;
+        }
+    }
+
+    for(int t=0 ; t<N_tile ; ++t)
+    {
+        if(awake_flag[t] && rest_steps[t]>=sleep_steps)
+        {
+            put_to_sleep(t,particles);
+            changed = true;
+        }
+    }
+
+    if(changed)
+        update_ranges();
+}
+
+void sleep_tiles::advance()
+{
+    ++clock_value;
+    for(int t=0 ; t<N_tile ; ++t)
+    {
+        if(awake_flag[t])
+        {
+            motion_clock[t] = clock_value;
+            rest_steps[t] = 0;
+        }
+    }
+}
+
+void sleep_tiles::put_to_sleep(int const tile,particle_store& particles)
+{
+    int const begin = tile_begin(tile);
+    int const end = tile_end(tile);
+
+    float* const vx = particles.velocity.x.data();
+    float* const vy = particles.velocity.y.data();
+    float* const vz = particles.velocity.z.data();
+    std::fill(vx+begin,vx+end,0.0f);
+    std::fill(vy+begin,vy+end,0.0f);
+    std::fill(vz+begin,vz+end,0.0f);
+
+    float const* const x = particles.position.x.data();
+    float const* const y = particles.position.y.data();
+    float const* const z = particles.position.z.data();
+    vec3 p_min = particles.position.get(begin);
+    vec3 p_max = p_min;
+    for(int k=begin ; k<end ; ++k)
+    {
+        p_min = vec3(std::min(p_min.x(),x[k]),std::min(p_min.y(),y[k]),std::min(p_min.z(),z[k]));
+        p_max = vec3(std::max(p_max.x(),x[k]),std::max(p_max.y(),y[k]),std::max(p_max.z(),z[k]));
+    }
+    center[tile] = (p_min+p_max)/2.0f;
+    radius[tile] = norm(p_max-p_min)/2.0f;
+
+    awake_flag[tile] = 0;
+    rest_steps[tile] = 0;
+}
+
+void sleep_tiles::update_ranges()
+{
+    ranges.clear();
+    N_awake = 0;
+    for(int t=0 ; t<N_tile ; ++t)
+    {
+        if(!awake_flag[t])
+            continue;
+        ++N_awake;
+        int const begin = t*size_per_tile;
+        int const end = std::min(begin+size_per_tile,N_particle);
+        if(!ranges.empty() && ranges.back().end==begin)
+            ranges.back().end = end;
+        else
+            ranges.push_back({begin,end});
+    }
+    ++revision_value;
+}
+
+/** Order of the boundary links (awake then sleeping extremity) */
+static bool link_order(int const a0,int const a1,int const b0,int const b1)
+{
+    return a0<b0 || (a0==b0 && a1<b1);
+}
+
+void sleep_tiles::filter_springs(std::vector<spring> const& springs,std::vector<int> const& batch_offset,particle_store const& particles)
+{
+    ASSERT_CPE(batch_offset.size()>0 && batch_offset.back()==static_cast<int>(springs.size()),"Incorrect spring batches");
+
+    spring_awake.clear();
+    spring_awake_batch.clear();
+    std::vector<boundary_link> previous;
+    previous.swap(boundary);
+
+    //a subset of a batch still shares no vertex: the batches are kept
+    int const N_batch = static_cast<int>(batch_offset.size())-1;
+    for(int b=0 ; b<N_batch ; ++b)
+    {
+        spring_awake_batch.push_back(spring_awake.size());
+        for(int k=batch_offset[b] ; k<batch_offset[b+1] ; ++k)
+        {
+            spring const& s = springs[k];
+            int const ti = tile(s.i);
+            int const tj = tile(s.j);
+            bool const ai = awake_flag[ti]!=0;
+            bool const aj = awake_flag[tj]!=0;
+            if(ai || aj)
+                spring_awake.push_back(s);
+            if(ai && !aj)
+                boundary.push_back({s.i,s.j,tj,vec3()});
+            if(aj && !ai)
+                boundary.push_back({s.j,s.i,ti,vec3()});
+        }
+    }
+    spring_awake_batch.push_back(spring_awake.size());
+
+    //the links already present keep their reference position (the drift accumulates)
+    auto const order = [](boundary_link const& a,boundary_link const& b) {return link_order(a.particle,a.sleeping_particle,b.particle,b.sleeping_particle);};
+    std::sort(boundary.begin(),boundary.end(),order);
+    for(boundary_link& link : boundary)
+    {
+        auto const it = std::lower_bound(previous.begin(),previous.end(),link,order);
+        bool const found = it!=previous.end() && it->particle==link.particle && it->sleeping_particle==link.sleeping_particle;
+        link.reference = found ? it->reference : particles.position.get(link.particle);
+    }
+
+    spring_revision = revision_value;
+}
+
+bool sleep_tiles::springs_outdated() const
+{
+    return spring_revision!=revision_value;
+}
+
+std::vector<spring> const& sleep_tiles::awake_springs() const
+{
+    return spring_awake;
+}
+
+std::vector<int> const& sleep_tiles::awake_batch_offset() const
+{
+    return spring_awake_batch;
+}
+
+}
@@ -0,0 +1,162 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef SLEEP_TILES_HPP
+#define SLEEP_TILES_HPP
+
+#include "particle_store.hpp"
+#include "spring.hpp"
+#include "../lib/3d/vec3.hpp"
+#include <vector>
+
+namespace cpe
+{
+
+/** Deactivation of the parts of the cloth at rest.
+ *
+ *  The particles are grouped in tiles of consecutive indices (strips of rows
+ *  for the grid cloth). A tile falls asleep when, during a given number of
+ *  consecutive steps, the speed of all its particles and their change of
+ *  velocity over a step (force residual, contacts included) stay below
+ *  thresholds. Its velocities are then set to zero and the solver skips it
+ *  (forces, collisions, integration, mesh updates) until it is woken up: by a
+ *  particle linked to it by a spring moving faster than twice the speed
+ *  threshold or drifting further than a distance since the tile fell asleep
+ *  (slow creep), by a collider moving close to it, or explicitly.
+ *
+ *  A clock is incremented at each step and each tile stores the clock of the
+ *  last step during which it moved: the consumers of the positions (mesh,
+ *  normals, rendering) only update the tiles moved since their last update. */
+class sleep_tiles
+{
+public:
+
+    sleep_tiles();
+
+    /** Split N particles in tiles of tile_size consecutive particles (all awake and moved) */
+    void set_tiles(int N_particle,int tile_size);
+    /** Number of tiles */
+    int size_tile() const;
+    /** Number of particles per tile (the last tile may be smaller) */
+    int tile_size() const;
+    /** Particles of a tile are in [tile_begin,tile_end) */
+    int tile_begin(int tile) const;
+    int tile_end(int tile) const;
+    /** Tile of a particle */
+    int tile(int particle) const;
+
+    bool awake(int tile) const;
+    int size_awake() const;
+    /** Consecutive awake tiles merged in ranges of particles */
+    std::vector<particle_range> const& awake_ranges() const;
+    void wake(int tile);
+    void wake_all();
+    /** Bounding sphere of a sleeping tile */
+    vec3 const& bound_center(int tile) const;
+    float bound_radius(int tile) const;
+
+    /** Speed under which a particle is considered at rest (default 2e-3) */
+    void set_velocity_threshold(float v);
+    float get_velocity_threshold() const;
+    /** Change of velocity per unit of time under which a particle is considered at rest (default 2e-3) */
+    void set_acceleration_threshold(float a);
+    float get_acceleration_threshold() const;
+    /** Displacement of a neighbor waking a sleeping tile up (default 1e-3) */
+    void set_wake_distance(float d);
+    float get_wake_distance() const;
+    /** Number of consecutive steps at rest before a tile falls asleep (default 30) */
+    void set_sleep_steps(int N);
+    int get_sleep_steps() const;
+
+    /** Clock of the last step */
+    long clock() const;
+    /** Clock of the last step during which the tile moved */
+    long motion(int tile) const;
+    /** Incremented each time the set of awake tiles changes */
+    long revision() const;
+
+    /** Store the velocities of the awake particles and clear the forces of the
+     *  sleeping particles linked to them by a spring (called before the forces) */
+    void begin_step(particle_store& particles);
+    /** Advance the clock after an integration step: put to sleep the tiles at rest
+     *  for long enough, wake the tiles disturbed through the springs */
+    void end_step(particle_store& particles,float dt);
+    /** Advance the clock without sleep detection (all the awake tiles moved) */
+    void advance();
+
+    /** Keep the springs having an awake extremity, sorted in the same batches.
+     *  Must be called again when revision() changes. */
+    void filter_springs(std::vector<spring> const& springs,std::vector<int> const& batch_offset,particle_store const& particles);
+    /** True if the awake tiles changed since the last filter_springs */
+    bool springs_outdated() const;
+    std::vector<spring> const& awake_springs() const;
+    std::vector<int> const& awake_batch_offset() const;
+
+private:
+
+    /** Zero the velocities of the tile and compute its bounding sphere */
+    void put_to_sleep(int tile,particle_store& particles);
+    /** Merge the awake tiles in ranges, increment the revision */
+    void update_ranges();
+
+    int N_particle = 0;
+    int size_per_tile = 1;
+    int N_tile = 0;
+
+    std::vector<char> awake_flag;
+    /** Number of consecutive steps at rest of each tile */
+    std::vector<int> rest_steps;
+    std::vector<long> motion_clock;
+    std::vector<vec3> center;
+    std::vector<float> radius;
+    std::vector<particle_range> ranges;
+    int N_awake = 0;
+
+    /** Velocities at the beginning of the step */
+    soa_vec3 previous_velocity;
+
+    std::vector<spring> spring_awake;
+    std::vector<int> spring_awake_batch;
+    /** Springs between an awake particle and a sleeping tile */
+    struct boundary_link
+    {
+        /** Awake extremity */
+        int particle;
+        /** Sleeping extremity and its tile */
+        int sleeping_particle;
+        int tile;
+        /** Position of the awake extremity when the link appeared */
+        vec3 reference;
+    };
+    std::vector<boundary_link> boundary;
+
+    float velocity_threshold;
+    float acceleration_threshold;
+    float wake_distance;
+    int sleep_steps;
+
+    long clock_value = 0;
+    long revision_value = 0;
+    long spring_revision = -1;
+};
+
+}
+
+#endif
@@ -0,0 +1,193 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "spatial_hash.hpp"
+
+#include "../lib/common/error_handling.hpp"
+#include <algorithm>
+#include <omp.h>
+
+namespace cpe
+{
+
+void spatial_hash::set_cell_size(float const size)
+{
+    ASSERT_CPE(size>0,"Cell size should be >0");
+    if(size!=cell)
+    {
+        cell = size;
+        inv_cell = 1.0f/size;
+        rebuild = true;
+    }
+}
+
+float spatial_hash::cell_size() const
+{
+    return cell;
+}
+
+int spatial_hash::size() const
+{
+    return entries.size();
+}
+
+int spatial_hash::last_sorted() const
+{
+    return N_sorted;
+}
+
+void spatial_hash::update(float const* const x,float const* const y,float const* const z,int const N)
+{
+    //at least twice more buckets than points
+    int bits = 1;
+    while((int64_t(1)<<bits) < 2*int64_t(N))
+        ++bits;
+    if(N!=static_cast<int>(entries.size()) || bits!=bucket_bits)
+        rebuild = true;
+    bucket_bits = bits;
+
+    if(rebuild)
+    {
+        entries.resize(N);
+        #pragma omp parallel for schedule(static)
+        for(int k=0 ; k<N ; ++k)
+        {
+            uint64_t const code = cell_code(cell_coordinate(x[k]),cell_coordinate(y[k]),cell_coordinate(z[k]));
+            entries[k] = {bucket_of(code),k,code};
+        }
+        radix_sort();
+        N_sorted = N;
+    }
+    else
+    {
+        //new cell of the points, in the previous order
+        buffer.resize(N);
+        #pragma omp parallel for schedule(static)
+        for(int i=0 ; i<N ; ++i)
+        {
+            int const k = entries[i].index;
+            uint64_t const code = cell_code(cell_coordinate(x[k]),cell_coordinate(y[k]),cell_coordinate(z[k]));
+            buffer[i] = {bucket_of(code),k,code};
+        }
+
+        //the points which kept their bucket are still sorted
+        changed.clear();
+        int N_kept = 0;
+        for(int i=0 ; i<N ; ++i)
+        {
+            if(buffer[i].bucket==entries[i].bucket)
+                buffer[N_kept++] = buffer[i];
+            else
+                changed.push_back(buffer[i]);
+        }
+        N_sorted = changed.size();
+
+        //same order as a rebuild (by bucket then by index): the order of the
+        // queries does not depend on the previous updates
+        auto const by_bucket_index = [](entry const& a,entry const& b)
+        {return a.bucket<b.bucket || (a.bucket==b.bucket && a.index<b.index);};
+        if(4*N_sorted > N)
+        {
+            //too many changes: complete (stable) sort of the points in index order
+            for(int i=0 ; i<N_kept ; ++i)
+                entries[buffer[i].index] = buffer[i];
+            for(entry const& e : changed)
+                entries[e.index] = e;
+            radix_sort();
+            N_sorted = N;
+        }
+        else
+        {
+            std::sort(changed.begin(),changed.end(),by_bucket_index);
+            std::merge(buffer.begin(),buffer.begin()+N_kept,changed.begin(),changed.end(),entries.begin(),by_bucket_index);
+        }
+    }
+
+    build_bucket_offset();
+    rebuild = false;
+}
+
+void spatial_hash::radix_sort()
+{
+    int const N = entries.size();
+    buffer.resize(N);
+
+    static int const RADIX_BITS = 8;
+    static int const RADIX = 1<<RADIX_BITS;
+    int const N_pass = (bucket_bits+RADIX_BITS-1)/RADIX_BITS;
+    std::vector<int> histogram(omp_get_max_threads()*RADIX);
+
+    for(int pass=0 ; pass<N_pass ; ++pass)
+    {
+        int const shift = pass*RADIX_BITS;
+
+        //stable counting sort on one digit: each thread counts its chunk,
+        // then scatters it after the chunks of the previous threads
+        #pragma omp parallel
+        {
+            int const thread = omp_get_thread_num();
+            int const N_thread = omp_get_num_threads();
+            int const begin = (static_cast<int64_t>(N)*thread)/N_thread;
+            int const end = (static_cast<int64_t>(N)*(thread+1))/N_thread;
+            int* const count = &histogram[thread*RADIX];
+
+            std::fill(count,count+RADIX,0);
+            for(int k=begin ; k<end ; ++k)
+                ++count[(entries[k].bucket>>shift)&(RADIX-1)];
+
+            #pragma omp barrier
+            #pragma omp single
+            {
+                int offset = 0;
+                for(int d=0 ; d<RADIX ; ++d)
+                {
+                    for(int t=0 ; t<N_thread ; ++t)
+                    {
+                        int const c = histogram[t*RADIX+d];
+                        histogram[t*RADIX+d] = offset;
+                        offset += c;
+                    }
+                }
+            }
+
+            for(int k=begin ; k<end ; ++k)
+                buffer[count[(entries[k].bucket>>shift)&(RADIX-1)]++] = entries[k];
+        }
+
+        entries.swap(buffer);
+    }
+}
+
+void spatial_hash::build_bucket_offset()
+{
+    int const N = entries.size();
+    int const N_bucket = 1<<bucket_bits;
+    bucket_offset.resize(N_bucket+1);
+
+    //the buckets in (bucket of entry k-1 , bucket of entry k] begin at k
+    #pragma omp parallel for schedule(static)
+    for(int k=0 ; k<=N ; ++k)
+    {
+        int const b_begin = k==0 ? 0 : static_cast<int>(entries[k-1].bucket)+1;
+        int const b_end = k==N ? N_bucket : static_cast<int>(entries[k].bucket);
+        for(int b=b_begin ; b<=b_end ; ++b)
+            bucket_offset[b] = k;
+    }
+}
+
+}
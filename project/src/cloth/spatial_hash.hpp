@@ -0,0 +1,147 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef SPATIAL_HASH_HPP
+#define SPATIAL_HASH_HPP
+
+#include "../lib/3d/vec3.hpp"
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace cpe
+{
+
+/** Uniform grid of cubic cells stored as a sorted cell list.
+ *
+ *  Each point is associated to the cell containing it, the cells are hashed
+ *  in a table of 2^n buckets (at least twice the number of points) and the
+ *  points are sorted by bucket (parallel radix sort), so that the points of a
+ *  cell are contiguous (in increasing index order, whatever the previous
+ *  updates). Memory and build time are linear in the number of points.
+ *
+ *  Between two steps of a simulation, few points change of cell: when the
+ *  number of points is unchanged, update() reuses the previous order and only
+ *  sorts the points which changed of bucket before merging them back. */
+class spatial_hash
+{
+public:
+
+    /** Size of the cells (a change forces a complete rebuild at the next update) */
+    void set_cell_size(float size);
+    float cell_size() const;
+
+    /** Set the N points (x[k],y[k],z[k]) of the grid */
+    void update(float const* x,float const* y,float const* z,int N);
+    /** Number of points */
+    int size() const;
+    /** Number of points sorted by the last update (changed of bucket, or all of them after a rebuild) */
+    int last_sorted() const;
+
+    /** Call f(k) for every point k in the cells overlapping the box [p_min,p_max] */
+    template <typename FUNCTION>
+    void query(vec3 const& p_min,vec3 const& p_max,FUNCTION f) const;
+
+private:
+
+    /** A point in the sorted cell list */
+    struct entry
+    {
+        /** Bucket of the cell (sort key) */
+        uint32_t bucket;
+        /** Index of the point */
+        int index;
+        /** Packed integer coordinates of the cell */
+        uint64_t cell;
+    };
+
+    /** Integer coordinate of the cell containing the value v along one axis */
+    int cell_coordinate(float v) const;
+    /** Packed coordinates of the cell (ix,iy,iz) (21 bits each) */
+    static uint64_t cell_code(int ix,int iy,int iz);
+    /** Bucket of a cell (multiplicative hash) */
+    uint32_t bucket_of(uint64_t cell) const;
+
+    /** Sort all the entries by bucket */
+    void radix_sort();
+    /** Compute the beginning of each bucket in the sorted entries */
+    void build_bucket_offset();
+
+    float cell = 1.0f;
+    float inv_cell = 1.0f;
+    /** log2 of the number of buckets */
+    int bucket_bits = 0;
+    /** True if the next update must sort all the points */
+    bool rebuild = true;
+    int N_sorted = 0;
+
+    /** Points sorted by bucket */
+    std::vector<entry> entries;
+    /** Work buffers of the sort */
+    std::vector<entry> buffer,changed;
+    /** Entries of bucket b are in [bucket_offset[b],bucket_offset[b+1]) */
+    std::vector<int> bucket_offset;
+};
+
+inline int spatial_hash::cell_coordinate(float const v) const
+{
+    return static_cast<int>(std::floor(v*inv_cell));
+}
+
+inline uint64_t spatial_hash::cell_code(int const ix,int const iy,int const iz)
+{
+    uint64_t const mask = (uint64_t(1)<<21)-1;
+    return (static_cast<uint64_t>(ix)&mask) | ((static_cast<uint64_t>(iy)&mask)<<21) | ((static_cast<uint64_t>(iz)&mask)<<42);
+}
+
+inline uint32_t spatial_hash::bucket_of(uint64_t const cell_value) const
+{
+    return bucket_bits==0 ? 0 : static_cast<uint32_t>((cell_value*0x9e3779b97f4a7c15ull) >> (64-bucket_bits));
+}
+
+template <typename FUNCTION>
+void spatial_hash::query(vec3 const& p_min,vec3 const& p_max,FUNCTION f) const
+{
+    if(entries.empty())
+        return;
+
+    int const x0 = cell_coordinate(p_min.x()), x1 = cell_coordinate(p_max.x());
+    int const y0 = cell_coordinate(p_min.y()), y1 = cell_coordinate(p_max.y());
+    int const z0 = cell_coordinate(p_min.z()), z1 = cell_coordinate(p_max.z());
+
+    for(int iz=z0 ; iz<=z1 ; ++iz)
+    {
+        for(int iy=y0 ; iy<=y1 ; ++iy)
+        {
+            for(int ix=x0 ; ix<=x1 ; ++ix)
+            {
+                uint64_t const code = cell_code(ix,iy,iz);
+                uint32_t const b = bucket_of(code);
+                for(int k=bucket_offset[b] ; k<bucket_offset[b+1] ; ++k)
+                    if(entries[k].cell==code)
+                        f(entries[k].index);
+            }
+        }
+    }
+}
+
+}
+
+#endif
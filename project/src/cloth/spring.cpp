@@ -0,0 +1,91 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "spring.hpp"
+
+#include "../lib/common/error_handling.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace cpe
+{
+
+void color_springs(std::vector<spring>& springs,int const begin,int const end,int const N_vertex,std::vector<int>& batch_offset)
+{
+    ASSERT_CPE(begin>=0 && begin<=end && end<=static_cast<int>(springs.size()),"Incorrect spring range");
+
+    //colors already used by the springs attached to each vertex:
+    // N_word words of 64 bits per vertex, widened when a vertex needs more colors
+    int N_word = 1;
+    std::vector<uint64_t> used(N_vertex,0);
+    std::vector<int> color(end-begin);
+    int N_color = 0;
+
+    for(int k=begin ; k<end ; ++k)
+    {
+        spring const& s = springs[k];
+        ASSERT_CPE(s.i>=0 && s.i<N_vertex && s.j>=0 && s.j<N_vertex,"Incorrect spring index");
+
+        //first word with a color free for both vertices
+        int w = 0;
+        while(w<N_word && (used[s.i*N_word+w] | used[s.j*N_word+w])==~uint64_t(0))
+            ++w;
+        if(w==N_word)
+        {
+            int const N_word_new = 2*N_word;
+            std::vector<uint64_t> widened(static_cast<size_t>(N_vertex)*N_word_new,0);
+            for(int v=0 ; v<N_vertex ; ++v)
+                std::copy(used.begin()+v*N_word,used.begin()+(v+1)*N_word,widened.begin()+v*N_word_new);
+            used.swap(widened);
+            N_word = N_word_new;
+        }
+
+        uint64_t& used_i = used[s.i*N_word+w];
+        uint64_t& used_j = used[s.j*N_word+w];
+        uint64_t const mask = used_i | used_j;
+        int b = 0;
+        while(mask & (uint64_t(1)<<b))
+            ++b;
+
+        used_i |= uint64_t(1)<<b;
+        used_j |= uint64_t(1)<<b;
+        int const c = 64*w+b;
+        color[k-begin] = c;
+        if(c+1>N_color)
+            N_color = c+1;
+    }
+
+    //stable counting sort of the springs by color
+    std::vector<int> offset(N_color+1,0);
+    for(int c : color)
+        ++offset[c+1];
+    for(int c=0 ; c<N_color ; ++c)
+        offset[c+1] += offset[c];
+
+    std::vector<spring> sorted(end-begin);
+    std::vector<int> position(offset.begin(),offset.end()-1);
+    for(int k=begin ; k<end ; ++k)
+        sorted[position[color[k-begin]]++] = springs[k];
+    std::copy(sorted.begin(),sorted.end(),springs.begin()+begin);
+
+    for(int c=0 ; c<N_color ; ++c)
+        batch_offset.push_back(begin+offset[c]);
+}
+
+}
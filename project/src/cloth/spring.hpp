@@ -0,0 +1,62 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef SPRING_HPP
+#define SPRING_HPP
+
+#include <vector>
+
+namespace cpe
+{
+
+/** The families of springs of the cloth (used as index in the spring offsets) */
+enum spring_family
+{
+    spring_structural = 0,
+    spring_shearing = 1,
+    spring_bending = 2,
+    spring_family_size = 3
+};
+
+/** A spring linking the vertices i and j (flat index in the vertex array).
+ *  The force applied on i is k*(rest_length-|pi-pj|)*(pi-pj)/|pi-pj|,
+ *  the opposite force is applied on j. */
+struct spring
+{
+    /** Index of the first extremity */
+    int i;
+    /** Index of the second extremity */
+    int j;
+    /** Stiffness */
+    float k;
+    /** Length at rest */
+    float rest_length;
+};
+
+/** Reorder the springs in [begin,end) by color such that two springs of the same
+ *  color never share an extremity (greedy edge coloring).
+ *  The offsets of each color batch are appended to batch_offset (begin of each
+ *  batch, the last batch ending at end). Springs of a batch can be evaluated in
+ *  parallel without write conflict on the forces. */
+void color_springs(std::vector<spring>& springs,int begin,int end,int N_vertex,std::vector<int>& batch_offset);
+
+}
+
+#endif
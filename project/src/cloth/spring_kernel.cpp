@@ -0,0 +1,290 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "spring_kernel.hpp"
+
+#include "../lib/common/error_handling.hpp"
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SPRING_KERNEL_X86
+#include <immintrin.h>
+#endif
+
+namespace cpe
+{
+
+//the AVX2 kernel gathers the springs with a stride of 4 values
+static_assert(sizeof(spring)==4*sizeof(int),"spring is expected to be stored as (i,j,k,rest_length)");
+
+void spring_forces_scalar(spring const* springs,int const begin,int const end,
+                          float const* px,float const* py,float const* pz,
+                          float* fx,float* fy,float* fz)
+{
+    for(int k=begin ; k<end ; ++k)
+    {
+        spring const& s = springs[k];
+        float const ux = px[s.i]-px[s.j];
+        float const uy = py[s.i]-py[s.j];
+        float const uz = pz[s.i]-pz[s.j];
+        float const L = std::sqrt(ux*ux+uy*uy+uz*uz);
+        if(L<1e-12f)
+            continue;
+
+        float const c = s.k*(s.rest_length-L)/L;
+        fx[s.i] += c*ux; fy[s.i] += c*uy; fz[s.i] += c*uz;
+        fx[s.j] -= c*ux; fy[s.j] -= c*uy; fz[s.j] -= c*uz;
+    }
+}
+
+/** Copy the last (incomplete) block of springs into a full block of W springs.
+ *  The padding lanes repeat the first spring with a zero stiffness and are never scattered. */
+template <int W>
+static inline void pad_block(spring const* s,int const N_valid,spring* padded)
+{
+    for(int l=0 ; l<W ; ++l)
+    {
+        padded[l] = s[l<N_valid ? l : 0];
+        if(l>=N_valid)
+            padded[l].k = 0.0f;
+    }
+}
+
+#ifdef SPRING_KERNEL_X86
+
+/** Compute c*u for 4 springs (one SSE register per component).
+ *  The same code is used for full and padded blocks so that the result of a
+ *  spring does not depend on its position in the range. */
+static void block_sse(spring const* s,int const N_valid,
+                      float const* px,float const* py,float const* pz,
+                      float* fx,float* fy,float* fz)
+{
+    spring padded[4];
+    if(N_valid<4)
+    {
+        pad_block<4>(s,N_valid,padded);
+        s = padded;
+    }
+
+    //the 4 springs (i,j,k,rest_length) are transposed into one register per field
+    float const* const base = reinterpret_cast<float const*>(s);
+    __m128 ri = _mm_loadu_ps(base);
+    __m128 rj = _mm_loadu_ps(base+4);
+    __m128 k = _mm_loadu_ps(base+8);
+    __m128 L0 = _mm_loadu_ps(base+12);
+    _MM_TRANSPOSE4_PS(ri,rj,k,L0);
+
+    alignas(16) int vi[4],vj[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(vi),_mm_castps_si128(ri));
+    _mm_store_si128(reinterpret_cast<__m128i*>(vj),_mm_castps_si128(rj));
+
+    __m128 const xi = _mm_setr_ps(px[vi[0]],px[vi[1]],px[vi[2]],px[vi[3]]);
+    __m128 const yi = _mm_setr_ps(py[vi[0]],py[vi[1]],py[vi[2]],py[vi[3]]);
+    __m128 const zi = _mm_setr_ps(pz[vi[0]],pz[vi[1]],pz[vi[2]],pz[vi[3]]);
+    __m128 const xj = _mm_setr_ps(px[vj[0]],px[vj[1]],px[vj[2]],px[vj[3]]);
+    __m128 const yj = _mm_setr_ps(py[vj[0]],py[vj[1]],py[vj[2]],py[vj[3]]);
+    __m128 const zj = _mm_setr_ps(pz[vj[0]],pz[vj[1]],pz[vj[2]],pz[vj[3]]);
+
+    __m128 const ux = _mm_sub_ps(xi,xj);
+    __m128 const uy = _mm_sub_ps(yi,yj);
+    __m128 const uz = _mm_sub_ps(zi,zj);
+    __m128 const L2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ux,ux),_mm_mul_ps(uy,uy)),_mm_mul_ps(uz,uz));
+
+    //1/L: approximation refined by one Newton step r = r*(1.5-0.5*L2*r*r)
+    __m128 r = _mm_rsqrt_ps(L2);
+    r = _mm_mul_ps(r,_mm_sub_ps(_mm_set1_ps(1.5f),_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f),L2),_mm_mul_ps(r,r))));
+
+    //c = k*(L0-L)/L = k*(L0/L-1), set to 0 for degenerated springs
+    __m128 c = _mm_mul_ps(k,_mm_sub_ps(_mm_mul_ps(L0,r),_mm_set1_ps(1.0f)));
+    c = _mm_and_ps(c,_mm_cmpge_ps(L2,_mm_set1_ps(1e-24f)));
+
+    alignas(16) float cx[4],cy[4],cz[4];
+    _mm_store_ps(cx,_mm_mul_ps(c,ux));
+    _mm_store_ps(cy,_mm_mul_ps(c,uy));
+    _mm_store_ps(cz,_mm_mul_ps(c,uz));
+
+    for(int l=0 ; l<N_valid ; ++l)
+    {
+        int const a = vi[l];
+        int const b = vj[l];
+        fx[a] += cx[l]; fy[a] += cy[l]; fz[a] += cz[l];
+        fx[b] -= cx[l]; fy[b] -= cy[l]; fz[b] -= cz[l];
+    }
+}
+
+void spring_forces_sse(spring const* springs,int const begin,int const end,
+                       float const* px,float const* py,float const* pz,
+                       float* fx,float* fy,float* fz)
+{
+    for(int k=begin ; k<end ; k+=4)
+    {
+        int const N_valid = end-k<4 ? end-k : 4;
+        block_sse(springs+k,N_valid,px,py,pz,fx,fy,fz);
+    }
+}
+
+/** Compute c*u for 8 springs (AVX2, positions are gathered) */
+__attribute__((target("avx2,fma")))
+static void block_avx2(spring const* s,int const N_valid,
+                       float const* px,float const* py,float const* pz,
+                       float* fx,float* fy,float* fz)
+{
+    spring padded[8];
+    if(N_valid<8)
+    {
+        pad_block<8>(s,N_valid,padded);
+        s = padded;
+    }
+
+    //the 8 springs (i,j,k,rest_length) are loaded in 4 registers and transposed
+    // in each 128 bits lane: lane l of the result corresponds to the spring order[l]
+    float const* const base = reinterpret_cast<float const*>(s);
+    __m256 const r0 = _mm256_loadu_ps(base);
+    __m256 const r1 = _mm256_loadu_ps(base+8);
+    __m256 const r2 = _mm256_loadu_ps(base+16);
+    __m256 const r3 = _mm256_loadu_ps(base+24);
+    __m256 const t0 = _mm256_unpacklo_ps(r0,r1);
+    __m256 const t1 = _mm256_unpackhi_ps(r0,r1);
+    __m256 const t2 = _mm256_unpacklo_ps(r2,r3);
+    __m256 const t3 = _mm256_unpackhi_ps(r2,r3);
+    __m256i const i = _mm256_castps_si256(_mm256_shuffle_ps(t0,t2,_MM_SHUFFLE(1,0,1,0)));
+    __m256i const j = _mm256_castps_si256(_mm256_shuffle_ps(t0,t2,_MM_SHUFFLE(3,2,3,2)));
+    __m256 const k  = _mm256_shuffle_ps(t1,t3,_MM_SHUFFLE(1,0,1,0));
+    __m256 const L0 = _mm256_shuffle_ps(t1,t3,_MM_SHUFFLE(3,2,3,2));
+    static int const order[8] = {0,2,4,6,1,3,5,7};
+
+    __m256 const ux = _mm256_sub_ps(_mm256_i32gather_ps(px,i,4),_mm256_i32gather_ps(px,j,4));
+    __m256 const uy = _mm256_sub_ps(_mm256_i32gather_ps(py,i,4),_mm256_i32gather_ps(py,j,4));
+    __m256 const uz = _mm256_sub_ps(_mm256_i32gather_ps(pz,i,4),_mm256_i32gather_ps(pz,j,4));
+    __m256 const L2 = _mm256_fmadd_ps(uz,uz,_mm256_fmadd_ps(uy,uy,_mm256_mul_ps(ux,ux)));
+
+    //1/L: approximation refined by one Newton step r = r*(1.5-0.5*L2*r*r)
+    __m256 r = _mm256_rsqrt_ps(L2);
+    __m256 const half_L2 = _mm256_mul_ps(_mm256_set1_ps(0.5f),L2);
+    r = _mm256_mul_ps(r,_mm256_fnmadd_ps(half_L2,_mm256_mul_ps(r,r),_mm256_set1_ps(1.5f)));
+
+    //c = k*(L0/L-1), set to 0 for degenerated springs
+    __m256 c = _mm256_mul_ps(k,_mm256_fmsub_ps(L0,r,_mm256_set1_ps(1.0f)));
+    c = _mm256_and_ps(c,_mm256_cmp_ps(L2,_mm256_set1_ps(1e-24f),_CMP_GE_OQ));
+
+    alignas(32) float cx[8],cy[8],cz[8];
+    alignas(32) int vi[8],vj[8];
+    _mm256_store_ps(cx,_mm256_mul_ps(c,ux));
+    _mm256_store_ps(cy,_mm256_mul_ps(c,uy));
+    _mm256_store_ps(cz,_mm256_mul_ps(c,uz));
+    _mm256_store_si256(reinterpret_cast<__m256i*>(vi),i);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(vj),j);
+
+    for(int l=0 ; l<8 ; ++l)
+    {
+        if(order[l]>=N_valid)
+            continue;
+        int const a = vi[l];
+        int const b = vj[l];
+        fx[a] += cx[l]; fy[a] += cy[l]; fz[a] += cz[l];
+        fx[b] -= cx[l]; fy[b] -= cy[l]; fz[b] -= cz[l];
+    }
+}
+
+void spring_forces_avx2(spring const* springs,int const begin,int const end,
+                        float const* px,float const* py,float const* pz,
+                        float* fx,float* fy,float* fz)
+{
+    for(int k=begin ; k<end ; k+=8)
+    {
+        int const N_valid = end-k<8 ? end-k : 8;
+        block_avx2(springs+k,N_valid,px,py,pz,fx,fy,fz);
+    }
+}
+
+#else
+
+void spring_forces_sse(spring const* springs,int const begin,int const end,
+                       float const* px,float const* py,float const* pz,
+                       float* fx,float* fy,float* fz)
+{
+    throw exception_cpe("SSE spring kernel is not available on this architecture",EXCEPTION_PARAMETERS_CPE);
+}
+
+void spring_forces_avx2(spring const* springs,int const begin,int const end,
+                        float const* px,float const* py,float const* pz,
+                        float* fx,float* fy,float* fz)
+{
+    throw exception_cpe("AVX2 spring kernel is not available on this architecture",EXCEPTION_PARAMETERS_CPE);
+}
+
+#endif
+
+bool spring_kernel_supported(spring_kernel_type const type)
+{
+    switch(type)
+    {
+    case spring_kernel_scalar:
+        return true;
+#ifdef SPRING_KERNEL_X86
+    case spring_kernel_sse:
+        return __builtin_cpu_supports("sse2");
+    case spring_kernel_avx2:
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+    default:
+        return false;
+    }
+}
+
+spring_kernel_type best_spring_kernel()
+{
+    //without gather instructions the SSE kernel loads the positions one by one
+    // and is not faster than the scalar one (see bench/spring_kernel_bench): it
+    // is never selected automatically.
+    if(spring_kernel_supported(spring_kernel_avx2))
+        return spring_kernel_avx2;
+    return spring_kernel_scalar;
+}
+
+spring_kernel get_spring_kernel(spring_kernel_type const type)
+{
+    ASSERT_CPE(spring_kernel_supported(type),"Spring kernel "+spring_kernel_name(type)+" is not supported by this CPU");
+
+    switch(type)
+    {
+    case spring_kernel_sse:
+        return spring_forces_sse;
+    case spring_kernel_avx2:
+        return spring_forces_avx2;
+    default:
+        return spring_forces_scalar;
+    }
+}
+
+std::string spring_kernel_name(spring_kernel_type const type)
+{
+    switch(type)
+    {
+    case spring_kernel_scalar:
+        return "scalar";
+    case spring_kernel_sse:
+        return "sse";
+    case spring_kernel_avx2:
+        return "avx2";
+    }
+    return "unknown";
+}
+
+}
@@ -0,0 +1,69 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef SPRING_KERNEL_HPP
+#define SPRING_KERNEL_HPP
+
+#include "spring.hpp"
+
+#include <string>
+
+namespace cpe
+{
+
+/** Kernel adding the forces of the springs [begin,end) to (fx,fy,fz).
+ *  The springs of the range must not share any vertex (see color_springs). */
+typedef void (*spring_kernel)(spring const* springs,int begin,int end,
+                              float const* px,float const* py,float const* pz,
+                              float* fx,float* fy,float* fz);
+
+/** Available implementations of the spring kernel */
+enum spring_kernel_type
+{
+    spring_kernel_scalar = 0,
+    spring_kernel_sse = 1,
+    spring_kernel_avx2 = 2
+};
+
+/** Reference implementation (sqrt and division) */
+void spring_forces_scalar(spring const* springs,int begin,int end,
+                          float const* px,float const* py,float const* pz,
+                          float* fx,float* fy,float* fz);
+/** 4 springs per instruction (SSE, rsqrt + one Newton step) */
+void spring_forces_sse(spring const* springs,int begin,int end,
+                       float const* px,float const* py,float const* pz,
+                       float* fx,float* fy,float* fz);
+/** 8 springs per instruction (AVX2 gathers, rsqrt + one Newton step) */
+void spring_forces_avx2(spring const* springs,int begin,int end,
+                        float const* px,float const* py,float const* pz,
+                        float* fx,float* fy,float* fz);
+
+/** Check if the current CPU can run the given kernel */
+bool spring_kernel_supported(spring_kernel_type type);
+/** The fastest kernel supported by the current CPU */
+spring_kernel_type best_spring_kernel();
+/** Function pointer associated to a kernel type (must be supported) */
+spring_kernel get_spring_kernel(spring_kernel_type type);
+/** Human readable name of the kernel */
+std::string spring_kernel_name(spring_kernel_type type);
+
+}
+
+#endif
@@ -0,0 +1,77 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef TRIPLE_BUFFER_HPP
+#define TRIPLE_BUFFER_HPP
+
+#include <atomic>
+
+namespace cpe
+{
+
+/** Lock-free single producer / single consumer triple buffer.
+ *  The producer fills write_buffer() then publish() it, the consumer calls
+ *  update() to get the last published buffer in read_buffer(). Neither side
+ *  ever blocks: the producer always has a free buffer (the intermediate one
+ *  is recycled if the consumer did not take it), and the consumer keeps its
+ *  buffer until it asks for a new one. Intermediate frames may be skipped. */
+template <typename T>
+class triple_buffer
+{
+public:
+
+    /** Buffer owned by the producer */
+    T& write_buffer() {return buffer[write_index];}
+    /** Give the write buffer to the consumer and take the intermediate one */
+    void publish()
+    {
+        int const previous = shared.exchange(write_index | FRESH,std::memory_order_acq_rel);
+        write_index = previous & INDEX;
+    }
+
+    /** Take the last published buffer, returns false (read buffer unchanged) if nothing new was published */
+    bool update()
+    {
+        if((shared.load(std::memory_order_relaxed) & FRESH)==0)
+            return false;
+        int const previous = shared.exchange(read_index,std::memory_order_acq_rel);
+        read_index = previous & INDEX;
+        return true;
+    }
+    /** Buffer owned by the consumer */
+    T const& read_buffer() const {return buffer[read_index];}
+
+private:
+
+    /** Bits of the shared state storing the index of the intermediate buffer */
+    static int const INDEX = 3;
+    /** Bit of the shared state set when the intermediate buffer has not been read */
+    static int const FRESH = 4;
+
+    T buffer[3];
+    int write_index = 0;
+    int read_index = 1;
+    /** Index of the intermediate buffer + FRESH bit */
+    std::atomic<int> shared{2};
+};
+
+}
+
+#endif
@@ -0,0 +1,234 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "wind_field.hpp"
+#include "../lib/common/error_handling.hpp"
+#include "../lib/random/counter_rng.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace cpe
+{
+
+wind_field::wind_field()
+{
+    set_octave(3,0.5f);
+    set_seed(0);
+}
+
+void wind_field::set_seed(uint64_t const seed)
+{
+    counter_rng const rng(seed,0);
+    offset = vec4(1000.0f*rng.uniform(0),1000.0f*rng.uniform(1),1000.0f*rng.uniform(2),1000.0f*rng.uniform(3));
+    lattice_a.step = lattice_b.step = -1;
+}
+
+void wind_field::set_resolution(int const N)
+{
+    ASSERT_CPE(N>0,"Lattice resolution should be >0");
+    resolution_data = N;
+    lattice_a.step = lattice_b.step = -1;
+}
+int wind_field::resolution() const {return resolution_data;}
+
+void wind_field::set_update_period(int const period)
+{
+    ASSERT_CPE(period>0,"Update period should be >0");
+    update_period_data = period;
+    lattice_a.step = lattice_b.step = -1;
+}
+int wind_field::update_period() const {return update_period_data;}
+
+void wind_field::set_frequency(float const space,float const time)
+{
+    frequency_space = space;
+    frequency_time = time;
+    lattice_a.step = lattice_b.step = -1;
+}
+
+void wind_field::set_octave(int const octave,float const persistency)
+{
+    noise = perlin(octave,persistency);
+
+    //perlin sums the octaves in [0,1] weighted by persistency^k
+    noise_normalization = 0.0f;
+    float weight = 1.0f;
+    for(int k=0 ; k<octave ; ++k)
+    {
+        noise_normalization += weight;
+        weight *= persistency;
+    }
+    lattice_a.step = lattice_b.step = -1;
+}
+
+void wind_field::build_lattice(lattice& L,vec3 const& p_min,vec3 const& p_max,long const step)
+{
+    int const R = resolution_data;
+
+    //margin covering the motion of the points until the next update
+    vec3 const margin = 0.25f*(p_max-p_min)+vec3(0.05f,0.05f,0.05f);
+    L.corner = p_min-margin;
+    vec3 const size = p_max-p_min+2.0f*margin;
+    vec3 const cell = size/static_cast<float>(R);
+    L.inv_cell = vec3(1.0f/cell.x(),1.0f/cell.y(),1.0f/cell.z());
+    L.value.resize((R+1)*(R+1)*(R+1));
+    L.step = step;
+
+    //noise coordinates of the nodes
+    int const N_node = (R+1)*(R+1)*(R+1);
+    node_x.resize(N_node); node_y.resize(N_node); node_z.resize(N_node); node_w.resize(N_node);
+    float const t = offset.w()+frequency_time*static_cast<float>(step);
+    for(int kz=0 ; kz<=R ; ++kz)
+    {
+        for(int ky=0 ; ky<=R ; ++ky)
+        {
+            for(int kx=0 ; kx<=R ; ++kx)
+            {
+                int const k = kx+(R+1)*(ky+(R+1)*kz);
+                node_x[k] = offset.x()+frequency_space*(L.corner.x()+kx*cell.x());
+                node_y[k] = offset.y()+frequency_space*(L.corner.y()+ky*cell.y());
+                node_z[k] = offset.z()+frequency_space*(L.corner.z()+kz*cell.z());
+                node_w[k] = t;
+            }
+        }
+    }
+
+    //batched noise evaluation, one z slice of nodes per task
+    int const N_slice = (R+1)*(R+1);
+    #pragma omp parallel for schedule(static)
+    for(int kz=0 ; kz<=R ; ++kz)
+    {
+        int const begin = kz*N_slice;
+        noise.evaluate_batch(&node_x[begin],&node_y[begin],&node_z[begin],&node_w[begin],&L.value[begin],N_slice);
+    }
+
+    float const inv_normalization = 1.0f/noise_normalization;
+    for(float& v : L.value)
+        v *= inv_normalization;
+}
+
+float wind_field::sample(lattice const& L,float const x,float const y,float const z) const
+{
+    int const R = resolution_data;
+    float const max_coord = static_cast<float>(R)-1e-4f;
+
+    float const ux = std::min(std::max((x-L.corner.x())*L.inv_cell.x(),0.0f),max_coord);
+    float const uy = std::min(std::max((y-L.corner.y())*L.inv_cell.y(),0.0f),max_coord);
+    float const uz = std::min(std::max((z-L.corner.z())*L.inv_cell.z(),0.0f),max_coord);
+
+    int const ix = static_cast<int>(ux);
+    int const iy = static_cast<int>(uy);
+    int const iz = static_cast<int>(uz);
+    float const fx = ux-ix;
+    float const fy = uy-iy;
+    float const fz = uz-iz;
+
+    int const sy = R+1;
+    int const sz = (R+1)*(R+1);
+    float const* const v = &L.value[ix+sy*iy+sz*iz];
+
+    float const v00 = v[0]    +fx*(v[1]-v[0]);
+    float const v10 = v[sy]   +fx*(v[sy+1]-v[sy]);
+    float const v01 = v[sz]   +fx*(v[sz+1]-v[sz]);
+    float const v11 = v[sz+sy]+fx*(v[sz+sy+1]-v[sz+sy]);
+
+    float const v0 = v00+fy*(v10-v00);
+    float const v1 = v01+fy*(v11-v01);
+    return v0+fz*(v1-v0);
+}
+
+void wind_field::evaluate(float const* const px,float const* const py,float const* const pz,int const N,long const step,float* const intensity)
+{
+    if(N<=0)
+        return;
+
+    long const period = update_period_data;
+    long const step_a = (step/period)*period;
+    long const step_b = step_a+period;
+
+    //re-sample the lattices when entering a new update period
+    if(lattice_a.step!=step_a || lattice_b.step!=step_b)
+    {
+        vec3 p_min(px[0],py[0],pz[0]);
+        vec3 p_max = p_min;
+        for(int k=1 ; k<N ; ++k)
+        {
+            p_min = vec3(std::min(p_min.x(),px[k]),std::min(p_min.y(),py[k]),std::min(p_min.z(),pz[k]));
+            p_max = vec3(std::max(p_max.x(),px[k]),std::max(p_max.y(),py[k]),std::max(p_max.z(),pz[k]));
+        }
+
+        if(lattice_b.step==step_a)
+            std::swap(lattice_a,lattice_b);
+        else
+            build_lattice(lattice_a,p_min,p_max,step_a);
+        build_lattice(lattice_b,p_min,p_max,step_b);
+    }
+
+    float const s = static_cast<float>(step-step_a)/static_cast<float>(period);
+
+    #pragma omp parallel for schedule(static)
+    for(int k=0 ; k<N ; ++k)
+    {
+        float const va = sample(lattice_a,px[k],py[k],pz[k]);
+        float const vb = sample(lattice_b,px[k],py[k],pz[k]);
+        intensity[k] = va+s*(vb-va);
+    }
+}
+
+void wind_field::get_lattice_state(long step[2],std::vector<float>& data) const
+{
+    int const N_node = (resolution_data+1)*(resolution_data+1)*(resolution_data+1);
+    data.clear();
+    lattice const* const lattices[2] = {&lattice_a,&lattice_b};
+    for(int k=0 ; k<2 ; ++k)
+    {
+        lattice const& L = *lattices[k];
+        step[k] = L.step;
+        for(int d=0 ; d<3 ; ++d)
+            data.push_back(L.corner[d]);
+        for(int d=0 ; d<3 ; ++d)
+            data.push_back(L.inv_cell[d]);
+        if(static_cast<int>(L.value.size())==N_node)
+            data.insert(data.end(),L.value.begin(),L.value.end());
+        else
+            data.insert(data.end(),N_node,0.0f);
+    }
+}
+
+bool wind_field::set_lattice_state(long const step[2],std::vector<float> const& data)
+{
+    int const N_node = (resolution_data+1)*(resolution_data+1)*(resolution_data+1);
+    if(static_cast<int>(data.size())!=2*(6+N_node))
+        return false;
+
+    lattice* const lattices[2] = {&lattice_a,&lattice_b};
+    for(int k=0 ; k<2 ; ++k)
+    {
+        lattice& L = *lattices[k];
+        float const* const v = &data[k*(6+N_node)];
+        L.step = step[k];
+        L.corner = vec3(v[0],v[1],v[2]);
+        L.inv_cell = vec3(v[3],v[4],v[5]);
+        L.value.assign(v+6,v+6+N_node);
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,110 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef WIND_FIELD_HPP
+#define WIND_FIELD_HPP
+
+#include "../lib/3d/vec3.hpp"
+#include "../lib/3d/vec4.hpp"
+#include "../lib/perlin/perlin.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace cpe
+{
+
+/** Spatially and temporally coherent wind intensity given by a 4D Perlin
+ *  noise (space + time).
+ *  The noise is only evaluated (in batch) on the nodes of a coarse lattice
+ *  covering the evaluated points, every update_period steps. The intensity of a point is
+ *  the trilinear interpolation in the lattice, linearly blended between the
+ *  lattices of the two surrounding update times. */
+class wind_field
+{
+public:
+
+    wind_field();
+
+    /** Different seeds give different (but reproducible) wind fields */
+    void set_seed(uint64_t seed);
+    /** Number of lattice cells along each axis (default 6) */
+    void set_resolution(int N);
+    int resolution() const;
+    /** Number of steps between two evaluations of the lattice (default 4) */
+    void set_update_period(int period);
+    int update_period() const;
+    /** Spatial frequency (1/length) and temporal frequency (1/step) of the noise */
+    void set_frequency(float space,float time);
+    /** Octaves and persistency of the Perlin noise */
+    void set_octave(int octave,float persistency);
+
+    /** Intensity in [0,1] at the N points (px,py,pz) for the time step `step` */
+    void evaluate(float const* px,float const* py,float const* pz,int N,long step,float* intensity);
+
+    /** Lattices of the current update period: steps and values (corner, inverse cell size,
+     *  node values of each lattice). They depend on the extent of the points when they
+     *  were sampled, a restart needs them to continue the same gusts. */
+    void get_lattice_state(long step[2],std::vector<float>& data) const;
+    /** Restore lattices given by get_lattice_state, returns false (and keeps the
+     *  lattices to sample) if the size does not match the resolution */
+    bool set_lattice_state(long const step[2],std::vector<float> const& data);
+
+private:
+
+    /** Noise values sampled on a regular grid at a given step */
+    struct lattice
+    {
+        /** Corner of the lattice */
+        vec3 corner;
+        /** Inverse of the cell size along each axis */
+        vec3 inv_cell;
+        /** (resolution+1)^3 values, x fastest */
+        std::vector<float> value;
+        /** Step of the sampling (-1: not sampled) */
+        long step = -1;
+    };
+
+    /** Sample the noise on the lattice covering [p_min,p_max] at the given step */
+    void build_lattice(lattice& L,vec3 const& p_min,vec3 const& p_max,long step);
+    /** Trilinear interpolation of the lattice values at (x,y,z) (clamped to the lattice) */
+    float sample(lattice const& L,float x,float y,float z) const;
+
+    perlin noise;
+    /** Sum of the octave weights (normalization of the noise in [0,1]) */
+    float noise_normalization;
+    /** Offset of the noise domain, given by the seed */
+    vec4 offset;
+
+    int resolution_data = 6;
+    int update_period_data = 4;
+    float frequency_space = 1.5f;
+    float frequency_time = 0.02f;
+
+    /** Lattices at the beginning and end of the current update period */
+    lattice lattice_a;
+    lattice lattice_b;
+    /** Noise coordinates of the lattice nodes (work buffers) */
+    std::vector<float> node_x,node_y,node_z,node_w;
+};
+
+}
+
+#endif
@@ -0,0 +1,141 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "xpbd_solver.hpp"
+
+#include "../lib/common/error_handling.hpp"
+
+#include <cmath>
+
+namespace cpe
+{
+
+xpbd_solver::xpbd_solver()
+    :previous_position(),lambda(),iterations(10)
+{}
+
+void xpbd_solver::set_iterations(int const N)
+{
+    ASSERT_CPE(N>0,"Number of iterations should be >0");
+    iterations = N;
+}
+
+int xpbd_solver::get_iterations() const
+{
+    return iterations;
+}
+
+void xpbd_solver::step(particle_store& particles,
+                       std::vector<spring> const& springs,
+                       std::vector<int> const& batch_offset,
+                       float const dt,float const damping)
+{
+    int const N = particles.size();
+    int const N_spring = springs.size();
+    ASSERT_CPE(batch_offset.size()>0 && batch_offset.back()==N_spring,"Incorrect spring batches");
+    ASSERT_CPE(dt>0,"Time step should be >0");
+
+    float* const px = particles.position.x.data();
+    float* const py = particles.position.y.data();
+    float* const pz = particles.position.z.data();
+    float* const vx = particles.velocity.x.data();
+    float* const vy = particles.velocity.y.data();
+    float* const vz = particles.velocity.z.data();
+    float const* const fx = particles.force.x.data();
+    float const* const fy = particles.force.y.data();
+    float const* const fz = particles.force.z.data();
+    float const* const w = particles.inv_mass.data();
+
+    previous_position.resize(N);
+    float* const qx = previous_position.x.data();
+    float* const qy = previous_position.y.data();
+    float* const qz = previous_position.z.data();
+
+    //prediction with the external forces
+    float const damping_factor = 1-damping*dt;
+    #pragma omp parallel for schedule(static)
+    for(int k=0 ; k<N ; ++k)
+    {
+        qx[k] = px[k]; qy[k] = py[k]; qz[k] = pz[k];
+
+        vx[k] = damping_factor*vx[k] + dt*w[k]*fx[k];
+        vy[k] = damping_factor*vy[k] + dt*w[k]*fy[k];
+        vz[k] = damping_factor*vz[k] + dt*w[k]*fz[k];
+
+        px[k] += dt*vx[k];
+        py[k] += dt*vy[k];
+        pz[k] += dt*vz[k];
+    }
+
+    //constraint projection
+    lambda.assign(N_spring,0.0f);
+    float* const l = lambda.data();
+    spring const* const s = springs.data();
+    float const inv_dt2 = 1.0f/(dt*dt);
+    int const N_batch = static_cast<int>(batch_offset.size())-1;
+
+    #pragma omp parallel
+    {
+        for(int it=0 ; it<iterations ; ++it)
+        {
+            for(int b=0 ; b<N_batch ; ++b)
+            {
+                #pragma omp for schedule(static)
+                for(int k=batch_offset[b] ; k<batch_offset[b+1] ; ++k)
+                {
+                    int const i = s[k].i;
+                    int const j = s[k].j;
+                    float const wi = w[i];
+                    float const wj = w[j];
+
+                    float const ux = px[i]-px[j];
+                    float const uy = py[i]-py[j];
+                    float const uz = pz[i]-pz[j];
+                    float const L = std::sqrt(ux*ux+uy*uy+uz*uz);
+                    if(L<1e-12f || s[k].k<=0.0f)
+                        continue;
+
+                    float const alpha = inv_dt2/s[k].k;
+                    float const denominator = wi+wj+alpha;
+                    if(denominator<=0.0f)
+                        continue;
+
+                    float const C = L-s[k].rest_length;
+                    float const dlambda = (-C-alpha*l[k])/denominator;
+                    l[k] += dlambda;
+
+                    float const c = dlambda/L;
+                    px[i] += wi*c*ux; py[i] += wi*c*uy; pz[i] += wi*c*uz;
+                    px[j] -= wj*c*ux; py[j] -= wj*c*uy; pz[j] -= wj*c*uz;
+                }
+            }
+        }
+    }
+
+    //velocities from the displacement
+    float const inv_dt = 1.0f/dt;
+    #pragma omp parallel for schedule(static)
+    for(int k=0 ; k<N ; ++k)
+    {
+        vx[k] = (px[k]-qx[k])*inv_dt;
+        vy[k] = (py[k]-qy[k])*inv_dt;
+        vz[k] = (pz[k]-qz[k])*inv_dt;
+    }
+}
+
+}
@@ -0,0 +1,70 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef XPBD_SOLVER_HPP
+#define XPBD_SOLVER_HPP
+
+#include "spring.hpp"
+#include "particle_store.hpp"
+
+#include <vector>
+
+namespace cpe
+{
+
+/** Extended position based dynamics (Macklin et al. 16).
+ *
+ *  Each spring is a distance constraint |xi-xj| = rest_length with compliance 1/k.
+ *  Positions are predicted from the external forces only, then the constraints
+ *  are projected by Gauss-Seidel iterations over the colored spring batches
+ *  (springs of a batch are projected in parallel), and the velocities are
+ *  deduced from the displacement. The number of iterations trades quality
+ *  against speed, the step is stable whatever the stiffness and time step.
+ */
+class xpbd_solver
+{
+public:
+
+    xpbd_solver();
+
+    /** Number of constraint projections per time step */
+    void set_iterations(int N);
+    int get_iterations() const;
+
+    /** Update the velocities and positions of the particles for a time step dt.
+     *  The forces must contain only the external forces (gravity, wind, ...). */
+    void step(particle_store& particles,
+              std::vector<spring> const& springs,
+              std::vector<int> const& batch_offset,
+              float dt,float damping);
+
+private:
+
+    /** Positions at the beginning of the step */
+    soa_vec3 previous_position;
+    /** Lagrange multiplier of each constraint */
+    aligned_vector<float> lambda;
+
+    int iterations;
+};
+
+}
+
+#endif
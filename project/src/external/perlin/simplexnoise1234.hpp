@@ -36,6 +36,8 @@
 #ifndef SIMPLEX_NOISE_1234_H_
 #define SIMPLEX_NOISE_1234_H_
 
+#include <cstddef>
+
 /** 1D, 2D, 3D and 4D double Perlin noise
  */
     double snoise1( double x );
@@ -43,4 +45,10 @@
     double snoise3( double x, double y, double z );
     double snoise4( double x, double y, double z, double w );
 
+/** 3D and 4D noise evaluated in single precision on n points: out[k]=snoise(x[k],y[k],...)
+ *  (SIMD implementation in simplexnoise_batch.cpp)
+ */
+    void snoise3_batch( const float* x, const float* y, const float* z, float* out, size_t n );
+    void snoise4_batch( const float* x, const float* y, const float* z, const float* w, float* out, size_t n );
+
 #endif
@@ -0,0 +1,468 @@
+// Batched (SIMD) evaluation of the 3D and 4D simplex noise of simplexnoise1234.cpp
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+
+/** \file
+		\brief snoise3_batch and snoise4_batch: same noise as snoise3 and snoise4
+		evaluated in single precision over arrays of points.
+*/
+
+/*
+ * The simplex traversal order is computed from the rank of each coordinate
+ * (number of coordinates it is larger than) instead of branches and of the
+ * 4D lookup table, which gives the same corners without any branch.
+ * The AVX2 version evaluates 8 points at once, the hashes are read in the
+ * permutation table with gather instructions. It is selected at runtime when
+ * the CPU supports it, the portable version is used otherwise and for the
+ * last points of the arrays.
+ * The indices are wrapped with &255 (identical to %256 used by the scalar
+ * functions for positive coordinates).
+ */
+
+#include "simplexnoise1234.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMPLEX_BATCH_X86
+#include <immintrin.h>
+#endif
+
+// Permutation table of simplexnoise1234.cpp
+extern unsigned char perm[512];
+
+namespace
+{
+
+float const F3f = 1.0f/3.0f;
+float const G3f = 1.0f/6.0f;
+float const F4f = 0.309016994f; // (sqrt(5)-1)/4
+float const G4f = 0.138196601f; // (5-sqrt(5))/20
+
+inline int fast_floor(float const x)
+{
+    int const i = static_cast<int>(x);
+    return x<static_cast<float>(i) ? i-1 : i;
+}
+
+inline float grad3f(int const hash,float const x,float const y,float const z)
+{
+    int const h = hash & 15;
+    float const u = h<8 ? x : y;
+    float const v = h<4 ? y : (h==12||h==14 ? x : z);
+    return ((h&1)? -u : u) + ((h&2)? -v : v);
+}
+
+inline float grad4f(int const hash,float const x,float const y,float const z,float const t)
+{
+    int const h = hash & 31;
+    float const u = h<24 ? x : y;
+    float const v = h<16 ? y : z;
+    float const w = h<8 ? z : t;
+    return ((h&1)? -u : u) + ((h&2)? -v : v) + ((h&4)? -w : w);
+}
+
+inline float corner_weight(float t)
+{
+    t = t>0.0f ? t : 0.0f;
+    t *= t;
+    return t*t;
+}
+
+/** Portable single precision 3D simplex noise (reference of the SIMD version) */
+float snoise3f(float const x,float const y,float const z)
+{
+    float const s = (x+y+z)*F3f;
+    int const i = fast_floor(x+s);
+    int const j = fast_floor(y+s);
+    int const k = fast_floor(z+s);
+    float const t = static_cast<float>(i+j+k)*G3f;
+    float const x0 = x-(i-t);
+    float const y0 = y-(j-t);
+    float const z0 = z-(k-t);
+
+    //rank of each coordinate gives the traversal order of the simplex
+    int const rx = (x0>=y0) + (x0>=z0);
+    int const ry = (y0>x0) + (y0>=z0);
+    int const rz = (z0>x0) + (z0>y0);
+    int const i1 = rx>=2, j1 = ry>=2, k1 = rz>=2;
+    int const i2 = rx>=1, j2 = ry>=1, k2 = rz>=1;
+
+    float const x1 = x0-i1+G3f,      y1 = y0-j1+G3f,      z1 = z0-k1+G3f;
+    float const x2 = x0-i2+2.0f*G3f, y2 = y0-j2+2.0f*G3f, z2 = z0-k2+2.0f*G3f;
+    float const x3 = x0-1.0f+3.0f*G3f, y3 = y0-1.0f+3.0f*G3f, z3 = z0-1.0f+3.0f*G3f;
+
+    int const ii = i & 255;
+    int const jj = j & 255;
+    int const kk = k & 255;
+
+    float const n0 = corner_weight(0.6f-x0*x0-y0*y0-z0*z0) * grad3f(perm[ii+perm[jj+perm[kk]]],x0,y0,z0);
+    float const n1 = corner_weight(0.6f-x1*x1-y1*y1-z1*z1) * grad3f(perm[ii+i1+perm[jj+j1+perm[kk+k1]]],x1,y1,z1);
+    float const n2 = corner_weight(0.6f-x2*x2-y2*y2-z2*z2) * grad3f(perm[ii+i2+perm[jj+j2+perm[kk+k2]]],x2,y2,z2);
+    float const n3 = corner_weight(0.6f-x3*x3-y3*y3-z3*z3) * grad3f(perm[ii+1+perm[jj+1+perm[kk+1]]],x3,y3,z3);
+
+    return 32.0f*(n0+n1+n2+n3);
+}
+
+/** Portable single precision 4D simplex noise (reference of the SIMD version) */
+float snoise4f(float const x,float const y,float const z,float const w)
+{
+    float const s = (x+y+z+w)*F4f;
+    int const i = fast_floor(x+s);
+    int const j = fast_floor(y+s);
+    int const k = fast_floor(z+s);
+    int const l = fast_floor(w+s);
+    float const t = static_cast<float>(i+j+k+l)*G4f;
+    float const x0 = x-(i-t);
+    float const y0 = y-(j-t);
+    float const z0 = z-(k-t);
+    float const w0 = w-(l-t);
+
+    //rank of each coordinate (equivalent to the simplex[64][4] table)
+    int const c1 = x0>y0, c2 = x0>z0, c3 = y0>z0;
+    int const c4 = x0>w0, c5 = y0>w0, c6 = z0>w0;
+    int const rx = c1+c2+c4;
+    int const ry = (1-c1)+c3+c5;
+    int const rz = (1-c2)+(1-c3)+c6;
+    int const rw = (1-c4)+(1-c5)+(1-c6);
+
+    int const i1 = rx>=3, j1 = ry>=3, k1 = rz>=3, l1 = rw>=3;
+    int const i2 = rx>=2, j2 = ry>=2, k2 = rz>=2, l2 = rw>=2;
+    int const i3 = rx>=1, j3 = ry>=1, k3 = rz>=1, l3 = rw>=1;
+
+    float const x1 = x0-i1+G4f,        y1 = y0-j1+G4f,        z1 = z0-k1+G4f,        w1 = w0-l1+G4f;
+    float const x2 = x0-i2+2.0f*G4f,   y2 = y0-j2+2.0f*G4f,   z2 = z0-k2+2.0f*G4f,   w2 = w0-l2+2.0f*G4f;
+    float const x3 = x0-i3+3.0f*G4f,   y3 = y0-j3+3.0f*G4f,   z3 = z0-k3+3.0f*G4f,   w3 = w0-l3+3.0f*G4f;
+    float const x4 = x0-1.0f+4.0f*G4f, y4 = y0-1.0f+4.0f*G4f, z4 = z0-1.0f+4.0f*G4f, w4 = w0-1.0f+4.0f*G4f;
+
+    int const ii = i & 255;
+    int const jj = j & 255;
+    int const kk = k & 255;
+    int const ll = l & 255;
+
+    float const n0 = corner_weight(0.6f-x0*x0-y0*y0-z0*z0-w0*w0) * grad4f(perm[ii+perm[jj+perm[kk+perm[ll]]]],x0,y0,z0,w0);
+    float const n1 = corner_weight(0.6f-x1*x1-y1*y1-z1*z1-w1*w1) * grad4f(perm[ii+i1+perm[jj+j1+perm[kk+k1+perm[ll+l1]]]],x1,y1,z1,w1);
+    float const n2 = corner_weight(0.6f-x2*x2-y2*y2-z2*z2-w2*w2) * grad4f(perm[ii+i2+perm[jj+j2+perm[kk+k2+perm[ll+l2]]]],x2,y2,z2,w2);
+    float const n3 = corner_weight(0.6f-x3*x3-y3*y3-z3*z3-w3*w3) * grad4f(perm[ii+i3+perm[jj+j3+perm[kk+k3+perm[ll+l3]]]],x3,y3,z3,w3);
+    float const n4 = corner_weight(0.6f-x4*x4-y4*y4-z4*z4-w4*w4) * grad4f(perm[ii+1+perm[jj+1+perm[kk+1+perm[ll+1]]]],x4,y4,z4,w4);
+
+    return 27.0f*(n0+n1+n2+n3+n4);
+}
+
+void snoise3_batch_scalar(float const* x,float const* y,float const* z,float* out,size_t begin,size_t end)
+{
+    for(size_t k=begin ; k<end ; ++k)
+        out[k] = snoise3f(x[k],y[k],z[k]);
+}
+
+void snoise4_batch_scalar(float const* x,float const* y,float const* z,float const* w,float* out,size_t begin,size_t end)
+{
+    for(size_t k=begin ; k<end ; ++k)
+        out[k] = snoise4f(x[k],y[k],z[k],w[k]);
+}
+
+#ifdef SIMPLEX_BATCH_X86
+
+/** Permutation table widened to 32 bits for the gather instructions */
+struct permutation_table_32
+{
+    int value[512];
+    permutation_table_32()
+    {
+        for(int k=0 ; k<512 ; ++k)
+            value[k] = perm[k];
+    }
+};
+
+int const* perm32()
+{
+    static permutation_table_32 const table;
+    return table.value;
+}
+
+__attribute__((target("avx2")))
+inline __m256i hash3_avx2(int const* P,__m256i const ii,__m256i const jj,__m256i const kk)
+{
+    __m256i h = _mm256_i32gather_epi32(P,kk,4);
+    h = _mm256_i32gather_epi32(P,_mm256_add_epi32(jj,h),4);
+    return _mm256_i32gather_epi32(P,_mm256_add_epi32(ii,h),4);
+}
+
+__attribute__((target("avx2")))
+inline __m256i hash4_avx2(int const* P,__m256i const ii,__m256i const jj,__m256i const kk,__m256i const ll)
+{
+    __m256i h = _mm256_i32gather_epi32(P,ll,4);
+    h = _mm256_i32gather_epi32(P,_mm256_add_epi32(kk,h),4);
+    h = _mm256_i32gather_epi32(P,_mm256_add_epi32(jj,h),4);
+    return _mm256_i32gather_epi32(P,_mm256_add_epi32(ii,h),4);
+}
+
+/** Flip the sign of v where the given bit of h is set */
+__attribute__((target("avx2")))
+inline __m256 flip_sign_avx2(__m256 const v,__m256i const h,int const bit)
+{
+    __m256i const sign = _mm256_slli_epi32(_mm256_srli_epi32(h,bit),31);
+    return _mm256_xor_ps(v,_mm256_castsi256_ps(sign));
+}
+
+/** Select a where the integer mask is set, b otherwise */
+__attribute__((target("avx2")))
+inline __m256 select_avx2(__m256i const mask,__m256 const a,__m256 const b)
+{
+    return _mm256_blendv_ps(b,a,_mm256_castsi256_ps(mask));
+}
+
+__attribute__((target("avx2")))
+inline __m256 grad3_avx2(__m256i hash,__m256 const x,__m256 const y,__m256 const z)
+{
+    __m256i const h = _mm256_and_si256(hash,_mm256_set1_epi32(15));
+    __m256i const lt8 = _mm256_cmpgt_epi32(_mm256_set1_epi32(8),h);
+    __m256i const lt4 = _mm256_cmpgt_epi32(_mm256_set1_epi32(4),h);
+    __m256i const is_12_14 = _mm256_or_si256(_mm256_cmpeq_epi32(h,_mm256_set1_epi32(12)),
+                                             _mm256_cmpeq_epi32(h,_mm256_set1_epi32(14)));
+    __m256 const u = select_avx2(lt8,x,y);
+    __m256 const v = select_avx2(lt4,y,select_avx2(is_12_14,x,z));
+    return _mm256_add_ps(flip_sign_avx2(u,h,0),flip_sign_avx2(v,h,1));
+}
+
+__attribute__((target("avx2")))
+inline __m256 grad4_avx2(__m256i hash,__m256 const x,__m256 const y,__m256 const z,__m256 const t)
+{
+    __m256i const h = _mm256_and_si256(hash,_mm256_set1_epi32(31));
+    __m256 const u = select_avx2(_mm256_cmpgt_epi32(_mm256_set1_epi32(24),h),x,y);
+    __m256 const v = select_avx2(_mm256_cmpgt_epi32(_mm256_set1_epi32(16),h),y,z);
+    __m256 const w = select_avx2(_mm256_cmpgt_epi32(_mm256_set1_epi32(8),h),z,t);
+    return _mm256_add_ps(_mm256_add_ps(flip_sign_avx2(u,h,0),flip_sign_avx2(v,h,1)),flip_sign_avx2(w,h,2));
+}
+
+/** max(t,0)^4 */
+__attribute__((target("avx2")))
+inline __m256 corner_weight_avx2(__m256 t)
+{
+    t = _mm256_max_ps(t,_mm256_setzero_ps());
+    t = _mm256_mul_ps(t,t);
+    return _mm256_mul_ps(t,t);
+}
+
+/** 1.0f where a>=b (or a>b), 0.0f otherwise */
+__attribute__((target("avx2")))
+inline __m256 ge_avx2(__m256 const a,__m256 const b)
+{
+    return _mm256_and_ps(_mm256_cmp_ps(a,b,_CMP_GE_OQ),_mm256_set1_ps(1.0f));
+}
+__attribute__((target("avx2")))
+inline __m256 gt_avx2(__m256 const a,__m256 const b)
+{
+    return _mm256_and_ps(_mm256_cmp_ps(a,b,_CMP_GT_OQ),_mm256_set1_ps(1.0f));
+}
+
+__attribute__((target("avx2")))
+inline __m256 dot3_avx2(__m256 const x,__m256 const y,__m256 const z)
+{
+    return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x,x),_mm256_mul_ps(y,y)),_mm256_mul_ps(z,z));
+}
+
+__attribute__((target("avx2")))
+size_t snoise3_batch_avx2(float const* x,float const* y,float const* z,float* out,size_t const n)
+{
+    int const* const P = perm32();
+    __m256 const one = _mm256_set1_ps(1.0f);
+    __m256 const two = _mm256_set1_ps(2.0f);
+    __m256 const g1 = _mm256_set1_ps(G3f);
+    __m256 const g2 = _mm256_set1_ps(2.0f*G3f);
+    __m256 const g3 = _mm256_set1_ps(3.0f*G3f-1.0f);
+    __m256 const limit = _mm256_set1_ps(0.6f);
+    __m256i const mask = _mm256_set1_epi32(255);
+    __m256i const one_i = _mm256_set1_epi32(1);
+
+    size_t k = 0;
+    for( ; k+8<=n ; k+=8)
+    {
+        __m256 const px = _mm256_loadu_ps(x+k);
+        __m256 const py = _mm256_loadu_ps(y+k);
+        __m256 const pz = _mm256_loadu_ps(z+k);
+
+        __m256 const s = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(px,py),pz),_mm256_set1_ps(F3f));
+        __m256 const fi = _mm256_floor_ps(_mm256_add_ps(px,s));
+        __m256 const fj = _mm256_floor_ps(_mm256_add_ps(py,s));
+        __m256 const fk = _mm256_floor_ps(_mm256_add_ps(pz,s));
+        __m256i const i = _mm256_cvttps_epi32(fi);
+        __m256i const j = _mm256_cvttps_epi32(fj);
+        __m256i const kz = _mm256_cvttps_epi32(fk);
+
+        __m256 const t = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_add_epi32(i,j),kz)),g1);
+        __m256 const x0 = _mm256_sub_ps(px,_mm256_sub_ps(fi,t));
+        __m256 const y0 = _mm256_sub_ps(py,_mm256_sub_ps(fj,t));
+        __m256 const z0 = _mm256_sub_ps(pz,_mm256_sub_ps(fk,t));
+
+        __m256 const rx = _mm256_add_ps(ge_avx2(x0,y0),ge_avx2(x0,z0));
+        __m256 const ry = _mm256_add_ps(gt_avx2(y0,x0),ge_avx2(y0,z0));
+        __m256 const rz = _mm256_add_ps(gt_avx2(z0,x0),gt_avx2(z0,y0));
+        __m256 const i1 = ge_avx2(rx,two), j1 = ge_avx2(ry,two), k1 = ge_avx2(rz,two);
+        __m256 const i2 = ge_avx2(rx,one), j2 = ge_avx2(ry,one), k2 = ge_avx2(rz,one);
+
+        __m256 const x1 = _mm256_add_ps(_mm256_sub_ps(x0,i1),g1);
+        __m256 const y1 = _mm256_add_ps(_mm256_sub_ps(y0,j1),g1);
+        __m256 const z1 = _mm256_add_ps(_mm256_sub_ps(z0,k1),g1);
+        __m256 const x2 = _mm256_add_ps(_mm256_sub_ps(x0,i2),g2);
+        __m256 const y2 = _mm256_add_ps(_mm256_sub_ps(y0,j2),g2);
+        __m256 const z2 = _mm256_add_ps(_mm256_sub_ps(z0,k2),g2);
+        __m256 const x3 = _mm256_add_ps(x0,g3);
+        __m256 const y3 = _mm256_add_ps(y0,g3);
+        __m256 const z3 = _mm256_add_ps(z0,g3);
+
+        __m256i const ii = _mm256_and_si256(i,mask);
+        __m256i const jj = _mm256_and_si256(j,mask);
+        __m256i const kk = _mm256_and_si256(kz,mask);
+
+        __m256i const h0 = hash3_avx2(P,ii,jj,kk);
+        __m256i const h1 = hash3_avx2(P,_mm256_add_epi32(ii,_mm256_cvttps_epi32(i1)),
+                                        _mm256_add_epi32(jj,_mm256_cvttps_epi32(j1)),
+                                        _mm256_add_epi32(kk,_mm256_cvttps_epi32(k1)));
+        __m256i const h2 = hash3_avx2(P,_mm256_add_epi32(ii,_mm256_cvttps_epi32(i2)),
+                                        _mm256_add_epi32(jj,_mm256_cvttps_epi32(j2)),
+                                        _mm256_add_epi32(kk,_mm256_cvttps_epi32(k2)));
+        __m256i const h3 = hash3_avx2(P,_mm256_add_epi32(ii,one_i),_mm256_add_epi32(jj,one_i),_mm256_add_epi32(kk,one_i));
+
+        __m256 const n0 = _mm256_mul_ps(corner_weight_avx2(_mm256_sub_ps(limit,dot3_avx2(x0,y0,z0))),grad3_avx2(h0,x0,y0,z0));
+        __m256 const n1 = _mm256_mul_ps(corner_weight_avx2(_mm256_sub_ps(limit,dot3_avx2(x1,y1,z1))),grad3_avx2(h1,x1,y1,z1));
+        __m256 const n2 = _mm256_mul_ps(corner_weight_avx2(_mm256_sub_ps(limit,dot3_avx2(x2,y2,z2))),grad3_avx2(h2,x2,y2,z2));
+        __m256 const n3 = _mm256_mul_ps(corner_weight_avx2(_mm256_sub_ps(limit,dot3_avx2(x3,y3,z3))),grad3_avx2(h3,x3,y3,z3));
+
+        __m256 const sum = _mm256_add_ps(_mm256_add_ps(n0,n1),_mm256_add_ps(n2,n3));
+        _mm256_storeu_ps(out+k,_mm256_mul_ps(_mm256_set1_ps(32.0f),sum));
+    }
+    return k;
+}
+
+__attribute__((target("avx2")))
+inline __m256 dot4_avx2(__m256 const x,__m256 const y,__m256 const z,__m256 const w)
+{
+    return _mm256_add_ps(dot3_avx2(x,y,z),_mm256_mul_ps(w,w));
+}
+
+__attribute__((target("avx2")))
+size_t snoise4_batch_avx2(float const* x,float const* y,float const* z,float const* w,float* out,size_t const n)
+{
+    int const* const P = perm32();
+    __m256 const one = _mm256_set1_ps(1.0f);
+    __m256 const two = _mm256_set1_ps(2.0f);
+    __m256 const three = _mm256_set1_ps(3.0f);
+    __m256 const g1 = _mm256_set1_ps(G4f);
+    __m256 const g2 = _mm256_set1_ps(2.0f*G4f);
+    __m256 const g3 = _mm256_set1_ps(3.0f*G4f);
+    __m256 const g4 = _mm256_set1_ps(4.0f*G4f-1.0f);
+    __m256 const limit = _mm256_set1_ps(0.6f);
+    __m256i const mask = _mm256_set1_epi32(255);
+    __m256i const one_i = _mm256_set1_epi32(1);
+
+    size_t k = 0;
+    for( ; k+8<=n ; k+=8)
+    {
+        __m256 const px = _mm256_loadu_ps(x+k);
+        __m256 const py = _mm256_loadu_ps(y+k);
+        __m256 const pz = _mm256_loadu_ps(z+k);
+        __m256 const pw = _mm256_loadu_ps(w+k);
+
+        __m256 const s = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(px,py),_mm256_add_ps(pz,pw)),_mm256_set1_ps(F4f));
+        __m256 const fi = _mm256_floor_ps(_mm256_add_ps(px,s));
+        __m256 const fj = _mm256_floor_ps(_mm256_add_ps(py,s));
+        __m256 const fk = _mm256_floor_ps(_mm256_add_ps(pz,s));
+        __m256 const fl = _mm256_floor_ps(_mm256_add_ps(pw,s));
+        __m256i const i = _mm256_cvttps_epi32(fi);
+        __m256i const j = _mm256_cvttps_epi32(fj);
+        __m256i const kz = _mm256_cvttps_epi32(fk);
+        __m256i const l = _mm256_cvttps_epi32(fl);
+
+        __m256i const sum_index = _mm256_add_epi32(_mm256_add_epi32(i,j),_mm256_add_epi32(kz,l));
+        __m256 const t = _mm256_mul_ps(_mm256_cvtepi32_ps(sum_index),g1);
+        __m256 const x0 = _mm256_sub_ps(px,_mm256_sub_ps(fi,t));
+        __m256 const y0 = _mm256_sub_ps(py,_mm256_sub_ps(fj,t));
+        __m256 const z0 = _mm256_sub_ps(pz,_mm256_sub_ps(fk,t));
+        __m256 const w0 = _mm256_sub_ps(pw,_mm256_sub_ps(fl,t));
+
+        __m256 const c1 = gt_avx2(x0,y0), c2 = gt_avx2(x0,z0), c3 = gt_avx2(y0,z0);
+        __m256 const c4 = gt_avx2(x0,w0), c5 = gt_avx2(y0,w0), c6 = gt_avx2(z0,w0);
+        __m256 const rx = _mm256_add_ps(_mm256_add_ps(c1,c2),c4);
+        __m256 const ry = _mm256_add_ps(_mm256_add_ps(_mm256_sub_ps(one,c1),c3),c5);
+        __m256 const rz = _mm256_add_ps(_mm256_add_ps(_mm256_sub_ps(one,c2),_mm256_sub_ps(one,c3)),c6);
+        __m256 const rw = _mm256_sub_ps(three,_mm256_add_ps(_mm256_add_ps(c4,c5),c6));
+
+        __m256 const i1 = ge_avx2(rx,three), j1 = ge_avx2(ry,three), k1 = ge_avx2(rz,three), l1 = ge_avx2(rw,three);
+        __m256 const i2 = ge_avx2(rx,two),   j2 = ge_avx2(ry,two),   k2 = ge_avx2(rz,two),   l2 = ge_avx2(rw,two);
+        __m256 const i3 = ge_avx2(rx,one),   j3 = ge_avx2(ry,one),   k3 = ge_avx2(rz,one),   l3 = ge_avx2(rw,one);
+
+        __m256 const x1 = _mm256_add_ps(_mm256_sub_ps(x0,i1),g1);
+        __m256 const y1 = _mm256_add_ps(_mm256_sub_ps(y0,j1),g1);
+        __m256 const z1 = _mm256_add_ps(_mm256_sub_ps(z0,k1),g1);
+        __m256 const w1 = _mm256_add_ps(_mm256_sub_ps(w0,l1),g1);
+        __m256 const x2 = _mm256_add_ps(_mm256_sub_ps(x0,i2),g2);
+        __m256 const y2 = _mm256_add_ps(_mm256_sub_ps(y0,j2),g2);
+        __m256 const z2 = _mm256_add_ps(_mm256_sub_ps(z0,k2),g2);
+        __m256 const w2 = _mm256_add_ps(_mm256_sub_ps(w0,l2),g2);
+        __m256 const x3 = _mm256_add_ps(_mm256_sub_ps(x0,i3),g3);
+        __m256 const y3 = _mm256_add_ps(_mm256_sub_ps(y0,j3),g3);
+        __m256 const z3 = _mm256_add_ps(_mm256_sub_ps(z0,k3),g3);
+        __m256 const w3 = _mm256_add_ps(_mm256_sub_ps(w0,l3),g3);
+        __m256 const x4 = _mm256_add_ps(x0,g4);
+        __m256 const y4 = _mm256_add_ps(y0,g4);
+        __m256 const z4 = _mm256_add_ps(z0,g4);
+        __m256 const w4 = _mm256_add_ps(w0,g4);
+
+        __m256i const ii = _mm256_and_si256(i,mask);
+        __m256i const jj = _mm256_and_si256(j,mask);
+        __m256i const kk = _mm256_and_si256(kz,mask);
+        __m256i const ll = _mm256_and_si256(l,mask);
+
+        __m256i const h0 = hash4_avx2(P,ii,jj,kk,ll);
+        __m256i const h1 = hash4_avx2(P,_mm256_add_epi32(ii,_mm256_cvttps_epi32(i1)),_mm256_add_epi32(jj,_mm256_cvttps_epi32(j1)),
+                                        _mm256_add_epi32(kk,_mm256_cvttps_epi32(k1)),_mm256_add_epi32(ll,_mm256_cvttps_epi32(l1)));
+        __m256i const h2 = hash4_avx2(P,_mm256_add_epi32(ii,_mm256_cvttps_epi32(i2)),_mm256_add_epi32(jj,_mm256_cvttps_epi32(j2)),
+                                        _mm256_add_epi32(kk,_mm256_cvttps_epi32(k2)),_mm256_add_epi32(ll,_mm256_cvttps_epi32(l2)));
+        __m256i const h3 = hash4_avx2(P,_mm256_add_epi32(ii,_mm256_cvttps_epi32(i3)),_mm256_add_epi32(jj,_mm256_cvttps_epi32(j3)),
+                                        _mm256_add_epi32(kk,_mm256_cvttps_epi32(k3)),_mm256_add_epi32(ll,_mm256_cvttps_epi32(l3)));
+        __m256i const h4 = hash4_avx2(P,_mm256_add_epi32(ii,one_i),_mm256_add_epi32(jj,one_i),
+                                        _mm256_add_epi32(kk,one_i),_mm256_add_epi32(ll,one_i));
+
+        __m256 const n0 = _mm256_mul_ps(corner_weight_avx2(_mm256_sub_ps(limit,dot4_avx2(x0,y0,z0,w0))),grad4_avx2(h0,x0,y0,z0,w0));
+        __m256 const n1 = _mm256_mul_ps(corner_weight_avx2(_mm256_sub_ps(limit,dot4_avx2(x1,y1,z1,w1))),grad4_avx2(h1,x1,y1,z1,w1));
+        __m256 const n2 = _mm256_mul_ps(corner_weight_avx2(_mm256_sub_ps(limit,dot4_avx2(x2,y2,z2,w2))),grad4_avx2(h2,x2,y2,z2,w2));
+        __m256 const n3 = _mm256_mul_ps(corner_weight_avx2(_mm256_sub_ps(limit,dot4_avx2(x3,y3,z3,w3))),grad4_avx2(h3,x3,y3,z3,w3));
+        __m256 const n4 = _mm256_mul_ps(corner_weight_avx2(_mm256_sub_ps(limit,dot4_avx2(x4,y4,z4,w4))),grad4_avx2(h4,x4,y4,z4,w4));
+
+        __m256 const sum = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(n0,n1),_mm256_add_ps(n2,n3)),n4);
+        _mm256_storeu_ps(out+k,_mm256_mul_ps(_mm256_set1_ps(27.0f),sum));
+    }
+    return k;
+}
+
+bool avx2_supported()
+{
+    static bool const supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+
+#endif
+
+}
+
+void snoise3_batch(const float* x,const float* y,const float* z,float* out,size_t n)
+{
+    size_t begin = 0;
+#ifdef SIMPLEX_BATCH_X86
+    if(avx2_supported())
+        begin = snoise3_batch_avx2(x,y,z,out,n);
+#endif
+    snoise3_batch_scalar(x,y,z,out,begin,n);
+}
+
+void snoise4_batch(const float* x,const float* y,const float* z,const float* w,float* out,size_t n)
+{
+    size_t begin = 0;
+#ifdef SIMPLEX_BATCH_X86
+    if(avx2_supported())
+        begin = snoise4_batch_avx2(x,y,z,w,out,n);
+#endif
+    snoise4_batch_scalar(x,y,z,w,out,begin,n);
+}
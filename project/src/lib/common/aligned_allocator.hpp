@@ -0,0 +1,74 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef ALIGNED_ALLOCATOR_HPP
+#define ALIGNED_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+namespace cpe
+{
+
+/** STL allocator returning memory aligned on ALIGNMENT bytes (cache line / SIMD register) */
+template <typename T,std::size_t ALIGNMENT=64>
+class aligned_allocator
+{
+public:
+
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind { typedef aligned_allocator<U,ALIGNMENT> other; };
+
+    aligned_allocator() {}
+    template <typename U>
+    aligned_allocator(aligned_allocator<U,ALIGNMENT> const&) {}
+
+    T* allocate(std::size_t n)
+    {
+        void* p = nullptr;
+        if(n==0)
+            n = 1;
+        if(posix_memalign(&p,ALIGNMENT,n*sizeof(T))!=0)
+            throw std::bad_alloc();
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p,std::size_t)
+    {
+        std::free(p);
+    }
+};
+
+template <typename T,typename U,std::size_t A>
+bool operator==(aligned_allocator<T,A> const&,aligned_allocator<U,A> const&) {return true;}
+template <typename T,typename U,std::size_t A>
+bool operator!=(aligned_allocator<T,A> const&,aligned_allocator<U,A> const&) {return false;}
+
+/** std::vector with aligned storage */
+template <typename T>
+using aligned_vector = std::vector<T,aligned_allocator<T> >;
+
+}
+
+#endif
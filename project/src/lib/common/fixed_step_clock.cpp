@@ -0,0 +1,94 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fixed_step_clock.hpp"
+#include "error_handling.hpp"
+
+#include <cmath>
+
+namespace cpe
+{
+
+fixed_step_clock::fixed_step_clock(double const step_duration_param,int const max_substeps_param)
+    :step_duration_data(step_duration_param),max_substeps_data(max_substeps_param)
+{
+    ASSERT_CPE(step_duration_param>0,"Step duration should be >0");
+    ASSERT_CPE(max_substeps_param>0,"Maximal number of substeps should be >0");
+    reset();
+}
+
+void fixed_step_clock::reset()
+{
+    accumulator = 0.0;
+    last_time = std::chrono::steady_clock::now();
+    step_counter_data = 0;
+    dropped_steps_data = 0;
+}
+
+int fixed_step_clock::advance()
+{
+    auto const now = std::chrono::steady_clock::now();
+    double const elapsed = std::chrono::duration<double>(now-last_time).count();
+    last_time = now;
+    return advance(elapsed);
+}
+
+int fixed_step_clock::advance(double const elapsed_seconds)
+{
+    if(elapsed_seconds>0)
+        accumulator += elapsed_seconds;
+
+    double const N_available = std::floor(accumulator/step_duration_data);
+    int N_step = static_cast<int>(N_available);
+    accumulator -= N_available*step_duration_data;
+
+    //drop the late steps that cannot be caught up
+    if(N_step>max_substeps_data)
+    {
+        dropped_steps_data += N_step-max_substeps_data;
+        N_step = max_substeps_data;
+    }
+
+    step_counter_data += N_step;
+    return N_step;
+}
+
+float fixed_step_clock::alpha() const
+{
+    float const a = static_cast<float>(accumulator/step_duration_data);
+    return a<0.0f ? 0.0f : (a>1.0f ? 1.0f : a);
+}
+
+double fixed_step_clock::step_duration() const {return step_duration_data;}
+void fixed_step_clock::set_step_duration(double const duration)
+{
+    ASSERT_CPE(duration>0,"Step duration should be >0");
+    step_duration_data = duration;
+}
+
+int fixed_step_clock::max_substeps() const {return max_substeps_data;}
+void fixed_step_clock::set_max_substeps(int const N)
+{
+    ASSERT_CPE(N>0,"Maximal number of substeps should be >0");
+    max_substeps_data = N;
+}
+
+long fixed_step_clock::step_counter() const {return step_counter_data;}
+long fixed_step_clock::dropped_steps() const {return dropped_steps_data;}
+
+}
@@ -0,0 +1,81 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef FIXED_STEP_CLOCK_HPP
+#define FIXED_STEP_CLOCK_HPP
+
+#include <chrono>
+
+namespace cpe
+{
+
+/** Fixed time step accumulator driven by the wall clock.
+ *  The elapsed real time is accumulated and consumed by steps of constant
+ *  duration: advance() returns how many simulation steps to run now (possibly
+ *  0), independently of how often it is called. The number of steps per call
+ *  is capped to avoid the "spiral of death" when a step is slower than real
+ *  time (the late time is then dropped). alpha() gives the fraction of step
+ *  remaining in the accumulator, used to interpolate the rendered state
+ *  between the two last simulated states. */
+class fixed_step_clock
+{
+public:
+
+    fixed_step_clock(double step_duration_param=0.025,int max_substeps_param=4);
+
+    /** Restart the accumulation from now (no pending step) */
+    void reset();
+
+    /** Accumulate the real time elapsed since the previous call and return the number of steps to run */
+    int advance();
+    /** Same as advance() with an explicit elapsed duration in seconds */
+    int advance(double elapsed_seconds);
+
+    /** Fraction in [0,1) of step accumulated after the last step */
+    float alpha() const;
+
+    /** Real time duration (s) of one simulation step */
+    double step_duration() const;
+    void set_step_duration(double duration);
+    /** Maximal number of steps returned by one call to advance */
+    int max_substeps() const;
+    void set_max_substeps(int N);
+
+    /** Total number of steps returned by advance since the last reset */
+    long step_counter() const;
+    /** Total number of steps dropped by the substep cap since the last reset */
+    long dropped_steps() const;
+
+private:
+
+    double step_duration_data;
+    int max_substeps_data;
+
+    /** Time accumulated and not yet consumed by a step (s) */
+    double accumulator = 0.0;
+    std::chrono::steady_clock::time_point last_time;
+
+    long step_counter_data = 0;
+    long dropped_steps_data = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,90 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mapped_file.hpp"
+
+#include "error_handling.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace cpe
+{
+
+mapped_file::mapped_file()
+    :file_data(nullptr),file_size(0)
+{}
+
+mapped_file::~mapped_file()
+{
+    close();
+}
+
+void mapped_file::open(std::string const& filename)
+{
+    close();
+
+    int const fid = ::open(filename.c_str(),O_RDONLY);
+    if(fid<0)
+        throw exception_cpe("Cannot open file "+filename,EXCEPTION_PARAMETERS_CPE);
+
+    struct stat status;
+    if(fstat(fid,&status)!=0 || status.st_size<=0)
+    {
+        ::close(fid);
+        throw exception_cpe("Cannot read the size of file "+filename,EXCEPTION_PARAMETERS_CPE);
+    }
+
+    int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    flags |= MAP_POPULATE;
+#endif
+    void* const data = mmap(nullptr,status.st_size,PROT_READ,flags,fid,0);
+    ::close(fid);
+    if(data==MAP_FAILED)
+        throw exception_cpe("Cannot map file "+filename,EXCEPTION_PARAMETERS_CPE);
+
+    file_data = data;
+    file_size = status.st_size;
+}
+
+void mapped_file::close()
+{
+    if(file_data!=nullptr)
+        munmap(file_data,file_size);
+    file_data = nullptr;
+    file_size = 0;
+}
+
+bool mapped_file::is_open() const
+{
+    return file_data!=nullptr;
+}
+
+char const* mapped_file::data() const
+{
+    return static_cast<char const*>(file_data);
+}
+
+size_t mapped_file::size() const
+{
+    return file_size;
+}
+
+}
@@ -0,0 +1,61 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+
+namespace cpe
+{
+
+/** Read only file mapped in memory.
+ *  The pages are loaded at the opening (instead of faulting during the
+ *  reads), the mapping is released by close or at the destruction. */
+class mapped_file
+{
+public:
+
+    mapped_file();
+    ~mapped_file();
+
+    mapped_file(mapped_file const&) = delete;
+    mapped_file& operator=(mapped_file const&) = delete;
+
+    /** Map a file (exception_cpe if it cannot be opened or mapped) */
+    void open(std::string const& filename);
+    void close();
+    bool is_open() const;
+
+    /** First byte of the file */
+    char const* data() const;
+    /** Size of the file in bytes */
+    size_t size() const;
+
+private:
+
+    void* file_data;
+    size_t file_size;
+};
+
+}
+
+#endif
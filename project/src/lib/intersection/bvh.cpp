@@ -0,0 +1,670 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "bvh.hpp"
+
+#include "../mesh/mesh_basic.hpp"
+#include "../common/error_handling.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace cpe
+{
+
+/** Number of bins of the SAH along each axis */
+static int const bin_count = 16;
+/** Nodes with more triangles are always split (when their centroids differ) */
+static int const max_leaf_size = 4;
+/** Deeper nodes are leaves whatever their size (bounds the traversal stack) */
+static int const max_depth = 60;
+static int const stack_size = 64;
+
+static float const infinity = std::numeric_limits<float>::infinity();
+
+static float dot3(float const* u,float const* v)
+{
+    return u[0]*v[0]+u[1]*v[1]+u[2]*v[2];
+}
+
+static void sub3(float const* u,float const* v,float* w)
+{
+    w[0] = u[0]-v[0];
+    w[1] = u[1]-v[1];
+    w[2] = u[2]-v[2];
+}
+
+static void cross3(float const* u,float const* v,float* w)
+{
+    w[0] = u[1]*v[2]-u[2]*v[1];
+    w[1] = u[2]*v[0]-u[0]*v[2];
+    w[2] = u[0]*v[1]-u[1]*v[0];
+}
+
+/** Half of the area of the box (only compared with other areas) */
+static float half_area(float const* box_min,float const* box_max)
+{
+    float const dx = box_max[0]-box_min[0];
+    float const dy = box_max[1]-box_min[1];
+    float const dz = box_max[2]-box_min[2];
+    return dx*dy+dy*dz+dz*dx;
+}
+
+/** Squared distance between the point p and the box (0 inside) */
+static float box_distance2(float const* box_min,float const* box_max,float const* p)
+{
+    float d2 = 0.0f;
+    for(int k=0 ; k<3 ; ++k)
+    {
+        float const d = std::max(std::max(box_min[k]-p[k],0.0f),p[k]-box_max[k]);
+        d2 += d*d;
+    }
+    return d2;
+}
+
+/** Parameter t where the ray enters the box, false if it misses it in [0,t_max] */
+static bool ray_box(float const* box_min,float const* box_max,float const* origin,float const* inv_direction,float const t_max,float& t_enter)
+{
+    float t0 = 0.0f, t1 = t_max;
+    for(int k=0 ; k<3 ; ++k)
+    {
+        float ta = (box_min[k]-origin[k])*inv_direction[k];
+        float tb = (box_max[k]-origin[k])*inv_direction[k];
+        if(ta>tb)
+            std::swap(ta,tb);
+        t0 = std::max(t0,ta);
+        t1 = std::min(t1,tb);
+    }
+    t_enter = t0;
+    return t0<=t1;
+}
+
+/** Closest point of the triangle (a,b,c) to p written as a+v.(b-a)+w.(c-a) (Ericson, Real-Time Collision Detection) */
+static void closest_point_triangle(float const* p,float const* a,float const* b,float const* c,float& v,float& w)
+{
+    float ab[3],ac[3],ap[3],bp[3],cp[3];
+    sub3(b,a,ab);
+    sub3(c,a,ac);
+
+    sub3(p,a,ap);
+    float const d1 = dot3(ab,ap), d2 = dot3(ac,ap);
+    if(d1<=0.0f && d2<=0.0f) {v = 0.0f; w = 0.0f; return;}
+
+    sub3(p,b,bp);
+    float const d3 = dot3(ab,bp), d4 = dot3(ac,bp);
+    if(d3>=0.0f && d4<=d3) {v = 1.0f; w = 0.0f; return;}
+
+    float const vc = d1*d4-d3*d2;
+    if(vc<=0.0f && d1>=0.0f && d3<=0.0f) {v = d1/(d1-d3); w = 0.0f; return;}
+
+    sub3(p,c,cp);
+    float const d5 = dot3(ab,cp), d6 = dot3(ac,cp);
+    if(d6>=0.0f && d5<=d6) {v = 0.0f; w = 1.0f; return;}
+
+    float const vb = d5*d2-d1*d6;
+    if(vb<=0.0f && d2>=0.0f && d6<=0.0f) {v = 0.0f; w = d2/(d2-d6); return;}
+
+    float const va = d3*d6-d5*d4;
+    if(va<=0.0f && d4-d3>=0.0f && d5-d6>=0.0f)
+    {
+        w = (d4-d3)/((d4-d3)+(d5-d6));
+        v = 1.0f-w;
+        return;
+    }
+
+    float const denom = 1.0f/(va+vb+vc);
+    v = vb*denom;
+    w = vc*denom;
+}
+
+/** Squared distance between p and the triangle given by its 9 coordinates, closest point in q */
+static float triangle_distance2(float const* p,float const* corners,float* q)
+{
+    float const* const a = corners;
+    float const* const b = corners+3;
+    float const* const c = corners+6;
+    float v,w;
+    closest_point_triangle(p,a,b,c,v,w);
+
+    float d2 = 0.0f;
+    for(int k=0 ; k<3 ; ++k)
+    {
+        q[k] = a[k]+v*(b[k]-a[k])+w*(c[k]-a[k]);
+        d2 += (p[k]-q[k])*(p[k]-q[k]);
+    }
+    return d2;
+}
+
+/** Intersection of the ray with the triangle given by its 9 coordinates (Moller-Trumbore) */
+static bool ray_triangle(float const* origin,float const* direction,float const* corners,float& t,float& u,float& v)
+{
+    float e1[3],e2[3],pv[3],tv[3],qv[3];
+    sub3(corners+3,corners,e1);
+    sub3(corners+6,corners,e2);
+    cross3(direction,e2,pv);
+
+    float const det = dot3(e1,pv);
+    if(std::abs(det)<1e-12f)
+        return false;
+    float const inv_det = 1.0f/det;
+
+    sub3(origin,corners,tv);
+    u = dot3(tv,pv)*inv_det;
+    if(u<0.0f || u>1.0f)
+        return false;
+
+    cross3(tv,e1,qv);
+    v = dot3(direction,qv)*inv_det;
+    if(v<0.0f || u+v>1.0f)
+        return false;
+
+    t = dot3(e2,qv)*inv_det;
+    return true;
+}
+
+
+void bvh::build(mesh_basic const& m)
+{
+    int const N_triangle = m.size_connectivity();
+    ASSERT_CPE(N_triangle>0,"Cannot build a bvh without triangle");
+
+    float const* const vertex = m.pointer_vertex();
+    int const* const triangle = m.pointer_triangle_index();
+
+    //bounding box and centroid (center of the box) of each triangle
+    std::vector<float> centroid(3*N_triangle);
+    std::vector<float> triangle_box(6*N_triangle);
+    #pragma omp parallel for schedule(static)
+    for(int k=0 ; k<N_triangle ; ++k)
+    {
+        for(int d=0 ; d<3 ; ++d)
+        {
+            float const a = vertex[3*triangle[3*k+0]+d];
+            float const b = vertex[3*triangle[3*k+1]+d];
+            float const c = vertex[3*triangle[3*k+2]+d];
+            float const x_min = std::min(a,std::min(b,c));
+            float const x_max = std::max(a,std::max(b,c));
+            triangle_box[6*k+d] = x_min;
+            triangle_box[6*k+3+d] = x_max;
+            centroid[3*k+d] = 0.5f*(x_min+x_max);
+        }
+    }
+
+    triangle_id.resize(N_triangle);
+    for(int k=0 ; k<N_triangle ; ++k)
+        triangle_id[k] = k;
+
+    //at most 2N-1 nodes: no reallocation during the build
+    nodes.clear();
+    nodes.reserve(2*N_triangle);
+    depth_tree = build_node(0,N_triangle,0,centroid,triangle_box);
+
+    triangle_slot.resize(N_triangle);
+    for(int k=0 ; k<N_triangle ; ++k)
+        triangle_slot[triangle_id[k]] = k;
+
+    copy_corners(m);
+}
+
+int bvh::build_node(int const begin,int const end,int const depth_node,std::vector<float> const& centroid,std::vector<float> const& triangle_box)
+{
+    int const index = nodes.size();
+    nodes.push_back(node());
+    int const N = end-begin;
+
+    //bounds of the triangles and of their centroids
+    float box_min[3] = {infinity,infinity,infinity};
+    float box_max[3] = {-infinity,-infinity,-infinity};
+    float centroid_min[3] = {infinity,infinity,infinity};
+    float centroid_max[3] = {-infinity,-infinity,-infinity};
+    for(int k=begin ; k<end ; ++k)
+    {
+        int const t = triangle_id[k];
+        for(int d=0 ; d<3 ; ++d)
+        {
+            box_min[d] = std::min(box_min[d],triangle_box[6*t+d]);
+            box_max[d] = std::max(box_max[d],triangle_box[6*t+3+d]);
+            centroid_min[d] = std::min(centroid_min[d],centroid[3*t+d]);
+            centroid_max[d] = std::max(centroid_max[d],centroid[3*t+d]);
+        }
+    }
+    for(int d=0 ; d<3 ; ++d)
+    {
+        nodes[index].box_min[d] = box_min[d];
+        nodes[index].box_max[d] = box_max[d];
+    }
+
+    if(N==1 || depth_node>=max_depth)
+    {
+        nodes[index].index = begin;
+        nodes[index].count = N;
+        return 0;
+    }
+
+    //binned SAH: cost of a split (A_left.N_left+A_right.N_right)/A + 1 compared to N for a leaf
+    float best_cost = infinity;
+    int best_axis = -1;
+    int best_split = 0;
+    for(int axis=0 ; axis<3 ; ++axis)
+    {
+        float const extent = centroid_max[axis]-centroid_min[axis];
+        if(!(extent>0.0f))
+            continue;
+        float const scale = bin_count/extent;
+
+        int bin_size[bin_count] = {0};
+        float bin_min[bin_count][3], bin_max[bin_count][3];
+        for(int b=0 ; b<bin_count ; ++b)
+            for(int d=0 ; d<3 ; ++d)
+            {
+                bin_min[b][d] = infinity;
+                bin_max[b][d] = -infinity;
+            }
+
+        for(int k=begin ; k<end ; ++k)
+        {
+            int const t = triangle_id[k];
+            int const b = std::min(static_cast<int>((centroid[3*t+axis]-centroid_min[axis])*scale),bin_count-1);
+            ++bin_size[b];
+            for(int d=0 ; d<3 ; ++d)
+            {
+                bin_min[b][d] = std::min(bin_min[b][d],triangle_box[6*t+d]);
+                bin_max[b][d] = std::max(bin_max[b][d],triangle_box[6*t+3+d]);
+            }
+        }
+
+        //right side of the split s: bins [s,bin_count)
+        float right_cost[bin_count];
+        float acc_min[3] = {infinity,infinity,infinity};
+        float acc_max[3] = {-infinity,-infinity,-infinity};
+        int acc_size = 0;
+        for(int b=bin_count-1 ; b>0 ; --b)
+        {
+            acc_size += bin_size[b];
+            for(int d=0 ; d<3 ; ++d)
+            {
+                acc_min[d] = std::min(acc_min[d],bin_min[b][d]);
+                acc_max[d] = std::max(acc_max[d],bin_max[b][d]);
+            }
+            right_cost[b] = acc_size>0 ? acc_size*half_area(acc_min,acc_max) : 0.0f;
+        }
+
+        //left side: bins [0,s)
+        for(int d=0 ; d<3 ; ++d)
+        {
+            acc_min[d] = infinity;
+            acc_max[d] = -infinity;
+        }
+        acc_size = 0;
+        for(int s=1 ; s<bin_count ; ++s)
+        {
+            acc_size += bin_size[s-1];
+            for(int d=0 ; d<3 ; ++d)
+            {
+                acc_min[d] = std::min(acc_min[d],bin_min[s-1][d]);
+                acc_max[d] = std::max(acc_max[d],bin_max[s-1][d]);
+            }
+            if(acc_size==0 || acc_size==N)
+                continue;
+            float const cost = acc_size*half_area(acc_min,acc_max)+right_cost[s];
+            if(cost<best_cost)
+            {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = s;
+            }
+        }
+    }
+
+    float const area = std::max(half_area(box_min,box_max),1e-30f);
+    bool const split_useful = best_axis>=0 && 1.0f+best_cost/area<N;
+    if(N<=max_leaf_size && !split_useful)
+    {
+        nodes[index].index = begin;
+        nodes[index].count = N;
+        return 0;
+    }
+
+    //split at the best bin, or in the middle if all the centroids are identical
+    int middle = begin+N/2;
+    if(best_axis>=0)
+    {
+        float const scale = bin_count/(centroid_max[best_axis]-centroid_min[best_axis]);
+        float const origin = centroid_min[best_axis];
+        int const axis = best_axis;
+        int const split = best_split;
+        middle = std::partition(triangle_id.begin()+begin,triangle_id.begin()+end,[&](int const t)
+        {
+            return std::min(static_cast<int>((centroid[3*t+axis]-origin)*scale),bin_count-1)<split;
+        })-triangle_id.begin();
+    }
+
+    int const depth_first = build_node(begin,middle,depth_node+1,centroid,triangle_box);
+    nodes[index].index = nodes.size();
+    nodes[index].count = 0;
+    int const depth_second = build_node(middle,end,depth_node+1,centroid,triangle_box);
+
+    return 1+std::max(depth_first,depth_second);
+}
+
+void bvh::copy_corners(mesh_basic const& m)
+{
+    int const N_triangle = triangle_id.size();
+    float const* const vertex = m.pointer_vertex();
+    int const* const triangle = m.pointer_triangle_index();
+
+    corner.resize(9*N_triangle);
+    #pragma omp parallel for schedule(static)
+    for(int slot=0 ; slot<N_triangle ; ++slot)
+    {
+        int const t = triangle_id[slot];
+        for(int j=0 ; j<3 ; ++j)
+            for(int d=0 ; d<3 ; ++d)
+                corner[9*slot+3*j+d] = vertex[3*triangle[3*t+j]+d];
+    }
+}
+
+void bvh::leaf_box(node& n) const
+{
+    for(int d=0 ; d<3 ; ++d)
+    {
+        n.box_min[d] = infinity;
+        n.box_max[d] = -infinity;
+    }
+    for(int slot=n.index ; slot<n.index+n.count ; ++slot)
+        for(int j=0 ; j<3 ; ++j)
+            for(int d=0 ; d<3 ; ++d)
+            {
+                n.box_min[d] = std::min(n.box_min[d],corner[9*slot+3*j+d]);
+                n.box_max[d] = std::max(n.box_max[d],corner[9*slot+3*j+d]);
+            }
+}
+
+void bvh::refit(mesh_basic const& m)
+{
+    ASSERT_CPE(m.size_connectivity()==size_triangle(),"The mesh does not have the triangles of the bvh");
+    copy_corners(m);
+
+    int const N_node = nodes.size();
+    #pragma omp parallel for schedule(static)
+    for(int k=0 ; k<N_node ; ++k)
+        if(nodes[k].count>0)
+            leaf_box(nodes[k]);
+
+    //the children are stored after their parent
+    for(int k=N_node-1 ; k>=0 ; --k)
+    {
+        node& n = nodes[k];
+        if(n.count>0)
+            continue;
+        node const& first = nodes[k+1];
+        node const& second = nodes[n.index];
+        for(int d=0 ; d<3 ; ++d)
+        {
+            n.box_min[d] = std::min(first.box_min[d],second.box_min[d]);
+            n.box_max[d] = std::max(first.box_max[d],second.box_max[d]);
+        }
+    }
+}
+
+int bvh::size_node() const
+{
+    return nodes.size();
+}
+
+int bvh::size_triangle() const
+{
+    return triangle_id.size();
+}
+
+int bvh::depth() const
+{
+    return depth_tree;
+}
+
+vec3 bvh::triangle_normal(int const triangle) const
+{
+    ASSERT_CPE(triangle>=0 && triangle<size_triangle(),"Incorrect triangle index");
+    float const* const corners = &corner[9*triangle_slot[triangle]];
+    float e1[3],e2[3],n[3];
+    sub3(corners+3,corners,e1);
+    sub3(corners+6,corners,e2);
+    cross3(e1,e2,n);
+    return normalized(vec3(n[0],n[1],n[2]));
+}
+
+bool bvh::closest_point(vec3 const& p,float const max_distance,bvh_closest_point& result) const
+{
+    result.triangle = -1;
+    if(nodes.empty())
+        return false;
+
+    float const q[3] = {p.x(),p.y(),p.z()};
+    float best_d2 = max_distance<0.0f ? infinity : max_distance*max_distance;
+    float best_point[3] = {0.0f,0.0f,0.0f};
+    int best_slot = -1;
+
+    int stack[stack_size];
+    int N_stack = 0;
+    stack[N_stack++] = 0;
+    while(N_stack>0)
+    {
+        int const k = stack[--N_stack];
+        node const& n = nodes[k];
+        if(box_distance2(n.box_min,n.box_max,q)>=best_d2)
+            continue;
+
+        if(n.count>0)
+        {
+            for(int slot=n.index ; slot<n.index+n.count ; ++slot)
+            {
+                float c[3];
+                float const d2 = triangle_distance2(q,&corner[9*slot],c);
+                if(d2<best_d2)
+                {
+                    best_d2 = d2;
+                    best_slot = slot;
+                    best_point[0] = c[0]; best_point[1] = c[1]; best_point[2] = c[2];
+                }
+            }
+        }
+        else
+        {
+            //visit the closest child first
+            int near = k+1, far = n.index;
+            float d_near = box_distance2(nodes[near].box_min,nodes[near].box_max,q);
+            float d_far = box_distance2(nodes[far].box_min,nodes[far].box_max,q);
+            if(d_far<d_near)
+            {
+                std::swap(near,far);
+                std::swap(d_near,d_far);
+            }
+            if(d_far<best_d2)
+                stack[N_stack++] = far;
+            if(d_near<best_d2)
+                stack[N_stack++] = near;
+        }
+    }
+
+    if(best_slot<0)
+        return false;
+
+    result.triangle = triangle_id[best_slot];
+    result.point = vec3(best_point[0],best_point[1],best_point[2]);
+    result.distance = std::sqrt(best_d2);
+    return true;
+}
+
+bool bvh::ray(vec3 const& origin,vec3 const& direction,float const t_max,bvh_ray_hit& hit) const
+{
+    hit.triangle = -1;
+    if(nodes.empty())
+        return false;
+
+    float const o[3] = {origin.x(),origin.y(),origin.z()};
+    float const d[3] = {direction.x(),direction.y(),direction.z()};
+    float const inv_d[3] = {1.0f/d[0],1.0f/d[1],1.0f/d[2]};
+
+    float best_t = t_max;
+    int best_slot = -1;
+    float best_u = 0.0f, best_v = 0.0f;
+
+    int stack[stack_size];
+    int N_stack = 0;
+    float t_enter = 0.0f;
+    if(ray_box(nodes[0].box_min,nodes[0].box_max,o,inv_d,best_t,t_enter))
+        stack[N_stack++] = 0;
+    while(N_stack>0)
+    {
+        int const k = stack[--N_stack];
+        node const& n = nodes[k];
+
+        if(n.count>0)
+        {
+            for(int slot=n.index ; slot<n.index+n.count ; ++slot)
+            {
+                float t,u,v;
+                if(ray_triangle(o,d,&corner[9*slot],t,u,v) && t>=0.0f && t<best_t)
+                {
+                    best_t = t;
+                    best_slot = slot;
+                    best_u = u;
+                    best_v = v;
+                }
+            }
+        }
+        else
+        {
+            //the boxes are tested when the node is pushed, against the current best hit
+            int near = k+1, far = n.index;
+            float t_near = 0.0f, t_far = 0.0f;
+            bool hit_near = ray_box(nodes[near].box_min,nodes[near].box_max,o,inv_d,best_t,t_near);
+            bool hit_far = ray_box(nodes[far].box_min,nodes[far].box_max,o,inv_d,best_t,t_far);
+            if(hit_near && hit_far && t_far<t_near)
+                std::swap(near,far);
+            else if(!hit_near)
+            {
+                near = far;
+                hit_near = hit_far;
+                hit_far = false;
+            }
+            if(hit_far)
+                stack[N_stack++] = far;
+            if(hit_near)
+                stack[N_stack++] = near;
+        }
+    }
+
+    if(best_slot<0)
+        return false;
+
+    hit.triangle = triangle_id[best_slot];
+    hit.t = best_t;
+    hit.u = best_u;
+    hit.v = best_v;
+    return true;
+}
+
+template <typename FUNCTION>
+void bvh::sphere_traversal(float const* center,float const radius,FUNCTION f) const
+{
+    if(nodes.empty())
+        return;
+
+    float const r2 = radius*radius;
+    int stack[stack_size];
+    int N_stack = 0;
+    stack[N_stack++] = 0;
+    while(N_stack>0)
+    {
+        int const k = stack[--N_stack];
+        node const& n = nodes[k];
+        if(box_distance2(n.box_min,n.box_max,center)>r2)
+            continue;
+
+        if(n.count>0)
+        {
+            for(int slot=n.index ; slot<n.index+n.count ; ++slot)
+            {
+                float c[3];
+                if(triangle_distance2(center,&corner[9*slot],c)<=r2)
+                    f(slot);
+            }
+        }
+        else
+        {
+            //depth first order: the first child on top
+            stack[N_stack++] = n.index;
+            stack[N_stack++] = k+1;
+        }
+    }
+}
+
+void bvh::sphere_overlap(vec3 const& center,float const radius,std::vector<int>& triangles) const
+{
+    float const c[3] = {center.x(),center.y(),center.z()};
+    sphere_traversal(c,radius,[&](int const slot){triangles.push_back(triangle_id[slot]);});
+}
+
+void bvh::closest_point(float const* x,float const* y,float const* z,int const N,float const max_distance,std::vector<bvh_closest_point>& result) const
+{
+    result.resize(N);
+    #pragma omp parallel for schedule(dynamic,256)
+    for(int k=0 ; k<N ; ++k)
+        closest_point(vec3(x[k],y[k],z[k]),max_distance,result[k]);
+}
+
+void bvh::ray(std::vector<vec3> const& origin,std::vector<vec3> const& direction,float const t_max,std::vector<bvh_ray_hit>& hits) const
+{
+    ASSERT_CPE(origin.size()==direction.size(),"Error of size");
+    int const N = origin.size();
+    hits.resize(N);
+    #pragma omp parallel for schedule(dynamic,256)
+    for(int k=0 ; k<N ; ++k)
+        ray(origin[k],direction[k],t_max,hits[k]);
+}
+
+void bvh::sphere_overlap(std::vector<vec3> const& center,float const radius,std::vector<int>& offset,std::vector<int>& triangles) const
+{
+    int const N = center.size();
+    offset.assign(N+1,0);
+
+    //count, then fill at the offsets (same order as sequential queries)
+    #pragma omp parallel for schedule(dynamic,256)
+    for(int k=0 ; k<N ; ++k)
+    {
+        float const c[3] = {center[k].x(),center[k].y(),center[k].z()};
+        int count = 0;
+        sphere_traversal(c,radius,[&count](int){++count;});
+        offset[k+1] = count;
+    }
+    for(int k=0 ; k<N ; ++k)
+        offset[k+1] += offset[k];
+
+    triangles.resize(offset[N]);
+    #pragma omp parallel for schedule(dynamic,256)
+    for(int k=0 ; k<N ; ++k)
+    {
+        float const c[3] = {center[k].x(),center[k].y(),center[k].z()};
+        int position = offset[k];
+        sphere_traversal(c,radius,[&](int const slot){triangles[position++] = triangle_id[slot];});
+    }
+}
+
+}
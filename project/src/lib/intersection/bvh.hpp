@@ -0,0 +1,139 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef BVH_HPP
+#define BVH_HPP
+
+#include "../3d/vec3.hpp"
+#include <vector>
+
+namespace cpe
+{
+
+class mesh_basic;
+
+/** Closest point of a mesh to a query point */
+struct bvh_closest_point
+{
+    /** Index of the triangle in the mesh (-1 if no triangle is closer than the max distance) */
+    int triangle = -1;
+    /** Closest point on the triangle */
+    vec3 point;
+    /** Distance between the query and the closest point */
+    float distance = 0.0f;
+};
+
+/** First intersection of a ray with a mesh */
+struct bvh_ray_hit
+{
+    /** Index of the triangle in the mesh (-1 if the ray does not hit the mesh) */
+    int triangle = -1;
+    /** Parameter of the hit along the ray (origin+t*direction) */
+    float t = 0.0f;
+    /** Barycentric coordinates of the hit relative to the 2nd and 3rd vertices of the triangle */
+    float u = 0.0f;
+    float v = 0.0f;
+};
+
+/** Bounding volume hierarchy over the triangles of a mesh.
+ *
+ *  The tree is built with the surface area heuristic (binned over the
+ *  centroids) and stored as a flat array in depth first order: the first child
+ *  of an inner node is the next node, the node stores the index of the second
+ *  one. The coordinates of the triangles are copied in the order of the leaves,
+ *  so the tree does not refer to the mesh after the build.
+ *
+ *  A deforming mesh (same connectivity) only needs refit: the boxes are
+ *  recomputed bottom-up, the tree is kept. Its quality degrades if the
+ *  deformation is large, build it again in this case.
+ *
+ *  The batched queries are evaluated in parallel, each query is independent. */
+class bvh
+{
+public:
+
+    /** Build the tree over the triangles of the mesh */
+    void build(mesh_basic const& m);
+    /** Update the boxes after a deformation of the mesh (same triangles as the build) */
+    void refit(mesh_basic const& m);
+
+    /** Number of nodes */
+    int size_node() const;
+    /** Number of triangles */
+    int size_triangle() const;
+    /** Largest depth of a leaf (0 for a single leaf) */
+    int depth() const;
+    /** Unit normal of a triangle (index in the mesh) */
+    vec3 triangle_normal(int triangle) const;
+
+    /** Closest point of the mesh at a distance smaller than max_distance (no limit if max_distance<0).
+        \return false if there is no such point. */
+    bool closest_point(vec3 const& p,float max_distance,bvh_closest_point& result) const;
+    /** First hit of the ray origin+t*direction with t in [0,t_max].
+        \return false if the ray does not hit the mesh. */
+    bool ray(vec3 const& origin,vec3 const& direction,float t_max,bvh_ray_hit& hit) const;
+    /** Triangles at a distance smaller than the radius from the center (appended to triangles, mesh indices) */
+    void sphere_overlap(vec3 const& center,float radius,std::vector<int>& triangles) const;
+
+    /** Closest point of N query points given as coordinate arrays (one result per point) */
+    void closest_point(float const* x,float const* y,float const* z,int N,float max_distance,std::vector<bvh_closest_point>& result) const;
+    /** First hit of each ray (one result per ray) */
+    void ray(std::vector<vec3> const& origin,std::vector<vec3> const& direction,float t_max,std::vector<bvh_ray_hit>& hits) const;
+    /** Triangles overlapping each sphere: sphere k in triangles[offset[k],offset[k+1]) */
+    void sphere_overlap(std::vector<vec3> const& center,float radius,std::vector<int>& offset,std::vector<int>& triangles) const;
+
+private:
+
+    /** Node of the flat tree (32 bytes) */
+    struct node
+    {
+        float box_min[3];
+        /** Inner node: index of the second child. Leaf: first triangle (in the leaf order) */
+        int index;
+        float box_max[3];
+        /** Number of triangles of a leaf, 0 for an inner node */
+        int count;
+    };
+
+    /** Build the subtree over the triangles [begin,end) of triangle_id, returns the depth of the subtree */
+    int build_node(int begin,int end,int depth_node,std::vector<float> const& centroid,std::vector<float> const& triangle_box);
+    /** Copy the coordinates of the triangles of the mesh in the order of the leaves */
+    void copy_corners(mesh_basic const& m);
+    /** Bounding box of the triangles of a leaf */
+    void leaf_box(node& n) const;
+
+    /** Triangles overlapping the sphere, calls f(slot) for each one (slot in the leaf order) */
+    template <typename FUNCTION>
+    void sphere_traversal(float const* center,float radius,FUNCTION f) const;
+
+    /** Nodes in depth first order (the root is nodes[0]) */
+    std::vector<node> nodes;
+    /** Index in the mesh of the triangles, in the order of the leaves */
+    std::vector<int> triangle_id;
+    /** Position in the leaf order of each triangle of the mesh */
+    std::vector<int> triangle_slot;
+    /** Coordinates of the 3 corners of the triangles (9 floats each), in the order of the leaves */
+    std::vector<float> corner;
+    int depth_tree = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,540 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "signed_distance_field.hpp"
+
+#include "bvh.hpp"
+#include "../mesh/mesh_basic.hpp"
+#include "../common/error_handling.hpp"
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+namespace cpe
+{
+
+/** Cells per block along each axis, samples per block along each axis and per block */
+static int const block_size = 8;
+static int const block_side = block_size+1;
+static int const block_samples = block_side*block_side*block_side;
+
+/** Offsets of the 8 corners of a cell in the samples of a block */
+static int const corner_offset[8] = {0,1,block_side,block_side+1,
+                                     block_side*block_side,block_side*block_side+1,
+                                     block_side*block_side+block_side,block_side*block_side+block_side+1};
+
+/** Header of the binary file */
+static char const file_magic[8] = {'C','P','E','_','S','D','F','\0'};
+static uint32_t const file_version = 1;
+
+/** Data needed by the lookup (shared by the scalar and SIMD implementations) */
+struct sdf_lookup
+{
+    float origin[3];
+    float inv_h;
+    /** Largest value of the coordinate in cells (slightly smaller than the number of cells) */
+    float limit[3];
+    int N_block[3];
+    int const* block_index;
+    float const* values;
+};
+
+/** Angle weighted pseudo-normals of a closed mesh (Baerentzen and Aanaes) */
+struct pseudo_normals
+{
+    /** Normal of each face (3 floats per triangle) */
+    std::vector<float> face;
+    /** Normal of the edge (corner j,corner j+1) of each triangle (9 floats per triangle) */
+    std::vector<float> edge;
+    /** Normal of each vertex (3 floats per vertex) */
+    std::vector<float> vertex;
+};
+
+static void normalize3(float* v)
+{
+    float const n = std::sqrt(v[0]*v[0]+v[1]*v[1]+v[2]*v[2]);
+    if(n>0.0f)
+    {
+        v[0] /= n; v[1] /= n; v[2] /= n;
+    }
+}
+
+static void compute_pseudo_normals(mesh_basic const& m,pseudo_normals& normals)
+{
+    int const N_vertex = m.size_vertex();
+    int const N_triangle = m.size_connectivity();
+    float const* const p = m.pointer_vertex();
+    int const* const tri = m.pointer_triangle_index();
+
+    normals.face.assign(3*N_triangle,0.0f);
+    normals.edge.assign(9*N_triangle,0.0f);
+    normals.vertex.assign(3*N_vertex,0.0f);
+
+    for(int t=0 ; t<N_triangle ; ++t)
+    {
+        float const* const a = p+3*tri[3*t];
+        float const* const b = p+3*tri[3*t+1];
+        float const* const c = p+3*tri[3*t+2];
+        float* const n = &normals.face[3*t];
+        float const u[3] = {b[0]-a[0],b[1]-a[1],b[2]-a[2]};
+        float const v[3] = {c[0]-a[0],c[1]-a[1],c[2]-a[2]};
+        n[0] = u[1]*v[2]-u[2]*v[1];
+        n[1] = u[2]*v[0]-u[0]*v[2];
+        n[2] = u[0]*v[1]-u[1]*v[0];
+        normalize3(n);
+
+        //vertex normals weighted by the angle of the triangle at the vertex
+        for(int j=0 ; j<3 ; ++j)
+        {
+            float const* const q0 = p+3*tri[3*t+j];
+            float const* const q1 = p+3*tri[3*t+(j+1)%3];
+            float const* const q2 = p+3*tri[3*t+(j+2)%3];
+            float e1[3] = {q1[0]-q0[0],q1[1]-q0[1],q1[2]-q0[2]};
+            float e2[3] = {q2[0]-q0[0],q2[1]-q0[1],q2[2]-q0[2]};
+            normalize3(e1);
+            normalize3(e2);
+            float const cos_angle = std::max(-1.0f,std::min(1.0f,e1[0]*e2[0]+e1[1]*e2[1]+e1[2]*e2[2]));
+            float const angle = std::acos(cos_angle);
+            float* const nv = &normals.vertex[3*tri[3*t+j]];
+            for(int d=0 ; d<3 ; ++d)
+                nv[d] += angle*n[d];
+        }
+    }
+    for(int k=0 ; k<N_vertex ; ++k)
+        normalize3(&normals.vertex[3*k]);
+
+    //edge normals: sum of the normals of the triangles sharing the edge (sorted half edges)
+    struct half_edge
+    {
+        int a,b;
+        int slot;
+        bool operator<(half_edge const& e) const {return a<e.a || (a==e.a && (b<e.b || (b==e.b && slot<e.slot)));}
+    };
+    std::vector<half_edge> half_edges(3*N_triangle);
+    for(int t=0 ; t<N_triangle ; ++t)
+        for(int j=0 ; j<3 ; ++j)
+        {
+            int const i0 = tri[3*t+j], i1 = tri[3*t+(j+1)%3];
+            half_edges[3*t+j] = {std::min(i0,i1),std::max(i0,i1),3*t+j};
+        }
+    std::sort(half_edges.begin(),half_edges.end());
+
+    int const N_half_edge = half_edges.size();
+    for(int begin=0 ; begin<N_half_edge ; )
+    {
+        int end = begin+1;
+        while(end<N_half_edge && half_edges[end].a==half_edges[begin].a && half_edges[end].b==half_edges[begin].b)
+            ++end;
+
+        float n[3] = {0.0f,0.0f,0.0f};
+        for(int k=begin ; k<end ; ++k)
+            for(int d=0 ; d<3 ; ++d)
+                n[d] += normals.face[3*(half_edges[k].slot/3)+d];
+        normalize3(n);
+        for(int k=begin ; k<end ; ++k)
+            for(int d=0 ; d<3 ; ++d)
+                normals.edge[3*half_edges[k].slot+d] = n[d];
+        begin = end;
+    }
+}
+
+/** Signed distance from p to the mesh, clamped to [-band,band] */
+static float clamped_signed_distance(bvh const& tree,pseudo_normals const& normals,mesh_basic const& m,vec3 const& p,float const band)
+{
+    bvh_closest_point closest;
+    float distance = band;
+    if(tree.closest_point(p,band,closest))
+        distance = closest.distance;
+    else
+        tree.closest_point(p,-1.0f,closest);
+
+    //barycentric coordinates of the closest point: closest feature
+    float const* const vertex = m.pointer_vertex();
+    int const* const tri = m.pointer_triangle_index()+3*closest.triangle;
+    vec3 const a(vertex[3*tri[0]],vertex[3*tri[0]+1],vertex[3*tri[0]+2]);
+    vec3 const b(vertex[3*tri[1]],vertex[3*tri[1]+1],vertex[3*tri[1]+2]);
+    vec3 const c(vertex[3*tri[2]],vertex[3*tri[2]+1],vertex[3*tri[2]+2]);
+    vec3 const v0 = b-a, v1 = c-a, v2 = closest.point-a;
+    float const d00 = dot(v0,v0), d01 = dot(v0,v1), d11 = dot(v1,v1);
+    float const d20 = dot(v2,v0), d21 = dot(v2,v1);
+    float const denom = d00*d11-d01*d01;
+
+    float weight[3] = {1.0f/3,1.0f/3,1.0f/3};
+    if(denom>0.0f)
+    {
+        weight[1] = (d11*d20-d01*d21)/denom;
+        weight[2] = (d00*d21-d01*d20)/denom;
+        weight[0] = 1.0f-weight[1]-weight[2];
+    }
+
+    float const epsilon = 1e-5f;
+    int N_zero = 0, zero = 0, nonzero = 0;
+    for(int j=0 ; j<3 ; ++j)
+    {
+        if(weight[j]<epsilon)
+        {
+            ++N_zero;
+            zero = j;
+        }
+        else
+            nonzero = j;
+    }
+
+    float const* n = &normals.face[3*closest.triangle];
+    if(N_zero==2)
+        n = &normals.vertex[3*tri[nonzero]];
+    else if(N_zero==1)
+        n = &normals.edge[3*(3*closest.triangle+(zero+1)%3)];
+
+    vec3 const d = p-closest.point;
+    bool const inside = d.x()*n[0]+d.y()*n[1]+d.z()*n[2]<0.0f;
+    return inside ? -distance : distance;
+}
+
+void signed_distance_field::build(mesh_basic const& m,float const voxel_size,float const band_value)
+{
+    ASSERT_CPE(voxel_size>0.0f,"Voxel size should be >0");
+    ASSERT_CPE(band_value>=voxel_size,"The band should be at least one voxel");
+    ASSERT_CPE(m.size_connectivity()>0,"Cannot build a distance field without triangle");
+
+    h = voxel_size;
+    band_width = band_value;
+
+    bvh tree;
+    tree.build(m);
+    pseudo_normals normals;
+    compute_pseudo_normals(m,normals);
+
+    //grid around the mesh, at more than the band from its bounding box
+    float const* const vertex = m.pointer_vertex();
+    float p_min[3] = {vertex[0],vertex[1],vertex[2]};
+    float p_max[3] = {vertex[0],vertex[1],vertex[2]};
+    for(int k=1 ; k<m.size_vertex() ; ++k)
+        for(int d=0 ; d<3 ; ++d)
+        {
+            p_min[d] = std::min(p_min[d],vertex[3*k+d]);
+            p_max[d] = std::max(p_max[d],vertex[3*k+d]);
+        }
+
+    float const margin = band_width+h;
+    float const block_length = block_size*h;
+    long N_block_total = 1;
+    for(int d=0 ; d<3 ; ++d)
+    {
+        float const extent = p_max[d]-p_min[d]+2.0f*margin;
+        N_block[d] = std::max(1,static_cast<int>(std::ceil(extent/block_length)));
+        N_cell[d] = block_size*N_block[d];
+        N_block_total *= N_block[d];
+    }
+    ASSERT_CPE(N_block_total<(1L<<31),"Too many blocks, increase the voxel size");
+    grid_origin = vec3(p_min[0]-margin,p_min[1]-margin,p_min[2]-margin);
+
+    //blocks close to the surface, sign of the others
+    int const N_total = N_block_total;
+    std::vector<char> in_band(N_total,0);
+    block_index.assign(N_total,0);
+    float const half_diagonal = 0.5f*std::sqrt(3.0f)*block_length;
+    #pragma omp parallel for schedule(dynamic,64)
+    for(int b=0 ; b<N_total ; ++b)
+    {
+        int const bx = b%N_block[0];
+        int const by = (b/N_block[0])%N_block[1];
+        int const bz = b/(N_block[0]*N_block[1]);
+        vec3 const center = grid_origin+block_length*vec3(bx+0.5f,by+0.5f,bz+0.5f);
+        bvh_closest_point closest;
+        if(tree.closest_point(center,band_width+half_diagonal,closest))
+            in_band[b] = 1;
+        else
+            block_index[b] = clamped_signed_distance(tree,normals,m,center,band_width)<0.0f ? 1 : 0;
+    }
+
+    //samples of the band blocks, after the two constant blocks
+    int N_stored = 2;
+    for(int b=0 ; b<N_total ; ++b)
+        if(in_band[b])
+            block_index[b] = N_stored++;
+
+    values.resize(static_cast<size_t>(N_stored)*block_samples);
+    std::fill(values.begin(),values.begin()+block_samples,band_width);
+    std::fill(values.begin()+block_samples,values.begin()+2*block_samples,-band_width);
+
+    #pragma omp parallel for schedule(dynamic,1)
+    for(int b=0 ; b<N_total ; ++b)
+    {
+        if(!in_band[b])
+            continue;
+        int const bx = b%N_block[0];
+        int const by = (b/N_block[0])%N_block[1];
+        int const bz = b/(N_block[0]*N_block[1]);
+        float* const block_values = &values[static_cast<size_t>(block_index[b])*block_samples];
+        for(int kz=0 ; kz<block_side ; ++kz)
+            for(int ky=0 ; ky<block_side ; ++ky)
+                for(int kx=0 ; kx<block_side ; ++kx)
+                {
+                    vec3 const p = grid_origin+h*vec3(block_size*bx+kx,block_size*by+ky,block_size*bz+kz);
+                    block_values[kx+block_side*(ky+block_side*kz)] = clamped_signed_distance(tree,normals,m,p,band_width);
+                }
+    }
+}
+
+void signed_distance_field::save(std::string const& filename) const
+{
+    ASSERT_CPE(!empty(),"Cannot save an empty distance field");
+    std::ofstream fid(filename.c_str(),std::ios::binary);
+    if(!fid.good())
+        throw exception_cpe("Cannot open file "+filename,EXCEPTION_PARAMETERS_CPE);
+
+    float const header_float[5] = {grid_origin.x(),grid_origin.y(),grid_origin.z(),h,band_width};
+    int32_t const header_int[4] = {N_block[0],N_block[1],N_block[2],static_cast<int32_t>(values.size()/block_samples)};
+
+    fid.write(file_magic,sizeof(file_magic));
+    fid.write(reinterpret_cast<char const*>(&file_version),sizeof(file_version));
+    fid.write(reinterpret_cast<char const*>(header_float),sizeof(header_float));
+    fid.write(reinterpret_cast<char const*>(header_int),sizeof(header_int));
+    fid.write(reinterpret_cast<char const*>(block_index.data()),block_index.size()*sizeof(int32_t));
+    fid.write(reinterpret_cast<char const*>(values.data()),values.size()*sizeof(float));
+
+    if(!fid.good())
+        throw exception_cpe("Error while writing file "+filename,EXCEPTION_PARAMETERS_CPE);
+}
+
+void signed_distance_field::load(std::string const& filename)
+{
+    std::ifstream fid(filename.c_str(),std::ios::binary);
+    if(!fid.good())
+        throw exception_cpe("Cannot open file "+filename,EXCEPTION_PARAMETERS_CPE);
+
+    char magic[sizeof(file_magic)];
+    uint32_t version = 0;
+    float header_float[5];
+    int32_t header_int[4];
+    fid.read(magic,sizeof(magic));
+    fid.read(reinterpret_cast<char*>(&version),sizeof(version));
+    fid.read(reinterpret_cast<char*>(header_float),sizeof(header_float));
+    fid.read(reinterpret_cast<char*>(header_int),sizeof(header_int));
+    if(!fid.good() || std::memcmp(magic,file_magic,sizeof(file_magic))!=0)
+        throw exception_cpe("File "+filename+" is not a distance field",EXCEPTION_PARAMETERS_CPE);
+    if(version!=file_version)
+        throw exception_cpe("Unsupported version "+std::to_string(version)+" of distance field in "+filename,EXCEPTION_PARAMETERS_CPE);
+
+    long N_block_total = 1;
+    for(int d=0 ; d<3 ; ++d)
+    {
+        if(header_int[d]<=0)
+            throw exception_cpe("Incorrect grid size in "+filename,EXCEPTION_PARAMETERS_CPE);
+        N_block_total *= header_int[d];
+    }
+    int const N_stored = header_int[3];
+    if(N_block_total>=(1L<<31) || N_stored<2 || !(header_float[3]>0.0f) || !(header_float[4]>0.0f))
+        throw exception_cpe("Incorrect header in "+filename,EXCEPTION_PARAMETERS_CPE);
+
+    std::vector<int> index(N_block_total);
+    std::vector<float> samples(static_cast<size_t>(N_stored)*block_samples);
+    fid.read(reinterpret_cast<char*>(index.data()),index.size()*sizeof(int32_t));
+    fid.read(reinterpret_cast<char*>(samples.data()),samples.size()*sizeof(float));
+    if(!fid.good())
+        throw exception_cpe("Truncated distance field in "+filename,EXCEPTION_PARAMETERS_CPE);
+    for(int const b : index)
+        if(b<0 || b>=N_stored)
+            throw exception_cpe("Incorrect block index in "+filename,EXCEPTION_PARAMETERS_CPE);
+
+    grid_origin = vec3(header_float[0],header_float[1],header_float[2]);
+    h = header_float[3];
+    band_width = header_float[4];
+    for(int d=0 ; d<3 ; ++d)
+    {
+        N_block[d] = header_int[d];
+        N_cell[d] = block_size*N_block[d];
+    }
+    block_index.swap(index);
+    values.swap(samples);
+}
+
+static sdf_lookup make_lookup(vec3 const& origin,float const h,int const* N_cell,int const* N_block,std::vector<int> const& block_index,std::vector<float> const& values)
+{
+    sdf_lookup g;
+    g.origin[0] = origin.x(); g.origin[1] = origin.y(); g.origin[2] = origin.z();
+    g.inv_h = 1.0f/h;
+    for(int d=0 ; d<3 ; ++d)
+    {
+        g.limit[d] = N_cell[d]-1e-3f;
+        g.N_block[d] = N_block[d];
+    }
+    g.block_index = block_index.data();
+    g.values = values.data();
+    return g;
+}
+
+/** Distance and gradient at one point (reference implementation) */
+static void sample_point(sdf_lookup const& g,float const x,float const y,float const z,float& distance,float& gx,float& gy,float& gz)
+{
+    float const fx = std::min(std::max((x-g.origin[0])*g.inv_h,0.0f),g.limit[0]);
+    float const fy = std::min(std::max((y-g.origin[1])*g.inv_h,0.0f),g.limit[1]);
+    float const fz = std::min(std::max((z-g.origin[2])*g.inv_h,0.0f),g.limit[2]);
+    int const i = static_cast<int>(fx), j = static_cast<int>(fy), k = static_cast<int>(fz);
+    float const tx = fx-i, ty = fy-j, tz = fz-k;
+
+    int const block = g.block_index[(i>>3)+g.N_block[0]*((j>>3)+g.N_block[1]*(k>>3))];
+    float const* const c = g.values+static_cast<size_t>(block)*block_samples+(i&7)+block_side*((j&7)+block_side*(k&7));
+    float const c000 = c[corner_offset[0]], c100 = c[corner_offset[1]], c010 = c[corner_offset[2]], c110 = c[corner_offset[3]];
+    float const c001 = c[corner_offset[4]], c101 = c[corner_offset[5]], c011 = c[corner_offset[6]], c111 = c[corner_offset[7]];
+
+    //interpolation along x, then y, then z
+    float const c00 = c000+tx*(c100-c000), c10 = c010+tx*(c110-c010);
+    float const c01 = c001+tx*(c101-c001), c11 = c011+tx*(c111-c011);
+    float const c0 = c00+ty*(c10-c00), c1 = c01+ty*(c11-c01);
+    distance = c0+tz*(c1-c0);
+
+    float const dx00 = c100-c000, dx10 = c110-c010, dx01 = c101-c001, dx11 = c111-c011;
+    float const dx0 = dx00+ty*(dx10-dx00), dx1 = dx01+ty*(dx11-dx01);
+    gx = (dx0+tz*(dx1-dx0))*g.inv_h;
+    gy = ((c10-c00)+tz*((c11-c01)-(c10-c00)))*g.inv_h;
+    gz = (c1-c0)*g.inv_h;
+}
+
+/** 8 points per instruction (AVX2 gathers of the block indices and of the 8 corners) */
+__attribute__((target("avx2,fma")))
+static void sample_block_avx2(sdf_lookup const& g,float const* x,float const* y,float const* z,float* distance,float* gx,float* gy,float* gz)
+{
+    __m256 const zero = _mm256_setzero_ps();
+    __m256 const inv_h = _mm256_set1_ps(g.inv_h);
+    __m256 const fx = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(x),_mm256_set1_ps(g.origin[0])),inv_h),zero),_mm256_set1_ps(g.limit[0]));
+    __m256 const fy = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(y),_mm256_set1_ps(g.origin[1])),inv_h),zero),_mm256_set1_ps(g.limit[1]));
+    __m256 const fz = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(z),_mm256_set1_ps(g.origin[2])),inv_h),zero),_mm256_set1_ps(g.limit[2]));
+    __m256i const i = _mm256_cvttps_epi32(fx);
+    __m256i const j = _mm256_cvttps_epi32(fy);
+    __m256i const k = _mm256_cvttps_epi32(fz);
+    __m256 const tx = _mm256_sub_ps(fx,_mm256_cvtepi32_ps(i));
+    __m256 const ty = _mm256_sub_ps(fy,_mm256_cvtepi32_ps(j));
+    __m256 const tz = _mm256_sub_ps(fz,_mm256_cvtepi32_ps(k));
+
+    __m256i const block_linear = _mm256_add_epi32(_mm256_srli_epi32(i,3),
+                                 _mm256_mullo_epi32(_mm256_set1_epi32(g.N_block[0]),
+                                 _mm256_add_epi32(_mm256_srli_epi32(j,3),_mm256_mullo_epi32(_mm256_set1_epi32(g.N_block[1]),_mm256_srli_epi32(k,3)))));
+    __m256i const block = _mm256_i32gather_epi32(g.block_index,block_linear,4);
+
+    __m256i const seven = _mm256_set1_epi32(7);
+    __m256i const side = _mm256_set1_epi32(block_side);
+    __m256i const local = _mm256_add_epi32(_mm256_and_si256(i,seven),
+                          _mm256_mullo_epi32(side,_mm256_add_epi32(_mm256_and_si256(j,seven),_mm256_mullo_epi32(side,_mm256_and_si256(k,seven)))));
+    __m256i const base = _mm256_add_epi32(_mm256_mullo_epi32(block,_mm256_set1_epi32(block_samples)),local);
+
+    __m256 c[8];
+    for(int n=0 ; n<8 ; ++n)
+        c[n] = _mm256_i32gather_ps(g.values,_mm256_add_epi32(base,_mm256_set1_epi32(corner_offset[n])),4);
+
+    //same operations as sample_point
+    __m256 const c00 = _mm256_fmadd_ps(tx,_mm256_sub_ps(c[1],c[0]),c[0]);
+    __m256 const c10 = _mm256_fmadd_ps(tx,_mm256_sub_ps(c[3],c[2]),c[2]);
+    __m256 const c01 = _mm256_fmadd_ps(tx,_mm256_sub_ps(c[5],c[4]),c[4]);
+    __m256 const c11 = _mm256_fmadd_ps(tx,_mm256_sub_ps(c[7],c[6]),c[6]);
+    __m256 const c0 = _mm256_fmadd_ps(ty,_mm256_sub_ps(c10,c00),c00);
+    __m256 const c1 = _mm256_fmadd_ps(ty,_mm256_sub_ps(c11,c01),c01);
+    _mm256_storeu_ps(distance,_mm256_fmadd_ps(tz,_mm256_sub_ps(c1,c0),c0));
+
+    __m256 const dx00 = _mm256_sub_ps(c[1],c[0]), dx10 = _mm256_sub_ps(c[3],c[2]);
+    __m256 const dx01 = _mm256_sub_ps(c[5],c[4]), dx11 = _mm256_sub_ps(c[7],c[6]);
+    __m256 const dx0 = _mm256_fmadd_ps(ty,_mm256_sub_ps(dx10,dx00),dx00);
+    __m256 const dx1 = _mm256_fmadd_ps(ty,_mm256_sub_ps(dx11,dx01),dx01);
+    _mm256_storeu_ps(gx,_mm256_mul_ps(_mm256_fmadd_ps(tz,_mm256_sub_ps(dx1,dx0),dx0),inv_h));
+    __m256 const dy0 = _mm256_sub_ps(c10,c00), dy1 = _mm256_sub_ps(c11,c01);
+    _mm256_storeu_ps(gy,_mm256_mul_ps(_mm256_fmadd_ps(tz,_mm256_sub_ps(dy1,dy0),dy0),inv_h));
+    _mm256_storeu_ps(gz,_mm256_mul_ps(_mm256_sub_ps(c1,c0),inv_h));
+}
+
+void signed_distance_field::sample_scalar(float const* x,float const* y,float const* z,int const N,float* distance,float* gx,float* gy,float* gz) const
+{
+    ASSERT_CPE(!empty(),"Empty distance field");
+    sdf_lookup const g = make_lookup(grid_origin,h,N_cell,N_block,block_index,values);
+
+    #pragma omp parallel for schedule(static)
+    for(int k=0 ; k<N ; ++k)
+        sample_point(g,x[k],y[k],z[k],distance[k],gx[k],gy[k],gz[k]);
+}
+
+void signed_distance_field::sample(float const* x,float const* y,float const* z,int const N,float* distance,float* gx,float* gy,float* gz) const
+{
+    static bool const avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    if(!avx2)
+    {
+        sample_scalar(x,y,z,N,distance,gx,gy,gz);
+        return;
+    }
+
+    ASSERT_CPE(!empty(),"Empty distance field");
+    sdf_lookup const g = make_lookup(grid_origin,h,N_cell,N_block,block_index,values);
+
+    int const N_simd = N-N%8;
+    #pragma omp parallel for schedule(static)
+    for(int k=0 ; k<N_simd ; k+=8)
+        sample_block_avx2(g,x+k,y+k,z+k,distance+k,gx+k,gy+k,gz+k);
+    for(int k=N_simd ; k<N ; ++k)
+        sample_point(g,x[k],y[k],z[k],distance[k],gx[k],gy[k],gz[k]);
+}
+
+float signed_distance_field::distance(vec3 const& p) const
+{
+    ASSERT_CPE(!empty(),"Empty distance field");
+    sdf_lookup const g = make_lookup(grid_origin,h,N_cell,N_block,block_index,values);
+    float d,gx,gy,gz;
+    sample_point(g,p.x(),p.y(),p.z(),d,gx,gy,gz);
+    return d;
+}
+
+bool signed_distance_field::empty() const
+{
+    return values.empty();
+}
+
+float signed_distance_field::voxel_size() const
+{
+    return h;
+}
+
+float signed_distance_field::band() const
+{
+    return band_width;
+}
+
+vec3 const& signed_distance_field::origin() const
+{
+    return grid_origin;
+}
+
+int signed_distance_field::size_cell(int const axis) const
+{
+    ASSERT_CPE(axis>=0 && axis<3,"Incorrect axis");
+    return N_cell[axis];
+}
+
+int signed_distance_field::size_band_block() const
+{
+    return empty() ? 0 : values.size()/block_samples-2;
+}
+
+long signed_distance_field::memory_size() const
+{
+    return values.size()*sizeof(float)+block_index.size()*sizeof(int);
+}
+
+}
@@ -0,0 +1,98 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef SIGNED_DISTANCE_FIELD_HPP
+#define SIGNED_DISTANCE_FIELD_HPP
+
+#include "../3d/vec3.hpp"
+#include <string>
+#include <vector>
+
+namespace cpe
+{
+
+class mesh_basic;
+
+/** Signed distance to a closed triangle mesh sampled on a sparse narrow band grid.
+ *
+ *  The grid is split into blocks of 8x8x8 cells. Only the blocks close to
+ *  the surface (closer than the band) store their samples: 9x9x9 values at
+ *  the corners of their cells, so the 8 corners of any cell are in the same
+ *  block. The other blocks point to one of two constant blocks (+band outside,
+ *  -band inside), so the lookup is the same for every point: one block index
+ *  and 8 values, whatever the number of triangles of the mesh.
+ *
+ *  The distance is trilinear in each cell, the gradient is the derivative of
+ *  this interpolation. Outside the grid the coordinates are clamped (the
+ *  border of the grid is at more than the band from the mesh, the distance is
+ *  +band with a zero gradient). Negative inside the mesh, positive outside.
+ *
+ *  The sign is given by the angle weighted pseudo-normals of the closest
+ *  feature (face, edge or vertex): the mesh must be closed and consistently
+ *  oriented (counter clockwise seen from outside). */
+class signed_distance_field
+{
+public:
+
+    /** Sample the mesh with cells of size voxel_size, values stored up to a distance band from the surface */
+    void build(mesh_basic const& m,float voxel_size,float band);
+
+    /** Write the field in a binary file (see load) */
+    void save(std::string const& filename) const;
+    /** Read a field written by save, throws if the file is not a valid field */
+    void load(std::string const& filename);
+
+    /** Distance and gradient at N points given as coordinate arrays (SIMD when available, parallel) */
+    void sample(float const* x,float const* y,float const* z,int N,float* distance,float* gx,float* gy,float* gz) const;
+    /** Reference scalar implementation of sample */
+    void sample_scalar(float const* x,float const* y,float const* z,int N,float* distance,float* gx,float* gy,float* gz) const;
+    /** Distance at a single point */
+    float distance(vec3 const& p) const;
+
+    bool empty() const;
+    float voxel_size() const;
+    float band() const;
+    /** Lower corner of the grid */
+    vec3 const& origin() const;
+    /** Number of cells along the axis (0,1,2) */
+    int size_cell(int axis) const;
+    /** Number of blocks storing samples (the two constant blocks excluded) */
+    int size_band_block() const;
+    /** Memory used by the samples and the block indices (bytes) */
+    long memory_size() const;
+
+private:
+
+    vec3 grid_origin;
+    float h = 0.0f;
+    float band_width = 0.0f;
+    /** Number of cells along each axis (multiple of the block size) */
+    int N_cell[3] = {0,0,0};
+    /** Number of blocks along each axis */
+    int N_block[3] = {0,0,0};
+    /** Block of samples of each block of the grid (0: constant outside, 1: constant inside) */
+    std::vector<int> block_index;
+    /** Samples of the blocks, 9x9x9 values per block (x fastest) */
+    std::vector<float> values;
+};
+
+}
+
+#endif
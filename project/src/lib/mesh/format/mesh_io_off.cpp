@@ -111,7 +111,28 @@ mesh load_mesh_file_off(std::string const& filename)
     return m;
 }
 
+void save_mesh_file_off(mesh_basic const& m,std::string const& filename)
+{
+    std::ofstream fid(filename.c_str());
+    if(!fid.good())
+        throw exception_cpe("Cannot open file "+filename,EXCEPTION_PARAMETERS_CPE);
+
+    int const N_vertex = m.size_vertex();
+    int const N_triangle = m.size_connectivity();
+
+    fid<<"OFF"<<std::endl;
+    fid<<N_vertex<<" "<<N_triangle<<" 0"<<std::endl;
 
+    float const* const p = N_vertex>0 ? m.pointer_vertex() : nullptr;
+    for(int k=0;k<N_vertex;++k)
+        fid<<p[3*k+0]<<" "<<p[3*k+1]<<" "<<p[3*k+2]<<std::endl;
+
+    int const* const tri = N_triangle>0 ? m.pointer_triangle_index() : nullptr;
+    for(int k=0;k<N_triangle;++k)
+        fid<<"3 "<<tri[3*k+0]<<" "<<tri[3*k+1]<<" "<<tri[3*k+2]<<std::endl;
 
+    if(!fid.good())
+        throw exception_cpe("Problem while writing file "+filename,EXCEPTION_PARAMETERS_CPE);
 }
 
+}
@@ -26,9 +26,12 @@
 namespace cpe
 {
 class mesh;
+class mesh_basic;
 
 /** Load a mesh structure from a OFF file */
 mesh load_mesh_file_off(std::string const& filename);
+/** Save the vertices and triangles of a mesh in a OFF file */
+void save_mesh_file_off(mesh_basic const& m,std::string const& filename);
 
 }
 
@@ -38,7 +38,7 @@ vec3& mesh::color(int const index)                       {return mesh_basic::col
 vec2 mesh::texture_coord(int const index) const          {return mesh_basic::texture_coord(index);}
 vec2& mesh::texture_coord(int const index)               {return mesh_basic::texture_coord(index);}
 triangle_index mesh::connectivity(int const index) const {return mesh_basic::connectivity(index);}
-triangle_index& mesh::connectivity(int const index)      {return mesh_basic::connectivity(index);}
+void mesh::set_connectivity(int const index,triangle_index const& idx) {mesh_basic::set_connectivity(index,idx);}
 
 void mesh::add_vertex(vec3 const& v)                     {mesh_basic::add_vertex(v);}
 void mesh::add_normal(vec3 const& n)                     {mesh_basic::add_normal(n);}
@@ -51,11 +51,5 @@ void mesh::load(std::string const& filename)
     *this = load_mesh_file(filename);
 }
 
-void mesh::translate_moving(QTime time){
-    for(vec3& vertex: vertex_data){
-        vertex.x() = sin((double)((double)time.elapsed()));
-    }
-
-}
 
 }
@@ -23,7 +23,7 @@
 
 
 #include "mesh_basic.hpp"
-#include <QTime>
+#include <string>
 
 namespace cpe
 {
@@ -47,7 +47,7 @@ public:
     vec2 texture_coord(int index) const;
     vec2& texture_coord(int index);
     triangle_index connectivity(int index) const;
-    triangle_index& connectivity(int index);
+    void set_connectivity(int index,triangle_index const& idx);
 
     void add_vertex(vec3 const& v);
     void add_normal(vec3 const& n);
@@ -56,7 +56,6 @@ public:
     void add_triangle_index(triangle_index const& idx);
 
     void load(std::string const& filename);
-    void translate_moving(QTime time);
 
 };
 
@@ -103,12 +103,13 @@ triangle_index mesh_basic::connectivity(int const index) const
 
     return connectivity_data[index];
 }
-triangle_index& mesh_basic::connectivity(int const index)
+void mesh_basic::set_connectivity(int const index,triangle_index const& idx)
 {
     ASSERT_CPE(index>=0,"Index ("+std::to_string(index)+") must be positive");
     ASSERT_CPE(index<size_connectivity(),"Index ("+std::to_string(index)+") must be less than the current size of the connectivity ("+std::to_string(size_connectivity())+")");
 
-    return connectivity_data[index];
+    connectivity_data[index] = idx;
+    connectivity_changed();
 }
 
 void mesh_basic::add_vertex(vec3 const& v)
@@ -134,6 +135,59 @@ void mesh_basic::add_texture_coord(vec2 const& t)
 void mesh_basic::add_triangle_index(triangle_index const& idx)
 {
     connectivity_data.push_back(idx);
+    connectivity_changed();
+}
+
+void mesh_basic::connectivity_changed()
+{
+    vertex_triangle_valid = false;
+}
+
+std::vector<int> const& mesh_basic::vertex_triangle_offset() const
+{
+    build_vertex_triangle();
+    return vertex_triangle_offset_data;
+}
+
+std::vector<int> const& mesh_basic::vertex_triangle_index() const
+{
+    build_vertex_triangle();
+    return vertex_triangle_index_data;
+}
+
+void mesh_basic::build_vertex_triangle() const
+{
+    int const N_vertex = size_vertex();
+    if(vertex_triangle_valid && static_cast<int>(vertex_triangle_offset_data.size())==N_vertex+1)
+        return;
+
+    //counting sort of the corners by vertex, the triangles stay in increasing order
+    int const N_triangle = size_connectivity();
+    std::vector<int>& offset = vertex_triangle_offset_data;
+    offset.assign(N_vertex+1,0);
+    for(int k_triangle=0 ; k_triangle<N_triangle ; ++k_triangle)
+    {
+        triangle_index const& tri = connectivity_data[k_triangle];
+        for(int k=0 ; k<3 ; ++k)
+        {
+            ASSERT_CPE(tri[k]>=0 && tri[k]<N_vertex,"Incorrect triangle index");
+            ++offset[tri[k]+1];
+        }
+    }
+    for(int k=0 ; k<N_vertex ; ++k)
+        offset[k+1] += offset[k];
+
+    std::vector<int>& index = vertex_triangle_index_data;
+    index.resize(offset[N_vertex]);
+    std::vector<int> position(offset.begin(),offset.end()-1);
+    for(int k_triangle=0 ; k_triangle<N_triangle ; ++k_triangle)
+    {
+        triangle_index const& tri = connectivity_data[k_triangle];
+        for(int k=0 ; k<3 ; ++k)
+            index[position[tri[k]]++] = k_triangle;
+    }
+
+    vertex_triangle_valid = true;
 }
 
 
@@ -204,7 +258,7 @@ void mesh_basic::fill_normal()
     for(int k_triangle=0;k_triangle<N_triangle;++k_triangle)
     {
         //get current triangle index
-        triangle_index const& tri=connectivity(k_triangle);
+        triangle_index const& tri=connectivity_data[k_triangle];
 
         //check that the index given have correct values
         ASSERT_CPE(tri.u0()>=0 && tri.u0()<N_vertex,"Incorrect triangle index");
@@ -231,6 +285,42 @@ void mesh_basic::fill_normal()
 
 }
 
+void mesh_basic::fill_normal_parallel()
+{
+    int const N_vertex=size_vertex();
+    if(size_normal()!=N_vertex)
+        normal_data.resize(N_vertex);
+
+    std::vector<int> const& offset=vertex_triangle_offset();
+    std::vector<int> const& index=vertex_triangle_index();
+
+    //normal of each triangle (same operations as fill_normal)
+    int const N_triangle=size_connectivity();
+    triangle_normal_data.resize(N_triangle);
+    #pragma omp parallel for schedule(static)
+    for(int k_triangle=0;k_triangle<N_triangle;++k_triangle)
+    {
+        triangle_index const& tri=connectivity_data[k_triangle];
+        vec3 const& p0=vertex_data[tri.u0()];
+        vec3 const& p1=vertex_data[tri.u1()];
+        vec3 const& p2=vertex_data[tri.u2()];
+
+        vec3 const u1=normalized(p1-p0);
+        vec3 const u2=normalized(p2-p0);
+        triangle_normal_data[k_triangle]=normalized(cross(u1,u2));
+    }
+
+    //each vertex sums its triangles in increasing order, as fill_normal
+    #pragma omp parallel for schedule(static)
+    for(int k=0;k<N_vertex;++k)
+    {
+        vec3 n;
+        for(int i=offset[k];i<offset[k+1];++i)
+            n+=triangle_normal_data[index[i]];
+        normal_data[k]=normalized(n);
+    }
+}
+
 void mesh_basic::transform_opposite_normal_orientation()
 {
     for(auto& n : normal_data)
@@ -414,7 +504,7 @@ void mesh_basic::fill_empty_field_by_default()
     int const N_vertex=size_vertex();
 
     if(size_normal()!=N_vertex)
-        fill_normal();
+        fill_normal_parallel();
     ASSERT_CPE(size_normal()==N_vertex,"Invalid normal computation");
 
     if(size_color()!=N_vertex)
@@ -75,6 +75,11 @@ public:
 
     /** Fill automatically the normals of the mesh. */
     void fill_normal();
+    /** Fill the normals with the same values as fill_normal, in two parallel
+     *  passes: the normal of each triangle, then for each vertex the sum over
+     *  its incident triangles (see vertex_triangle_offset). No vertex is
+     *  written by two threads. */
+    void fill_normal_parallel();
 
     /** Fill all the fields (normal, color, texture, etc) if they are not already filled. */
     void fill_empty_field_by_default();
@@ -120,6 +125,18 @@ public:
 
     bool valid_mesh() const;
 
+    /******************************************/
+    // Vertex to triangle table
+    /******************************************/
+
+    /** The triangles incident to the vertex k are
+     *  vertex_triangle_index()[vertex_triangle_offset()[k] .. vertex_triangle_offset()[k+1]-1],
+     *  in increasing order (a triangle is repeated for each of its corners on the vertex).
+     *  The table is built on first use and kept until the connectivity or the
+     *  number of vertices changes (not thread safe). */
+    std::vector<int> const& vertex_triangle_offset() const;
+    std::vector<int> const& vertex_triangle_index() const;
+
 protected:
 
     vec3 vertex(int index) const;
@@ -131,7 +148,8 @@ protected:
     vec2 texture_coord(int index) const;
     vec2& texture_coord(int index);
     triangle_index connectivity(int index) const;
-    triangle_index& connectivity(int index);
+    /** Replace a triangle (invalidates the vertex to triangle table) */
+    void set_connectivity(int index,triangle_index const& idx);
 
 
     void add_vertex(vec3 const& v);
@@ -143,6 +161,10 @@ protected:
     /** Compute the two extremities of the Axis Aligned Bounding Box */
     void compute_mesh_aabb_extremities(vec3& corner_min,vec3& corner_max);
 
+    /** To be called after a direct modification of connectivity_data
+     *  (invalidates the vertex to triangle table) */
+    void connectivity_changed();
+
 
 protected:
 
@@ -158,6 +180,18 @@ protected:
 
     /** Internal storage for the triangles indices */
     std::vector<triangle_index> connectivity_data;
+
+private:
+
+    /** Build the vertex to triangle table from connectivity_data */
+    void build_vertex_triangle() const;
+
+    /** Cached vertex to triangle table (compressed rows) */
+    mutable std::vector<int> vertex_triangle_offset_data;
+    mutable std::vector<int> vertex_triangle_index_data;
+    mutable bool vertex_triangle_valid = false;
+    /** Normals of the triangles used by fill_normal_parallel */
+    std::vector<vec3> triangle_normal_data;
 };
 
 }
@@ -19,6 +19,10 @@
 #include "mesh_parametric.hpp"
 #include "../common/error_handling.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
 namespace cpe
 {
 
@@ -154,6 +158,158 @@ vec2& mesh_parametric::texture_coord(int const ku,int const kv)
     return mesh_basic::texture_coord(offset);
 }
 
+/** In place normalization, same values as normalized() */
+static inline void normalize(float& x,float& y,float& z)
+{
+    float const n = std::sqrt(x*x+y*y+z*z);
+    if(n>1e-6f)
+    {
+        x /= n;
+        y /= n;
+        z /= n;
+    }
+    else
+    {
+        x = 1.0f;
+        y = 0.0f;
+        z = 0.0f;
+    }
+}
+
+/** Normal of the triangle (p0,p1,p2), same operations as fill_normal */
+static inline void triangle_normal(float const* p0,float const* p1,float const* p2,float& nx,float& ny,float& nz)
+{
+    float ax = p1[0]-p0[0], ay = p1[1]-p0[1], az = p1[2]-p0[2];
+    float bx = p2[0]-p0[0], by = p2[1]-p0[1], bz = p2[2]-p0[2];
+    normalize(ax,ay,az);
+    normalize(bx,by,bz);
+    nx = ay*bz-az*by;
+    ny = az*bx-ax*bz;
+    nz = ax*by-ay*bx;
+    normalize(nx,ny,nz);
+}
+
+/** Normals of the two triangles of each quad of the row kv: n[0..2] for the
+ *  triangle (o,o+1,o+Nu+1), n[3..5] for (o,o+Nu+1,o+Nu) with o=ku+Nu*kv */
+static void quad_row_normals(float const* const p,int const Nu,int const kv,float* const* n)
+{
+    float* const n0x = n[0]; float* const n0y = n[1]; float* const n0z = n[2];
+    float* const n1x = n[3]; float* const n1y = n[4]; float* const n1z = n[5];
+    float const* const row = p+3*static_cast<size_t>(Nu)*kv;
+
+    #pragma omp simd
+    for(int ku=0 ; ku<Nu-1 ; ++ku)
+    {
+        float const* const p0 = row+3*ku;
+        float const* const p1 = p0+3;
+        float const* const p2 = p0+3*(Nu+1);
+        float const* const p3 = p0+3*Nu;
+        triangle_normal(p0,p1,p2,n0x[ku],n0y[ku],n0z[ku]);
+        triangle_normal(p0,p2,p3,n1x[ku],n1y[ku],n1z[ku]);
+    }
+}
+
+/** Normal of the vertex ku of a row from the triangles of the quad rows
+ *  below and above it (nullptr on the border of the grid). The triangles are
+ *  summed in the order of fill_normal (increasing index). */
+static void gather_normal(float const* const* below,float const* const* above,int const ku,int const Nu,float* normal)
+{
+    bool const left = ku>0;
+    bool const right = ku<Nu-1;
+    for(int i=0 ; i<3 ; ++i)
+    {
+        float s = 0.0f;
+        if(below!=nullptr && left) {s += below[i][ku-1]; s += below[3+i][ku-1];}
+        if(below!=nullptr && right) s += below[3+i][ku];
+        if(above!=nullptr && left) s += above[i][ku-1];
+        if(above!=nullptr && right) {s += above[i][ku]; s += above[3+i][ku];}
+        normal[i] = s;
+    }
+    normalize(normal[0],normal[1],normal[2]);
+}
+
+void mesh_parametric::fill_normal_grid()
+{
+    if(size_normal()!=size_vertex())
+        normal_data.resize(size_vertex());
+    fill_normal_grid_rows(0,size_v());
+}
+
+void mesh_parametric::fill_normal_grid_rows(int const row_begin,int const row_end)
+{
+    int const Nu = size_u();
+    int const Nv = size_v();
+    ASSERT_CPE(row_begin>=0 && row_begin<=row_end && row_end<=Nv,"Incorrect rows");
+    ASSERT_CPE(size_vertex()==Nu*Nv && size_normal()==Nu*Nv,"Incorrect data size");
+    ASSERT_CPE(size_connectivity()==2*std::max(Nu-1,0)*std::max(Nv-1,0),"The mesh is not the grid of set_plane_xy_unit");
+    if(row_begin==row_end)
+        return;
+
+    float const* const p = pointer_vertex();
+    //vec3 stores its 3 coordinates contiguously (see pointer())
+    float* const normal = reinterpret_cast<float*>(normal_data.data());
+    int const N_quad = Nu-1;
+
+    #pragma omp parallel
+    {
+        //triangle normals of the quad rows below and above the current vertex row
+        std::vector<float> buffer(12*static_cast<size_t>(N_quad));
+        float* below[6];
+        float* above[6];
+        for(int i=0 ; i<6 ; ++i)
+        {
+            below[i] = buffer.data()+i*N_quad;
+            above[i] = buffer.data()+(6+i)*N_quad;
+        }
+
+        //contiguous rows per thread: the quads above a row are below the next one
+        int previous = -2;
+        #pragma omp for schedule(static)
+        for(int kv=row_begin ; kv<row_end ; ++kv)
+        {
+            if(kv==previous+1)
+                std::swap(below,above);
+            else if(kv>0)
+                quad_row_normals(p,Nu,kv-1,below);
+            if(kv<Nv-1)
+                quad_row_normals(p,Nu,kv,above);
+            previous = kv;
+
+            float* const row = normal+3*static_cast<size_t>(Nu)*kv;
+            float const* const* const b = kv>0 ? below : nullptr;
+            float const* const* const a = kv<Nv-1 ? above : nullptr;
+            if(b==nullptr || a==nullptr || Nu<3)
+            {
+                for(int ku=0 ; ku<Nu ; ++ku)
+                    gather_normal(b,a,ku,Nu,row+3*ku);
+                continue;
+            }
+
+            gather_normal(b,a,0,Nu,row);
+            #pragma omp simd
+            for(int ku=1 ; ku<Nu-1 ; ++ku)
+            {
+                float s[3];
+                for(int i=0 ; i<3 ; ++i)
+                {
+                    s[i] = 0.0f;
+                    s[i] += b[i][ku-1];
+                    s[i] += b[3+i][ku-1];
+                    s[i] += b[3+i][ku];
+                    s[i] += a[i][ku-1];
+                    s[i] += a[i][ku];
+                    s[i] += a[3+i][ku];
+                }
+                normalize(s[0],s[1],s[2]);
+                row[3*ku] = s[0];
+                row[3*ku+1] = s[1];
+                row[3*ku+2] = s[2];
+            }
+            gather_normal(b,a,Nu-1,Nu,row+3*(Nu-1));
+        }
+    }
+}
+
 bool mesh_parametric::valid_mesh() const
 {
     int const total_size=size_u()*size_v();
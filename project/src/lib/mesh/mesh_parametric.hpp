@@ -53,6 +53,14 @@ public:
     vec2 texture_coord(int ku,int kv) const;
     vec2& texture_coord(int ku,int kv);
 
+    /** Fill the normals from the one ring of each vertex in the grid.
+     *  Same values as fill_normal for the triangulation of set_plane_xy_unit,
+     *  but each vertex gathers the normals of its 6 triangles (no scatter):
+     *  the rows are computed in parallel. */
+    void fill_normal_grid();
+    /** Fill the normals of the rows [row_begin,row_end[ only (see fill_normal_grid) */
+    void fill_normal_grid_rows(int row_begin,int row_end);
+
     /** Check if the mesh is valid */
     bool valid_mesh() const;
 
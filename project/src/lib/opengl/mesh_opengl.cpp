@@ -182,6 +182,24 @@ void mesh_opengl::update_vbo_normal(mesh_basic const& m)
     glBufferSubData(GL_ARRAY_BUFFER,0,3*sizeof(float)*m.size_normal(),m.pointer_normal()); PRINT_OPENGL_ERROR();
 }
 
+void mesh_opengl::update_vbo_vertex(mesh_basic const& m,int const begin,int const end)
+{
+    ASSERT_CPE(begin>=0 && begin<=end && end<=m.size_vertex(),"Incorrect vertex range");
+    glBindBuffer(GL_ARRAY_BUFFER,vbo_vertex); PRINT_OPENGL_ERROR();
+    ASSERT_CPE(glIsBuffer(vbo_vertex),"vbo_buffer incorrect");
+
+    glBufferSubData(GL_ARRAY_BUFFER,3*sizeof(float)*begin,3*sizeof(float)*(end-begin),m.pointer_vertex()+3*begin); PRINT_OPENGL_ERROR();
+}
+
+void mesh_opengl::update_vbo_normal(mesh_basic const& m,int const begin,int const end)
+{
+    ASSERT_CPE(begin>=0 && begin<=end && end<=m.size_normal(),"Incorrect normal range");
+    glBindBuffer(GL_ARRAY_BUFFER,vbo_normal); PRINT_OPENGL_ERROR();
+    ASSERT_CPE(glIsBuffer(vbo_normal),"vbo_buffer incorrect");
+
+    glBufferSubData(GL_ARRAY_BUFFER,3*sizeof(float)*begin,3*sizeof(float)*(end-begin),m.pointer_normal()+3*begin); PRINT_OPENGL_ERROR();
+}
+
 void mesh_opengl::update_vbo_color(mesh_basic const& m)
 {
     //VBO vertex
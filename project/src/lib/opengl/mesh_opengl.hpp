@@ -47,6 +47,10 @@ public:
     void update_vbo_vertex(mesh_basic const& m);
     /** Update only the normal on the GPU */
     void update_vbo_normal(mesh_basic const& m);
+    /** Update the vertices [begin,end) on the GPU */
+    void update_vbo_vertex(mesh_basic const& m,int begin,int end);
+    /** Update the normals [begin,end) on the GPU */
+    void update_vbo_normal(mesh_basic const& m,int begin,int end);
     /** Update only the color on the GPU */
     void update_vbo_color(mesh_basic const& m);
     /** Update only the texture on the GPU */
@@ -112,4 +112,68 @@ float perlin::operator()(vec4 const& p) const
 }
 
 
+/** Points are processed by blocks small enough to stay in L1 cache */
+static size_t const BATCH_BLOCK = 256;
+
+void perlin::evaluate_batch(float const* x,float const* y,float const* z,float* value,size_t const N) const
+{
+    float sx[BATCH_BLOCK],sy[BATCH_BLOCK],sz[BATCH_BLOCK],noise[BATCH_BLOCK];
+
+    for(size_t begin=0 ; begin<N ; begin+=BATCH_BLOCK)
+    {
+        size_t const n = N-begin<BATCH_BLOCK ? N-begin : BATCH_BLOCK;
+        for(size_t k=0;k<n;++k)
+            value[begin+k] = 0.0f;
+
+        float frequency=1.0f;
+        float persistency=1.0f;
+        for(int octave=0;octave<octave_data;octave++)
+        {
+            for(size_t k=0;k<n;++k)
+            {
+                sx[k] = x[begin+k]*frequency;
+                sy[k] = y[begin+k]*frequency;
+                sz[k] = z[begin+k]*frequency;
+            }
+            snoise3_batch(sx,sy,sz,noise,n);
+            for(size_t k=0;k<n;++k)
+                value[begin+k] += persistency*(0.5f+0.5f*noise[k]);
+
+            frequency *= 2.0f;
+            persistency *= persistency_data;
+        }
+    }
+}
+
+void perlin::evaluate_batch(float const* x,float const* y,float const* z,float const* w,float* value,size_t const N) const
+{
+    float sx[BATCH_BLOCK],sy[BATCH_BLOCK],sz[BATCH_BLOCK],sw[BATCH_BLOCK],noise[BATCH_BLOCK];
+
+    for(size_t begin=0 ; begin<N ; begin+=BATCH_BLOCK)
+    {
+        size_t const n = N-begin<BATCH_BLOCK ? N-begin : BATCH_BLOCK;
+        for(size_t k=0;k<n;++k)
+            value[begin+k] = 0.0f;
+
+        float frequency=1.0f;
+        float persistency=1.0f;
+        for(int octave=0;octave<octave_data;octave++)
+        {
+            for(size_t k=0;k<n;++k)
+            {
+                sx[k] = x[begin+k]*frequency;
+                sy[k] = y[begin+k]*frequency;
+                sz[k] = z[begin+k]*frequency;
+                sw[k] = w[begin+k]*frequency;
+            }
+            snoise4_batch(sx,sy,sz,sw,noise,n);
+            for(size_t k=0;k<n;++k)
+                value[begin+k] += persistency*(0.5f+0.5f*noise[k]);
+
+            frequency *= 2.0f;
+            persistency *= persistency_data;
+        }
+    }
+}
+
 }
@@ -21,6 +21,8 @@
 #ifndef PERLIN_HPP
 #define PERLIN_HPP
 
+#include <cstddef>
+
 namespace cpe
 {
 
@@ -50,6 +52,12 @@ public:
     /** Perlin noise in 4D */
     float operator()(vec4 const& p) const;
 
+    /** Perlin noise in 3D of N points: value[k] = (*this)(vec3(x[k],y[k],z[k]))
+     *  (single precision SIMD noise, each octave evaluated for all the points at once) */
+    void evaluate_batch(float const* x,float const* y,float const* z,float* value,size_t N) const;
+    /** Perlin noise in 4D of N points: value[k] = (*this)(vec4(x[k],y[k],z[k],w[k])) */
+    void evaluate_batch(float const* x,float const* y,float const* z,float const* w,float* value,size_t N) const;
+
 private:
     /** The number of octave (the number of sumation) */
     int octave_data;
@@ -0,0 +1,46 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "counter_rng.hpp"
+
+namespace cpe
+{
+
+uint64_t splitmix64(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+counter_rng::counter_rng(uint64_t const seed,uint64_t const step)
+{
+    uint64_t const key = splitmix64(seed ^ splitmix64(step));
+    key0 = static_cast<uint32_t>(key);
+    key1 = static_cast<uint32_t>(key >> 32);
+}
+
+void counter_rng::fill_uniform(float* const value,int const N,uint32_t const first_index) const
+{
+    #pragma omp parallel for simd schedule(static)
+    for(int k=0 ; k<N ; ++k)
+        value[k] = uniform(first_index+static_cast<uint32_t>(k));
+}
+
+}
@@ -0,0 +1,80 @@
+/*
+**    TP CPE Lyon
+**    Copyright (C) 2015 Damien Rohmer
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef COUNTER_RNG_HPP
+#define COUNTER_RNG_HPP
+
+#include <cstdint>
+
+namespace cpe
+{
+
+/** SplitMix64 finalizer: bijective mixing of a 64 bits value */
+uint64_t splitmix64(uint64_t x);
+
+/** Stateless counter based random generator.
+ *  The value of index i is a pure function of (seed,step,i): there is no
+ *  sequential state, so any subset of the indices can be drawn in any order
+ *  (or in parallel) with identical results. The 64 bits key (seed,step) is
+ *  mixed once by SplitMix64, each index then only needs a few 32 bits
+ *  multiply/xor-shift rounds which the compiler can vectorize. */
+class counter_rng
+{
+public:
+
+    counter_rng(uint64_t seed,uint64_t step);
+
+    /** Random 32 bits integer associated to index */
+    uint32_t uint32(uint32_t index) const;
+    /** Random float uniformly distributed in [0,1) associated to index */
+    float uniform(uint32_t index) const;
+    /** Fill value[k] with uniform(first_index+k) for k in [0,N), in parallel
+     *  (the values do not depend on the number of threads) */
+    void fill_uniform(float* value,int N,uint32_t first_index=0) const;
+
+private:
+
+    uint32_t key0;
+    uint32_t key1;
+};
+
+inline uint32_t counter_rng::uint32(uint32_t const index) const
+{
+    //two rounds of a 32 bits integer hash keyed by the (seed,step) key
+    uint32_t x = index ^ key0;
+    x ^= x >> 16; x *= 0x7feb352du;
+    x ^= x >> 15; x *= 0x846ca68bu;
+    x ^= x >> 16;
+    x += key1;
+    x ^= x >> 16; x *= 0x7feb352du;
+    x ^= x >> 15; x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+inline float counter_rng::uniform(uint32_t const index) const
+{
+    //24 most significant bits: exactly representable float in [0,1)
+    return static_cast<float>(uint32(index) >> 8) * (1.0f/16777216.0f);
+}
+
+}
+
+#endif
@@ -4,6 +4,7 @@
 #include "../../lib/common/error_handling.hpp"
 #include "ui_mainwindow.h"
 
+#include <algorithm>
 #include <iostream>
 
 
@@ -46,7 +47,12 @@ myWindow::myWindow(QWidget *parent)
     connect(ui->toggle_wind,SIGNAL(stateChanged(int)),this,SLOT(action_toggle_wind()));
     connect(ui->wind_force_slider,SIGNAL(valueChanged(int)),this,SLOT(action_wind_force_changed()));
     connect(ui->sphere_scale,SIGNAL(valueChanged(int)),this,SLOT(action_scale_changed()));
+    connect(ui->integrator,SIGNAL(currentIndexChanged(int)),this,SLOT(action_integrator_changed()));
     connect(ui->restart,SIGNAL(clicked()),this,SLOT(action_restart_simulation()));
+    connect(ui->save_checkpoint,SIGNAL(clicked()),this,SLOT(action_save_checkpoint()));
+    connect(ui->record,SIGNAL(clicked()),this,SLOT(action_record()));
+    connect(ui->playback,SIGNAL(clicked()),this,SLOT(action_playback()));
+    connect(ui->playback_position,SIGNAL(valueChanged(int)),this,SLOT(action_playback_position_changed()));
 
 }
 
@@ -114,6 +120,64 @@ void myWindow::action_scale_changed()
                 QString("Sphere scale : ").append(QString::number(ui->sphere_scale->value())));
 }
 
+void myWindow::action_integrator_changed()
+{
+    glWidget->get_scene().set_integrator(
+                static_cast<cpe::cloth_integrator>(ui->integrator->currentIndex()));
+}
+
+
+void myWindow::action_restart_simulation()
+{
+    glWidget->get_scene().restart_simulation();
+    //the playback and the recording, if any, are stopped by the restart
+    ui->record->setChecked(false);
+    ui->playback->setChecked(false);
+    ui->record->setEnabled(true);
+    ui->save_checkpoint->setEnabled(true);
+    ui->playback_position->setEnabled(false);
+}
+
+void myWindow::action_save_checkpoint()
+{
+    glWidget->get_scene().save_checkpoint();
+}
+
+void myWindow::action_record()
+{
+    if(ui->record->isChecked())
+        glWidget->get_scene().start_recording();
+    else
+        glWidget->get_scene().stop_recording();
+}
+
+void myWindow::action_playback()
+{
+    scene& s = glWidget->get_scene();
+    if(ui->playback->isChecked())
+    {
+        //the recording is closed by the playback
+        ui->record->setChecked(false);
+        s.stop_recording();
+        if(!s.start_playback())
+            ui->playback->setChecked(false);
+    }
+    else
+        s.stop_playback();
+
+    ui->record->setEnabled(!s.playing());
+    //the simulated cloth is not updated during the playback
+    ui->save_checkpoint->setEnabled(!s.playing());
+    ui->playback_position->setEnabled(s.playing());
+    ui->playback_position->setRange(0,std::max(0,s.size_playback_frame()-1));
+    ui->playback_position->setValue(0);
+}
+
+void myWindow::action_playback_position_changed()
+{
+    if(glWidget->get_scene().playing())
+        glWidget->get_scene().seek_playback(ui->playback_position->value());
+}
 
 void myWindow::action_update_fps(){
     //ui->fps->setText(QString("Fps : ").append(QString::number(glWidget->get_scene().fps)));
@@ -45,7 +45,18 @@ private slots:
     void action_toggle_wind();
     void action_wind_force_changed();
     void action_scale_changed();
-    //void action_restart_simulation();
+    /** Change the time integration scheme of the cloth */
+    void action_integrator_changed();
+    /** Start the simulation again (from the saved state of the cloth if any) */
+    void action_restart_simulation();
+    /** Save the current state of the cloth, used by the next restarts */
+    void action_save_checkpoint();
+    /** Start or stop the recording of the simulation */
+    void action_record();
+    /** Play the recorded simulation instead of simulating (or go back to the simulation) */
+    void action_playback();
+    /** Continue the playback from the frame of the slider */
+    void action_playback_position_changed();
     void action_update_fps();
 
 private:
@@ -13,7 +13,11 @@
 #include "../../lib/common/error_handling.hpp"
 
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <fstream>
+#include <iostream>
 #include <string>
 #include <sstream>
 
@@ -26,14 +30,13 @@ void scene::change_k_params(float& k_structural, float& k_shearing, float& k_ben
     mesh_cloth.set_k_struct(k_structural);
     mesh_cloth.set_k_shear(k_shearing);
     mesh_cloth.set_k_bend(k_bending);
+    simulation.set_k_params(k_structural,k_shearing,k_bending);
 }
 
 void scene::load_scene()
 {
-    time_integration.restart();
     time_running.start();
     delta_t=0.15f;
-    divergence=false;
 
     //*****************************************//
     // Preload default structure               //
@@ -64,9 +67,159 @@ void scene::load_scene()
     //*****************************************//
     mesh_cloth.set_plane_xy_unit(50,50);
     mesh_cloth.fill_empty_field_by_default();
+    //the parts of the cloth at rest are not simulated nor uploaded
+    mesh_cloth.set_sleeping(true);
     mesh_cloth_opengl.fill_vbo(mesh_cloth);
 
+    //*****************************************//
+    // Start the simulation thread
+    //*****************************************//
+    start_simulation();
+
+}
+
+void scene::start_simulation()
+{
+    simulation_parameters parameters;
+    parameters.ground = mesh_ground.vertex(0).z();
+    parameters.wind = wind;
+    parameters.wind_force = wind_force;
+    parameters.sphere_radius = sphere_radius;
+    parameters.sphere_center = sphere_center;
+    parameters.dt = delta_t;
+    //one time step every 25ms of real time, at most 4 steps at once
+    simulation.start(mesh_cloth,parameters,0.025,4);
+}
+
+void scene::restart_simulation()
+{
+    playback.close();
+
+    //a saved (pre-settled) state if any, the flat cloth otherwise
+    std::ifstream fid(checkpoint_file.c_str(),std::ios::binary);
+    if(fid.good())
+    {
+        try
+        {
+            mesh_cloth.load_checkpoint(checkpoint_file);
+        }
+        catch(cpe::exception_cpe const& e)
+        {
+            std::cout<<std::endl<<e.report_exception()<<std::endl;
+            mesh_cloth.set_plane_xy_unit(mesh_cloth.size_u(),mesh_cloth.size_v());
+        }
+    }
+    else
+        mesh_cloth.set_plane_xy_unit(mesh_cloth.size_u(),mesh_cloth.size_v());
+
+    mesh_cloth.sync_mesh();
+    mesh_cloth.fill_normal_grid();
+    mesh_cloth.fill_empty_field_by_default();
+    mesh_cloth.set_sleeping(true);
+    mesh_cloth_opengl.fill_vbo(mesh_cloth);
+
+    start_simulation();
+}
+
+void scene::save_checkpoint()
+{
+    simulation.save_checkpoint(checkpoint_file);
+}
+
+void scene::start_recording(bool const record_normal)
+{
+    //compressed frames, the error is far below a pixel
+    cloth_cache_info format;
+    format.has_normal = record_normal;
+    format.codec = codec_quantized;
+    simulation.start_recording(record_file,format);
+}
+
+void scene::stop_recording()
+{
+    simulation.stop_recording();
+}
+
+bool scene::start_playback()
+{
+    try
+    {
+        playback.open(record_file);
+        cloth_cache_info const& info = playback.info();
+        if(info.size_u<=1 || info.size_v<=1 || playback.size_frame()==0)
+            throw exception_cpe("The record "+record_file+" does not contain frames of a cloth grid",EXCEPTION_PARAMETERS_CPE);
+    }
+    catch(cpe::exception_cpe const& e)
+    {
+        std::cout<<std::endl<<e.report_exception()<<std::endl;
+        playback.close();
+        return false;
+    }
 
+    //the simulation (and its recording) stops during the playback
+    simulation.stop();
+
+    cloth_cache_info const& info = playback.info();
+    if(info.size_u!=mesh_cloth.size_u() || info.size_v!=mesh_cloth.size_v())
+    {
+        mesh_cloth.set_plane_xy_unit(info.size_u,info.size_v);
+        mesh_cloth.fill_empty_field_by_default();
+        mesh_cloth_opengl.fill_vbo(mesh_cloth);
+    }
+    seek_playback(0);
+    return true;
+}
+
+void scene::stop_playback()
+{
+    if(!playback.is_open())
+        return;
+    playback.close();
+    restart_simulation();
+}
+
+bool scene::playing() const
+{
+    return playback.is_open();
+}
+
+int scene::size_playback_frame() const
+{
+    return playback.size_frame();
+}
+
+void scene::seek_playback(int const frame)
+{
+    playback_start = std::chrono::steady_clock::now()-std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(frame*simulation.step_duration()));
+    playback_frame = -1;
+}
+
+void scene::draw_playback()
+{
+    //recorded frames are shown at the pace of the simulation steps
+    double const elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now()-playback_start).count();
+    int const frame = static_cast<long>(elapsed/simulation.step_duration())%playback.size_frame();
+    if(frame==playback_frame)
+        return;
+    playback_frame = frame;
+
+    bool const has_normal = playback.info().has_normal;
+    playback.read_frame(frame,playback_position,&playback_normal);
+    int const N = playback_position.size();
+    int const Nu = mesh_cloth.size_u();
+    for(int k=0 ; k<N ; ++k)
+        mesh_cloth.vertex(k%Nu,k/Nu) = playback_position[k];
+    if(has_normal)
+    {
+        for(int k=0 ; k<N ; ++k)
+            mesh_cloth.normal(k%Nu,k/Nu) = playback_normal[k];
+    }
+    else
+        mesh_cloth.fill_normal_grid();
+
+    mesh_cloth_opengl.update_vbo_vertex(mesh_cloth);
+    mesh_cloth_opengl.update_vbo_normal(mesh_cloth);
 }
 
 void scene::draw_scene()
@@ -91,36 +244,51 @@ void scene::draw_scene()
 
 
 
-    //try numerical integration (stop computation if divergence)
-    try
+    if(playback.is_open())
+        draw_playback();
+
+    //take the last frame computed by the simulation thread (never blocks)
+    simulation.consume_frame();
+    cloth_frame const& frame = simulation.frame();
+    int const Nu = mesh_cloth.size_u();
+    int const Nv = mesh_cloth.size_v();
+    if(!playback.is_open() && static_cast<int>(frame.position.size())==Nu*Nv)
     {
-        if(divergence==false && time_integration.elapsed() > 5)
+        // a frame of a new run is fully uploaded
+        if(frame.run!=vbo_run)
         {
-            // compute-force / time integration
-
-            mesh_cloth.update_force(mesh_ground.vertex(0).z(),
-                                    wind,wind_force,
-                                    sphere_radius,
-                                    sphere_center);
-            mesh_cloth.integration_step(delta_t);
+            vbo_run = frame.run;
+            vbo_clock = -1;
+        }
 
-            // re-compute normals
-            mesh_cloth.fill_normal();
+        // rendered positions interpolated between the two last steps,
+        // only the tiles moving (or moved since the last draw) are uploaded
+        double const elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now()-frame.time).count();
+        float const alpha = static_cast<float>(std::min(1.0,elapsed/simulation.step_duration()));
+        int const N_tile = frame.tile_motion.size();
+        for(int t=0 ; t<N_tile ; )
+        {
+            if(frame.tile_motion[t]<vbo_clock)
+            {
+                ++t;
+                continue;
+            }
+            int const begin = frame.tile_offset[t];
+            while(t<N_tile && frame.tile_motion[t]>=vbo_clock)
+                ++t;
+            int const end = frame.tile_offset[t];
+
+            for(int k=begin ; k<end ; ++k)
+            {
+                mesh_cloth.vertex(k%Nu,k/Nu) = frame.previous_position[k]+alpha*(frame.position[k]-frame.previous_position[k]);
+                mesh_cloth.normal(k%Nu,k/Nu) = frame.normal[k];
+            }
 
             // update opengl container
-            mesh_cloth_opengl.update_vbo_vertex(mesh_cloth);
-            mesh_cloth_opengl.update_vbo_normal(mesh_cloth);
-
-            time_integration.restart();
-        }
-    }
-    catch(exception_divergence const& e)
-    {
-        if(divergence==false)
-        {
-            std::cout<<"\n\nDivergence, time integration stoped"<<std::endl;
-            divergence = true;
+            mesh_cloth_opengl.update_vbo_vertex(mesh_cloth,begin,end);
+            mesh_cloth_opengl.update_vbo_normal(mesh_cloth,begin,end);
         }
+        vbo_clock = frame.clock;
     }
 
     //draw the cloth
@@ -168,11 +336,6 @@ void scene::set_widget(myWidgetGL* widget_param)
     pwidget=widget_param;
 }
 
-QTime scene::get_time_integration(){
-    return time_integration;
-}
-
-
 static cpe::mesh build_ground(float const L,float const h)
 {
     mesh m;
@@ -215,6 +378,7 @@ cpe::mesh_basic scene::get_sphere_mesh(){
 void scene::toggle_wind(){
     std::cout << "wind toggled !" << std::endl;
     wind = !wind;
+    simulation.set_wind(wind);
 }
 
 bool scene::get_wind(){
@@ -223,6 +387,7 @@ bool scene::get_wind(){
 
 void scene::set_wind_force(int force){
     wind_force = force;
+    simulation.set_wind_force(force);
 }
 
 cpe::mesh_opengl scene::get_sphere_mesh_opengl()
@@ -233,11 +398,19 @@ cpe::mesh_opengl scene::get_sphere_mesh_opengl()
 void scene::set_sphere_center(vec3 center)
 {
     sphere_center = center;
+    simulation.set_sphere(sphere_radius,sphere_center);
 }
 
 void scene::set_sphere_radius(float radius)
 {
     sphere_radius = radius;
+    simulation.set_sphere(sphere_radius,sphere_center);
+}
+
+void scene::set_integrator(cpe::cloth_integrator type)
+{
+    mesh_cloth.set_integrator(type);
+    simulation.set_integrator(type);
 }
 
 
@@ -8,6 +8,7 @@
 
 #include <GL/glew.h>
 #include <GL/gl.h>
+#include <QTime>
 
 #include "../../lib/3d/mat3.hpp"
 #include "../../lib/3d/vec3.hpp"
@@ -15,6 +16,8 @@
 #include "../../lib/opengl/mesh_opengl.hpp"
 #include "../../lib/interface/camera_matrices.hpp"
 #include "../../cloth/mesh_parametric_cloth.hpp"
+#include "../../cloth/simulation_thread.hpp"
+#include "../../cloth/cloth_cache.hpp"
 
 
 #include <vector>
@@ -42,9 +45,6 @@ public:
 
     void change_k_params(float&, float&,float&);
 
-    /** Get the time interpolation to be able to restart the simulation */
-    QTime get_time_integration();
-
     cpe::mesh_parametric_cloth get_mesh_cloth();
     cpe::mesh_opengl get_sphere_mesh_opengl();
     cpe::mesh_basic get_sphere_mesh();
@@ -53,6 +53,28 @@ public:
     void set_wind_force(int wind_force);
     void set_sphere_radius(float sphere_r);
     void set_sphere_center(cpe::vec3 sphere_c);
+    /** Set the time integration scheme of the cloth */
+    void set_integrator(cpe::cloth_integrator type);
+    /** Start the simulation again from the checkpoint file if it exists (written
+     *  by save_checkpoint or cloth_sim --checkpoint), from the flat cloth otherwise */
+    void restart_simulation();
+    /** Write the current state of the simulated cloth in the checkpoint file
+     *  (written by the simulation thread between two steps) */
+    void save_checkpoint();
+    /** Record the following steps of the simulation in the record file */
+    void start_recording(bool record_normal=false);
+    void stop_recording();
+    /** Stop the simulation and play the frames of the record file in loop
+     *  (no simulation: the frames are read from the file). Returns false if
+     *  the file cannot be played */
+    bool start_playback();
+    /** Stop the playback and restart the simulation */
+    void stop_playback();
+    bool playing() const;
+    /** Number of frames of the played record */
+    int size_playback_frame() const;
+    /** Continue the playback from the given frame */
+    void seek_playback(int frame);
     cpe::mesh build_sphere(float radius,cpe::vec3 center);
 
     int fps;
@@ -77,7 +99,7 @@ private:
     cpe::mesh_opengl mesh_ground_opengl;
 
 
-    /** Cloth mesh */
+    /** Cloth mesh (rendered copy, the simulated cloth is owned by the simulation thread) */
     cpe::mesh_parametric_cloth mesh_cloth;
     /** Cloth mesh for OpenGL drawing */
     cpe::mesh_opengl mesh_cloth_opengl;
@@ -95,18 +117,37 @@ private:
     GLuint texture_ground;
 
 
-    /** Time counter */
-    QTime time_integration;
+    /** Time integration of the cloth running on its own thread */
+    cpe::simulation_thread simulation;
+    /** State of the cloth used by restart_simulation */
+    std::string const checkpoint_file = "data/cloth_checkpoint.cpe";
+    /** Frames written by start_recording and read by start_playback */
+    std::string const record_file = "data/cloth_record.ccache";
+    /** Recorded frames played instead of the simulation */
+    cpe::cloth_cache playback;
+    /** Real time at which frame 0 of the playback was (or would have been) shown */
+    std::chrono::steady_clock::time_point playback_start;
+    /** Frame of the playback uploaded to the cloth VBO */
+    int playback_frame = -1;
+    std::vector<cpe::vec3> playback_position;
+    std::vector<cpe::vec3> playback_normal;
+    /** Run and clock of the last frame uploaded to the cloth VBO */
+    int vbo_run = -1;
+    long vbo_clock = -1;
     /** Running time */
     QTime time_running;
 
+    /** Start the simulation thread on the cloth mesh with the current parameters */
+    void start_simulation();
+
+    /** Upload the frame of the playback corresponding to the current time */
+    void draw_playback();
+
     /** Setup the shader for the mesh */
     void setup_shader_mesh(GLuint shader_id);
 
     /** The time interval for the numerical integration */
     float delta_t;
-    /** Variable indicating if the system diverged (stop the time integration) */
-    bool divergence;
     bool wind = false;
     int wind_force = 25;
 